@@ -0,0 +1,358 @@
+#include "AsyncFileWriter.h"
+#include "Logging.h"
+#include "ThreadPool.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+using namespace muduo;
+
+struct AsyncFileWriter::Request {
+  int fd;
+  const char *data;
+  size_t len;
+  off_t offset;
+  DoneCallback done;
+};
+
+namespace muduo {
+namespace detail {
+
+/**
+ * @brief 直接使用系统调用的最小io_uring封装（不依赖liburing）
+ *        SQ只由提交线程（持有AsyncFileWriter::mutex_）写，CQ只由完成线程读
+ */
+struct Uring : noncopyable {
+  Uring() : ringFd(-1), sqRing(NULL), cqRing(NULL), sqes(NULL) {
+    memZero(&params, sizeof params);
+  }
+
+  ~Uring() {
+    if (sqes) {
+      ::munmap(sqes, params.sq_entries * sizeof(struct io_uring_sqe));
+    }
+    if (cqRing && cqRing != sqRing) {
+      ::munmap(cqRing, cqRingSize);
+    }
+    if (sqRing) {
+      ::munmap(sqRing, sqRingSize);
+    }
+    if (ringFd >= 0) {
+      ::close(ringFd);
+    }
+  }
+
+  // 返回false表示内核不支持或没有权限
+  bool init(unsigned entries) {
+    ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (ringFd < 0) {
+      return false;
+    }
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+    sqRing = mmapRing(sqRingSize, IORING_OFF_SQ_RING);
+    if (!sqRing) {
+      return false;
+    }
+    cqRing = (params.features & IORING_FEAT_SINGLE_MMAP)
+                 ? sqRing
+                 : mmapRing(cqRingSize, IORING_OFF_CQ_RING);
+    sqes = static_cast<struct io_uring_sqe *>(mmapRing(
+        params.sq_entries * sizeof(struct io_uring_sqe), IORING_OFF_SQES));
+    return cqRing && sqes;
+  }
+
+  void *mmapRing(size_t size, off_t offset) {
+    void *p = ::mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ringFd, offset);
+    return p == MAP_FAILED ? NULL : p;
+  }
+
+  unsigned *sqField(unsigned off) {
+    return reinterpret_cast<unsigned *>(static_cast<char *>(sqRing) + off);
+  }
+
+  unsigned *cqField(unsigned off) {
+    return reinterpret_cast<unsigned *>(static_cast<char *>(cqRing) + off);
+  }
+
+  // 提交一个写操作（data为NULL时提交NOP，用于唤醒完成线程）
+  // 返回false表示内核没有接收（如EAGAIN、EBUSY），该项已从SQ中撤回
+  bool submit(int fd, const char *data, size_t len, off_t offset,
+              uint64_t userData) {
+    unsigned tail = *sqField(params.sq_off.tail);
+    unsigned mask = *sqField(params.sq_off.ring_mask);
+    unsigned index = tail & mask;
+    struct io_uring_sqe *sqe = &sqes[index];
+    memZero(sqe, sizeof *sqe);
+    if (data) {
+      sqe->opcode = IORING_OP_WRITE;
+      sqe->fd = fd;
+      sqe->addr = reinterpret_cast<uint64_t>(data);
+      sqe->len = static_cast<uint32_t>(len);
+      sqe->off = static_cast<uint64_t>(offset);
+    } else {
+      sqe->opcode = IORING_OP_NOP;
+    }
+    sqe->user_data = userData;
+    sqField(params.sq_off.array)[index] = index;
+    __atomic_store_n(sqField(params.sq_off.tail), tail + 1, __ATOMIC_RELEASE);
+    int n;
+    while ((n = enter(1, 0, 0)) < 0 && errno == EINTR) {
+    }
+    if (n != 1) {
+      // 没有SQPOLL，内核只在io_uring_enter中取SQ，失败时该项还没有被取走
+      __atomic_store_n(sqField(params.sq_off.tail), tail, __ATOMIC_RELEASE);
+      return false;
+    }
+    return true;
+  }
+
+  // 取一个完成事件，没有时阻塞等待
+  void waitCompletion(uint64_t *userData, int32_t *result) {
+    unsigned *headPtr = cqField(params.cq_off.head);
+    for (;;) {
+      unsigned head = *headPtr;
+      unsigned tail =
+          __atomic_load_n(cqField(params.cq_off.tail), __ATOMIC_ACQUIRE);
+      if (head != tail) {
+        unsigned mask = *cqField(params.cq_off.ring_mask);
+        const struct io_uring_cqe *cqes =
+            reinterpret_cast<const struct io_uring_cqe *>(
+                static_cast<char *>(cqRing) + params.cq_off.cqes);
+        *userData = cqes[head & mask].user_data;
+        *result = cqes[head & mask].res;
+        __atomic_store_n(headPtr, head + 1, __ATOMIC_RELEASE);
+        return;
+      }
+      enter(0, 1, IORING_ENTER_GETEVENTS);
+    }
+  }
+
+  int enter(unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, ringFd, toSubmit,
+                                      minComplete, flags, NULL, 0));
+  }
+
+  int ringFd;
+  struct io_uring_params params;
+  size_t sqRingSize;
+  size_t cqRingSize;
+  void *sqRing;
+  void *cqRing;
+  struct io_uring_sqe *sqes;
+};
+
+// 写完len个字节，返回最终的结果（出错时为-errno）
+ssize_t pwriteAll(int fd, const char *data, size_t len, off_t offset) {
+  size_t written = 0;
+  while (written < len) {
+    ssize_t n = ::pwrite(fd, data + written, len - written,
+                         offset + static_cast<off_t>(written));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -errno;
+    }
+    written += static_cast<size_t>(n);
+  }
+  return static_cast<ssize_t>(written);
+}
+
+} // namespace detail
+} // namespace muduo
+
+AsyncFileWriter::AsyncFileWriter(int maxInflight, Backend preferred)
+    : maxInflight_(maxInflight), backend_(preferred), mutex_(), cond_(mutex_),
+      inflight_(0) {
+  assert(maxInflight_ > 0);
+  if (backend_ == kIoUring) {
+    uring_.reset(new detail::Uring);
+    // 多留一个位置给停止时的NOP
+    if (uring_->init(static_cast<unsigned>(maxInflight_ + 1))) {
+      completionThread_.reset(
+          new Thread(std::bind(&AsyncFileWriter::uringCompletionLoop, this),
+                     "AsyncFileWriter"));
+      completionThread_->start();
+    } else {
+      LOG_WARN << "io_uring unavailable (" << strerror_tl(errno)
+               << "), fall back to thread pool";
+      uring_.reset();
+      backend_ = kThreadPool;
+    }
+  }
+  if (backend_ == kThreadPool) {
+    pool_.reset(new ThreadPool("AsyncFileWriter"));
+    pool_->start(maxInflight_);
+  }
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+  waitAll();
+  if (completionThread_) {
+    {
+      MutexLockGuard lock(mutex_);
+      // user_data为0表示停止；此时没有在写的请求，EBUSY等是暂时的
+      while (!uring_->submit(-1, NULL, 0, 0, 0)) {
+        ::sched_yield();
+      }
+    }
+    completionThread_->join();
+  }
+  if (pool_) {
+    pool_->stop();
+  }
+}
+
+void AsyncFileWriter::write(int fd, const char *data, size_t len, off_t offset,
+                            DoneCallback done) {
+  Request *req = new Request{fd, data, len, offset, std::move(done)};
+  {
+    MutexLockGuard lock(mutex_);
+    while (inflight_ >= maxInflight_) {
+      cond_.wait();
+    }
+    ++inflight_;
+    if (backend_ == kIoUring && submitToUring(req)) {
+      return;
+    }
+  }
+  if (backend_ == kIoUring) {
+    // 提交失败，在调用线程中同步写完
+    complete(req, detail::pwriteAll(req->fd, req->data, req->len, req->offset));
+    return;
+  }
+  pool_->run([this, req] {
+    complete(req, detail::pwriteAll(req->fd, req->data, req->len, req->offset));
+  });
+}
+
+bool AsyncFileWriter::submitToUring(Request *req) {
+  mutex_.assertLocked();
+  return uring_->submit(req->fd, req->data, req->len, req->offset,
+                        reinterpret_cast<uint64_t>(req));
+}
+
+void AsyncFileWriter::uringCompletionLoop() {
+  for (;;) {
+    uint64_t userData = 0;
+    int32_t result = 0;
+    uring_->waitCompletion(&userData, &result);
+    if (userData == 0) {
+      break;
+    }
+    Request *req = reinterpret_cast<Request *>(userData);
+    ssize_t n = result;
+    // 只写了一部分或者内核不支持IORING_OP_WRITE，剩下的同步写完
+    if (n >= 0 && static_cast<size_t>(n) < req->len) {
+      ssize_t rest =
+          detail::pwriteAll(req->fd, req->data + n, req->len - n,
+                            req->offset + static_cast<off_t>(n));
+      n = rest < 0 ? rest : n + rest;
+    } else if (n < 0 && n != -EIO && n != -ENOSPC) {
+      n = detail::pwriteAll(req->fd, req->data, req->len, req->offset);
+    }
+    complete(req, n);
+  }
+}
+
+void AsyncFileWriter::complete(Request *req, ssize_t result) {
+  if (result < 0) {
+    fprintf(stderr, "AsyncFileWriter::write() failed %s\n",
+            strerror_tl(static_cast<int>(-result)));
+  }
+  if (req->done) {
+    req->done();
+  }
+  delete req;
+  MutexLockGuard lock(mutex_);
+  --inflight_;
+  cond_.notifyAll();
+}
+
+void AsyncFileWriter::waitAll() {
+  MutexLockGuard lock(mutex_);
+  while (inflight_ > 0) {
+    cond_.wait();
+  }
+}
+
+int AsyncFileWriter::inflight() const {
+  MutexLockGuard lock(mutex_);
+  return inflight_;
+}
+
+FileUtil::AsyncAppendFile::AsyncAppendFile(StringArg filename,
+                                           AsyncFileWriter *writer)
+    : writer_(writer),
+      fd_(::open(filename.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644)),
+      writtenBytes_(0), mutex_(), noPending_(mutex_), pending_(0) {
+  if (fd_ < 0) {
+    fprintf(stderr, "AsyncAppendFile: open %s failed %s\n", filename.c_str(),
+            strerror_tl(errno));
+    return;
+  }
+  // 不能用O_APPEND，否则pwrite会忽略偏移量；从文件末尾开始写
+  struct stat st;
+  if (::fstat(fd_, &st) == 0) {
+    writtenBytes_ = st.st_size;
+  }
+}
+
+FileUtil::AsyncAppendFile::~AsyncAppendFile() {
+  {
+    MutexLockGuard lock(mutex_);
+    while (pending_ > 0) {
+      noPending_.wait();
+    }
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+void FileUtil::AsyncAppendFile::append(const char *data, size_t len,
+                                       AsyncFileWriter::DoneCallback done) {
+  if (fd_ < 0) {
+    // 数据被丢弃，但done仍要调用，调用者靠它释放data
+    if (done) {
+      done();
+    }
+    return;
+  }
+  {
+    MutexLockGuard lock(mutex_);
+    ++pending_;
+  }
+  writer_->write(fd_, data, len, writtenBytes_,
+                 std::bind(&AsyncAppendFile::onWriteDone, this,
+                           std::move(done)));
+  writtenBytes_ += static_cast<off_t>(len);
+}
+
+void FileUtil::AsyncAppendFile::onWriteDone(
+    const AsyncFileWriter::DoneCallback &done) {
+  if (done) {
+    done();
+  }
+  MutexLockGuard lock(mutex_);
+  if (--pending_ == 0) {
+    noPending_.notifyAll();
+  }
+}
@@ -0,0 +1,116 @@
+#ifndef BASE_ASYNCFILEWRITER_H
+#define BASE_ASYNCFILEWRITER_H
+
+#include "Condition.h"
+#include "Mutex.h"
+#include "StringPiece.h"
+#include "Thread.h"
+
+#include <functional>
+#include <memory>
+#include <sys/types.h>
+
+namespace muduo {
+class ThreadPool;
+
+namespace detail {
+struct Uring;
+}
+
+/**
+ * @brief 异步写文件，同时可以有多个写操作在进行
+ *        优先使用io_uring，内核不支持时退化为线程池 + pwrite
+ *        写操作完成后在完成线程中调用回调，此时数据才可以释放或复用
+ */
+class AsyncFileWriter : noncopyable {
+public:
+  typedef std::function<void()> DoneCallback;
+
+  enum Backend {
+    kIoUring,
+    kThreadPool,
+  };
+
+  /**
+   * @brief Construct a new Async File Writer object
+   *
+   * @param maxInflight 最多同时进行的写操作数，超过时write()阻塞
+   * @param preferred 优先使用的实现
+   */
+  explicit AsyncFileWriter(int maxInflight = 4, Backend preferred = kIoUring);
+  ~AsyncFileWriter(); // 等待所有写操作完成
+
+  Backend backend() const { return backend_; }
+
+  /**
+   * @brief 把data开始的len个字节写到fd的offset处，完成后调用done
+   *        data在done被调用之前必须保持有效
+   */
+  void write(int fd, const char *data, size_t len, off_t offset,
+             DoneCallback done);
+
+  /**
+   * @brief 等待所有已提交的写操作完成
+   *
+   */
+  void waitAll();
+
+  int inflight() const;
+
+private:
+  struct Request;
+
+  // 返回false表示提交失败，由调用者同步写
+  bool submitToUring(Request *req);
+  void uringCompletionLoop();
+  void complete(Request *req, ssize_t result);
+
+  const int maxInflight_;
+  Backend backend_;
+  mutable MutexLock mutex_;
+  Condition cond_ GUARDED_BY(mutex_);
+  int inflight_ GUARDED_BY(mutex_);
+  std::unique_ptr<detail::Uring> uring_;
+  std::unique_ptr<Thread> completionThread_; // 收割io_uring的完成事件
+  std::unique_ptr<ThreadPool> pool_;
+};
+
+namespace FileUtil {
+/**
+ * @brief 与AppendFile对应的异步版本，不经过stdio，直接按偏移量提交写操作
+ *        not thread safe
+ */
+class AsyncAppendFile : noncopyable {
+public:
+  /**
+   * @brief Construct a new Async Append File object
+   *
+   * @param filename
+   * @param writer 可以被多个文件共用
+   */
+  AsyncAppendFile(StringArg filename, AsyncFileWriter *writer);
+  ~AsyncAppendFile(); // 等待本文件的写操作完成后关闭
+
+  void append(const char *data, size_t len, AsyncFileWriter::DoneCallback done);
+
+  off_t writtenBytes() const { return writtenBytes_; }
+
+  // 打开文件失败时为false，之后的写入都被忽略（仍然调用done）
+  bool valid() const { return fd_ >= 0; }
+
+private:
+  void onWriteDone(const AsyncFileWriter::DoneCallback &done);
+
+  AsyncFileWriter *writer_;
+  int fd_;
+  off_t writtenBytes_; // 下一个写操作的偏移，即提交过的字节数
+  // 本文件尚未完成的写操作数，析构时要等待其归零
+  MutexLock mutex_;
+  Condition noPending_ GUARDED_BY(mutex_);
+  int pending_ GUARDED_BY(mutex_);
+};
+} // namespace FileUtil
+
+} // namespace muduo
+
+#endif // BASE_ASYNCFILEWRITER_H
@@ -1,21 +1,77 @@
 #include "AsyncLogging.h"
+#include "AsyncFileWriter.h"
+#include "BinaryLogging.h"
 #include "LogFile.h"
+#include "Logging.h"
 #include "Timestamp.h"
 
+#include <inttypes.h>
 #include <stdio.h>
+#include <time.h>
+
+#include <algorithm>
 
 using namespace muduo;
 
+namespace {
+int64_t monotonicNanoseconds() {
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+} // namespace
+
 AsyncLogging::AsyncLogging(const string &basename, off_t rollSize,
-                           int flushInterval)
-    : flushInterval_(flushInterval), running_(false), basename_(basename),
+                           int flushInterval, FrontEnd frontEnd)
+    : flushInterval_(flushInterval), frontEnd_(frontEnd),
+      overloadPolicy_(kDropBuffers),
+      maxPendingBuffers_(kDefaultMaxPendingBuffers),
+      bufferPoolSize_(kDefaultBufferPoolSize),
+      keepBuffersOnDrop_(kDefaultKeepBuffersOnDrop), blockTimeout_(1.0),
+      spillBasename_(basename + ".spill"), vectoredOutput_(false),
+      asyncOutput_(false), maxInflightWrites_(4), running_(false),
+      basename_(basename),
       rollSize_(rollSize),// thread绑定threadFunc回调函数
       thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging"), latch_(1),
-      mutex_(), cond_(mutex_), currentBuffer_(new Buffer),
-      nextBuffer_(new Buffer), buffers_() {
+      mutex_(), cond_(mutex_), notFull_(mutex_), currentBuffer_(new Buffer),
+      nextBuffer_(new Buffer), buffers_(),
+      appendedBytes_("asynclogging_appended_bytes_total",
+                     "Bytes appended by front-end threads",
+                     "log=\"" + basename + "\""),
+      droppedBytes_("asynclogging_dropped_bytes_total",
+                    "Bytes dropped under overload", "log=\"" + basename + "\""),
+      droppedLines_("asynclogging_dropped_lines_total",
+                    "Lines dropped under overload",
+                    "log=\"" + basename + "\""),
+      blockedNanoseconds_("asynclogging_blocked_nanoseconds_total",
+                          "Time front-end threads spent blocked",
+                          "log=\"" + basename + "\""),
+      blockedTimes_("asynclogging_blocked_total",
+                    "Times a front-end thread blocked",
+                    "log=\"" + basename + "\""),
+      spilledBytes_("asynclogging_spilled_bytes_total",
+                    "Bytes written to the spill file",
+                    "log=\"" + basename + "\""),
+      pendingBuffers_("asynclogging_pending_buffers",
+                      "Full buffers waiting for the back end",
+                      "log=\"" + basename + "\"",
+                      [this] {
+                        MutexLockGuard lock(mutex_);
+                        return static_cast<int64_t>(buffers_.size());
+                      }) {
   currentBuffer_->bzero(); // 缓冲区清零
   nextBuffer_->bzero();
-  buffers_.reserve(16); // vector预定大小，避免自动增长（效率更高）
+  buffers_.reserve(maxPendingBuffers_ + 1); // vector预定大小，避免自动增长（效率更高）
+}
+
+AsyncLogging::Stats AsyncLogging::stats() const {
+  Stats stats;
+  stats.droppedBytes = droppedBytes_.value();
+  stats.droppedLines = droppedLines_.value();
+  stats.blockedNanoseconds = blockedNanoseconds_.value();
+  stats.blockedTimes = blockedTimes_.value();
+  stats.spilledBytes = spilledBytes_.value();
+  return stats;
 }
 
 /********************************************************************
@@ -27,31 +83,270 @@ Description :
 （nextBuffer_）移用为当前缓冲区（currentBuffer_）。
 *********************************************************************/
 void AsyncLogging::append(const char *logline, int len) {
+  appendedBytes_.add(len);
+  if (frontEnd_ == kThreadLocalBuffer) {
+    appendToStaging(logline, len);
+  } else {
+    muduo::MutexLockGuard lock(mutex_);
+    appendLocked(logline, len, true);
+  }
+}
+
+void AsyncLogging::appendBinary(const char *block, int len) {
   muduo::MutexLockGuard lock(mutex_);
+  // 待解码的量与文本一样以maxPendingBuffers_块大buffer为上限；
+  // 调用点字典很小，丢了之后的记录都无法解码，总是保留
+  const size_t n = static_cast<size_t>(len);
+  if (len > 0 && block[0] == detail::kBinaryLogBlock && !hasRoom(n)) {
+    if (overloadPolicy_ != kBlockProducers || !waitForRoom(n)) {
+      // 不解析记录，只计入丢弃的字节数；二进制块也无法写入spill文件
+      droppedBytes_.add(len);
+      return;
+    }
+  }
+  binaryBlocks_.append(block, static_cast<size_t>(len));
+  // 攒够一个大buffer的量就唤醒后端，否则等到flushInterval_
+  if (binaryBlocks_.size() >= static_cast<size_t>(detail::kLargeBuffer)) {
+    cond_.notify();
+  }
+}
+
+void AsyncLogging::appendLocked(const char *logline, int len, bool mayBlock) {
+  mutex_.assertLocked();
   // 如果当前buffer的长度大于要添加的日志记录的长度，即当前buffer还有空间，就添加到当前日志。
   if (currentBuffer_->avail() > len) {
     currentBuffer_->append(logline, len);
+    return;
   }
+
+  // 待写的buffer已经达到上限，阻塞前端直到后端腾出空位
+  if (mayBlock && overloadPolicy_ == kBlockProducers &&
+      buffers_.size() >= maxPendingBuffers_) {
+    if (!waitForRoom(0)) {
+      droppedBytes_.add(len);
+      droppedLines_.add();
+      return;
+    }
+    // 等待期间后端可能已经换走了currentBuffer_
+    if (currentBuffer_->avail() > len) {
+      currentBuffer_->append(logline, len);
+      return;
+    }
+  }
+
   // 当前buffer已满。
+  // 把当前buffer添加到buffer数组中。
+  buffers_.push_back(std::move(currentBuffer_));
+  // 如果另一块缓冲区不为空，则将预备好的另一块缓冲区移用为当前缓冲区。
+  if (nextBuffer_) // 存在
+  {
+    currentBuffer_ = std::move(nextBuffer_);
+  }
+  // 其次从空闲buffer池中取一块
+  else if (!emptyBuffers_.empty()) {
+    currentBuffer_ = std::move(emptyBuffers_.back());
+    emptyBuffers_.pop_back();
+  }
+  // 如果前端写入速度太快了，一下子把所有缓冲都用完了，那么只好分配一块新的buffer，作当前缓冲区。
   else {
-    // 把当前buffer添加到buffer数组中。
-    buffers_.push_back(std::move(currentBuffer_));
-    // 如果另一块缓冲区不为空，则将预备好的另一块缓冲区移用为当前缓冲区。
-    if (nextBuffer_) // 存在
-    {
-      currentBuffer_ = std::move(nextBuffer_);
+    currentBuffer_.reset(new Buffer); // Rarely happens
+  }
+  // 添加日志记录。
+  currentBuffer_->append(logline, len);
+  // 通知后端开始写入日志数据。
+  cond_.notify();
+}
+
+bool AsyncLogging::hasRoom(size_t binaryLen) const {
+  mutex_.assertLocked();
+  if (binaryLen == 0) {
+    return buffers_.size() < maxPendingBuffers_;
+  }
+  return binaryBlocks_.size() + binaryLen <=
+         maxPendingBuffers_ * static_cast<size_t>(detail::kLargeBuffer);
+}
+
+bool AsyncLogging::waitForRoom(size_t binaryLen) {
+  mutex_.assertLocked();
+  int64_t start = monotonicNanoseconds();
+  int64_t deadline = start + static_cast<int64_t>(blockTimeout_ * 1e9);
+  int64_t now = start;
+  while (!hasRoom(binaryLen) && running_ && now < deadline) {
+    cond_.notify();
+    notFull_.waitForSeconds(static_cast<double>(deadline - now) / 1e9);
+    now = monotonicNanoseconds();
+  }
+  blockedNanoseconds_.add(now - start);
+  blockedTimes_.add();
+  // 已经stop()的话不再阻塞，交给后端最后一次写入
+  return hasRoom(binaryLen) || !running_;
+}
+
+/********************************************************************
+Description :
+kThreadLocalBuffer模式下，日志先写入当前线程私有的暂存区，只锁暂存区
+自己的mutex（平时无竞争）。暂存区放不下时，才获取mutex_把整个暂存区
+一次性拷贝进currentBuffer_，即每kStagingBuffer字节才争用一次mutex_。
+*********************************************************************/
+void AsyncLogging::appendToStaging(const char *logline, int len) {
+  Staging *staging = threadStaging();
+  muduo::MutexLockGuard stagingLock(staging->mutex);
+  if (staging->buffer.avail() <= len) {
+    muduo::MutexLockGuard lock(mutex_);
+    if (staging->buffer.length() > 0) {
+      appendLocked(staging->buffer.data(), staging->buffer.length(), true);
+      staging->buffer.reset();
     }
-    // 如果前端写入速度太快了，一下子把两块缓冲都用完了，那么只好分配一块新的buffer，作当前缓冲区。
-    else {
-      currentBuffer_.reset(new Buffer); // Rarely happens
+    // 超长的日志直接写入currentBuffer_
+    if (staging->buffer.avail() <= len) {
+      appendLocked(logline, len, true);
+      return;
     }
-    // 添加日志记录。
-    currentBuffer_->append(logline, len);
-    // 通知后端开始写入日志数据。
-    cond_.notify();
+  }
+  staging->buffer.append(logline, len);
+}
+
+AsyncLogging::Staging *AsyncLogging::threadStaging() {
+  StagingHolder &holder = threadStaging_.value();
+  if (__builtin_expect(!holder.staging, 0)) {
+    holder.staging = std::make_shared<Staging>();
+    muduo::MutexLockGuard lock(mutex_);
+    stagings_.push_back(holder.staging);
+  }
+  return holder.staging.get();
+}
+
+/********************************************************************
+Description :
+后端线程每次醒来（超时或有buffer写满）都收集一遍所有暂存区，
+保证不再写日志的线程留在暂存区里的内容也能在flushInterval_内落盘。
+锁的顺序与前端一致：先暂存区的mutex，再mutex_。
+正在被所属线程占用的暂存区（可能正阻塞在kBlockProducers上）直接跳过，
+它写满后会自己交接。
+*********************************************************************/
+void AsyncLogging::collectStagings(bool waitBusy) {
+  std::vector<StagingPtr> stagings;
+  {
+    muduo::MutexLockGuard lock(mutex_);
+    stagings = stagings_;
+  }
+
+  bool hasRetired = false;
+  for (const auto &staging : stagings) {
+    // 先读retired再收集：线程退出前写入的日志一定能在下面被收集到
+    hasRetired = staging->retired || hasRetired;
+    if (waitBusy) {
+      staging->mutex.lock();
+    } else if (!staging->mutex.tryLock()) {
+      continue;
+    }
+    if (staging->buffer.length() > 0) {
+      muduo::MutexLockGuard lock(mutex_);
+      appendLocked(staging->buffer.data(), staging->buffer.length(), false);
+      staging->buffer.reset();
+    }
+    staging->mutex.unlock();
+  }
+
+  if (hasRetired) {
+    muduo::MutexLockGuard lock(mutex_);
+    stagings_.erase(std::remove_if(stagings_.begin(), stagings_.end(),
+                                   [](const StagingPtr &staging) {
+                                     return staging->retired.load();
+                                   }),
+                    stagings_.end());
   }
 }
 
+/********************************************************************
+Description :
+前端陷入死循环，拼命发送日志消息，超过后端的处理能力，这是典型的生产速度
+超过消费速度，会造成数据在内存中的堆积，严重时引发性能问题(可用内存不足)
+或程序崩溃(分配内存失败)。
+前keepBuffersOnDrop_块buffer总是原样写入，其余的按overloadPolicy_处理。
+*********************************************************************/
+void AsyncLogging::handleOverload(BufferVector *buffersToWrite,
+                                  LogFile *output,
+                                  std::unique_ptr<LogFile> *spill) {
+  BufferVector &buffers = *buffersToWrite;
+  const size_t keep = std::min(keepBuffersOnDrop_, buffers.size());
+  char buf[256];
+  // 与日志行的时间格式和时区相同
+  char timebuf[Logger::kTimeLength + 1];
+  timebuf[Logger::formatTime(Timestamp::now(), timebuf)] = '\0';
+
+  if (overloadPolicy_ == kSpillToFile) {
+    if (!*spill) {
+      spill->reset(new LogFile(spillBasename_, rollSize_, false, flushInterval_,
+                               1024, NULL, fileOptions_));
+    }
+    int64_t spilled = 0;
+    for (size_t i = keep; i < buffers.size(); ++i) {
+      (*spill)->append(buffers[i]->data(), buffers[i]->length());
+      spilled += buffers[i]->length();
+    }
+    (*spill)->flush();
+    spilledBytes_.add(spilled);
+    snprintf(buf, sizeof buf,
+             "Spilled log message at %s, %zd larger buffers, %" PRId64
+             " bytes to %s\n",
+             timebuf, buffers.size() - keep, spilled, spillBasename_.c_str());
+    // 已经写入spill文件的buffer不再写入日志文件，保留下来复用
+    for (size_t i = keep; i < buffers.size(); ++i) {
+      buffers[i]->reset();
+    }
+  } else if (overloadPolicy_ == kDropByLevel) {
+    int64_t dropped = 0;
+    for (size_t i = keep; i < buffers.size(); ++i) {
+      dropped += dropLowLevelLines(buffers[i].get());
+    }
+    droppedBytes_.add(dropped);
+    snprintf(buf, sizeof buf,
+             "Dropped log message below WARN at %s, %" PRId64 " bytes\n",
+             timebuf, dropped);
+  } else {
+    int64_t dropped = 0;
+    int64_t lines = 0;
+    for (size_t i = keep; i < buffers.size(); ++i) {
+      const char *data = buffers[i]->data();
+      dropped += buffers[i]->length();
+      lines += std::count(data, data + buffers[i]->length(), '\n');
+    }
+    droppedBytes_.add(dropped);
+    droppedLines_.add(lines);
+    snprintf(buf, sizeof buf, "Dropped log message at %s, %zd larger buffers\n",
+             timebuf, buffers.size() - keep);
+    // 丢掉多余日志，以腾出内存，仅保留keep块缓冲区
+    buffers.erase(buffers.begin() + keep, buffers.end());
+  }
+  fputs(buf, stderr);
+  output->append(buf, static_cast<int>(strlen(buf)));
+}
+
+int64_t AsyncLogging::dropLowLevelLines(Buffer *buffer) {
+  // 先reset再原地搬移：写指针总是不超过读指针
+  const char *p = buffer->data();
+  const char *end = p + buffer->length();
+  buffer->reset();
+  int64_t dropped = 0;
+  while (p != end) {
+    const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+    const char *next = eol ? eol + 1 : end;
+    int len = static_cast<int>(next - p);
+    Logger::LogLevel level = Logger::FATAL;
+    // 无法识别级别的行按重要的日志保留
+    if (Logger::parseLogLevel(p, len, &level) && level < Logger::WARN) {
+      dropped += len;
+      droppedLines_.add();
+    } else {
+      memmove(buffer->current(), p, len);
+      buffer->add(len);
+    }
+    p = next;
+  }
+  return dropped;
+}
+
 /********************************************************************
 Description :
 如果buffers_为空，使用条件变量等待条件满足（即前端线程把一个已经满了
@@ -63,22 +358,44 @@ Description :
 void AsyncLogging::threadFunc() {
   assert(running_ == true);
   latch_.countDown();
-  LogFile output(basename_, rollSize_, false);
+  // writer要比output后析构，output关闭文件前会等待写操作完成
+  std::unique_ptr<AsyncFileWriter> writer;
+  if (asyncOutput_) {
+    writer.reset(new AsyncFileWriter(maxInflightWrites_));
+  }
+  LogFile output(basename_, rollSize_, false, flushInterval_, 1024,
+                 writer.get(), fileOptions_);
+  // 滚动时后端线程不阻塞在打开新文件和关闭旧文件上
+  output.setPreopen(true);
+  std::unique_ptr<LogFile> spill; // kSpillToFile时才创建
   BufferPtr newBuffer1(new Buffer);
   BufferPtr newBuffer2(new Buffer);
   newBuffer1->bzero();
   newBuffer2->bzero();
   BufferVector buffersToWrite; // 写入日志记录文件的BufferVector。
-  buffersToWrite.reserve(16);
+  buffersToWrite.reserve(maxPendingBuffers_ + 1);
+  BinaryLogDecoder decoder; // 解码appendBinary()收到的二进制日志
+  string binaryToWrite;
   while (running_) {
     assert(newBuffer1 && newBuffer1->length() == 0);
     assert(newBuffer2 && newBuffer2->length() == 0);
     assert(buffersToWrite.empty());
 
+    if (frontEnd_ == kThreadLocalBuffer) {
+      {
+        muduo::MutexLockGuard lock(mutex_);
+        if (buffers_.empty()) {
+          cond_.waitForSeconds(flushInterval_);
+        }
+      }
+      // 醒来后先把各线程暂存区中的日志收集到currentBuffer_
+      collectStagings(false);
+    }
+
     {
       muduo::MutexLockGuard lock(mutex_);
       // 如果buffers_为空，那么表示没有数据需要写入文件，那么就等待指定的时间。
-      if (buffers_.empty()) // unusual usage!
+      if (buffers_.empty() && frontEnd_ == kSharedBuffer) // unusual usage!
       {
         // 超时 或 前端写满一个或者多个buffer
         cond_.waitForSeconds(flushInterval_);
@@ -93,63 +410,158 @@ void AsyncLogging::threadFunc() {
       currentBuffer_ = std::move(newBuffer1); // 清空
       // buffers_和buffersToWrite交换数据，此时buffers_所有的数据存放在buffersToWrite，而buffers_变为空。
       buffersToWrite.swap(buffers_); // 交换存储
+      binaryToWrite.swap(binaryBlocks_);
       // 如果nextBuffer_为空，将新的buffer（newBuffer2）移用为另一个缓冲区（nextBuffer_）。
       if (!nextBuffer_) // 不存在
       {
         nextBuffer_ = std::move(newBuffer2);
       }
+      // buffers_已经清空，唤醒被阻塞的前端
+      if (overloadPolicy_ == kBlockProducers) {
+        notFull_.notifyAll();
+      }
     }
 
     assert(!buffersToWrite.empty());
 
-    // 如果将要写入文件的buffer列表中buffer的个数大于25，那么将多余数据删除。
-    // 前端陷入死循环，拼命发送日志消息，超过后端的处理能力，这是典型的生产速度超过消费速度，
-    // 会造成数据在内存中的堆积，严重时引发性能问题(可用内存不足)或程序崩溃(分配内存失败)。
-    if (buffersToWrite.size() > 25) // ???
-    {
-      char buf[256];
-      snprintf(buf, sizeof buf,
-               "Dropped log message at %s, %zd larger buffers\n",
-               Timestamp::now().toFormattedString().c_str(),
-               buffersToWrite.size() - 2);
-      fputs(buf, stderr);
-      output.append(buf, static_cast<int>(strlen(buf)));
-      // 丢掉多余日志，以腾出内存，仅保留两块缓冲区
-      buffersToWrite.erase(buffersToWrite.begin() + 2, buffersToWrite.end());
+    // 如果将要写入文件的buffer列表中buffer的个数大于上限，按过载策略处理多余的buffer。
+    // kBlockProducers下前端已经被限流，超出的只可能是后端自己收集的暂存区，全部写入
+    if (buffersToWrite.size() > maxPendingBuffers_ &&
+        overloadPolicy_ != kBlockProducers) {
+      handleOverload(&buffersToWrite, &output, &spill);
     }
 
-    // 写入文件
-    for (const auto &buffer : buffersToWrite) {
-      // FIXME: use unbuffered stdio FILE ? or use ::writev ?
-      output.append(buffer->data(), buffer->length());
-    }
+    // 写入文件，异步写时已经交出去的buffer会从buffersToWrite中移除
+    writeBinary(binaryToWrite, &decoder, &output);
+    binaryToWrite.clear();
+    writeBuffers(&buffersToWrite, &output);
 
     // 重新调整buffersToWrite的大小
-    // 将buffersToWrite内的buffer重新填充newBuffer1和newBuffer2
-    if (buffersToWrite.size() > 2) {
+    // 将buffersToWrite内的buffer重新填充newBuffer1和newBuffer2，
+    // 另外最多保留bufferPoolSize_ - 2块放入空闲buffer池
+    if (buffersToWrite.size() > bufferPoolSize_) {
       // drop non-bzero-ed buffers, avoid trashing
-      buffersToWrite.resize(2);
+      buffersToWrite.resize(bufferPoolSize_);
     }
 
     // 从buffersToWrite中弹出一个作为newBuffer1
     if (!newBuffer1) {
-      assert(!buffersToWrite.empty());
-      newBuffer1 = std::move(buffersToWrite.back());
-      buffersToWrite.pop_back();
-      newBuffer1->reset();
+      newBuffer1 = takeSpareBuffer(&buffersToWrite);
     }
 
     // 从buffersToWrite中弹出一个作为newBuffer2
     if (!newBuffer2) {
-      assert(!buffersToWrite.empty());
-      newBuffer2 = std::move(buffersToWrite.back());
-      buffersToWrite.pop_back();
-      newBuffer2->reset();
+      newBuffer2 = takeSpareBuffer(&buffersToWrite);
+    }
+
+    if (!buffersToWrite.empty()) {
+      muduo::MutexLockGuard lock(mutex_);
+      for (auto &buffer : buffersToWrite) {
+        if (emptyBuffers_.size() + 2 >= bufferPoolSize_) {
+          break;
+        }
+        buffer->reset();
+        emptyBuffers_.push_back(std::move(buffer));
+      }
     }
     // 清空buffersToWrite
     buffersToWrite.clear();
     output.flush();
   }
 
+  // stop()之后把暂存区和前端缓冲区中剩余的日志写完，避免丢失最后一批日志
+  if (frontEnd_ == kThreadLocalBuffer) {
+    collectStagings(true);
+  }
+  {
+    muduo::MutexLockGuard lock(mutex_);
+    buffers_.push_back(std::move(currentBuffer_));
+    currentBuffer_ = std::move(newBuffer1);
+    buffersToWrite.swap(buffers_);
+    binaryToWrite.swap(binaryBlocks_);
+    notFull_.notifyAll();
+  }
+  writeBinary(binaryToWrite, &decoder, &output);
+  writeBuffers(&buffersToWrite, &output);
   output.flush();
-}
\ No newline at end of file
+}
+
+void AsyncLogging::writeBuffers(BufferVector *buffersToWrite,
+                                LogFile *output) {
+  if (asyncOutput_) {
+    // 交出buffer的所有权，写完后由recycleBuffer放回空闲buffer池
+    BufferVector unused;
+    for (auto &buffer : *buffersToWrite) {
+      if (buffer->length() > 0) {
+        Buffer *raw = buffer.release();
+        output->appendAsync(raw->data(), static_cast<size_t>(raw->length()),
+                            std::bind(&AsyncLogging::recycleBuffer, this, raw));
+      } else {
+        unused.push_back(std::move(buffer));
+      }
+    }
+    buffersToWrite->swap(unused);
+  } else if (vectoredOutput_) {
+    std::vector<struct iovec> iov;
+    iov.reserve(buffersToWrite->size());
+    for (const auto &buffer : *buffersToWrite) {
+      if (buffer->length() > 0) {
+        struct iovec vec;
+        vec.iov_base = const_cast<char *>(buffer->data());
+        vec.iov_len = static_cast<size_t>(buffer->length());
+        iov.push_back(vec);
+      }
+    }
+    if (!iov.empty()) {
+      output->appendv(iov.data(), static_cast<int>(iov.size()));
+    }
+  } else {
+    for (const auto &buffer : *buffersToWrite) {
+      output->append(buffer->data(), buffer->length());
+    }
+  }
+}
+
+void AsyncLogging::recycleBuffer(Buffer *buffer) {
+  BufferPtr recycled(buffer);
+  recycled->reset();
+  muduo::MutexLockGuard lock(mutex_);
+  if (emptyBuffers_.size() < bufferPoolSize_) {
+    emptyBuffers_.push_back(std::move(recycled));
+  }
+}
+
+AsyncLogging::BufferPtr AsyncLogging::takeSpareBuffer(BufferVector *leftovers) {
+  BufferPtr buffer;
+  if (!leftovers->empty()) {
+    buffer = std::move(leftovers->back());
+    leftovers->pop_back();
+    buffer->reset();
+    return buffer;
+  }
+  {
+    muduo::MutexLockGuard lock(mutex_);
+    if (!emptyBuffers_.empty()) {
+      buffer = std::move(emptyBuffers_.back());
+      emptyBuffers_.pop_back();
+    }
+  }
+  // 丢弃了太多buffer、或者buffer还在异步写时重新分配
+  if (!buffer) {
+    buffer.reset(new Buffer);
+  }
+  return buffer;
+}
+
+void AsyncLogging::writeBinary(const string &blocks, BinaryLogDecoder *decoder,
+                               LogFile *output) {
+  if (blocks.empty()) {
+    return;
+  }
+  string text;
+  size_t n = decoder->decode(blocks.data(), blocks.size(), &text);
+  // BinaryLogger每次输出的都是完整的条目
+  assert(n == blocks.size());
+  (void)n;
+  output->append(text.data(), static_cast<int>(text.size()));
+}
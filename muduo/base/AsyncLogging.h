@@ -4,18 +4,71 @@
 #include "BlockingQueue.h"
 #include "BoundedBlockingQueue.h"
 #include "CountDownLatch.h"
+#include "FileUtil.h"
 #include "LogStream.h"
+#include "Metrics.h"
 #include "Mutex.h"
 #include "Thread.h"
+#include "ThreadLocal.h"
 
+#include <algorithm>
 #include <atomic>
 #include <vector>
 
+#include <sys/uio.h>
+
 namespace muduo {
 
+class BinaryLogDecoder;
+class LogFile;
+
 class AsyncLogging : noncopyable {
 public:
-  AsyncLogging(const string &basename, off_t rollSize, int flushInterval = 3);
+  /**
+   * @brief 前端写入方式
+   *
+   */
+  enum FrontEnd {
+    // 所有前端线程竞争同一把mutex_，直接写入currentBuffer_
+    kSharedBuffer,
+    // 每个前端线程先写入自己的暂存区，暂存区写满时才加锁整块交给后端，
+    // 前端线程之间不再争用mutex_
+    kThreadLocalBuffer,
+  };
+
+  /**
+   * @brief 前端写入速度超过后端处理能力（待写buffer超过上限）时的处理策略
+   *
+   */
+  enum OverloadPolicy {
+    // 只保留最早的若干块buffer，其余整块丢弃
+    kDropBuffers,
+    // 前端等待后端消化，最多等待blockTimeout秒，仍然没有空位则丢弃该条日志
+    kBlockProducers,
+    // 只丢弃WARN级别以下的日志，WARN及以上的日志全部写入
+    kDropByLevel,
+    // 超出的buffer写入另一个文件（spill文件）
+    kSpillToFile,
+  };
+
+  /**
+   * @brief 各种策略下的计数，可用于监控报警
+   *
+   */
+  struct Stats {
+    int64_t droppedBytes;       // 丢弃的字节数
+    int64_t droppedLines;       // 丢弃的日志行数（二进制日志只计入字节数）
+    int64_t blockedNanoseconds; // 前端累计被阻塞的时间
+    int64_t blockedTimes;       // 前端被阻塞的次数
+    int64_t spilledBytes;       // 写入spill文件的字节数
+  };
+
+  static const int kDefaultMaxPendingBuffers = 25;
+  static const int kDefaultBufferPoolSize = 2;
+  static const int kDefaultKeepBuffersOnDrop = 2;
+
+  AsyncLogging(const string &basename, off_t rollSize, int flushInterval = 3,
+               FrontEnd frontEnd = kSharedBuffer);
 
   ~AsyncLogging() {
     if (running_) {
@@ -25,6 +78,14 @@ public:
 
   void append(const char *logline, int len);
 
+  /**
+   * @brief 接收BinaryLogger输出的二进制块，由后端线程解码成文本后写入日志文件
+   *        用法：BinaryLogger::setOutput()设置的输出函数中调用
+   *        待解码的数据超过maxPendingBuffers块大buffer时，kBlockProducers下等待，
+   *        其他策略下丢弃整块（计入droppedBytes）
+   */
+  void appendBinary(const char *block, int len);
+
   void start() {
     // 在构造函数中latch_的值为1
     // 线程运行之后将latch_的减为0
@@ -40,6 +101,100 @@ public:
     thread_.join();
   }
 
+  FrontEnd frontEnd() const { return frontEnd_; }
+
+  // Must be called before start()
+  /**
+   * @brief 设置过载策略，默认kDropBuffers
+   *
+   * @param policy
+   */
+  void setOverloadPolicy(OverloadPolicy policy) { overloadPolicy_ = policy; }
+
+  /**
+   * @brief 待写buffer数超过该值即认为过载，默认25
+   *
+   * @param maxBuffers
+   */
+  void setMaxPendingBuffers(int maxBuffers) {
+    assert(maxBuffers > 0);
+    maxPendingBuffers_ = static_cast<size_t>(maxBuffers);
+  }
+
+  /**
+   * @brief 后端写完后最多保留多少块空闲buffer供前端复用，默认2，最少2
+   *
+   * @param poolSize
+   */
+  void setBufferPoolSize(int poolSize) {
+    bufferPoolSize_ = static_cast<size_t>(std::max(poolSize, 2));
+  }
+
+  /**
+   * @brief kDropBuffers/kDropByLevel/kSpillToFile下，按原样写入日志文件的buffer数，默认2
+   *
+   * @param keepBuffers
+   */
+  void setKeepBuffersOnDrop(int keepBuffers) {
+    assert(keepBuffers > 0);
+    keepBuffersOnDrop_ = static_cast<size_t>(keepBuffers);
+  }
+
+  /**
+   * @brief kBlockProducers下前端最长的等待时间
+   *
+   * @param seconds
+   */
+  void setBlockTimeout(double seconds) { blockTimeout_ = seconds; }
+
+  /**
+   * @brief kSpillToFile下spill文件的basename，默认为basename + ".spill"
+   *
+   * @param basename
+   */
+  void setSpillBasename(const string &basename) { spillBasename_ = basename; }
+
+  /**
+   * @brief 为true时后端把每一批buffer用一次::writev直接写入文件，
+   *        不再逐块经过stdio缓冲区（少一次拷贝，系统调用次数也更少）
+   *
+   * @param on
+   */
+  void setVectoredOutput(bool on) { vectoredOutput_ = on; }
+
+  /**
+   * @brief 为true时后端通过AsyncFileWriter（io_uring或线程池）异步写文件，
+   *        同时可以有多块buffer在写，buffer写完后才回到空闲buffer池，
+   *        磁盘慢时后端不会阻塞在write/flush上。优先于setVectoredOutput
+   *
+   * @param on
+   */
+  void setAsyncOutput(bool on) { asyncOutput_ = on; }
+
+  /**
+   * @brief 异步写文件时最多同时在写的buffer数，默认4
+   *
+   * @param maxInflight
+   */
+  void setMaxInflightWrites(int maxInflight) {
+    assert(maxInflight > 0);
+    maxInflightWrites_ = maxInflight;
+  }
+
+  /**
+   * @brief 日志文件和spill文件的AppendFile选项，例如预分配、写回后从page cache中丢掉、
+   *        按字节数fsync；异步写文件（setAsyncOutput）时不适用
+   *
+   * @param options
+   */
+  void setFileOptions(const FileUtil::AppendFile::Options &options) {
+    fileOptions_ = options;
+  }
+
+  OverloadPolicy overloadPolicy() const { return overloadPolicy_; }
+
+  Stats stats() const;
+
 private:
   void threadFunc();
 
@@ -48,7 +203,125 @@ private:
   typedef std::vector<std::unique_ptr<Buffer>> BufferVector;
   typedef BufferVector::value_type BufferPtr; // 指向buffer的指针
 
+  typedef muduo::detail::FixedBuffer<muduo::detail::kStagingBuffer>
+      StagingBuffer;
+
+  /**
+   * @brief 前端线程私有的暂存区
+   *        mutex只在暂存区写满交接、或后端定期收集时才会有竞争，
+   *        平时只被所属线程访问，不会在线程之间来回传递cache line
+   */
+  struct Staging : noncopyable {
+    Staging() : retired(false) {}
+
+    MutexLock mutex;
+    StagingBuffer buffer GUARDED_BY(mutex);
+    std::atomic<bool> retired; // 所属线程已经退出，后端收集完毕后即可回收
+  };
+  typedef std::shared_ptr<Staging> StagingPtr;
+
+  /**
+   * @brief 保存在线程局部存储中，线程退出时把暂存区标记为retired
+   *
+   */
+  struct StagingHolder : noncopyable {
+    ~StagingHolder() {
+      if (staging) {
+        staging->retired = true;
+      }
+    }
+
+    StagingPtr staging;
+  };
+
+  /**
+   * @brief 把一段日志写入currentBuffer_，写满时交给后端
+   *
+   */
+  void appendLocked(const char *logline, int len, bool mayBlock)
+      REQUIRES(mutex_);
+
+  /**
+   * @brief 是否还能放下：binaryLen为0时检查待写的文本buffer数，
+   *        否则检查待解码的二进制日志加上binaryLen字节是否超过上限
+   */
+  bool hasRoom(size_t binaryLen) const REQUIRES(mutex_);
+
+  /**
+   * @brief kBlockProducers下等待后端腾出空位，返回false表示超时仍然没有空位
+   *
+   */
+  bool waitForRoom(size_t binaryLen) REQUIRES(mutex_);
+
+  /**
+   * @brief 后端线程发现过载时按overloadPolicy_处理buffersToWrite
+   *
+   */
+  void handleOverload(BufferVector *buffersToWrite, LogFile *output,
+                      std::unique_ptr<LogFile> *spill);
+
+  /**
+   * @brief 把buffer中WARN级别以下的日志行去掉，返回去掉的字节数
+   *
+   */
+  int64_t dropLowLevelLines(Buffer *buffer);
+
+  /**
+   * @brief kThreadLocalBuffer模式下的append
+   *
+   */
+  void appendToStaging(const char *logline, int len);
+
+  /**
+   * @brief 获取(必要时创建并登记)当前线程的暂存区
+   *
+   */
+  Staging *threadStaging();
+
+  /**
+   * @brief 后端线程收集所有暂存区中尚未交接的日志，并回收已退出线程的暂存区
+   *
+   * @param waitBusy 为false时跳过正在被所属线程使用的暂存区
+   */
+  void collectStagings(bool waitBusy);
+
+  /**
+   * @brief 把buffersToWrite写入output
+   *
+   */
+  void writeBuffers(BufferVector *buffersToWrite, LogFile *output);
+
+  /**
+   * @brief 把binaryBlocks_中取出的二进制日志解码后写入output
+   *
+   */
+  void writeBinary(const string &blocks, BinaryLogDecoder *decoder,
+                   LogFile *output);
+
+  /**
+   * @brief 异步写完一块buffer后在完成线程中调用，放回空闲buffer池
+   *
+   */
+  void recycleBuffer(Buffer *buffer);
+
+  /**
+   * @brief 后端补充newBuffer1/newBuffer2，依次从leftovers、空闲buffer池中取，
+   *        都没有时重新分配
+   */
+  BufferPtr takeSpareBuffer(BufferVector *leftovers);
+
   const int flushInterval_; // 定期（flushInterval_秒）将缓冲区的数据写到文件中
+  const FrontEnd frontEnd_;   // 前端写入方式
+  OverloadPolicy overloadPolicy_;
+  size_t maxPendingBuffers_;
+  size_t bufferPoolSize_;
+  size_t keepBuffersOnDrop_;
+  double blockTimeout_;
+  string spillBasename_;
+  bool vectoredOutput_;
+  bool asyncOutput_;
+  int maxInflightWrites_;
+  FileUtil::AppendFile::Options fileOptions_;
   std::atomic<bool> running_; // 是否正在运行
   const string basename_;     // 日志名字
   const off_t rollSize_;      // 预留的日志大小
@@ -57,9 +330,24 @@ private:
   muduo::CountDownLatch latch_;
   muduo::MutexLock mutex_;
   muduo::Condition cond_ GUARDED_BY(mutex_);
+  muduo::Condition notFull_ GUARDED_BY(mutex_); // kBlockProducers下唤醒被阻塞的前端
   BufferPtr currentBuffer_ GUARDED_BY(mutex_); // 当前的缓冲区
   BufferPtr nextBuffer_ GUARDED_BY(mutex_);    // 下一个缓冲区
   BufferVector buffers_ GUARDED_BY(mutex_);    // 缓冲区队列
+  BufferVector emptyBuffers_ GUARDED_BY(mutex_); // 空闲buffer池
+  string binaryBlocks_ GUARDED_BY(mutex_); // 尚未解码的二进制日志
+  std::vector<StagingPtr> stagings_ GUARDED_BY(mutex_); // 所有线程的暂存区
+  muduo::ThreadLocal<StagingHolder> threadStaging_;
+
+  // 以下指标注册在MetricsRegistry中，标签为log="basename"
+  // 前端线程各自累加自己的分片，互不干扰
+  MetricCounter appendedBytes_;
+  MetricCounter droppedBytes_;
+  MetricCounter droppedLines_;
+  MetricCounter blockedNanoseconds_;
+  MetricCounter blockedTimes_;
+  MetricCounter spilledBytes_;
+  MetricGauge pendingBuffers_;
 };
 
 } // namespace muduo
@@ -1,20 +1,48 @@
 #ifndef BASE_ATOMIC_H
 #define BASE_ATOMIC_H
 
+#include "CurrentThread.h"
+#include "Mutex.h"
+#include "SpinWait.h"
+#include "noncopyable.h"
+
 #include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <new>
 
 namespace muduo {
 namespace detail {
-template <typename T> class AtomicIntegerT {
+/**
+ * @brief 原子整数，默认的内存序与原来的__sync实现一样是顺序一致的
+ *        每个操作都可以指定更弱的内存序，例如只用于统计的计数用memory_order_relaxed
+ *        get()只是一次普通的load，不再是加锁的CAS
+ *
+ */
+template <typename T> class AtomicIntegerT : noncopyable {
 public:
   AtomicIntegerT() : value_(0) {}
 
   /**
-   * @brief 返回操作之前的值
+   * @brief 返回当前的值
    *
    * @return T
    */
-  T get() { return __sync_val_compare_and_swap(&value_, 0, 0); }
+  T get(std::memory_order order = std::memory_order_seq_cst) const {
+    return value_.load(order);
+  }
+
+  void set(T newValue, std::memory_order order = std::memory_order_seq_cst) {
+    value_.store(newValue, order);
+  }
+
+  T getRelaxed() const { return value_.load(std::memory_order_relaxed); }
+  T getAcquire() const { return value_.load(std::memory_order_acquire); }
+  void setRelease(T newValue) {
+    value_.store(newValue, std::memory_order_release);
+  }
 
   /**
    * @brief T加上x并返回操作之前的值
@@ -22,7 +50,9 @@ public:
    * @param x
    * @return T
    */
-  T getAndAdd(T x) { return __sync_fetch_and_add(&value_, x); }
+  T getAndAdd(T x, std::memory_order order = std::memory_order_seq_cst) {
+    return value_.fetch_add(x, order);
+  }
 
   /**
    * @brief 将T设为newValue并返回操作之前的值
@@ -30,8 +60,8 @@ public:
    * @param newValue
    * @return T
    */
-  T getAndSet(T newValue) {
-    return __sync_lock_test_and_set(&value_, newValue);
+  T getAndSet(T newValue, std::memory_order order = std::memory_order_seq_cst) {
+    return value_.exchange(newValue, order);
   }
 
   /**
@@ -40,7 +70,9 @@ public:
    * @param x
    * @return T
    */
-  T addAndGet(T x) { return getAndAdd(x) + x; }
+  T addAndGet(T x, std::memory_order order = std::memory_order_seq_cst) {
+    return getAndAdd(x, order) + x;
+  }
 
   /**
    * @brief 前置递增
@@ -56,20 +88,99 @@ public:
    */
   T decrementAndGet() { return addAndGet(-1); }
 
-  void add(T x) { getAndAdd(x); }
+  void add(T x, std::memory_order order = std::memory_order_seq_cst) {
+    getAndAdd(x, order);
+  }
 
   void increment() { incrementAndGet(); }
 
   void decrement() { decrementAndGet(); }
 
+  // 只用于统计的计数
+  void addRelaxed(T x) { value_.fetch_add(x, std::memory_order_relaxed); }
+
 private:
-  volatile T value_; // 防止编译器对代码进行优化
+  std::atomic<T> value_;
+};
+
+/**
+ * @brief 独占一个cache line的原子整数，多个被不同线程频繁修改的计数放在一起时避免伪共享
+ *        不要用new分配单个对象（C++11的operator new不保证对齐），作为成员或全局变量使用
+ *
+ */
+template <typename T>
+class alignas(kCacheLineSize) PaddedAtomicIntegerT : public AtomicIntegerT<T> {
 };
 } // namespace detail
 
 typedef detail::AtomicIntegerT<int32_t> AtomicInt32;
 typedef detail::AtomicIntegerT<int64_t> AtomicInt64;
+typedef detail::PaddedAtomicIntegerT<int32_t> PaddedAtomicInt32;
+typedef detail::PaddedAtomicIntegerT<int64_t> PaddedAtomicInt64;
+
+/**
+ * @brief 分条带的计数，适合频繁累加、很少读取的计数
+ *        每个线程按tid固定累加其中一条（各占一个cache line），读取时求和
+ *        线程多于条带数时几个线程共用一条，仍然正确，只是会有竞争
+ *
+ */
+class StripedCounter : noncopyable {
+public:
+  /**
+   * @brief stripes为0时取不小于CPU个数的2的幂，最多64
+   *
+   */
+  explicit StripedCounter(int stripes = 0) : mask_(0), stripes_(NULL) {
+    if (stripes <= 0) {
+      stripes = static_cast<int>(::sysconf(_SC_NPROCESSORS_ONLN));
+    }
+    int n = 1;
+    while (n < stripes && n < kMaxStripes) {
+      n *= 2;
+    }
+    mask_ = n - 1;
+    void *memory = NULL;
+    MCHECK(posix_memalign(&memory, detail::kCacheLineSize,
+                          sizeof(PaddedAtomicInt64) * static_cast<size_t>(n)));
+    stripes_ = static_cast<PaddedAtomicInt64 *>(memory);
+    for (int i = 0; i < n; ++i) {
+      new (&stripes_[i]) PaddedAtomicInt64;
+    }
+  }
+
+  ~StripedCounter() {
+    for (int i = 0; i <= mask_; ++i) {
+      stripes_[i].~PaddedAtomicInt64();
+    }
+    ::free(stripes_);
+  }
+
+  void add(int64_t x) {
+    stripes_[CurrentThread::tid() & mask_].addRelaxed(x);
+  }
+
+  void increment() { add(1); }
+
+  void decrement() { add(-1); }
+
+  // 各条带之和，与并发的add()之间没有先后保证
+  int64_t get() const {
+    int64_t sum = 0;
+    for (int i = 0; i <= mask_; ++i) {
+      sum += stripes_[i].getRelaxed();
+    }
+    return sum;
+  }
+
+  int stripes() const { return mask_ + 1; }
+
+private:
+  static const int kMaxStripes = 64;
+
+  int mask_;
+  PaddedAtomicInt64 *stripes_;
+};
 
 } // namespace muduo
 
-#endif // BASE_ATOMIC_H
\ No newline at end of file
+#endif // BASE_ATOMIC_H
@@ -0,0 +1,435 @@
+#include "BinaryLogging.h"
+#include "CurrentThread.h"
+#include "Mutex.h"
+#include "ThreadLocal.h"
+#include "Timestamp.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include <memory>
+
+namespace muduo {
+extern const char *LogLevelName[Logger::NUM_LOG_LEVELS];
+
+namespace detail {
+__thread char *t_binaryLogCur = NULL;
+__thread char *t_binaryLogEnd = NULL;
+} // namespace detail
+} // namespace muduo
+
+using namespace muduo;
+using namespace muduo::detail;
+
+// std::max按引用取参数，需要定义
+const size_t BinaryLogger::kBlockSize;
+
+namespace {
+
+int64_t monotonicNanoseconds() {
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+void defaultBinaryOutput(const char *data, int len);
+
+/**
+ * @brief 所有线程共享的状态：调用点字典、输出函数、tick的校准基准
+ *
+ */
+struct BinaryLogState : noncopyable {
+  BinaryLogState()
+      : emittedSites(0), output(defaultBinaryOutput), anchorTicks(0),
+        anchorNanoseconds(0) {}
+
+  MutexLock mutex;
+  std::vector<std::pair<BinaryLogSite *, const uint8_t *>> sites
+      GUARDED_BY(mutex);
+  size_t emittedSites GUARDED_BY(mutex); // 已经写入输出的字典条目数
+  BinaryLogger::OutputFunc output GUARDED_BY(mutex);
+  int64_t anchorTicks GUARDED_BY(mutex);
+  int64_t anchorNanoseconds GUARDED_BY(mutex);
+  BinaryLogDecoder decoder GUARDED_BY(mutex); // 默认输出函数使用
+};
+
+BinaryLogState &state() {
+  static BinaryLogState s;
+  return s;
+}
+
+void defaultBinaryOutput(const char *data, int len) {
+  // 在state().mutex内调用
+  string text;
+  state().decoder.decode(data, static_cast<size_t>(len), &text);
+  size_t n = fwrite(text.data(), 1, text.size(), stdout);
+  (void)n;
+}
+
+void flushBuffer(char *block);
+
+/**
+ * @brief 线程私有的块，线程退出时输出剩余的记录
+ *
+ */
+struct BinaryLogBuffer : noncopyable {
+  BinaryLogBuffer() : capacity(0) {}
+  ~BinaryLogBuffer() {
+    // 此时ThreadLocal中已经取不到本对象，不能调用BinaryLogger::flush()
+    if (t_binaryLogCur) {
+      flushBuffer(data.get());
+    }
+    t_binaryLogCur = NULL;
+    t_binaryLogEnd = NULL;
+  }
+
+  std::unique_ptr<char[]> data;
+  size_t capacity;
+};
+
+ThreadLocal<BinaryLogBuffer> &threadBuffer() {
+  static ThreadLocal<BinaryLogBuffer> buffer;
+  return buffer;
+}
+
+// 写入块头并交给输出函数，字典中新增的条目先于这一块输出
+void outputBlock(char *block, size_t len) {
+  BinaryLogState &s = state();
+  char *p = block;
+  *p++ = static_cast<char>(kBinaryLogBlock);
+  p = encodeRaw(p, static_cast<int32_t>(CurrentThread::tid()));
+  int64_t ticks = binaryLogTicks();
+  int64_t nanoseconds = monotonicNanoseconds();
+  p = encodeRaw(p, ticks);
+  p = encodeRaw(p, Timestamp::now().microSecondsSinceEpoch());
+
+#if defined(__x86_64__) || defined(__i386__)
+  // 起点在第一次登记调用点时确定，之后不再改变
+  int64_t anchorTicks = 0;
+  int64_t anchorNanoseconds = 0;
+  {
+    MutexLockGuard lock(s.mutex);
+    anchorTicks = s.anchorTicks;
+    anchorNanoseconds = s.anchorNanoseconds;
+  }
+  // 用第一次登记调用点以来的TSC增量校准，间隔太短时多等一会儿（不持有锁）
+  while (nanoseconds - anchorNanoseconds < 1000 * 1000) {
+    ticks = binaryLogTicks();
+    nanoseconds = monotonicNanoseconds();
+  }
+  double ticksPerMicroSecond = static_cast<double>(ticks - anchorTicks) * 1e3 /
+                               static_cast<double>(nanoseconds - anchorNanoseconds);
+#else
+  (void)nanoseconds;
+  double ticksPerMicroSecond = 1e3;
+#endif
+  encodeRaw(p, ticksPerMicroSecond);
+
+  MutexLockGuard lock(s.mutex);
+
+  if (s.emittedSites < s.sites.size()) {
+    string dict;
+    for (size_t i = s.emittedSites; i < s.sites.size(); ++i) {
+      const BinaryLogSite *site = s.sites[i].first;
+      const uint8_t *types = s.sites[i].second;
+      Logger::SourceFile file(site->file);
+      size_t ntypes = 0;
+      while (types[ntypes++] != kBinaryArgEnd) {
+      }
+      char header[1 + 4 + 1 + 4];
+      char *h = header;
+      *h++ = static_cast<char>(kBinaryLogSite);
+      h = encodeRaw(h, site->id);
+      *h++ = static_cast<char>(site->level);
+      encodeRaw(h, static_cast<int32_t>(site->line));
+      dict.append(header, sizeof header);
+      char str[sizeof(uint16_t) + kMaxBinaryStringLength];
+      dict.append(str, static_cast<size_t>(
+                           encodeString(str, file.data_,
+                                        static_cast<size_t>(file.size_)) -
+                           str));
+      dict.append(str, static_cast<size_t>(
+                           encodeString(str, site->format,
+                                        strlen(site->format)) -
+                           str));
+      dict.append(reinterpret_cast<const char *>(types), ntypes);
+    }
+    s.emittedSites = s.sites.size();
+    s.output(dict.data(), static_cast<int>(dict.size()));
+  }
+  s.output(block, static_cast<int>(len));
+}
+
+void flushBuffer(char *block) {
+  if (t_binaryLogCur > block + BinaryLogger::kBlockHeaderSize) {
+    outputBlock(block, static_cast<size_t>(t_binaryLogCur - block));
+    t_binaryLogCur = block + BinaryLogger::kBlockHeaderSize;
+  }
+}
+
+} // namespace
+
+uint32_t BinaryLogger::registerSite(BinaryLogSite *site, const uint8_t *types) {
+  BinaryLogState &s = state();
+  MutexLockGuard lock(s.mutex);
+  if (site->id == 0) {
+    if (s.sites.empty()) {
+      s.anchorTicks = binaryLogTicks();
+      s.anchorNanoseconds = monotonicNanoseconds();
+    }
+    s.sites.push_back(std::make_pair(site, types));
+    __atomic_store_n(&site->id, static_cast<uint32_t>(s.sites.size()),
+                     __ATOMIC_RELEASE);
+  }
+  return site->id;
+}
+
+char *BinaryLogger::reserveSlow(size_t len) {
+  BinaryLogBuffer &buffer = threadBuffer().value();
+  flush();
+  // 特别长的记录（多个长字符串参数）单独扩大本线程的块
+  size_t capacity = std::max(kBlockSize, kBlockHeaderSize + len);
+  if (buffer.capacity < capacity) {
+    buffer.data.reset(new char[capacity]);
+    buffer.capacity = capacity;
+  }
+  t_binaryLogCur = buffer.data.get() + kBlockHeaderSize;
+  t_binaryLogEnd = buffer.data.get() + buffer.capacity;
+  return t_binaryLogCur;
+}
+
+void BinaryLogger::flush() {
+  if (t_binaryLogCur) {
+    flushBuffer(threadBuffer().value().data.get());
+  }
+}
+
+void BinaryLogger::setOutput(OutputFunc out) {
+  BinaryLogState &s = state();
+  MutexLockGuard lock(s.mutex);
+  s.output = out;
+  s.emittedSites = 0; // 新的输出需要完整的字典
+}
+
+namespace {
+
+template <typename T> bool decodeRaw(const char **p, const char *end, T *v) {
+  if (static_cast<size_t>(end - *p) < sizeof(T)) {
+    return false;
+  }
+  memcpy(v, *p, sizeof(T));
+  *p += sizeof(T);
+  return true;
+}
+
+bool decodeString(const char **p, const char *end, StringPiece *str) {
+  uint16_t len = 0;
+  if (!decodeRaw(p, end, &len) || end - *p < len) {
+    return false;
+  }
+  str->set(*p, len);
+  *p += len;
+  return true;
+}
+
+} // namespace
+
+BinaryLogDecoder::BinaryLogDecoder()
+    : tid_(0), blockTicks_(0), blockMicroSeconds_(0), ticksPerMicroSecond_(1),
+      lastSecond_(0), error_(false) {
+  timebuf_[0] = '\0';
+}
+
+size_t BinaryLogDecoder::decode(const char *data, size_t len, string *output) {
+  size_t pos = 0;
+  while (pos < len && !error_) {
+    size_t n = 0;
+    switch (data[pos]) {
+    case kBinaryLogSite:
+      n = decodeSite(data + pos, len - pos);
+      break;
+    case kBinaryLogBlock:
+      n = decodeBlock(data + pos, len - pos);
+      break;
+    case kBinaryLogRecord:
+      n = decodeRecord(data + pos, len - pos, output);
+      break;
+    default:
+      error_ = true;
+      break;
+    }
+    if (n == 0) {
+      break;
+    }
+    pos += n;
+  }
+  return pos;
+}
+
+size_t BinaryLogDecoder::decodeSite(const char *data, size_t len) {
+  const char *p = data + 1;
+  const char *end = data + len;
+  uint32_t id = 0;
+  char level = 0;
+  int32_t line = 0;
+  StringPiece file, format;
+  if (!decodeRaw(&p, end, &id) || !decodeRaw(&p, end, &level) ||
+      !decodeRaw(&p, end, &line) || !decodeString(&p, end, &file) ||
+      !decodeString(&p, end, &format)) {
+    return 0;
+  }
+  const char *types = p;
+  while (p < end && *p != kBinaryArgEnd) {
+    ++p;
+  }
+  if (p == end) {
+    return 0;
+  }
+  ++p;
+  if (id == 0 || level < 0 || level >= Logger::NUM_LOG_LEVELS) {
+    error_ = true;
+    return 0;
+  }
+  if (sites_.size() < id) {
+    sites_.resize(id);
+  }
+  Site &site = sites_[id - 1];
+  site.level = static_cast<Logger::LogLevel>(level);
+  site.line = line;
+  site.file = file.as_string();
+  site.format = format.as_string();
+  site.types.assign(types, p - 1);
+  return static_cast<size_t>(p - data);
+}
+
+size_t BinaryLogDecoder::decodeBlock(const char *data, size_t len) {
+  const char *p = data + 1;
+  const char *end = data + len;
+  int32_t tid = 0;
+  int64_t ticks = 0, microSeconds = 0;
+  double ticksPerMicroSecond = 0;
+  if (!decodeRaw(&p, end, &tid) || !decodeRaw(&p, end, &ticks) ||
+      !decodeRaw(&p, end, &microSeconds) ||
+      !decodeRaw(&p, end, &ticksPerMicroSecond)) {
+    return 0;
+  }
+  tid_ = tid;
+  blockTicks_ = ticks;
+  blockMicroSeconds_ = microSeconds;
+  ticksPerMicroSecond_ = ticksPerMicroSecond > 0 ? ticksPerMicroSecond : 1;
+  return static_cast<size_t>(p - data);
+}
+
+size_t BinaryLogDecoder::decodeRecord(const char *data, size_t len,
+                                      string *output) {
+  const char *p = data + 1;
+  const char *end = data + len;
+  uint32_t id = 0;
+  int64_t ticks = 0;
+  if (!decodeRaw(&p, end, &id) || !decodeRaw(&p, end, &ticks)) {
+    return 0;
+  }
+  if (id == 0 || id > sites_.size() || sites_[id - 1].format.empty()) {
+    error_ = true; // 缺少字典
+    return 0;
+  }
+  const Site &site = sites_[id - 1];
+
+  int64_t microSecondsSinceEpoch =
+      blockMicroSeconds_ -
+      static_cast<int64_t>(static_cast<double>(blockTicks_ - ticks) /
+                           ticksPerMicroSecond_);
+  time_t seconds = static_cast<time_t>(microSecondsSinceEpoch /
+                                       Timestamp::kMicroSecondsPerSecond);
+  int microseconds = static_cast<int>(microSecondsSinceEpoch %
+                                      Timestamp::kMicroSecondsPerSecond);
+  if (seconds != lastSecond_) {
+    lastSecond_ = seconds;
+    struct tm tm_time;
+    ::gmtime_r(&seconds, &tm_time);
+    snprintf(timebuf_, sizeof timebuf_, "%4d%02d%02d %02d:%02d:%02d",
+             tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+             tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+  }
+
+  // 与Logger::Impl相同的格式
+  LogStream stream;
+  stream << timebuf_ << Fmt(".%06dZ ", microseconds) << ' '
+         << Fmt("%5d", tid_) << ' ' << LogLevelName[site.level];
+
+  const char *fmt = site.format.c_str();
+  for (size_t i = 0; i < site.types.size(); ++i) {
+    const char *placeholder = strstr(fmt, "{}");
+    if (placeholder) {
+      stream.append(fmt, static_cast<int>(placeholder - fmt));
+      fmt = placeholder + 2;
+    }
+    bool ok = true;
+    switch (site.types[i]) {
+    case kBinaryArgInt32: {
+      int32_t v = 0;
+      ok = decodeRaw(&p, end, &v);
+      stream << v;
+      break;
+    }
+    case kBinaryArgUInt32: {
+      uint32_t v = 0;
+      ok = decodeRaw(&p, end, &v);
+      stream << v;
+      break;
+    }
+    case kBinaryArgInt64: {
+      int64_t v = 0;
+      ok = decodeRaw(&p, end, &v);
+      stream << v;
+      break;
+    }
+    case kBinaryArgUInt64: {
+      uint64_t v = 0;
+      ok = decodeRaw(&p, end, &v);
+      stream << v;
+      break;
+    }
+    case kBinaryArgDouble: {
+      double v = 0;
+      ok = decodeRaw(&p, end, &v);
+      stream << v;
+      break;
+    }
+    case kBinaryArgChar: {
+      char v = 0;
+      ok = decodeRaw(&p, end, &v);
+      stream << v;
+      break;
+    }
+    case kBinaryArgBool: {
+      bool v = false;
+      ok = decodeRaw(&p, end, &v);
+      stream << v;
+      break;
+    }
+    case kBinaryArgPointer: {
+      uint64_t v = 0;
+      ok = decodeRaw(&p, end, &v);
+      stream << reinterpret_cast<const void *>(static_cast<uintptr_t>(v));
+      break;
+    }
+    case kBinaryArgString: {
+      StringPiece v;
+      ok = decodeString(&p, end, &v);
+      stream << v;
+      break;
+    }
+    default:
+      error_ = true;
+      return 0;
+    }
+    if (!ok) {
+      return 0;
+    }
+  }
+  stream << fmt << " - " << site.file << ':' << site.line << '\n';
+  output->append(stream.buffer().data(),
+                 static_cast<size_t>(stream.buffer().length()));
+  return static_cast<size_t>(p - data);
+}
@@ -0,0 +1,334 @@
+#ifndef BASE_BINARYLOGGING_H
+#define BASE_BINARYLOGGING_H
+
+#include "Logging.h"
+#include "StringPiece.h"
+#include "Types.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+namespace muduo {
+
+/**
+ * @brief 一个BINLOG_*调用点的静态信息，由宏为每个调用点定义一个static对象
+ *        第一次记录时才登记并分配id，之后记录中只保存id
+ */
+struct BinaryLogSite {
+  Logger::LogLevel level;
+  const char *file;
+  int line;
+  const char *format; // 必须是字符串常量，"{}"表示一个参数的位置
+  uint32_t id;        // 0表示还没有登记
+};
+
+namespace detail {
+
+// 二进制日志流中的条目类型，每个条目以一个字节的类型开头
+enum BinaryLogEntry {
+  kBinaryLogSite = 1,   // 调用点字典：id、级别、文件、行号、格式串、参数类型
+  kBinaryLogBlock = 2,  // 块头：线程id以及把tick换算成时间的参数
+  kBinaryLogRecord = 3, // 一条日志：调用点id、tick、参数的原始字节
+};
+
+enum BinaryArgType {
+  kBinaryArgEnd,
+  kBinaryArgInt32,
+  kBinaryArgUInt32,
+  kBinaryArgInt64,
+  kBinaryArgUInt64,
+  kBinaryArgDouble,
+  kBinaryArgChar,
+  kBinaryArgBool,
+  kBinaryArgPointer,
+  kBinaryArgString, // uint16长度 + 内容，超过kMaxBinaryStringLength的部分截断
+};
+
+const size_t kMaxBinaryStringLength = 1024;
+
+template <typename T> inline char *encodeRaw(char *p, T v) {
+  memcpy(p, &v, sizeof v);
+  return p + sizeof v;
+}
+
+inline char *encodeString(char *p, const char *str, size_t len) {
+  uint16_t n = static_cast<uint16_t>(std::min(len, kMaxBinaryStringLength));
+  p = encodeRaw(p, n);
+  memcpy(p, str, n);
+  return p + n;
+}
+
+template <typename T>
+struct IsBinaryInteger
+    : std::integral_constant<bool, std::is_integral<T>::value &&
+                                       !std::is_same<T, bool>::value &&
+                                       !std::is_same<T, char>::value> {};
+
+/**
+ * @brief 参数类型到编码方式的映射，不支持的类型在编译时报错
+ *
+ */
+template <typename T, typename Enable = void> struct BinaryArg;
+
+template <typename T>
+struct BinaryArg<T, typename std::enable_if<IsBinaryInteger<T>::value &&
+                                            sizeof(T) <= 4>::type> {
+  typedef typename std::conditional<std::is_signed<T>::value, int32_t,
+                                    uint32_t>::type Stored;
+  static const int kType =
+      std::is_signed<T>::value ? kBinaryArgInt32 : kBinaryArgUInt32;
+  static size_t size(T) { return sizeof(Stored); }
+  static char *encode(char *p, T v) {
+    return encodeRaw(p, static_cast<Stored>(v));
+  }
+};
+
+template <typename T>
+struct BinaryArg<T, typename std::enable_if<IsBinaryInteger<T>::value &&
+                                            (sizeof(T) > 4)>::type> {
+  typedef typename std::conditional<std::is_signed<T>::value, int64_t,
+                                    uint64_t>::type Stored;
+  static const int kType =
+      std::is_signed<T>::value ? kBinaryArgInt64 : kBinaryArgUInt64;
+  static size_t size(T) { return sizeof(Stored); }
+  static char *encode(char *p, T v) {
+    return encodeRaw(p, static_cast<Stored>(v));
+  }
+};
+
+template <typename T>
+struct BinaryArg<
+    T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+  static const int kType = kBinaryArgDouble;
+  static size_t size(T) { return sizeof(double); }
+  static char *encode(char *p, T v) {
+    return encodeRaw(p, static_cast<double>(v));
+  }
+};
+
+template <> struct BinaryArg<char> {
+  static const int kType = kBinaryArgChar;
+  static size_t size(char) { return 1; }
+  static char *encode(char *p, char v) { return encodeRaw(p, v); }
+};
+
+template <> struct BinaryArg<bool> {
+  static const int kType = kBinaryArgBool;
+  static size_t size(bool) { return 1; }
+  static char *encode(char *p, bool v) { return encodeRaw(p, v); }
+};
+
+template <typename T> struct BinaryArg<T *> {
+  static const int kType = kBinaryArgPointer;
+  static size_t size(const T *) { return sizeof(uint64_t); }
+  static char *encode(char *p, const T *v) {
+    return encodeRaw(p, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(v)));
+  }
+};
+
+// 字符串需要拷贝内容，是唯一需要strlen的参数类型
+template <> struct BinaryArg<const char *> {
+  static const int kType = kBinaryArgString;
+  static size_t size(const char *v) {
+    return sizeof(uint16_t) + std::min(strlen(v), kMaxBinaryStringLength);
+  }
+  static char *encode(char *p, const char *v) {
+    return encodeString(p, v, strlen(v));
+  }
+};
+
+template <> struct BinaryArg<char *> : BinaryArg<const char *> {};
+
+template <> struct BinaryArg<StringPiece> {
+  static const int kType = kBinaryArgString;
+  static size_t size(const StringPiece &v) {
+    return sizeof(uint16_t) +
+           std::min(static_cast<size_t>(v.size()), kMaxBinaryStringLength);
+  }
+  static char *encode(char *p, const StringPiece &v) {
+    return encodeString(p, v.data(), static_cast<size_t>(v.size()));
+  }
+};
+
+template <> struct BinaryArg<string> {
+  static const int kType = kBinaryArgString;
+  static size_t size(const string &v) {
+    return sizeof(uint16_t) + std::min(v.size(), kMaxBinaryStringLength);
+  }
+  static char *encode(char *p, const string &v) {
+    return encodeString(p, v.data(), v.size());
+  }
+};
+
+template <typename T>
+struct BinaryArgOf : BinaryArg<typename std::decay<T>::type> {};
+
+// 每种参数组合一份类型表，以kBinaryArgEnd结尾
+template <typename... Args> const uint8_t *binaryArgTypes() {
+  static const uint8_t types[] = {
+      static_cast<uint8_t>(BinaryArgOf<Args>::kType)...,
+      static_cast<uint8_t>(kBinaryArgEnd)};
+  return types;
+}
+
+inline size_t binaryArgsSize() { return 0; }
+
+template <typename T, typename... Rest>
+inline size_t binaryArgsSize(const T &v, const Rest &... rest) {
+  return BinaryArgOf<T>::size(v) + binaryArgsSize(rest...);
+}
+
+inline char *encodeBinaryArgs(char *p) { return p; }
+
+template <typename T, typename... Rest>
+inline char *encodeBinaryArgs(char *p, const T &v, const Rest &... rest) {
+  return encodeBinaryArgs(BinaryArgOf<T>::encode(p, v), rest...);
+}
+
+/**
+ * @brief 记录时间用的tick，x86上是TSC，其他平台是CLOCK_MONOTONIC的纳秒数
+ *        写块时记录tick与实际时间的对应关系，由解码端换算
+ */
+inline int64_t binaryLogTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return static_cast<int64_t>(__builtin_ia32_rdtsc());
+#else
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+#endif
+}
+
+// 当前线程的块中下一个可写位置和块的末尾
+extern __thread char *t_binaryLogCur;
+extern __thread char *t_binaryLogEnd;
+
+} // namespace detail
+
+/**
+ * @brief 二进制（延迟格式化）日志
+ *        调用线程只写入调用点id、tick和参数的原始字节，不做任何格式化；
+ *        每个线程攒满一块（默认64KB）后交给输出函数，
+ *        由AsyncLogging后端线程或者离线工具用BinaryLogDecoder还原成文本
+ */
+class BinaryLogger {
+public:
+  typedef Logger::OutputFunc OutputFunc;
+
+  static const size_t kBlockSize = 64 * 1024;
+  // 块头：类型、tid、tick、微秒时间戳、每微秒的tick数
+  static const size_t kBlockHeaderSize = 1 + 4 + 8 + 8 + 8;
+  // 记录头：类型、调用点id、tick
+  static const size_t kRecordHeaderSize = 1 + 4 + 8;
+
+  template <typename... Args>
+  static void log(BinaryLogSite *site, const Args &... args) {
+    uint32_t id = __atomic_load_n(&site->id, __ATOMIC_ACQUIRE);
+    if (__builtin_expect(id == 0, 0)) {
+      id = registerSite(site, detail::binaryArgTypes<Args...>());
+    }
+    size_t len = kRecordHeaderSize + detail::binaryArgsSize(args...);
+    char *p = detail::t_binaryLogCur;
+    if (__builtin_expect(
+            static_cast<size_t>(detail::t_binaryLogEnd - p) < len, 0)) {
+      p = reserveSlow(len);
+    }
+    detail::t_binaryLogCur = p + len;
+    *p++ = static_cast<char>(detail::kBinaryLogRecord);
+    p = detail::encodeRaw(p, id);
+    p = detail::encodeRaw(p, detail::binaryLogTicks());
+    detail::encodeBinaryArgs(p, args...);
+  }
+
+  /**
+   * @brief 把当前线程尚未输出的记录交给输出函数
+   *        线程退出时会自动调用，主线程退出前需要手动调用
+   */
+  static void flush();
+
+  /**
+   * @brief 设置输出函数，默认解码成文本后写到stdout
+   *        输出函数在全局锁内调用，收到的是完整的块，可以直接写入文件
+   */
+  static void setOutput(OutputFunc out);
+
+private:
+  static uint32_t registerSite(BinaryLogSite *site, const uint8_t *types);
+  static char *reserveSlow(size_t len);
+};
+
+/**
+ * @brief 把BinaryLogger输出的字节流还原成与Logger相同格式的文本
+ *        not thread safe
+ */
+class BinaryLogDecoder : noncopyable {
+public:
+  BinaryLogDecoder();
+
+  /**
+   * @brief 解码一段字节流，文本追加到output
+   *
+   * @return size_t 解码了的字节数，末尾不完整的条目需要与后续数据拼接后再解码
+   */
+  size_t decode(const char *data, size_t len, string *output);
+
+  /**
+   * @brief 输入不是BinaryLogger的字节流
+   *
+   */
+  bool error() const { return error_; }
+
+private:
+  struct Site {
+    Logger::LogLevel level;
+    int line;
+    string file;
+    string format;
+    std::vector<uint8_t> types;
+  };
+
+  // 返回条目长度，数据不完整时返回0
+  size_t decodeSite(const char *data, size_t len);
+  size_t decodeBlock(const char *data, size_t len);
+  size_t decodeRecord(const char *data, size_t len, string *output);
+
+  std::vector<Site> sites_; // 下标为id - 1
+  int tid_;
+  int64_t blockTicks_;
+  int64_t blockMicroSeconds_;
+  double ticksPerMicroSecond_;
+  time_t lastSecond_;
+  char timebuf_[64];
+  bool error_;
+};
+
+} // namespace muduo
+
+// 用法：BINLOG_INFO("request {} took {} us", id, elapsed);
+// 参数支持整数、浮点数、char、bool、指针和字符串
+#define MUDUO_BINLOG(level, format, ...)                                       \
+  do {                                                                         \
+    if (MUDUO_LOG_ENABLED(level)) {                                            \
+      static muduo::BinaryLogSite muduo_binlog_site = {level, __FILE__,        \
+                                                       __LINE__, format, 0};   \
+      muduo::BinaryLogger::log(&muduo_binlog_site, ##__VA_ARGS__);             \
+    }                                                                          \
+  } while (0)
+
+#define BINLOG_TRACE(format, ...)                                              \
+  MUDUO_BINLOG(muduo::Logger::TRACE, format, ##__VA_ARGS__)
+#define BINLOG_DEBUG(format, ...)                                              \
+  MUDUO_BINLOG(muduo::Logger::DEBUG, format, ##__VA_ARGS__)
+#define BINLOG_INFO(format, ...)                                               \
+  MUDUO_BINLOG(muduo::Logger::INFO, format, ##__VA_ARGS__)
+#define BINLOG_WARN(format, ...)                                               \
+  MUDUO_BINLOG(muduo::Logger::WARN, format, ##__VA_ARGS__)
+#define BINLOG_ERROR(format, ...)                                              \
+  MUDUO_BINLOG(muduo::Logger::ERROR, format, ##__VA_ARGS__)
+
+#endif // BASE_BINARYLOGGING_H
@@ -2,32 +2,51 @@
 #define BASE_BLOCKINGQUEUE_H
 
 #include "Condition.h"
+#include "Metrics.h"
 #include "Mutex.h"
+#include "RingBuffer.h"
 
 #include <assert.h>
-#include <deque>
+
+#include <memory>
 
 namespace muduo {
 /**
  * @brief 无边界的阻塞队列
+ *        元素连续存放在环形缓冲区中，容量稳定后put/take不再分配内存
  *
  * @tparam T
  */
 template <typename T> class BlockingQueue : noncopyable {
 public:
-  using queue_type = std::deque<T>;
+  using queue_type = RingBuffer<T>;
   BlockingQueue() : mutex_(), notEmpty_(mutex_), queue_() {}
 
+  /**
+   * @brief 在MetricsRegistry中登记put/take次数和当前长度，标签为queue="name"
+   *        Must be called before the queue is shared
+   *
+   */
+  void enableMetrics(const string &name) {
+    metrics_.reset(new QueueMetrics(name, this));
+  }
+
   void put(const T &x) {
     MutexLockGuard lock(mutex_);
     queue_.push_back(x);
     notEmpty_.notify();
+    if (metrics_) {
+      metrics_->puts.add();
+    }
   }
 
   void put(T &&x) {
     MutexLockGuard lock(mutex_);
     queue_.push_back(std::move(x));
     notEmpty_.notify();
+    if (metrics_) {
+      metrics_->puts.add();
+    }
   }
 
   T take() {
@@ -39,11 +58,14 @@ public:
     assert(!queue_.empty());
     T front(std::move(queue_.front()));
     queue_.pop_front();
+    if (metrics_) {
+      metrics_->takes.add();
+    }
     return front;
   }
 
   queue_type drain() {
-    std::deque<T> queue;
+    queue_type queue;
     {
       MutexLockGuard lock(mutex_);
       queue = std::move(queue_);
@@ -58,9 +80,25 @@ public:
   }
 
 private:
+  struct QueueMetrics {
+    QueueMetrics(const string &name, const BlockingQueue *queue)
+        : puts("blockingqueue_puts_total", "Elements put",
+               "queue=\"" + name + "\""),
+          takes("blockingqueue_takes_total", "Elements taken",
+                "queue=\"" + name + "\""),
+          size("blockingqueue_size", "Elements waiting",
+               "queue=\"" + name + "\"",
+               [queue] { return static_cast<int64_t>(queue->size()); }) {}
+
+    MetricCounter puts;
+    MetricCounter takes;
+    MetricGauge size;
+  };
+
   mutable MutexLock mutex_;               //保证互斥
   Condition notEmpty_ GUARDED_BY(mutex_); //保证同步，唤醒等待的消费者
-  std::deque<T> queue_ GUARDED_BY(mutex_);
+  queue_type queue_ GUARDED_BY(mutex_);
+  std::unique_ptr<QueueMetrics> metrics_; // 为空时不统计
 };
 } // namespace muduo
 
@@ -0,0 +1,229 @@
+#ifndef BASE_BOUNDEDMPMCQUEUE_H
+#define BASE_BOUNDEDMPMCQUEUE_H
+
+#include "Condition.h"
+#include "Mutex.h"
+#include "SpinWait.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace muduo {
+namespace detail {
+
+// 只有一个CPU时直接睡眠
+inline int mpmcSpinCount() { return isMultiCore() ? 128 : 0; }
+
+} // namespace detail
+
+/**
+ * @brief 有上界的多生产者多消费者无锁队列（Dmitry Vyukov的环形队列），
+ *        接口与BoundedBlockingQueue相同
+ *        每个槽位带一个序号，put/take各用一次CAS占到位置，
+ *        队列不空不满时不加锁、不通知；空或满时先自旋一会儿，再在Condition上等待
+ *
+ * @tparam T 需要可移动构造
+ */
+template <typename T> class BoundedMPMCQueue : noncopyable {
+public:
+  // 容量向上取整到2的幂
+  explicit BoundedMPMCQueue(int maxsize)
+      : capacity_(roundUpPowerOfTwo(maxsize)), mask_(capacity_ - 1),
+        cells_(NULL), enqueuePos_(0), dequeuePos_(0), waitingProducers_(0),
+        waitingConsumers_(0), notEmpty_(mutex_), notFull_(mutex_) {
+    // C++11的new不保证按cache line对齐
+    void *memory = NULL;
+    MCHECK(posix_memalign(&memory, detail::kCacheLineSize,
+                          sizeof(Cell) * capacity_));
+    cells_ = static_cast<Cell *>(memory);
+    for (size_t i = 0; i < capacity_; ++i) {
+      new (&cells_[i]) Cell;
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~BoundedMPMCQueue() {
+    T *x;
+    while (Cell *cell = beginTake(&x)) {
+      x->~T();
+      endTake(cell);
+    }
+    ::free(cells_);
+  }
+
+  void put(const T &x) {
+    T copy(x);
+    put(std::move(copy));
+  }
+
+  void put(T &&x) {
+    Cell *cell = waitPut();
+    new (&cell->storage) T(std::move(x));
+    // seq_cst的store与等待者的登记构成Dekker式的同步，见waitFor()
+    cell->sequence.store(cell->position + 1, std::memory_order_seq_cst);
+    wakeUp(&waitingConsumers_, &notEmpty_);
+  }
+
+  T take() {
+    T *x;
+    Cell *cell = waitTake(&x);
+    T front(std::move(*x));
+    x->~T();
+    endTake(cell, std::memory_order_seq_cst);
+    wakeUp(&waitingProducers_, &notFull_);
+    return front;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  bool full() const { return size() >= capacity_; }
+
+  // 并发修改时只是一个近似值
+  size_t size() const {
+    size_t head = dequeuePos_.load(std::memory_order_relaxed);
+    size_t tail = enqueuePos_.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+  size_t capacity() const { return capacity_; }
+
+private:
+  // 每个槽位独占cache line：相邻槽位分别被生产者和消费者修改时不会伪共享，
+  // 代价是T较小时每个槽位占64字节
+  struct alignas(detail::kCacheLineSize) Cell {
+    std::atomic<size_t> sequence;
+    size_t position; // 占到本槽位时的位置，发布时计算新的序号
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  static size_t roundUpPowerOfTwo(int n) {
+    assert(n > 0);
+    size_t size = 1;
+    while (size < static_cast<size_t>(n)) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  // sequence == pos说明槽位空闲，可以写入
+  Cell *beginPut() {
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell *cell = &cells_[pos & mask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueuePos_.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+          cell->position = pos;
+          return cell;
+        }
+      } else if (diff < 0) {
+        return NULL; // 满
+      } else {
+        pos = enqueuePos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // sequence == pos + 1说明槽位已写入，可以读出
+  Cell *beginTake(T **x) {
+    size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell *cell = &cells_[pos & mask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeuePos_.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+          cell->position = pos;
+          *x = reinterpret_cast<T *>(&cell->storage);
+          return cell;
+        }
+      } else if (diff < 0) {
+        return NULL; // 空
+      } else {
+        pos = dequeuePos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // 槽位留给下一圈的生产者
+  void endTake(Cell *cell,
+               std::memory_order order = std::memory_order_release) {
+    cell->sequence.store(cell->position + capacity_, order);
+  }
+
+  Cell *waitPut() {
+    return waitFor([this] { return beginPut(); }, &waitingProducers_,
+                   &notFull_);
+  }
+
+  Cell *waitTake(T **x) {
+    return waitFor([this, x] { return beginTake(x); }, &waitingConsumers_,
+                   &notEmpty_);
+  }
+
+  /**
+   * @brief 先自旋，再在cond上等待
+   *        等待者每次等待前先登记再重试，唤醒方先用seq_cst的store发布槽位再检查登记数，
+   *        不会两边都看不到对方；x86上这个store是一条xchg，比store + mfence便宜
+   */
+  template <typename Try>
+  Cell *waitFor(Try tryOnce, std::atomic<int> *waiting, Condition *cond) {
+    Cell *cell = tryOnce();
+    for (int i = 0; !cell && i < detail::mpmcSpinCount(); ++i) {
+      detail::cpuRelax();
+      cell = tryOnce();
+    }
+    if (!cell) {
+      MutexLockGuard lock(mutex_);
+      for (;;) {
+        waiting->fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if ((cell = tryOnce())) {
+          break; // 多出的登记只会引起一次多余的notifyAll
+        }
+        cond->wait();
+      }
+    }
+    return cell;
+  }
+
+  // 清零登记数并唤醒所有等待者，之后的put/take在有人重新登记之前不再加锁
+  void wakeUp(std::atomic<int> *waiting, Condition *cond) {
+    if (waiting->load(std::memory_order_seq_cst) > 0 &&
+        waiting->exchange(0, std::memory_order_seq_cst) > 0) {
+      MutexLockGuard lock(mutex_);
+      cond->notifyAll();
+    }
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  Cell *cells_;
+  // 生产者和消费者各自修改的位置放在不同的cache line，避免伪共享
+  char pad0_[detail::kCacheLineSize];
+  std::atomic<size_t> enqueuePos_;
+  char pad1_[detail::kCacheLineSize - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> dequeuePos_;
+  char pad2_[detail::kCacheLineSize - sizeof(std::atomic<size_t>)];
+  std::atomic<int> waitingProducers_;
+  std::atomic<int> waitingConsumers_;
+  mutable MutexLock mutex_; // 只在空或者满时使用
+  Condition notEmpty_ GUARDED_BY(mutex_);
+  Condition notFull_ GUARDED_BY(mutex_);
+};
+
+} // namespace muduo
+
+#endif // BASE_BOUNDEDMPMCQUEUE_H
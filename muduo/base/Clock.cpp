@@ -0,0 +1,249 @@
+#include "Clock.h"
+
+#include "Mutex.h"
+
+#include <time.h>
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define MUDUO_HAVE_TSC 1
+#endif
+
+using namespace muduo;
+
+namespace muduo {
+namespace detail {
+__thread int64_t t_cachedMicroseconds = 0;
+} // namespace detail
+} // namespace muduo
+
+namespace {
+
+const int64_t kNanoSecondsPerSecond = 1000 * 1000 * 1000;
+// 与系统时钟重新同步的间隔
+const int64_t kResyncNanoseconds = kNanoSecondsPerSecond;
+// 误差超过这么多时认为系统时间被调整过，直接跳到系统时间
+const int64_t kMaxSlewNanoseconds = 1000 * 1000;
+
+std::atomic<int> g_source(Clock::kRealtime);
+
+int64_t readClock(clockid_t clock) {
+  struct timespec ts;
+  ::clock_gettime(clock, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * kNanoSecondsPerSecond + ts.tv_nsec;
+}
+
+#ifdef MUDUO_HAVE_TSC
+uint64_t readTsc() { return __rdtsc(); }
+
+bool hasInvariantTsc() {
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return (edx & (1u << 8)) != 0;
+}
+#else
+uint64_t readTsc() { return 0; }
+
+bool hasInvariantTsc() { return false; }
+#endif
+
+// 同一时刻的TSC和时钟读数：两次TSC之间读时钟，取间隔最小的一次
+void samplePair(clockid_t clock, uint64_t *tsc, int64_t *nanoseconds) {
+  uint64_t best = UINT64_MAX;
+  *tsc = 0;
+  *nanoseconds = 0;
+  for (int i = 0; i < 5; ++i) {
+    uint64_t before = readTsc();
+    int64_t ns = readClock(clock);
+    uint64_t after = readTsc();
+    if (after - before < best) {
+      best = after - before;
+      *tsc = before + (after - before) / 2;
+      *nanoseconds = ns;
+    }
+  }
+}
+
+/**
+ * @brief 用TSC推算的时钟：time = baseNs + (tsc - baseTsc) * nsPerTick
+ *        三个参数用seqlock发布，读者不加锁；同一时刻只有一个线程重新同步
+ *
+ */
+class TscClock {
+public:
+  TscClock()
+      : seq_(0), baseTsc_(0), baseNs_(0), nsPerTick_(0), monoTsc_(0),
+        monoNsPerTick_(0), resyncing_(false), calibrated_(false) {}
+
+  bool calibrate() {
+    MutexLockGuard lock(mutex_);
+    if (calibrated_) {
+      return true;
+    }
+    if (!hasInvariantTsc()) {
+      return false;
+    }
+    // 系统时钟和单调时钟各自与TSC成对采样
+    uint64_t wallTsc0, monoTsc0, monoTsc1, wallTsc1;
+    int64_t wall0, wall1, mono0, mono1;
+    samplePair(CLOCK_REALTIME, &wallTsc0, &wall0);
+    samplePair(CLOCK_MONOTONIC, &monoTsc0, &mono0);
+    struct timespec delay = {0, 10 * 1000 * 1000};
+    ::nanosleep(&delay, NULL);
+    samplePair(CLOCK_MONOTONIC, &monoTsc1, &mono1);
+    double perTick = static_cast<double>(mono1 - mono0) /
+                     static_cast<double>(monoTsc1 - monoTsc0);
+    samplePair(CLOCK_REALTIME, &wallTsc1, &wall1);
+
+    calTsc_ = wallTsc0;
+    calNs_ = wall0;
+    monoTsc_ = monoTsc0;
+    monoBaseNs_ = mono0;
+    monoNsPerTick_ = perTick;
+    publish(wallTsc1, wall1, perTick);
+    calibrated_ = true;
+    return true;
+  }
+
+  bool calibrated() const { return calibrated_; }
+
+  double ghz() const {
+    return monoNsPerTick_ > 0 ? 1.0 / monoNsPerTick_ : 0.0;
+  }
+
+  int64_t nowNanoseconds() {
+    uint64_t tsc = readTsc();
+    uint64_t baseTsc;
+    int64_t baseNs;
+    double perTick;
+    read(&baseTsc, &baseNs, &perTick);
+    // 读TSC之后别的线程可能发布了更新的baseTsc，差值按有符号数算，不早于baseNs
+    int64_t ticks = static_cast<int64_t>(tsc - baseTsc);
+    if (ticks < 0) {
+      ticks = 0;
+    }
+    int64_t elapsed =
+        static_cast<int64_t>(static_cast<double>(ticks) * perTick);
+    if (elapsed >= kResyncNanoseconds) {
+      resync(tsc, baseNs + elapsed);
+    }
+    return baseNs + elapsed;
+  }
+
+  // 单调时间只用校准时的频率，不随系统时钟调整
+  int64_t monotonicNanoseconds() const {
+    return monoBaseNs_ + static_cast<int64_t>(
+                             static_cast<double>(readTsc() - monoTsc_) *
+                             monoNsPerTick_);
+  }
+
+private:
+  void read(uint64_t *baseTsc, int64_t *baseNs, double *perTick) const {
+    unsigned seq;
+    do {
+      seq = seq_.load(std::memory_order_acquire);
+      *baseTsc = baseTsc_.load(std::memory_order_relaxed);
+      *baseNs = baseNs_.load(std::memory_order_relaxed);
+      *perTick = nsPerTick_.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) != 0 || seq != seq_.load(std::memory_order_relaxed));
+  }
+
+  // 只在持有mutex_或者resyncing_时调用
+  void publish(uint64_t baseTsc, int64_t baseNs, double perTick) {
+    seq_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    baseTsc_.store(baseTsc, std::memory_order_relaxed);
+    baseNs_.store(baseNs, std::memory_order_relaxed);
+    nsPerTick_.store(perTick, std::memory_order_relaxed);
+    seq_.fetch_add(1, std::memory_order_release);
+  }
+
+  // 以当前推算值为起点，调整频率使误差在下一个同步周期内消除，保证不倒退
+  void resync(uint64_t tsc, int64_t predicted) {
+    if (resyncing_.exchange(true, std::memory_order_acquire)) {
+      return;
+    }
+    uint64_t nowTsc;
+    int64_t wall;
+    samplePair(CLOCK_REALTIME, &nowTsc, &wall);
+    double perTick = static_cast<double>(wall - calNs_) /
+                     static_cast<double>(nowTsc - calTsc_);
+    predicted += static_cast<int64_t>(static_cast<double>(nowTsc - tsc) *
+                                      nsPerTick_.load(std::memory_order_relaxed));
+    int64_t error = wall - predicted;
+    if (error > kMaxSlewNanoseconds || error < -kMaxSlewNanoseconds) {
+      // 系统时间被调整过，重新开始计算频率
+      calTsc_ = nowTsc;
+      calNs_ = wall;
+      publish(nowTsc, wall, nsPerTick_.load(std::memory_order_relaxed));
+    } else {
+      double ticks = static_cast<double>(kResyncNanoseconds) / perTick;
+      publish(nowTsc, predicted,
+              perTick + static_cast<double>(error) / ticks);
+    }
+    resyncing_.store(false, std::memory_order_release);
+  }
+
+  MutexLock mutex_; // 串行化calibrate()
+  std::atomic<unsigned> seq_;
+  std::atomic<uint64_t> baseTsc_;
+  std::atomic<int64_t> baseNs_;
+  std::atomic<double> nsPerTick_;
+  // 计算频率的起点，只由重新同步的线程修改
+  uint64_t calTsc_;
+  int64_t calNs_;
+  // 单调时钟的参数，校准后不再改变
+  uint64_t monoTsc_;
+  int64_t monoBaseNs_;
+  double monoNsPerTick_;
+  std::atomic<bool> resyncing_;
+  std::atomic<bool> calibrated_;
+};
+
+TscClock g_tsc;
+
+} // namespace
+
+Clock::Source Clock::setSource(Source source) {
+  if (source == kTsc && !g_tsc.calibrate()) {
+    source = kRealtime;
+  }
+  g_source.store(source, std::memory_order_release);
+  return source;
+}
+
+Clock::Source Clock::source() {
+  return static_cast<Source>(g_source.load(std::memory_order_acquire));
+}
+
+int64_t Clock::nowMicroseconds() {
+  switch (g_source.load(std::memory_order_acquire)) {
+  case kRealtimeCoarse:
+    return readClock(CLOCK_REALTIME_COARSE) / 1000;
+  case kTsc:
+    return g_tsc.nowNanoseconds() / 1000;
+  default:
+    return readClock(CLOCK_REALTIME) / 1000;
+  }
+}
+
+int64_t Clock::monotonicNanoseconds() {
+  switch (g_source.load(std::memory_order_acquire)) {
+  case kRealtimeCoarse:
+    return readClock(CLOCK_MONOTONIC_COARSE);
+  case kTsc:
+    return g_tsc.monotonicNanoseconds();
+  default:
+    return readClock(CLOCK_MONOTONIC);
+  }
+}
+
+bool Clock::tscAvailable() { return hasInvariantTsc(); }
+
+double Clock::tscGhz() { return g_tsc.calibrated() ? g_tsc.ghz() : 0.0; }
@@ -0,0 +1,106 @@
+#ifndef BASE_CLOCK_H
+#define BASE_CLOCK_H
+
+#include "Timestamp.h"
+
+#include <stdint.h>
+
+namespace muduo {
+
+namespace detail {
+extern __thread int64_t t_cachedMicroseconds;
+} // namespace detail
+
+/**
+ * @brief Timestamp::now()和MonotonicTime::now()背后的时钟，进程内全局切换
+ *        kRealtime：clock_gettime(CLOCK_REALTIME)，与原来的gettimeofday相同
+ *        kRealtimeCoarse：CLOCK_REALTIME_COARSE，只读内核上次tick的时间，精度为一个tick（通常1-4ms）
+ *        kTsc：用invariant TSC推算，启用时校准一次（约10ms），之后每秒与系统时钟重新同步，
+ *              误差在下一秒内逐渐消除而不是跳变；CPU不支持时退回kRealtime
+ *
+ */
+class Clock {
+public:
+  enum Source { kRealtime, kRealtimeCoarse, kTsc };
+
+  Clock() = delete;
+
+  /**
+   * @brief 切换时钟，返回实际使用的时钟
+   *
+   */
+  static Source setSource(Source source);
+  static Source source();
+
+  // 当前时钟的微秒时间戳
+  static int64_t nowMicroseconds();
+  // 单调时钟的纳秒数，起点不确定，只用于计算间隔
+  static int64_t monotonicNanoseconds();
+
+  // CPU是否有invariant TSC
+  static bool tscAvailable();
+  // 校准得到的TSC频率，未校准时为0
+  static double tscGhz();
+
+  /**
+   * @brief 本线程缓存的当前时间，第一次调用时读取时钟，之后只在updateCachedNow()时更新
+   *        适合事件循环的一次迭代或者一批日志共用一个时间
+   *
+   */
+  static Timestamp cachedNow() {
+    if (__builtin_expect(detail::t_cachedMicroseconds == 0, 0)) {
+      return updateCachedNow();
+    }
+    return Timestamp(detail::t_cachedMicroseconds);
+  }
+
+  static Timestamp updateCachedNow() {
+    detail::t_cachedMicroseconds = nowMicroseconds();
+    return Timestamp(detail::t_cachedMicroseconds);
+  }
+};
+
+/**
+ * @brief 单调时间，不受系统时间调整的影响，用于测量间隔
+ *        与Timestamp一样是值类型，精度为纳秒
+ *
+ */
+class MonotonicTime {
+public:
+  MonotonicTime() : nanoseconds_(0) {}
+
+  explicit MonotonicTime(int64_t nanoseconds) : nanoseconds_(nanoseconds) {}
+
+  static MonotonicTime now() {
+    return MonotonicTime(Clock::monotonicNanoseconds());
+  }
+
+  int64_t nanoseconds() const { return nanoseconds_; }
+  int64_t microseconds() const { return nanoseconds_ / 1000; }
+
+  static const int64_t kNanoSecondsPerSecond = 1000 * 1000 * 1000;
+
+private:
+  int64_t nanoseconds_;
+};
+
+inline bool operator<(MonotonicTime lhs, MonotonicTime rhs) {
+  return lhs.nanoseconds() < rhs.nanoseconds();
+}
+
+inline bool operator==(MonotonicTime lhs, MonotonicTime rhs) {
+  return lhs.nanoseconds() == rhs.nanoseconds();
+}
+
+/**
+ * @brief 返回两个单调时间的差，以s为单位
+ *
+ */
+inline double timeDifference(MonotonicTime high, MonotonicTime low) {
+  return static_cast<double>(high.nanoseconds() - low.nanoseconds()) /
+         MonotonicTime::kNanoSecondsPerSecond;
+}
+
+} // namespace muduo
+
+#endif // BASE_CLOCK_H
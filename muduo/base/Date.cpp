@@ -1,5 +1,6 @@
 #include "Date.h"
 #include <stdio.h>
+#include <time.h>
 
 namespace muduo {
 namespace detail {
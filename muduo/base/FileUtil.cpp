@@ -9,25 +9,139 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h> // IOV_MAX
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <limits>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 using namespace muduo;
 
+namespace {
+const off_t kPageSize = 4096;
+
+// 取整到页
+off_t roundUpToPage(off_t n) { return (n + kPageSize - 1) & ~(kPageSize - 1); }
+} // namespace
+
 // 非线程安全
 FileUtil::AppendFile::AppendFile(StringArg filename)
-    : fp_(::fopen(filename.c_str(), "ae")), // 'e' for O_CLOEXEC
-      writtenBytes_(0) {
-  assert(fp_);
-  ::setbuffer(fp_, buffer_, sizeof buffer_);
-  // posix_fadvise POSIX_FADV_DONTNEED ?
+    : AppendFile(filename, Options()) {}
+
+FileUtil::AppendFile::AppendFile(StringArg filename, const Options &options)
+    : options_(options), fp_(NULL), fd_(-1), buffer_(NULL), bufferLength_(0),
+      writtenBytes_(0), startOffset_(0), nextCheck_(0), allocatedEnd_(0),
+      writebackStart_(0), lastFsync_(0) {
+  if (options_.rawFd) {
+    fd_ = ::open(filename.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+                 0644);
+    options_.bufferSize = static_cast<size_t>(
+        roundUpToPage(static_cast<off_t>(options_.bufferSize)));
+  } else {
+    fp_ = ::fopen(filename.c_str(), "ae"); // 'e' for O_CLOEXEC
+    fd_ = fp_ ? ::fileno(fp_) : -1;
+  }
+  if (fd_ < 0) {
+    fprintf(stderr, "AppendFile: open %s failed %s\n", filename.c_str(),
+            strerror_tl(errno));
+    return;
+  }
+
+  void *buffer = NULL;
+  if (::posix_memalign(&buffer, static_cast<size_t>(kPageSize),
+                       options_.bufferSize) != 0) {
+    fprintf(stderr, "AppendFile: posix_memalign failed\n");
+    abort();
+  }
+  buffer_ = static_cast<char *>(buffer);
+  if (fp_) {
+    ::setbuffer(fp_, buffer_, options_.bufferSize);
+  }
+
+  struct stat statbuf;
+  if (::fstat(fd_, &statbuf) == 0) {
+    startOffset_ = statbuf.st_size;
+  }
+  allocatedEnd_ = startOffset_;
+  lastFsync_ = startOffset_;
+  if (options_.dropBehindBytes > 0) {
+    // 每块至少要比缓冲区大，开始写回时上一块一定已经全部交给内核了
+    off_t minChunk = static_cast<off_t>(options_.bufferSize);
+    options_.dropBehindBytes =
+        roundUpToPage(std::max(options_.dropBehindBytes, 2 * minChunk));
+    writebackStart_ = startOffset_ / options_.dropBehindBytes *
+                      options_.dropBehindBytes;
+  }
+  afterWrite();
 }
 
-FileUtil::AppendFile::~AppendFile() { ::fclose(fp_); }
+FileUtil::AppendFile::~AppendFile() {
+  if (fd_ < 0) {
+    return;
+  }
+  flushBuffer();
+  struct stat statbuf;
+  if (allocatedEnd_ > startOffset_ && ::fstat(fd_, &statbuf) == 0 &&
+      allocatedEnd_ > statbuf.st_size) {
+    // 释放预分配而没有用到的空间：ext4的PUNCH_HOLE不处理文件结尾之后的部分，
+    // 截断到当前长度才会释放
+    if (::ftruncate(fd_, statbuf.st_size) < 0) {
+      fprintf(stderr, "AppendFile: ftruncate failed %s\n", strerror_tl(errno));
+    }
+  }
+  if (options_.dropBehindBytes > 0) {
+    // 写完的文件不再占用page cache
+    ::sync_file_range(fd_, writebackStart_, 0,
+                      SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                          SYNC_FILE_RANGE_WAIT_AFTER);
+    ::posix_fadvise(fd_, 0, 0, POSIX_FADV_DONTNEED);
+  }
+  if (fp_) {
+    ::fclose(fp_);
+  } else {
+    ::close(fd_);
+  }
+  ::free(buffer_);
+}
 
 // 不是线程安全的，需要外部加锁
 void FileUtil::AppendFile::append(const char *logline, const size_t len) {
+  if (fd_ < 0) {
+    return;
+  }
+  if (!fp_) {
+    size_t avail = options_.bufferSize - bufferLength_;
+    if (len <= avail) {
+      memcpy(buffer_ + bufferLength_, logline, len);
+      bufferLength_ += len;
+      if (bufferLength_ == options_.bufferSize) {
+        flushBuffer();
+      }
+    } else {
+      // 先填满缓冲区写出去，剩下的整块直接写，不足一块的留在缓冲区
+      memcpy(buffer_ + bufferLength_, logline, avail);
+      bufferLength_ += avail;
+      flushBuffer();
+      size_t remain = len - avail;
+      size_t direct = remain / options_.bufferSize * options_.bufferSize;
+      writeFully(logline + avail, direct);
+      memcpy(buffer_, logline + avail + direct, remain - direct);
+      bufferLength_ = remain - direct;
+    }
+    writtenBytes_ += len;
+    afterWrite();
+    return;
+  }
+
   size_t written = 0;
 
   while (written != len) {
@@ -44,15 +158,151 @@ void FileUtil::AppendFile::append(const char *logline, const size_t len) {
   }
 
   writtenBytes_ += written; // 已经写入个数
+  afterWrite();
 }
 
-void FileUtil::AppendFile::flush() { ::fflush(fp_); }
+void FileUtil::AppendFile::appendv(const struct iovec *iov, int iovcnt) {
+  if (fd_ < 0) {
+    return;
+  }
+  flushBuffer();
+  const int fd = fd_;
+  // 复制一份，写了一部分时要调整iov_base/iov_len
+  struct iovec vec[IOV_MAX];
+  size_t total = 0;
+  while (iovcnt > 0) {
+    int count = std::min(iovcnt, IOV_MAX);
+    std::copy(iov, iov + count, vec);
+    iov += count;
+    iovcnt -= count;
+
+    struct iovec *first = vec;
+    while (count > 0) {
+      ssize_t n = ::writev(fd, first, count);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        fprintf(stderr, "AppendFile::appendv() failed %s\n",
+                strerror_tl(errno));
+        writtenBytes_ += total;
+        return;
+      }
+      size_t written = static_cast<size_t>(n);
+      total += written;
+      // 跳过已经写完的iovec
+      while (count > 0 && written >= first->iov_len) {
+        written -= first->iov_len;
+        ++first;
+        --count;
+      }
+      if (count > 0) {
+        first->iov_base = static_cast<char *>(first->iov_base) + written;
+        first->iov_len -= written;
+      }
+    }
+  }
+  writtenBytes_ += total;
+  afterWrite();
+}
+
+void FileUtil::AppendFile::flush() {
+  if (fd_ < 0) {
+    return;
+  }
+  flushBuffer();
+  if (options_.fsyncOnFlush) {
+    ::fdatasync(fd_);
+    lastFsync_ = startOffset_ + writtenBytes_;
+  }
+}
 
 size_t FileUtil::AppendFile::write(const char *logline, size_t len) {
   // #undef fwrite_unlocked
   return ::fwrite_unlocked(logline, 1, len, fp_);
 }
 
+void FileUtil::AppendFile::writeFully(const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::write(fd_, data, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fprintf(stderr, "AppendFile::append() failed %s\n", strerror_tl(errno));
+      return;
+    }
+    data += n;
+    len -= static_cast<size_t>(n);
+  }
+}
+
+void FileUtil::AppendFile::flushBuffer() {
+  if (fp_) {
+    ::fflush(fp_);
+  } else if (bufferLength_ > 0) {
+    writeFully(buffer_, bufferLength_);
+    bufferLength_ = 0;
+  }
+}
+
+void FileUtil::AppendFile::afterWrite() {
+  off_t offset = startOffset_ + writtenBytes_;
+  if (offset < nextCheck_) {
+    return;
+  }
+  nextCheck_ = std::numeric_limits<off_t>::max();
+  if (options_.preallocateBytes > 0) {
+    preallocate(offset);
+  }
+  if (options_.dropBehindBytes > 0) {
+    dropBehind(offset);
+  }
+  if (options_.fsyncBytes > 0) {
+    if (offset - lastFsync_ >= options_.fsyncBytes) {
+      flushBuffer();
+      ::fdatasync(fd_);
+      lastFsync_ = offset;
+    }
+    nextCheck_ = std::min(nextCheck_, lastFsync_ + options_.fsyncBytes);
+  }
+}
+
+void FileUtil::AppendFile::preallocate(off_t offset) {
+  // 剩下不到一半时再预留一段
+  off_t extent = options_.preallocateBytes;
+  if (allocatedEnd_ - offset < extent / 2) {
+    off_t start = std::max(allocatedEnd_, offset);
+    if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, start, extent) == 0) {
+      allocatedEnd_ = start + extent;
+    } else {
+      // 文件系统不支持时不再尝试
+      fprintf(stderr, "AppendFile: fallocate failed %s\n", strerror_tl(errno));
+      options_.preallocateBytes = 0;
+      return;
+    }
+  }
+  nextCheck_ = std::min(nextCheck_, allocatedEnd_ - extent / 2);
+}
+
+void FileUtil::AppendFile::dropBehind(off_t offset) {
+  const off_t chunk = options_.dropBehindBytes;
+  while (offset >= writebackStart_ + chunk) {
+    // 开始写回刚写满的一块，不等待
+    ::sync_file_range(fd_, writebackStart_, chunk, SYNC_FILE_RANGE_WRITE);
+    if (writebackStart_ >= chunk) {
+      // 上一块已经写回了一段时间，等它完成后从page cache中丢掉
+      off_t previous = writebackStart_ - chunk;
+      ::sync_file_range(fd_, previous, chunk,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                            SYNC_FILE_RANGE_WAIT_AFTER);
+      ::posix_fadvise(fd_, previous, chunk, POSIX_FADV_DONTNEED);
+    }
+    writebackStart_ += chunk;
+  }
+  nextCheck_ = std::min(nextCheck_, writebackStart_ + chunk);
+}
+
 FileUtil::ReadSmallFile::ReadSmallFile(StringArg filename)
     : fd_(::open(filename.c_str(), O_RDONLY | O_CLOEXEC)), err_(0) {
   buf_[0] = '\0';
@@ -142,6 +392,149 @@ int FileUtil::ReadSmallFile::readToBuffer(int *size) {
   return err;
 }
 
+namespace {
+const size_t kHugePageSize = 2 * 1024 * 1024;
+} // namespace
+
+FileUtil::MappedFile::MappedFile(StringArg filename, int options)
+    : data_(NULL), size_(0), mapping_(NULL), mappingSize_(0), err_(0) {
+  int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    err_ = errno;
+    return;
+  }
+  struct stat statbuf;
+  if (::fstat(fd, &statbuf) < 0) {
+    err_ = errno;
+  } else if (S_ISDIR(statbuf.st_mode)) {
+    err_ = EISDIR;
+  } else if (!S_ISREG(statbuf.st_mode)) {
+    err_ = EINVAL;
+  }
+  size_ = err_ == 0 ? static_cast<size_t>(statbuf.st_size) : 0;
+  if (size_ == 0) {
+    ::close(fd);
+    return;
+  }
+
+  int flags = MAP_PRIVATE;
+  if (options & kPopulate) {
+    flags |= MAP_POPULATE;
+  }
+  void *addr = MAP_FAILED;
+  if (options & kHugePages) {
+    // 先保留多2MB的地址空间，再把文件映射到其中2MB对齐的位置
+    mappingSize_ = size_ + kHugePageSize;
+    mapping_ = ::mmap(NULL, mappingSize_, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping_ != MAP_FAILED) {
+      uintptr_t aligned = (reinterpret_cast<uintptr_t>(mapping_) +
+                           kHugePageSize - 1) &
+                          ~(kHugePageSize - 1);
+      addr = ::mmap(reinterpret_cast<void *>(aligned), size_, PROT_READ,
+                    flags | MAP_FIXED, fd, 0);
+      if (addr == MAP_FAILED) {
+        int savedErrno = errno;
+        ::munmap(mapping_, mappingSize_);
+        errno = savedErrno;
+      }
+    }
+  } else {
+    mappingSize_ = size_;
+    addr = ::mmap(NULL, size_, PROT_READ, flags, fd, 0);
+    mapping_ = addr;
+  }
+  if (addr == MAP_FAILED) {
+    err_ = errno;
+    mapping_ = NULL;
+    mappingSize_ = 0;
+    size_ = 0;
+    ::close(fd);
+    return;
+  }
+  ::close(fd); // 映射建立以后不再需要fd
+
+  data_ = static_cast<const char *>(addr);
+  // madvise只是建议，失败了也不影响读取
+  if (options & kHugePages) {
+    ::madvise(addr, size_, MADV_HUGEPAGE);
+  }
+  if (options & kSequential) {
+    ::madvise(addr, size_, MADV_SEQUENTIAL);
+  }
+  if (options & kWillNeed) {
+    ::madvise(addr, size_, MADV_WILLNEED);
+  }
+}
+
+FileUtil::MappedFile::~MappedFile() {
+  if (mapping_) {
+    ::munmap(mapping_, mappingSize_);
+  }
+}
+
+StringPiece FileUtil::MappedFile::slice(size_t offset, size_t len) const {
+  if (offset >= size_) {
+    return StringPiece();
+  }
+  len = std::min(len, size_ - offset);
+  assert(len <= INT_MAX);
+  return StringPiece(data_ + offset, static_cast<int>(len));
+}
+
+FileUtil::MappedFile::LineIterator::LineIterator(const char *begin,
+                                                 const char *end)
+    : pos_(begin), end_(end), scan_(begin), chunk_(begin), mask_(0) {}
+
+bool FileUtil::MappedFile::LineIterator::next(StringPiece *line) {
+  if (pos_ >= end_) {
+    return false;
+  }
+  const char *newline = findNewline();
+  const char *lineEnd = newline ? newline : end_;
+  assert(lineEnd - pos_ <= INT_MAX);
+  *line = StringPiece(pos_, static_cast<int>(lineEnd - pos_));
+  pos_ = newline ? newline + 1 : end_;
+  return true;
+}
+
+const char *FileUtil::MappedFile::LineIterator::findNewline() {
+#if defined(__AVX2__)
+  const int kChunkSize = 32;
+  const __m256i newlines = _mm256_set1_epi8('\n');
+#elif defined(__SSE2__)
+  const int kChunkSize = 16;
+  const __m128i newlines = _mm_set1_epi8('\n');
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+  while (mask_ == 0) {
+    if (end_ - scan_ < kChunkSize) {
+      // 已扫描的'\n'都已经返回过，pos_之后、scan_之前没有'\n'
+      return static_cast<const char *>(
+          ::memchr(pos_, '\n', static_cast<size_t>(end_ - pos_)));
+    }
+#if defined(__AVX2__)
+    __m256i bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(scan_));
+    mask_ = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newlines)));
+#else
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(scan_));
+    mask_ = static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newlines)));
+#endif
+    chunk_ = scan_;
+    scan_ += kChunkSize;
+  }
+  const char *newline = chunk_ + __builtin_ctz(mask_);
+  mask_ &= mask_ - 1;
+  return newline;
+#else
+  return static_cast<const char *>(
+      ::memchr(pos_, '\n', static_cast<size_t>(end_ - pos_)));
+#endif
+}
+
 // 对成员函数进行模板的显示实例化，提高效率
 template int FileUtil::readFile(StringArg filename, int maxSize,
                                 string *content, int64_t *, int64_t *,
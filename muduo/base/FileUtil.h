@@ -3,7 +3,9 @@
 
 #include "StringPiece.h"
 #include "noncopyable.h"
+#include <stdint.h>
 #include <sys/types.h> // for off_t
+#include <sys/uio.h>   // for iovec
 
 namespace muduo {
 namespace FileUtil {
@@ -44,25 +46,148 @@ int readFile(StringArg filename, int maxSize, String *content,
   return file.readToString(maxSize, content, fileSize, modifyTime, createTime);
 }
 
+/**
+ * @brief 只读映射整个文件，适合启动时加载的大文件，内容不复制
+ *        StringPiece的长度是int，slice()和每一行不能超过2GB，整个文件没有限制
+ *
+ */
+class MappedFile : noncopyable {
+public:
+  enum Option {
+    kPopulate = 1 << 0,   // MAP_POPULATE，映射时就读入整个文件
+    kSequential = 1 << 1, // MADV_SEQUENTIAL，加大预读
+    kWillNeed = 1 << 2,   // MADV_WILLNEED，后台开始预读
+    // 映射到2MB对齐的地址并MADV_HUGEPAGE，内核支持文件页THP时减少TLB miss
+    kHugePages = 1 << 3,
+  };
+
+  /**
+   * @brief options为Option的按位或
+   *
+   */
+  explicit MappedFile(StringArg filename, int options = 0);
+  ~MappedFile();
+
+  // return errno
+  int error() const { return err_; }
+  bool valid() const { return err_ == 0; }
+
+  // 空文件时为NULL
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // [offset, offset + len)，超出文件的部分被截掉
+  StringPiece slice(size_t offset, size_t len) const;
+
+  /**
+   * @brief 逐行遍历，每次扫描一块（AVX2为32字节，SSE2为16字节）得到其中所有'\n'的位掩码，
+   *        短行不必每行调用一次memchr；不足一块的结尾用memchr，不会读到映射之外
+   *
+   */
+  class LineIterator {
+  public:
+    LineIterator(const char *begin, const char *end);
+
+    /**
+     * @brief 下一行，不含'\n'；最后一行没有'\n'时也会返回
+     *
+     * @return false 已经到结尾
+     */
+    bool next(StringPiece *line);
+
+  private:
+    const char *findNewline();
+
+    const char *pos_;   // 下一行的开始
+    const char *end_;
+    const char *scan_;  // 还没扫描的第一个字节
+    const char *chunk_; // 上一次扫描的块
+    uint32_t mask_;     // chunk_中还没返回的'\n'
+  };
+
+  LineIterator lines() const { return LineIterator(data_, data_ + size_); }
+
+private:
+  const char *data_;
+  size_t size_;
+  void *mapping_; // 用于munmap，kHugePages时包括前后为了对齐多保留的部分
+  size_t mappingSize_;
+  int err_;
+};
+
 // not thread safe
 class AppendFile : noncopyable {
 public:
+  /**
+   * @brief 控制写入的文件占用多少page cache、何时落盘，默认与原来一样：
+   *        stdio的64KB缓冲区，不预分配，不主动回收page cache，不fsync
+   *
+   */
+  struct Options {
+    Options()
+        : preallocateBytes(0), dropBehindBytes(0), fsyncBytes(0),
+          fsyncOnFlush(false), rawFd(false), bufferSize(64 * 1024) {}
+
+    // 在写入位置之前用fallocate(FALLOC_FL_KEEP_SIZE)预留这么大的空间，减少碎片和元数据更新
+    // 关闭时释放文件结尾之后没有用到的部分；0表示不预分配
+    off_t preallocateBytes;
+    // 按这么大（取整到页）分块：写满一块就用sync_file_range开始写回，
+    // 等上一块写回完成后POSIX_FADV_DONTNEED，不让日志挤掉应用的热数据；0表示不做
+    off_t dropBehindBytes;
+    // 每写入这么多字节fdatasync一次；0表示不按字节数fsync
+    off_t fsyncBytes;
+    // flush()时fdatasync，配合LogFile的flushInterval得到按时间的落盘周期
+    bool fsyncOnFlush;
+    // 不用stdio，直接write(2)，缓冲区按页对齐，每次写满整个缓冲区
+    bool rawFd;
+    // 缓冲区大小，rawFd模式下取整到页
+    size_t bufferSize;
+  };
+
   explicit AppendFile(StringArg filename);
+  AppendFile(StringArg filename, const Options &options);
 
   ~AppendFile();
 
   void append(const char *logline, size_t len);
 
+  /**
+   * @brief 用一次::writev写入多块数据，不经过stdio缓冲区
+   *        写入之前会先flush缓冲区，保证与append写入的数据顺序一致
+   *
+   * @param iov
+   * @param iovcnt
+   */
+  void appendv(const struct iovec *iov, int iovcnt);
+
   void flush();
 
   off_t writtenBytes() const { return writtenBytes_; }
 
+  // 打开文件失败时为false，之后的写入都被忽略
+  bool valid() const { return fd_ >= 0; }
+
 private:
   size_t write(const char *logline, size_t len);
-
-  FILE *fp_;               // 文件指针
-  char buffer_[64 * 1024]; // 缓冲区 64K
-  off_t writtenBytes_;     // 已经写入的字节数
+  // rawFd模式下把[data, data + len)全部写入fd_
+  void writeFully(const char *data, size_t len);
+  void flushBuffer();
+  // 写入之后按Options预分配、回收page cache、fsync
+  void afterWrite();
+  void preallocate(off_t offset);
+  void dropBehind(off_t offset);
+
+  Options options_;      // 构造时调整过的参数
+  FILE *fp_;             // 文件指针，rawFd模式下为NULL
+  int fd_;               // 打开失败时为-1
+  char *buffer_;         // 缓冲区，默认64K；rawFd模式下按页对齐
+  size_t bufferLength_;  // rawFd模式下缓冲区中的字节数
+  off_t writtenBytes_;   // 已经写入的字节数
+  off_t startOffset_;      // 打开时文件的长度
+  off_t nextCheck_;        // 写到这个位置时才需要afterWrite()
+  off_t allocatedEnd_;     // 预分配到的位置
+  off_t writebackStart_;   // 下一块开始写回的位置
+  off_t lastFsync_;
 };
 
 } // namespace FileUtil
@@ -0,0 +1,117 @@
+#include "Futex.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+using namespace muduo;
+
+namespace {
+
+const int kMaxSpins = 100;
+
+int *addr(std::atomic<int> *word) { return reinterpret_cast<int *>(word); }
+
+long futex(std::atomic<int> *word, int op, int val,
+           const struct timespec *timeout = NULL,
+           std::atomic<int> *word2 = NULL, int val3 = 0) {
+  return ::syscall(SYS_futex, addr(word), op | FUTEX_PRIVATE_FLAG, val,
+                   timeout, word2 ? addr(word2) : NULL, val3);
+}
+
+// *word仍然等于expected时睡眠，返回false表示超时
+bool futexWait(std::atomic<int> *word, int expected,
+               const struct timespec *timeout = NULL) {
+  return futex(word, FUTEX_WAIT, expected, timeout) == 0 ||
+         errno != ETIMEDOUT;
+}
+
+void futexWake(std::atomic<int> *word, int count) {
+  futex(word, FUTEX_WAKE, count);
+}
+
+} // namespace
+
+void FutexMutex::lockSlow() {
+  if (detail::isMultiCore()) {
+    int estimate = spins_.load(std::memory_order_relaxed);
+    int maxSpins = std::min(kMaxSpins, estimate * 2 + 10);
+    int n = 0;
+    for (; n < maxSpins; ++n) {
+      detail::cpuRelax();
+      int c = state_.load(std::memory_order_relaxed);
+      if (c == 0 && state_.compare_exchange_weak(c, 1,
+                                                 std::memory_order_acquire,
+                                                 std::memory_order_relaxed)) {
+        spins_.store(estimate + (n - estimate) / 8, std::memory_order_relaxed);
+        return;
+      }
+    }
+    spins_.store(estimate + (n - estimate) / 8, std::memory_order_relaxed);
+  }
+  lockContended();
+}
+
+void FutexMutex::lockContended() {
+  while (state_.exchange(2, std::memory_order_acquire) != 0) {
+    futexWait(&state_, 2);
+  }
+}
+
+void FutexMutex::wakeOne() { futexWake(&state_, 1); }
+
+void FutexCondition::wait() { waitUntil(NULL); }
+
+bool FutexCondition::waitForSeconds(double seconds) {
+  const int64_t kNanoSecondsPerSecond = 1000000000;
+  int64_t nanoseconds = static_cast<int64_t>(seconds * kNanoSecondsPerSecond);
+  if (nanoseconds < 0) {
+    nanoseconds = 0;
+  }
+  // FUTEX_WAIT的超时是相对时间
+  struct timespec timeout;
+  timeout.tv_sec = static_cast<time_t>(nanoseconds / kNanoSecondsPerSecond);
+  timeout.tv_nsec = static_cast<long>(nanoseconds % kNanoSecondsPerSecond);
+  return !waitUntil(&timeout);
+}
+
+bool FutexCondition::waitUntil(const struct timespec *timeout) {
+  mutex_.assertLocked();
+  int seq = seq_.load(std::memory_order_relaxed);
+  mutex_.unlock();
+  bool woken = futexWait(&seq_, seq, timeout);
+  mutex_.lockContended();
+  mutex_.assignHolder();
+  return woken;
+}
+
+void FutexCondition::notify() {
+  seq_.fetch_add(1, std::memory_order_relaxed);
+  futexWake(&seq_, 1);
+}
+
+void FutexCondition::notifyAll() {
+  int seq = seq_.fetch_add(1, std::memory_order_relaxed) + 1;
+  // 唤醒一个，其余的转移到mutex上；mutex的状态在被唤醒者加锁时置为2，解锁时逐个唤醒
+  while (futex(&seq_, FUTEX_CMP_REQUEUE, 1, reinterpret_cast<timespec *>(
+                                               static_cast<uintptr_t>(INT_MAX)),
+               &mutex_.state_, seq) < 0 &&
+         errno == EAGAIN) {
+    seq = seq_.load(std::memory_order_relaxed);
+  }
+}
+
+void FutexCountDownLatch::wait() {
+  int c;
+  while ((c = count_.load(std::memory_order_acquire)) > 0) {
+    futexWait(&count_, c);
+  }
+}
+
+void FutexCountDownLatch::wakeAll() { futexWake(&count_, INT_MAX); }
@@ -0,0 +1,153 @@
+#ifndef BASE_FUTEX_H
+#define BASE_FUTEX_H
+
+#include "Mutex.h"
+#include "SpinWait.h"
+
+#include <atomic>
+
+namespace muduo {
+
+/**
+ * @brief 基于futex的互斥锁，接口与MutexLock相同
+ *        状态只有一个int：0未加锁，1加锁，2加锁且可能有等待者（Drepper, "Futexes Are Tricky"）
+ *        无竞争时加锁、解锁各一条原子指令，不进入内核；
+ *        有竞争时先自适应地自旋，自旋次数跟随最近成功时用的次数（类似PTHREAD_MUTEX_ADAPTIVE_NP）
+ *        持有者只在debug版本中记录，release版本的isLockedByThisThread()只能判断是否被加锁
+ *
+ */
+class CAPABILITY("mutex") FutexMutex : noncopyable {
+public:
+  FutexMutex() : state_(0), spins_(0), holder_(0) {}
+
+  ~FutexMutex() { assert(state_.load(std::memory_order_relaxed) == 0); }
+
+  bool isLockedByThisThread() const {
+#ifndef NDEBUG
+    return holder_ == CurrentThread::tid();
+#else
+    return state_.load(std::memory_order_relaxed) != 0;
+#endif
+  }
+
+  void assertLocked() const ASSERT_CAPABILITY(this) {
+    assert(isLockedByThisThread());
+  }
+
+  void lock() ACQUIRE() {
+    int c = 0;
+    if (!state_.compare_exchange_strong(c, 1, std::memory_order_acquire,
+                                        std::memory_order_relaxed)) {
+      lockSlow();
+    }
+    assignHolder();
+  }
+
+  bool tryLock() TRY_ACQUIRE(true) {
+    int c = 0;
+    if (state_.compare_exchange_strong(c, 1, std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+      assignHolder();
+      return true;
+    }
+    return false;
+  }
+
+  void unlock() RELEASE() {
+    unassignHolder();
+    if (state_.exchange(0, std::memory_order_release) == 2) {
+      wakeOne();
+    }
+  }
+
+private:
+  friend class FutexCondition;
+
+  void lockSlow();
+  // 等待者被唤醒后要以状态2加锁，自己解锁时才会唤醒下一个（包括FutexCondition转移过来的）
+  void lockContended();
+  void wakeOne();
+
+#ifndef NDEBUG
+  void assignHolder() { holder_ = CurrentThread::tid(); }
+  void unassignHolder() { holder_ = 0; }
+#else
+  void assignHolder() {}
+  void unassignHolder() {}
+#endif
+
+  std::atomic<int> state_;
+  std::atomic<int> spins_; // 自适应自旋的估计值，竞争着更新，不要求精确
+  pid_t holder_;
+};
+
+class SCOPED_CAPABILITY FutexMutexGuard : noncopyable {
+public:
+  explicit FutexMutexGuard(FutexMutex &mutex) ACQUIRE(mutex) : mutex_(mutex) {
+    mutex_.lock();
+  }
+
+  ~FutexMutexGuard() RELEASE() { mutex_.unlock(); }
+
+private:
+  FutexMutex &mutex_;
+};
+
+/**
+ * @brief 与FutexMutex配合的条件变量，接口与Condition相同
+ *        notifyAll()只唤醒一个等待者，其余的用FUTEX_CMP_REQUEUE直接转移到mutex上排队，
+ *        不会所有等待者同时醒来争抢同一把锁
+ *
+ */
+class FutexCondition : noncopyable {
+public:
+  explicit FutexCondition(FutexMutex &mutex) : mutex_(mutex), seq_(0) {}
+
+  void wait();
+
+  /**
+   * @brief 等待数秒，如果超时退出返回true，否则返回false
+   *
+   */
+  bool waitForSeconds(double seconds);
+
+  void notify();
+
+  void notifyAll();
+
+private:
+  // 返回false表示超时
+  bool waitUntil(const struct timespec *timeout);
+
+  FutexMutex &mutex_;
+  std::atomic<int> seq_; // 每次notify加一，等待者睡眠前比较
+};
+
+/**
+ * @brief 基于futex的倒计时计数器，接口与CountDownLatch相同
+ *        只有一个原子计数，countDown()不加锁，只在减到0时唤醒一次
+ *
+ */
+class FutexCountDownLatch : noncopyable {
+public:
+  explicit FutexCountDownLatch(int count) : count_(count) {}
+
+  void wait();
+
+  void countDown() {
+    if (count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      wakeAll();
+    }
+  }
+
+  int getCount() const { return count_.load(std::memory_order_acquire); }
+
+private:
+  void wakeAll();
+
+  std::atomic<int> count_;
+};
+
+} // namespace muduo
+
+#endif // BASE_FUTEX_H
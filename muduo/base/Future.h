@@ -0,0 +1,304 @@
+#ifndef BASE_FUTURE_H
+#define BASE_FUTURE_H
+
+#include "Condition.h"
+#include "Exception.h"
+#include "InlineTask.h"
+#include "Mutex.h"
+
+#include <assert.h>
+
+#include <exception>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace muduo {
+
+template <typename T> class Future;
+
+namespace detail {
+
+// 结果的存储，void没有值
+template <typename T> class FutureStorage : noncopyable {
+public:
+  FutureStorage() : hasValue_(false) {}
+  ~FutureStorage() {
+    if (hasValue_) {
+      ptr()->~T();
+    }
+  }
+
+  template <typename U> void set(U &&value) {
+    assert(!hasValue_);
+    new (&storage_) T(std::forward<U>(value));
+    hasValue_ = true;
+  }
+
+  // 只能取一次
+  T take() {
+    assert(hasValue_);
+    T value(std::move(*ptr()));
+    ptr()->~T();
+    hasValue_ = false;
+    return value;
+  }
+
+private:
+  T *ptr() { return reinterpret_cast<T *>(&storage_); }
+
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+  bool hasValue_;
+};
+
+template <> class FutureStorage<void> : noncopyable {
+public:
+  void set() {}
+  void take() {}
+};
+
+/**
+ * @brief Future和生产者共享的状态
+ *        只有在有线程等待时才notify，结果就绪时如果有后续任务就在当前线程直接运行
+ *
+ */
+template <typename T> class FutureState : noncopyable {
+public:
+  typedef InlineTask<> Continuation;
+
+  FutureState() : mutex_(), cond_(mutex_), ready_(false), waiters_(0) {}
+
+  template <typename... Args> void setValue(Args &&... args) {
+    {
+      MutexLockGuard lock(mutex_);
+      storage_.set(std::forward<Args>(args)...);
+    }
+    complete();
+  }
+
+  void setException(std::exception_ptr e) {
+    {
+      MutexLockGuard lock(mutex_);
+      exception_ = e;
+    }
+    complete();
+  }
+
+  bool ready() const {
+    MutexLockGuard lock(mutex_);
+    return ready_;
+  }
+
+  void wait() {
+    MutexLockGuard lock(mutex_);
+    while (!ready_) {
+      ++waiters_;
+      cond_.wait();
+      --waiters_;
+    }
+  }
+
+  // 就绪后才能调用，有异常时重新抛出
+  T take() {
+    MutexLockGuard lock(mutex_);
+    assert(ready_);
+    if (exception_) {
+      std::rethrow_exception(exception_);
+    }
+    return storage_.take();
+  }
+
+  std::exception_ptr exception() const {
+    MutexLockGuard lock(mutex_);
+    return exception_;
+  }
+
+  // 已就绪则立即在当前线程运行，否则由完成结果的线程运行
+  void onReady(Continuation continuation) {
+    {
+      MutexLockGuard lock(mutex_);
+      if (!ready_) {
+        assert(!continuation_);
+        continuation_ = std::move(continuation);
+        return;
+      }
+    }
+    continuation();
+  }
+
+private:
+  void complete() {
+    Continuation continuation;
+    {
+      MutexLockGuard lock(mutex_);
+      assert(!ready_);
+      ready_ = true;
+      continuation = std::move(continuation_);
+      if (waiters_ > 0) {
+        cond_.notifyAll();
+      }
+    }
+    if (continuation) {
+      continuation();
+    }
+  }
+
+  mutable MutexLock mutex_;
+  Condition cond_ GUARDED_BY(mutex_);
+  bool ready_ GUARDED_BY(mutex_);
+  int waiters_ GUARDED_BY(mutex_);
+  FutureStorage<T> storage_ GUARDED_BY(mutex_);
+  std::exception_ptr exception_ GUARDED_BY(mutex_);
+  Continuation continuation_ GUARDED_BY(mutex_);
+};
+
+// 运行f并把返回值或者异常存入state
+template <typename R> struct FutureInvoker {
+  template <typename F, typename... Args>
+  static void run(FutureState<R> *state, F &f, Args &&... args) {
+    try {
+      state->setValue(f(std::forward<Args>(args)...));
+    } catch (...) {
+      state->setException(std::current_exception());
+    }
+  }
+};
+
+template <> struct FutureInvoker<void> {
+  template <typename F, typename... Args>
+  static void run(FutureState<void> *state, F &f, Args &&... args) {
+    try {
+      f(std::forward<Args>(args)...);
+    } catch (...) {
+      state->setException(std::current_exception());
+      return;
+    }
+    state->setValue();
+  }
+};
+
+// ThreadPool::submit()放入队列的任务
+// 没有运行就被丢弃时（比如线程池已经stop），让等待的一方得到异常而不是一直等下去
+template <typename R, typename F> class FutureTask {
+public:
+  FutureTask(std::shared_ptr<FutureState<R>> state, F &&func)
+      : state_(std::move(state)), func_(std::move(func)) {}
+  FutureTask(FutureTask &&) = default;
+
+  ~FutureTask() {
+    if (state_) {
+      state_->setException(std::make_exception_ptr(
+          Exception("task discarded before running")));
+    }
+  }
+
+  void operator()() {
+    std::shared_ptr<FutureState<R>> state(std::move(state_));
+    FutureInvoker<R>::run(state.get(), func_);
+  }
+
+private:
+  std::shared_ptr<FutureState<R>> state_;
+  F func_;
+};
+
+// then()的参数F以T为参数（T为void时没有参数），返回R
+template <typename T, typename F> struct ContinuationResult {
+  typedef typename std::result_of<F(T)>::type type;
+};
+
+template <typename F> struct ContinuationResult<void, F> {
+  typedef typename std::result_of<F()>::type type;
+};
+
+// 前一个Future就绪后运行func，把结果存入next
+// prev存放着本对象，这里用裸指针，避免循环引用；运行时prev一定还活着
+template <typename T, typename R, typename F> struct ThenTask {
+  FutureState<T> *prev;
+  std::shared_ptr<FutureState<R>> next;
+  F func;
+
+  void operator()() { call(std::is_void<T>()); }
+
+private:
+  void call(std::false_type) {
+    std::exception_ptr e = prev->exception();
+    if (e) {
+      next->setException(e);
+    } else {
+      FutureInvoker<R>::run(next.get(), func, prev->take());
+    }
+  }
+
+  void call(std::true_type) {
+    std::exception_ptr e = prev->exception();
+    if (e) {
+      next->setException(e);
+    } else {
+      FutureInvoker<R>::run(next.get(), func);
+    }
+  }
+};
+
+} // namespace detail
+
+/**
+ * @brief ThreadPool::submit()返回的结果，类似std::future，
+ *        但等待时不需要额外的线程，可以用then()串联后续任务
+ *        get()和then()只能调用其中一个，且只能调用一次
+ *
+ * @tparam T 结果类型，可以是void
+ */
+template <typename T> class Future {
+public:
+  typedef detail::FutureState<T> State;
+
+  Future() {}
+  explicit Future(std::shared_ptr<State> state) : state_(std::move(state)) {}
+
+  bool valid() const { return static_cast<bool>(state_); }
+
+  bool ready() const { return state_->ready(); }
+
+  void wait() const { state_->wait(); }
+
+  /**
+   * @brief 等待结果，任务抛出的异常在这里重新抛出
+   *
+   * @return T
+   */
+  T get() {
+    assert(valid());
+    std::shared_ptr<State> state(std::move(state_));
+    state->wait();
+    return state->take();
+  }
+
+  /**
+   * @brief 结果就绪后运行f(结果)，返回f的结果的Future
+   *        如果此时已经就绪，f在调用线程运行；否则在完成任务的线程上紧接着运行，不再放回队列
+   *        前面的任务抛出异常时跳过f，把异常传给返回的Future
+   *
+   */
+  template <typename F>
+  Future<typename detail::ContinuationResult<T, F>::type> then(F &&f) {
+    typedef typename detail::ContinuationResult<T, F>::type R;
+    typedef typename std::decay<F>::type Func;
+    assert(valid());
+    std::shared_ptr<detail::FutureState<R>> next(
+        std::make_shared<detail::FutureState<R>>());
+    std::shared_ptr<State> prev(std::move(state_));
+    detail::ThenTask<T, R, Func> continuation = {prev.get(), next,
+                                                 std::forward<F>(f)};
+    prev->onReady(std::move(continuation));
+    return Future<R>(next);
+  }
+
+private:
+  std::shared_ptr<State> state_;
+};
+
+} // namespace muduo
+
+#endif // BASE_FUTURE_H
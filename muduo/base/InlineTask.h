@@ -0,0 +1,162 @@
+#ifndef BASE_INLINETASK_H
+#define BASE_INLINETASK_H
+
+#include <stddef.h>
+
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace muduo {
+
+/**
+ * @brief 只能移动的void()任务，不大于kInlineSize字节的可调用对象直接存放在对象内部，
+ *        不需要分配内存；更大的（或者移动时可能抛异常的）放在堆上
+ *        std::function要求可调用对象可复制，捕获unique_ptr的lambda放不进去，
+ *        而且libstdc++里超过16字节的捕获就要分配内存
+ *
+ * @tparam kInlineSize 内部缓冲区大小，一般取64或128
+ */
+template <size_t kInlineSize = 64> class InlineTask {
+public:
+  static const size_t kCapacity = kInlineSize;
+
+  InlineTask() noexcept : ops_(NULL) {}
+  InlineTask(std::nullptr_t) noexcept : ops_(NULL) {}
+
+  template <typename F,
+            typename = typename std::enable_if<!std::is_same<
+                typename std::decay<F>::type, InlineTask>::value>::type>
+  InlineTask(F &&f) : ops_(NULL) {
+    typedef typename std::decay<F>::type Functor;
+    if (!isNull(f)) {
+      init<Functor>(std::forward<F>(f),
+                    std::integral_constant<bool, fitsInline<Functor>()>());
+    }
+  }
+
+  InlineTask(InlineTask &&rhs) noexcept : ops_(rhs.ops_) {
+    if (ops_) {
+      ops_->move(&storage_, &rhs.storage_);
+      rhs.ops_ = NULL;
+    }
+  }
+
+  InlineTask &operator=(InlineTask &&rhs) noexcept {
+    if (this != &rhs) {
+      reset();
+      if (rhs.ops_) {
+        rhs.ops_->move(&storage_, &rhs.storage_);
+        ops_ = rhs.ops_;
+        rhs.ops_ = NULL;
+      }
+    }
+    return *this;
+  }
+
+  InlineTask &operator=(std::nullptr_t) noexcept {
+    reset();
+    return *this;
+  }
+
+  InlineTask(const InlineTask &) = delete;
+  InlineTask &operator=(const InlineTask &) = delete;
+
+  ~InlineTask() { reset(); }
+
+  void operator()() { ops_->invoke(&storage_); }
+
+  explicit operator bool() const noexcept { return ops_ != NULL; }
+
+  // 是否存放在对象内部，调用方可以据此确认提交任务时不会分配内存
+  bool isInline() const noexcept { return ops_ && ops_->isInline; }
+
+  template <typename Functor> static constexpr bool fitsInline() {
+    return sizeof(Functor) <= sizeof(Storage) &&
+           alignof(Functor) <= alignof(Storage) &&
+           std::is_nothrow_move_constructible<Functor>::value;
+  }
+
+private:
+  typedef typename std::aligned_storage<kInlineSize, alignof(max_align_t)>::type
+      Storage;
+
+  struct Ops {
+    void (*invoke)(void *self);
+    // 把src移动到未初始化的dst，并销毁src
+    void (*move)(void *dst, void *src);
+    void (*destroy)(void *self);
+    bool isInline;
+  };
+
+  template <typename Functor> struct InlineOps {
+    static Functor *get(void *p) { return static_cast<Functor *>(p); }
+    static void invoke(void *self) { (*get(self))(); }
+    static void move(void *dst, void *src) {
+      new (dst) Functor(std::move(*get(src)));
+      get(src)->~Functor();
+    }
+    static void destroy(void *self) { get(self)->~Functor(); }
+    static const Ops ops;
+  };
+
+  template <typename Functor> struct HeapOps {
+    static Functor *&get(void *p) { return *static_cast<Functor **>(p); }
+    static void invoke(void *self) { (*get(self))(); }
+    static void move(void *dst, void *src) {
+      *static_cast<Functor **>(dst) = get(src);
+    }
+    static void destroy(void *self) { delete get(self); }
+    static const Ops ops;
+  };
+
+  template <typename T> static bool isNull(const T &) { return false; }
+  template <typename R> static bool isNull(R (*const &f)()) { return f == NULL; }
+  template <typename R> static bool isNull(const std::function<R()> &f) {
+    return !f;
+  }
+
+  template <typename Functor, typename F>
+  void init(F &&f, std::true_type /* inline */) {
+    new (&storage_) Functor(std::forward<F>(f));
+    ops_ = &InlineOps<Functor>::ops;
+  }
+
+  template <typename Functor, typename F>
+  void init(F &&f, std::false_type /* inline */) {
+    *reinterpret_cast<Functor **>(&storage_) = new Functor(std::forward<F>(f));
+    ops_ = &HeapOps<Functor>::ops;
+  }
+
+  void reset() noexcept {
+    if (ops_) {
+      ops_->destroy(&storage_);
+      ops_ = NULL;
+    }
+  }
+
+  const Ops *ops_;
+  Storage storage_;
+};
+
+template <size_t kInlineSize>
+const size_t InlineTask<kInlineSize>::kCapacity;
+
+template <size_t kInlineSize>
+template <typename Functor>
+const typename InlineTask<kInlineSize>::Ops
+    InlineTask<kInlineSize>::InlineOps<Functor>::ops = {
+        &InlineOps<Functor>::invoke, &InlineOps<Functor>::move,
+        &InlineOps<Functor>::destroy, true};
+
+template <size_t kInlineSize>
+template <typename Functor>
+const typename InlineTask<kInlineSize>::Ops
+    InlineTask<kInlineSize>::HeapOps<Functor>::ops = {
+        &HeapOps<Functor>::invoke, &HeapOps<Functor>::move,
+        &HeapOps<Functor>::destroy, false};
+
+} // namespace muduo
+
+#endif // BASE_INLINETASK_H
@@ -1,19 +1,258 @@
 #include "LogFile.h"
+#include "AsyncFileWriter.h"
+#include "BlockingQueue.h"
+#include "CurrentThread.h"
 #include "FileUtil.h"
+#include "Logging.h"
 #include "ProcessInfo.h"
+#include "Thread.h"
 
 #include <assert.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <vector>
 
 using namespace muduo;
 
+/**
+ * @brief LogFile的后台线程，以最低的CPU和IO优先级运行，
+ *        只在需要预先打开、压缩或者按保留策略删除旧文件时才创建：
+ *        1. setPreopen(true)时预先打开下一个日志文件
+ *           （临时名称basename.next.hostname.pid.log），
+ *           滚动时写线程只需要交换指针并rename
+ *        2. 关闭旧文件（flush可能阻塞），按需压缩，再按保留策略删除最旧的文件
+ */
+class LogFile::Archiver : noncopyable {
+public:
+  typedef std::function<void()> Task;
+
+  Archiver(const string &basename, const string &nextName,
+           AsyncFileWriter *asyncWriter,
+           const FileUtil::AppendFile::Options &fileOptions)
+      : basename_(basename), nextName_(nextName), asyncWriter_(asyncWriter),
+        fileOptions_(fileOptions),
+        compress_(false), maxFiles_(0), maxBytes_(0),
+        thread_(std::bind(&Archiver::threadFunc, this), "LogFileArchiver") {
+    thread_.start();
+  }
+
+  ~Archiver() {
+    queue_.put(Task()); // 处理完之前的任务后退出
+    thread_.join();
+    if (nextFile_ || nextAsyncFile_) {
+      nextFile_.reset();
+      nextAsyncFile_.reset();
+      ::unlink(nextName_.c_str());
+    }
+  }
+
+  const string &nextName() const { return nextName_; }
+
+  void setCompress(bool on) { compress_ = on; }
+
+  void setRetention(int maxFiles, int64_t maxBytes) {
+    maxFiles_ = maxFiles;
+    maxBytes_ = maxBytes;
+  }
+
+  void preopen() { queue_.put(std::bind(&Archiver::doPreopen, this)); }
+
+  // 取走预先打开的文件，还没有打开好时返回false；rename失败时用giveBack()还回来
+  bool takePreopened(std::unique_ptr<FileUtil::AppendFile> *file,
+                     std::unique_ptr<FileUtil::AsyncAppendFile> *asyncFile) {
+    MutexLockGuard lock(mutex_);
+    if (!nextFile_ && !nextAsyncFile_) {
+      return false;
+    }
+    file->swap(nextFile_);
+    asyncFile->swap(nextAsyncFile_);
+    return true;
+  }
+
+  void giveBack(std::unique_ptr<FileUtil::AppendFile> file,
+                std::unique_ptr<FileUtil::AsyncAppendFile> asyncFile) {
+    MutexLockGuard lock(mutex_);
+    nextFile_ = std::move(file);
+    nextAsyncFile_ = std::move(asyncFile);
+  }
+
+  /**
+   * @brief 交给后台线程关闭、压缩旧文件，并删除多余的旧文件
+   *
+   * @param current 当前正在写的文件，不能删除
+   */
+  void retire(std::unique_ptr<FileUtil::AppendFile> file,
+              std::unique_ptr<FileUtil::AsyncAppendFile> asyncFile,
+              const string &filename, const string &current) {
+    // std::function要求可拷贝，用shared_ptr包装
+    std::shared_ptr<RetiredFile> retired(new RetiredFile);
+    retired->file = std::move(file);
+    retired->asyncFile = std::move(asyncFile);
+    retired->filename = filename;
+    queue_.put(std::bind(&Archiver::doRetire, this, retired, current));
+  }
+
+private:
+  struct RetiredFile {
+    std::unique_ptr<FileUtil::AppendFile> file;
+    std::unique_ptr<FileUtil::AsyncAppendFile> asyncFile;
+    string filename;
+  };
+
+  void threadFunc() {
+    ::setpriority(PRIO_PROCESS, CurrentThread::tid(), 19);
+#ifdef SYS_ioprio_set
+    const int kIoprioWhoProcess = 1;
+    const int kIoprioClassIdle = 3;
+    ::syscall(SYS_ioprio_set, kIoprioWhoProcess, CurrentThread::tid(),
+              kIoprioClassIdle << 13);
+#endif
+    while (Task task = queue_.take()) {
+      task();
+    }
+  }
+
+  void doPreopen() {
+    std::unique_ptr<FileUtil::AppendFile> file;
+    std::unique_ptr<FileUtil::AsyncAppendFile> asyncFile;
+    if (asyncWriter_) {
+      asyncFile.reset(new FileUtil::AsyncAppendFile(nextName_, asyncWriter_));
+    } else {
+      file.reset(new FileUtil::AppendFile(nextName_, fileOptions_));
+    }
+    MutexLockGuard lock(mutex_);
+    nextFile_ = std::move(file);
+    nextAsyncFile_ = std::move(asyncFile);
+  }
+
+  void doRetire(const std::shared_ptr<RetiredFile> &retired,
+                const string &current) {
+    // 析构时flush并关闭，异步文件还要等待尚未完成的写操作
+    retired->file.reset();
+    retired->asyncFile.reset();
+    if (compress_) {
+      gzipFile(retired->filename);
+    }
+    if (maxFiles_ > 0 || maxBytes_ > 0) {
+      prune(current);
+    }
+  }
+
+  static void gzipFile(const string &filename) {
+    string gzName = filename + ".gz";
+    FILE *in = ::fopen(filename.c_str(), "rbe");
+    if (!in) {
+      return;
+    }
+    gzFile out = ::gzopen(gzName.c_str(), "wb");
+    bool ok = out != NULL;
+    char buf[64 * 1024];
+    size_t n = 0;
+    while (ok && (n = ::fread(buf, 1, sizeof buf, in)) > 0) {
+      ok = ::gzwrite(out, buf, static_cast<unsigned>(n)) ==
+           static_cast<int>(n);
+    }
+    ok = ok && !::ferror(in);
+    if (out && ::gzclose(out) != Z_OK) {
+      ok = false;
+    }
+    ::fclose(in);
+    if (ok) {
+      ::unlink(filename.c_str());
+    } else {
+      fprintf(stderr, "LogFile: failed to compress %s\n", filename.c_str());
+      ::unlink(gzName.c_str());
+    }
+  }
+
+  static bool endsWith(const string &str, const char *suffix) {
+    size_t len = strlen(suffix);
+    return str.size() >= len &&
+           str.compare(str.size() - len, len, suffix) == 0;
+  }
+
+  // 文件名中时间在最前面，按名字排序就是按时间排序
+  void prune(const string &current) {
+    DIR *dir = ::opendir(".");
+    if (!dir) {
+      return;
+    }
+    string prefix = basename_ + '.';
+    std::vector<std::pair<string, int64_t>> files;
+    while (struct dirent *entry = ::readdir(dir)) {
+      string name(entry->d_name);
+      // 跳过临时文件basename.next.*和其他同名前缀的文件
+      if (name.size() <= prefix.size() ||
+          name.compare(0, prefix.size(), prefix) != 0 ||
+          !isdigit(static_cast<unsigned char>(name[prefix.size()])) ||
+          !(endsWith(name, ".log") || endsWith(name, ".log.gz")) ||
+          name == current) {
+        continue;
+      }
+      struct stat st;
+      if (::stat(name.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+        files.push_back(
+            std::make_pair(name, static_cast<int64_t>(st.st_size)));
+      }
+    }
+    ::closedir(dir);
+
+    std::sort(files.begin(), files.end());
+    int64_t totalBytes = 0;
+    for (const auto &f : files) {
+      totalBytes += f.second;
+    }
+    size_t remaining = files.size();
+    for (const auto &f : files) {
+      bool tooMany = maxFiles_ > 0 && remaining > static_cast<size_t>(maxFiles_);
+      bool tooLarge = maxBytes_ > 0 && totalBytes > maxBytes_;
+      if (!tooMany && !tooLarge) {
+        break;
+      }
+      ::unlink(f.first.c_str());
+      totalBytes -= f.second;
+      --remaining;
+    }
+  }
+
+  const string basename_;
+  const string nextName_;
+  AsyncFileWriter *asyncWriter_;
+  const FileUtil::AppendFile::Options fileOptions_;
+  // 以下设置在append()之前修改，之后只由后台线程读取
+  bool compress_;
+  int maxFiles_;
+  int64_t maxBytes_;
+
+  BlockingQueue<Task> queue_;
+  Thread thread_;
+  MutexLock mutex_;
+  std::unique_ptr<FileUtil::AppendFile> nextFile_ GUARDED_BY(mutex_);
+  std::unique_ptr<FileUtil::AsyncAppendFile> nextAsyncFile_ GUARDED_BY(mutex_);
+};
+
 LogFile::LogFile(const std::string &basename, off_t rollSize, bool threadSafe,
-                 int flushInterval, int checkEveryN)
+                 int flushInterval, int checkEveryN,
+                 AsyncFileWriter *asyncWriter,
+                 const FileUtil::AppendFile::Options &fileOptions)
     : basename_(basename), rollSize_(rollSize), flushInterval_(flushInterval),
-      checkEveryN_(checkEveryN), count_(0),
+      checkEveryN_(checkEveryN), fileOptions_(fileOptions),
+      suffix_('.' + ProcessInfo::hostname() + '.' +
+              std::to_string(ProcessInfo::pid()) + ".log"),
+      rollPeriod_(kRollPerSeconds_), preopen_(false), count_(0),
       mutex_(threadSafe ? new MutexLock : NULL), startOfPeriod_(0),
-      lastRoll_(0), lastFlush_(0) {
+      lastRoll_(0), lastFlush_(0), asyncWriter_(asyncWriter) {
   assert(basename.find('/') == string::npos);
   rollFile();
 }
@@ -30,7 +269,28 @@ void LogFile::append(const char *logline, int len) {
   }
 }
 
+void LogFile::appendv(const struct iovec *iov, int iovcnt) {
+  if (mutex_) {
+    MutexLockGuard lock(*mutex_);
+    appendv_unlock(iov, iovcnt);
+  } else {
+    appendv_unlock(iov, iovcnt);
+  }
+}
+
+void LogFile::appendAsync(const char *data, size_t len, DoneCallback done) {
+  if (mutex_) {
+    MutexLockGuard lock(*mutex_);
+    appendAsync_unlock(data, len, std::move(done));
+  } else {
+    appendAsync_unlock(data, len, std::move(done));
+  }
+}
+
 void LogFile::flush() {
+  if (asyncFile_) {
+    return; // 没有用户态缓冲
+  }
   if (mutex_) {
     MutexLockGuard lock(*mutex_);
     file_->flush();
@@ -40,19 +300,56 @@ void LogFile::flush() {
 }
 
 void LogFile::append_unlock(const char *logline, int len) {
-  // 调用成员变量file_的方法，也就是FileUtil.h中的AppendFile的不加锁apeend方法
-  file_->append(logline, len); // 写入文件
+  if (asyncFile_) {
+    // 调用者返回后logline就失效了，只能拷贝一份
+    std::shared_ptr<string> copy(new string(logline, len));
+    asyncFile_->append(copy->data(), copy->size(), [copy] {});
+  } else {
+    // 调用成员变量file_的方法，也就是FileUtil.h中的AppendFile的不加锁apeend方法
+    file_->append(logline, len); // 写入文件
+  }
+  checkRoll_unlock(1);
+}
 
+void LogFile::appendv_unlock(const struct iovec *iov, int iovcnt) {
+  if (asyncFile_) {
+    for (int i = 0; i < iovcnt; ++i) {
+      std::shared_ptr<string> copy(
+          new string(static_cast<const char *>(iov[i].iov_base),
+                     iov[i].iov_len));
+      asyncFile_->append(copy->data(), copy->size(), [copy] {});
+    }
+  } else {
+    file_->appendv(iov, iovcnt);
+  }
+  checkRoll_unlock(iovcnt);
+}
+
+void LogFile::appendAsync_unlock(const char *data, size_t len,
+                                 DoneCallback done) {
+  if (asyncFile_) {
+    asyncFile_->append(data, len, std::move(done));
+  } else {
+    file_->append(data, len);
+    if (done) {
+      done();
+    }
+  }
+  checkRoll_unlock(1);
+}
+
+void LogFile::checkRoll_unlock(int count) {
   // 写入字节数大小超过滚动设定大小
-  if (file_->writtenBytes() > rollSize_) // writtenBytes() : 写了多少字节大小
+  off_t written = asyncFile_ ? asyncFile_->writtenBytes() : file_->writtenBytes();
+  if (written > rollSize_) // writtenBytes() : 写了多少字节大小
   {
     rollFile(); // 滚动
   } else {
-    ++count_; // 增加行数
+    count_ += count; // 增加行数
     if (count_ >= checkEveryN_) {
       count_ = 0;
       time_t now = ::time(NULL);
-      time_t thisPeriod = now / kRollPerSeconds_ * kRollPerSeconds_;
+      time_t thisPeriod = now / rollPeriod_ * rollPeriod_;
       // 比较时间是否相等，不等就是第二天0点，那么滚动
       if (thisPeriod != startOfPeriod_) {
         rollFile();
@@ -61,51 +358,128 @@ void LogFile::append_unlock(const char *logline, int len) {
           flushInterval_) // 判断是否超过flush间隔时间，超过了就flush，否则什么都不做
       {
         lastFlush_ = now; // 更新
-        file_->flush();
+        if (file_) {
+          file_->flush();
+        }
       }
     }
   }
 }
 
 bool LogFile::rollFile() {
-  time_t now = 0;
-  string filename = getLogFileName(basename_, &now); // 获取生成一个文件名称
-  // 注意，这里先除KRollPerSeconds然后乘KPollPerSeconds表示对齐值KRollPerSeconds的整数倍，也就是时间调整到当天零点(/除法会引发取整)
-  time_t start = now / kRollPerSeconds_ * kRollPerSeconds_;
+  time_t now = ::time(NULL);
+  // 注意，这里先除rollPeriod_然后乘rollPeriod_表示对齐到周期的整数倍，默认是当天零点(/除法会引发取整)
+  time_t start = now / rollPeriod_ * rollPeriod_;
 
   // 如果大于lastRoll，产生一个新的日志文件，并更新lastRoll
   if (now > lastRoll_) {
+    string filename = getLogFileName(now); // 获取生成一个文件名称
     lastRoll_ = now;
     lastFlush_ = now;
     startOfPeriod_ = start;
-    file_.reset(new FileUtil::AppendFile(filename));
+
+    string oldFilename = filename_;
+    std::unique_ptr<FileUtil::AppendFile> file;
+    std::unique_ptr<FileUtil::AsyncAppendFile> asyncFile;
+    if (archiver_ && archiver_->takePreopened(&file, &asyncFile)) {
+      // 已经打开的文件改名不影响写入
+      if (::rename(archiver_->nextName().c_str(), filename.c_str()) != 0) {
+        // 不能用LOG_*：输出可能就是这个LogFile，mutex_不可重入
+        fprintf(stderr, "LogFile::rollFile rename %s failed: %s\n",
+                filename.c_str(), strerror_tl(errno));
+        // 继续写旧文件，预先打开的文件留给下一次滚动
+        archiver_->giveBack(std::move(file), std::move(asyncFile));
+        return false;
+      }
+      filename_ = filename;
+    } else {
+      if (asyncWriter_) {
+        asyncFile.reset(new FileUtil::AsyncAppendFile(filename, asyncWriter_));
+      } else {
+        file.reset(new FileUtil::AppendFile(filename, fileOptions_));
+      }
+      filename_ = filename;
+    }
+
+    // 交换之后file和asyncFile是旧文件
+    file_.swap(file);
+    asyncFile_.swap(asyncFile);
+    if (archiver_) {
+      if (preopen_) {
+        archiver_->preopen();
+      }
+      if (file || asyncFile) {
+        archiver_->retire(std::move(file), std::move(asyncFile), oldFilename,
+                          filename_);
+      }
+    }
+    // 没有后台线程时旧文件在这里关闭
     return true;
   }
   return false;
 }
 
-string LogFile::getLogFileName(const string &basename, time_t *now) {
+void LogFile::setRollPeriod(int seconds) {
+  assert(seconds > 0);
+  if (mutex_) {
+    MutexLockGuard lock(*mutex_);
+    rollPeriod_ = seconds;
+    startOfPeriod_ = lastRoll_ / rollPeriod_ * rollPeriod_;
+  } else {
+    rollPeriod_ = seconds;
+    startOfPeriod_ = lastRoll_ / rollPeriod_ * rollPeriod_;
+  }
+}
+
+void LogFile::setPreopen(bool on) {
+  bool wasOn = preopen_;
+  preopen_ = on;
+  if (on && !wasOn) {
+    if (archiver_) {
+      archiver_->preopen();
+    } else {
+      startArchiver();
+    }
+  }
+}
+
+void LogFile::setCompress(bool on) {
+  if (on || archiver_) {
+    startArchiver();
+    archiver_->setCompress(on);
+  }
+}
+
+void LogFile::setRetention(int maxFiles, int64_t maxBytes) {
+  if (maxFiles > 0 || maxBytes > 0 || archiver_) {
+    startArchiver();
+    archiver_->setRetention(maxFiles, maxBytes);
+  }
+}
+
+void LogFile::startArchiver() {
+  if (!archiver_) {
+    archiver_.reset(new Archiver(basename_, basename_ + ".next" + suffix_,
+                                 asyncWriter_, fileOptions_));
+    if (preopen_) {
+      archiver_->preopen();
+    }
+  }
+}
+
+string LogFile::getLogFileName(time_t now) const {
   string filename;
-  filename.reserve(basename.size() + 64);
-  filename = basename;
+  filename.reserve(basename_.size() + 24 + suffix_.size());
+  filename = basename_;
 
   char timebuf[32];
   struct tm tm;
-  *now = time(NULL);
   // 获取当前时间，UTC时间，_r是线程安全，
-  gmtime_r(now, &tm); // FIXME: localtime_r ?
-  strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S.",
+  gmtime_r(&now, &tm); // FIXME: localtime_r ?
+  strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S",
            &tm); // 格式化时间，strftime函数
   filename += timebuf;
-
-  // 根据processinfo模块内部调用::gethostname函数获取主机名
-  filename += ProcessInfo::hostname();
-
-  char pidbuf[32];
-  snprintf(pidbuf, sizeof pidbuf, ".%d", ProcessInfo::pid()); // 进程号
-  filename += pidbuf;
-
-  filename += ".log";
+  filename += suffix_;
 
   return filename;
 }
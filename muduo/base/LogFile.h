@@ -1,39 +1,98 @@
 #ifndef BASE_LOGFILE_H
 #define BASE_LOGFILE_H
 
+#include "FileUtil.h"
 #include "Mutex.h"
 #include "Types.h"
 
+#include <functional>
 #include <memory>
 
+struct iovec;
+
 namespace muduo {
+class AsyncFileWriter;
+
 namespace FileUtil {
-class AppendFile;
+class AsyncAppendFile;
 }
 
 class LogFile : noncopyable {
 public:
+  typedef std::function<void()> DoneCallback;
+
+  // asyncWriter不为NULL时通过它异步写文件，此时flush()不做任何事
+  // fileOptions用于每个日志文件的AppendFile（预分配、回收page cache、fsync周期等），
+  // 异步写文件时不适用
   LogFile(const string &basename, off_t rollSize, bool threadSafe = true,
           int flushInterval = 3,
-          int checkEveryN = 1024); // 默认分割行数1024
+          int checkEveryN = 1024, // 默认分割行数1024
+          AsyncFileWriter *asyncWriter = NULL,
+          const FileUtil::AppendFile::Options &fileOptions =
+              FileUtil::AppendFile::Options());
   ~LogFile();
 
   void append(const char *logline, int len); // 将一行长度为len添加到日志文件中
+  // 用一次::writev写入多块数据，每块计为一次append
+  void appendv(const struct iovec *iov, int iovcnt);
+  // 异步写入，不拷贝数据，写完后在完成线程中调用done，之前data必须保持有效
+  // 没有设置asyncWriter时同步写入并立即调用done
+  void appendAsync(const char *data, size_t len, DoneCallback done);
   void flush();                              // 刷新
   bool rollFile();
 
+  /**
+   * @brief 设置按时间滚动的周期，默认一天（按UTC零点），例如60 * 60为每小时
+   *
+   * @param seconds 周期
+   */
+  void setRollPeriod(int seconds);
+
+  /**
+   * @brief 在后台线程预先打开下一个日志文件（临时名称basename.next.*），
+   *        并在后台关闭旧文件，滚动时写线程不会阻塞在open和flush上，默认关闭
+   *        Must be called before append().
+   */
+  void setPreopen(bool on);
+
+  /**
+   * @brief 滚动之后在后台线程用gzip压缩旧的日志文件，默认不压缩
+   *        Must be called before append().
+   */
+  void setCompress(bool on);
+
+  /**
+   * @brief 旧日志文件最多保留的个数和总字节数（含压缩后的文件），超过时从最旧的开始删除，
+   *        0表示不限制；检查当前目录下所有basename.YYYYmmdd-*.log[.gz]文件
+   *        Must be called before append().
+   */
+  void setRetention(int maxFiles, int64_t maxBytes);
+
 private:
+  class Archiver;
+
   // 不加锁的append方式
   void append_unlock(const char *logline, int len);
+  void appendv_unlock(const struct iovec *iov, int iovcnt);
+  void appendAsync_unlock(const char *data, size_t len, DoneCallback done);
+  // 写入之后检查是否需要滚动或者flush，count为本次写入计入的append次数
+  void checkRoll_unlock(int count);
+  // 第一次需要预先打开、压缩或者删除旧文件时创建后台线程
+  void startArchiver();
 
-  // 获取日志文件的名称
-  static string getLogFileName(const string &basename, time_t *now);
+  // 获取日志文件的名称，主机名和pid在构造时缓存
+  string getLogFileName(time_t now) const;
 
   const string basename_; // 日志文件basename
   const off_t
       rollSize_; // off_t 文件操作指针移动; 日志文件达到rolsize生成一个新文件
   const int flushInterval_; // 日志写入间隔时间
   const int checkEveryN_;
+  const FileUtil::AppendFile::Options fileOptions_;
+  // ".hostname.pid.log"，ProcessInfo::hostname()需要系统调用，只取一次
+  const string suffix_;
+  int rollPeriod_; // 按时间滚动的周期，秒
+  bool preopen_;   // 滚动后预先打开下一个文件
 
   int count_; // 计数器，检测是否需要换新文件
 
@@ -45,6 +104,12 @@ private:
   time_t lastRoll_;  // 上一次滚动日志文件时间
   time_t lastFlush_; // 上一次日志写入文件时间
   std::unique_ptr<FileUtil::AppendFile> file_; // 文件智能指针
+  AsyncFileWriter *asyncWriter_;
+  std::unique_ptr<FileUtil::AsyncAppendFile> asyncFile_; // 异步模式下代替file_
+  string filename_; // 当前日志文件的名称
+  // 预先打开下一个文件，关闭、压缩、删除旧文件，都在后台线程中进行；
+  // 没有设置预先打开、压缩和保留策略时为NULL，不创建线程
+  std::unique_ptr<Archiver> archiver_;
 
   const static int kRollPerSeconds_ = 60 * 60 * 24;
 };
@@ -5,12 +5,14 @@
 #include "LogStream.h"
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
 #include <type_traits>
 #include <assert.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 // 使用PRIu32进行格式化的输出的时候需要引用：#include <inttypes.h>
 // 需要同时增加编译宏：__STDC_FORMAT_MACRS
@@ -23,7 +25,6 @@
 using namespace muduo;
 using namespace muduo::detail;
 
-// TODO:: better itoa.
 #if defined(__clang__)
 // #pragma用于指示编译器完成一些特定的动作
 #pragma clang diagnostic ignored "-Wtautological-compare"
@@ -35,58 +36,458 @@ namespace muduo
 {
     namespace detail
     {
-        const char digits[] = "9876543210123456789";
-        const char* zero = digits + 9;
-        static_assert(sizeof(digits) == 20, "wrong number of digits");
+        // 两位一组的查表，每次除以100输出两位数字
+        const char digitsLut[] =
+            "0001020304050607080910111213141516171819"
+            "2021222324252627282930313233343536373839"
+            "4041424344454647484950515253545556575859"
+            "6061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+        static_assert(sizeof(digitsLut) == 201, "wrong number of digitsLut");
 
         const char digitsHex[] = "0123456789ABCDEF";
         static_assert(sizeof(digitsHex) == 17, "wrong number of digitsHex");
 
+        const uint64_t kPow10[] = {
+            1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+            10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+            100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+            100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+            100000000000000000ULL, 1000000000000000000ULL,
+            10000000000000000000ULL};
+
+        // 十进制位数：由最高位的位置估算floor(log10(v))（log10(2) ≈ 1233 / 4096），
+        // 再和10的幂比较一次修正，没有循环；v | 1让0也算一位
+        inline int countDigits(uint64_t v)
+        {
+            v |= 1;
+            int t = (64 - __builtin_clzll(v)) * 1233 >> 12;
+            return t - (v < kPow10[t]) + 1;
+        }
+
+        // 先算出位数，从个位开始往前写，不需要再reverse
+        template<typename U>
+        size_t convertUnsigned(char buf[], U value)
+        {
+            int n = countDigits(value);
+            char* p = buf + n;
+            *p = '\0';
+            while (value >= 100)
+            {
+                size_t i = static_cast<size_t>(value % 100) * 2;
+                value /= 100;
+                p -= 2;
+                memcpy(p, digitsLut + i, 2);
+            }
+            if (value >= 10)
+            {
+                p -= 2;
+                memcpy(p, digitsLut + static_cast<size_t>(value) * 2, 2);
+            }
+            else
+            {
+                *--p = static_cast<char>('0' + value);
+            }
+            assert(p == buf);
+            return static_cast<size_t>(n);
+        }
+
         // 将整数转换为字符串
         template<typename T>
         size_t convert(char buf[], T value)
         {
-            T i = value;
-            char* p = buf;
+            typedef typename std::make_unsigned<T>::type U;
+            U u = static_cast<U>(value);
+            if (value < 0)
+            {
+                // 在无符号类型上取反，最小的负数也不会溢出
+                *buf = '-';
+                return convertUnsigned(buf + 1, static_cast<U>(0 - u)) + 1;
+            }
+            return convertUnsigned(buf, u);
+        }
 
+        // uintptr_t : unsigned long int
+        size_t convertHex(char buf[], uintptr_t value)
+        {
+            const int kBits = static_cast<int>(sizeof(uintptr_t)) * 8;
+            int n = (kBits - __builtin_clzl(value | 1) + 3) / 4;
+            char* p = buf + n;
+            *p = '\0';
             do
             {
-                // lsd : last digit,最后一位数字
-                int lsd = static_cast<int>(i % 10);
-                i /= 10;
-                *p++ = zero[lsd];
-            } while (i != 0);
+                *--p = digitsHex[value & 0xF];
+                value >>= 4;
+            } while (p != buf);
 
-            if (value < 0)
+            return static_cast<size_t>(n);
+        }
+
+        /**
+         * @brief Grisu3（Florian Loitsch, "Printing Floating-Point Numbers Quickly
+         *        and Accurately with Integers"），DiyFp参照Milo Yip的dtoa，
+         *        digitGen和roundWeed参照double-conversion
+         *        只用64位整数运算，得到能还原成同一个double的最短数字；
+         *        不能保证最短时退回snprintf
+         */
+        struct DiyFp
+        {
+            DiyFp(uint64_t fp, int exp) : f(fp), e(exp) {}
+
+            explicit DiyFp(double d)
             {
-                *p++ = '-';
+                uint64_t u;
+                memcpy(&u, &d, sizeof u);
+                int biasedE = static_cast<int>((u & kDpExponentMask) >> kDpSignificandSize);
+                uint64_t significand = u & kDpSignificandMask;
+                if (biasedE != 0)
+                {
+                    f = significand + kDpHiddenBit;
+                    e = biasedE - kDpExponentBias;
+                }
+                else
+                {
+                    f = significand;
+                    e = kDpMinExponent + 1;
+                }
             }
-            *p = '\0';
-            std::reverse(buf, p);
 
-            return p - buf;
+            DiyFp operator-(const DiyFp& rhs) const
+            {
+                return DiyFp(f - rhs.f, e);
+            }
+
+            DiyFp operator*(const DiyFp& rhs) const
+            {
+                unsigned __int128 p = static_cast<unsigned __int128>(f) * rhs.f;
+                uint64_t h = static_cast<uint64_t>(p >> 64);
+                uint64_t l = static_cast<uint64_t>(p);
+                if (l & (uint64_t(1) << 63))    // rounding
+                {
+                    h++;
+                }
+                return DiyFp(h, e + rhs.e + 64);
+            }
+
+            DiyFp normalize() const
+            {
+                int s = __builtin_clzll(f);
+                return DiyFp(f << s, e - s);
+            }
+
+            // 与相邻两个double的中点m-和m+，二者之间的数都会还原成本数
+            void normalizedBoundaries(DiyFp* minus, DiyFp* plus) const
+            {
+                DiyFp pl = DiyFp((f << 1) + 1, e - 1).normalize();
+                DiyFp mi = (f == kDpHiddenBit) ? DiyFp((f << 2) - 1, e - 2)
+                                               : DiyFp((f << 1) - 1, e - 1);
+                mi.f <<= mi.e - pl.e;
+                mi.e = pl.e;
+                *plus = pl;
+                *minus = mi;
+            }
+
+            static const int kDpSignificandSize = 52;
+            static const int kDpExponentBias = 0x3FF + kDpSignificandSize;
+            static const int kDpMinExponent = -kDpExponentBias;
+            static const uint64_t kDpExponentMask = 0x7FF0000000000000ULL;
+            static const uint64_t kDpSignificandMask = 0x000FFFFFFFFFFFFFULL;
+            static const uint64_t kDpHiddenBit = 0x0010000000000000ULL;
+
+            uint64_t f;
+            int e;
+        };
+
+        // 10^-348, 10^-340, ..., 10^340，使乘积的二进制指数落在[-60, -32]内
+        DiyFp getCachedPower(int e, int* K)
+        {
+            static const uint64_t kCachedPowersF[] = {
+                0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+                0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+                0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+                0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+                0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+                0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+                0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+                0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+                0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+                0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+                0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+                0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+                0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+                0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+                0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+                0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+                0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+                0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+                0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+                0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+                0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+                0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+                0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+                0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+                0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+                0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+                0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+                0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+                0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+            };
+            static const int16_t kCachedPowersE[] = {
+                -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+                -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+                -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+                -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+                -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+                109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+                375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+                641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+                907, 933, 960, 986, 1013, 1039, 1066,
+            };
+            double dk = (-61 - e) * 0.30102999566398114 + 347;
+            int k = static_cast<int>(dk);
+            if (dk - k > 0.0)
+            {
+                k++;
+            }
+            unsigned index = static_cast<unsigned>((k >> 3) + 1);
+            *K = -(-348 + static_cast<int>(index << 3));
+            return DiyFp(kCachedPowersF[index], kCachedPowersE[index]);
         }
 
-        // uintptr_t : unsigned long int
-        size_t convertHex(char buf[], uintptr_t value)
+        /**
+         * @brief Grisu3的收尾：把最后一位往w靠近，并检查结果在乘法的误差范围内
+         *        一定是最短且最接近的，返回false表示无法确定
+         *        unit为误差的上界，按当前位数放大过
+         */
+        bool roundWeed(char* buffer, int len, uint64_t distanceTooHighW,
+                       uint64_t unsafeInterval, uint64_t rest,
+                       uint64_t tenKappa, uint64_t unit)
         {
-            uintptr_t i = value;
-            char* p = buf;
+            uint64_t smallDistance = distanceTooHighW - unit;
+            uint64_t bigDistance = distanceTooHighW + unit;
+            while (rest < smallDistance && unsafeInterval - rest >= tenKappa &&
+                   (rest + tenKappa < smallDistance ||
+                    smallDistance - rest >= rest + tenKappa - smallDistance))
+            {
+                buffer[len - 1]--;
+                rest += tenKappa;
+            }
+            // 按误差的另一端也还能再往下调，说明不知道哪个更接近
+            if (rest < bigDistance && unsafeInterval - rest >= tenKappa &&
+                (rest + tenKappa < bigDistance ||
+                 bigDistance - rest > rest + tenKappa - bigDistance))
+            {
+                return false;
+            }
+            // 太靠近区间两端的，可能其实在区间外（或恰好在边界上）
+            return 2 * unit <= rest && rest <= unsafeInterval - 4 * unit;
+        }
 
-            do
+        // low、w、high为同一指数的缩放结果，各自的误差小于1
+        bool digitGen(const DiyFp& low, const DiyFp& w, const DiyFp& high,
+                      char* buffer, int* len, int* kappa)
+        {
+            uint64_t unit = 1;
+            const DiyFp tooLow(low.f - unit, low.e);
+            const DiyFp tooHigh(high.f + unit, high.e);
+            uint64_t unsafeInterval = (tooHigh - tooLow).f;
+            const DiyFp one(uint64_t(1) << -w.e, w.e);
+            // 指数在[-60, -32]内，整数部分至少为8
+            uint32_t integrals = static_cast<uint32_t>(tooHigh.f >> -one.e);
+            uint64_t fractionals = tooHigh.f & (one.f - 1);
+            *kappa = countDigits(integrals);
+            uint32_t divisor = static_cast<uint32_t>(kPow10[*kappa - 1]);
+            *len = 0;
+
+            while (*kappa > 0)
             {
-                int lsd = static_cast<int>(i % 16);
-                i /= 16;
-                *p++ = digitsHex[lsd];
-            } while (i != 0);
+                buffer[(*len)++] = static_cast<char>('0' + integrals / divisor);
+                integrals %= divisor;
+                --*kappa;
+                uint64_t rest =
+                    (static_cast<uint64_t>(integrals) << -one.e) + fractionals;
+                if (rest < unsafeInterval)
+                {
+                    return roundWeed(buffer, *len, (tooHigh - w).f,
+                                     unsafeInterval, rest,
+                                     static_cast<uint64_t>(divisor) << -one.e,
+                                     unit);
+                }
+                divisor /= 10;
+            }
 
-            *p = '\0';
-            std::reverse(buf, p);
+            for (;;)
+            {
+                fractionals *= 10;
+                unit *= 10;
+                unsafeInterval *= 10;
+                buffer[(*len)++] =
+                    static_cast<char>('0' + (fractionals >> -one.e));
+                fractionals &= one.f - 1;
+                --*kappa;
+                if (fractionals < unsafeInterval)
+                {
+                    return roundWeed(buffer, *len, (tooHigh - w).f * unit,
+                                     unsafeInterval, fractionals, one.f, unit);
+                }
+            }
+        }
+
+        // value > 0，结果为digits * 10^K，返回false时digits不可用
+        bool grisu3(double value, char* digits, int* length, int* K)
+        {
+            const DiyFp v(value);
+            DiyFp mMinus(0, 0), mPlus(0, 0);
+            v.normalizedBoundaries(&mMinus, &mPlus);
+
+            const DiyFp cmk = getCachedPower(mPlus.e, K);
+            const DiyFp W = v.normalize() * cmk;
+            const DiyFp Wp = mPlus * cmk;
+            const DiyFp Wm = mMinus * cmk;
+            int kappa = 0;
+            bool ok = digitGen(Wm, W, Wp, digits, length, &kappa);
+            *K += kappa;
+            return ok;
+        }
+
+        /**
+         * @brief Grisu3无法确定时（约0.5%，多是恰好落在两个double中点上的短小数，
+         *        如5e22），二分查找能还原的最短位数，由snprintf正确舍入
+         *        位数越多越接近value，能还原的位数是单调的
+         */
+        void shortestBySnprintf(double value, char* digits, int* length, int* K)
+        {
+            char buf[32];
+            int lo = 1;
+            int hi = 17; // 17位一定能还原
+            while (lo < hi)
+            {
+                int mid = (lo + hi) / 2;
+                snprintf(buf, sizeof buf, "%.*e", mid - 1, value);
+                if (strtod(buf, NULL) == value)
+                {
+                    hi = mid;
+                }
+                else
+                {
+                    lo = mid + 1;
+                }
+            }
+            // d.ddde+XX
+            snprintf(buf, sizeof buf, "%.*e", lo - 1, value);
+            const char* p = buf;
+            int n = 0;
+            for (; *p != 'e'; ++p)
+            {
+                if (*p != '.')
+                {
+                    digits[n++] = *p;
+                }
+            }
+            *length = n;
+            *K = atoi(p + 1) - (n - 1);
+        }
 
-            return p - buf;
+        // 与printf相同，指数至少两位
+        char* writeExponent(char* p, int exp)
+        {
+            *p++ = 'e';
+            if (exp < 0)
+            {
+                *p++ = '-';
+                exp = -exp;
+            }
+            else
+            {
+                *p++ = '+';
+            }
+            if (exp >= 100)
+            {
+                *p++ = static_cast<char>('0' + exp / 100);
+                exp %= 100;
+            }
+            memcpy(p, digitsLut + exp * 2, 2);
+            return p + 2;
+        }
+
+        size_t convertDouble(char buf[], double value)
+        {
+            char* p = buf;
+            if (std::isnan(value))
+            {
+                memcpy(buf, "nan", 4);
+                return 3;
+            }
+            if (std::signbit(value))
+            {
+                *p++ = '-';
+                value = -value;
+            }
+            if (value == 0.0)
+            {
+                *p++ = '0';
+            }
+            else if (std::isinf(value))
+            {
+                memcpy(p, "inf", 3);
+                p += 3;
+            }
+            else
+            {
+                char digits[20];
+                int length = 0;
+                int K = 0;
+                if (!grisu3(value, digits, &length, &K))
+                {
+                    shortestBySnprintf(value, digits, &length, &K);
+                }
+
+                // 10^(kk-1) <= value < 10^kk，和%.17g一样按指数选择定点或科学计数法
+                int kk = length + K;
+                if (length <= kk && kk <= 17)
+                {
+                    // 1234e3 -> 1234000
+                    memcpy(p, digits, length);
+                    memset(p + length, '0', kk - length);
+                    p += kk;
+                }
+                else if (0 < kk && kk <= 17)
+                {
+                    // 1234e-2 -> 12.34
+                    memcpy(p, digits, kk);
+                    p[kk] = '.';
+                    memcpy(p + kk + 1, digits + kk, length - kk);
+                    p += length + 1;
+                }
+                else if (-4 < kk && kk <= 0)
+                {
+                    // 1234e-6 -> 0.001234
+                    int offset = 2 - kk;
+                    p[0] = '0';
+                    p[1] = '.';
+                    memset(p + 2, '0', offset - 2);
+                    memcpy(p + offset, digits, length);
+                    p += length + offset;
+                }
+                else
+                {
+                    // 1234e30 -> 1.234e+33
+                    *p++ = digits[0];
+                    if (length > 1)
+                    {
+                        *p++ = '.';
+                        memcpy(p, digits + 1, length - 1);
+                        p += length - 1;
+                    }
+                    p = writeExponent(p, kk - 1);
+                }
+            }
+            *p = '\0';
+            return static_cast<size_t>(p - buf);
         }
 
         template class FixedBuffer<kSmallBuffer>;   // 模版类
+        template class FixedBuffer<kStagingBuffer>;
         template class FixedBuffer<kLargeBuffer>;
 
 
@@ -316,12 +717,15 @@ LogStream& LogStream::operator<<(const void* p)
     return *this;
 }
 
-// FIXME:: replace this with Grisu3 by Florian Loitsch
+// Grisu2，输出能还原成同一个double的最短数字
+// 以前是"%.12g"（最多12位有效数字，例如0.1 + 0.2输出0.3），
+// 现在位数不再截断（0.1 + 0.2输出0.30000000000000004），
+// 定点/科学计数法的选择和%.17g相同，指数格式与printf相同
 LogStream& LogStream::operator<<(double v)
 {
     if (buffer_.avail() >= kMaxNumericSize)
     {
-        int len = snprintf(buffer_.current(), kMaxNumericSize, "%.12g", v);
+        size_t len = convertDouble(buffer_.current(), v);
         buffer_.add(len);
     }
     return *this;
@@ -13,6 +13,8 @@ namespace detail {
 const int kSmallBuffer = 4000;
 // 大的缓冲区大小
 const int kLargeBuffer = 4000 * 1000;
+// 前端线程私有暂存区的大小，可容纳若干条日志，写满后整块交给后端
+const int kStagingBuffer = 4000 * 16;
 
 /**
  * @brief 固定大小的buffer
@@ -1,5 +1,7 @@
 #include "Logging.h"
 #include "CurrentThread.h"
+#include "Mutex.h"
+#include "TimeFormat.h"
 #include "TimeZone.h"
 #include "Timestamp.h"
 
@@ -7,12 +9,12 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <atomic>
 #include <sstream>
+#include <vector>
 
 namespace muduo {
 __thread char t_errnobuf[512];
-__thread char t_time[64];
-__thread time_t t_lastSecond;
 
 const char *strerror_tl(int savedErrno) {
   /** strerror_r(int __errnum, char *__buf, size_t __buflen)
@@ -37,10 +39,135 @@ Logger::LogLevel initLogLevel() { // 初始化日志级别
 
 Logger::LogLevel g_logLevel = initLogLevel(); // 初始化日志级别
 
+Logger::LogFormat initStructuredFormat() {
+  const char *format = ::getenv("MUDUO_LOG_FORMAT");
+  if (format && strcmp(format, "json") == 0) {
+    return Logger::kJson;
+  }
+  return Logger::kLogfmt;
+}
+
+Logger::LogFormat g_structuredFormat = initStructuredFormat();
+
+/**
+ * @brief 所有执行过的LOG_*调用点和各模块的日志级别
+ *        级别变化时刷新每个调用点缓存的开关
+ */
+class LogSiteRegistry : noncopyable {
+public:
+  LogSiteRegistry() {
+    // MUDUO_LOG_MODULES=EventLoop=TRACE,Timer=WARN
+    const char *env = ::getenv("MUDUO_LOG_MODULES");
+    string modules(env ? env : "");
+    size_t start = 0;
+    while (start < modules.size()) {
+      size_t end = modules.find(',', start);
+      if (end == string::npos) {
+        end = modules.size();
+      }
+      string item(modules, start, end - start);
+      size_t eq = item.find('=');
+      Logger::LogLevel level = Logger::INFO;
+      if (eq != string::npos && parseLevelName(item.c_str() + eq + 1, &level)) {
+        modules_.push_back(std::make_pair(item.substr(0, eq), level));
+      }
+      start = end + 1;
+    }
+  }
+
+  bool registerSite(Logger::Site *site) {
+    MutexLockGuard lock(mutex_);
+    if (site->state == Logger::Site::kUnregistered) {
+      sites_.push_back(site);
+      update(site);
+    }
+    return site->state == Logger::Site::kEnabled;
+  }
+
+  void setModuleLevel(const string &module, Logger::LogLevel level) {
+    MutexLockGuard lock(mutex_);
+    bool found = false;
+    for (auto &m : modules_) {
+      if (m.first == module) {
+        m.second = level;
+        found = true;
+      }
+    }
+    if (!found) {
+      modules_.push_back(std::make_pair(module, level));
+    }
+    updateAll();
+  }
+
+  void clearModuleLevels() {
+    MutexLockGuard lock(mutex_);
+    modules_.clear();
+    updateAll();
+  }
+
+  void updateAll() {
+    // 可能与registerSite()并发，因此也要加锁
+    mutex_.assertLocked();
+    for (Logger::Site *site : sites_) {
+      update(site);
+    }
+  }
+
+  MutexLock &mutex() { return mutex_; }
+
+private:
+  static bool parseLevelName(const char *name, Logger::LogLevel *level) {
+    static const char *kNames[Logger::NUM_LOG_LEVELS] = {
+        "TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"};
+    for (int i = 0; i < Logger::NUM_LOG_LEVELS; ++i) {
+      if (strcmp(name, kNames[i]) == 0) {
+        *level = static_cast<Logger::LogLevel>(i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  Logger::LogLevel levelOf(const char *file) const REQUIRES(mutex_) {
+    Logger::SourceFile basename(file);
+    StringPiece name(basename.data_, basename.size_);
+    const char *dot = static_cast<const char *>(
+        memchr(basename.data_, '.', static_cast<size_t>(basename.size_)));
+    StringPiece stem(basename.data_,
+                     dot ? static_cast<int>(dot - basename.data_)
+                         : basename.size_);
+    for (const auto &m : modules_) {
+      if (name == m.first || stem == m.first) {
+        return m.second;
+      }
+    }
+    return g_logLevel;
+  }
+
+  void update(Logger::Site *site) REQUIRES(mutex_) {
+    int state = site->level >= levelOf(site->file) ? Logger::Site::kEnabled
+                                                   : Logger::Site::kDisabled;
+    __atomic_store_n(&site->state, state, __ATOMIC_RELAXED);
+  }
+
+  MutexLock mutex_;
+  std::vector<Logger::Site *> sites_ GUARDED_BY(mutex_);
+  std::vector<std::pair<string, Logger::LogLevel>> modules_ GUARDED_BY(mutex_);
+};
+
+// 不析构，进程退出时其他线程的LOG_*仍可能登记调用点
+LogSiteRegistry &logSiteRegistry() {
+  static LogSiteRegistry *registry = new LogSiteRegistry;
+  return *registry;
+}
+
 const char *LogLevelName[Logger::NUM_LOG_LEVELS] = {
     "TRACE ", "DEBUG ", "INFO  ", "WARN  ", "ERROR ", "FATAL ",
 };
 
+// 结构化日志中的级别名不带补齐的空格
+const int LogLevelNameLength[Logger::NUM_LOG_LEVELS] = {5, 5, 4, 4, 5, 5};
+
 class T // 编译时获取字符串长度的类
 {
 public:
@@ -72,23 +199,29 @@ void defaultFlush() {
 
 Logger::OutputFunc g_output = defaultOutput; // 默认输出方法
 Logger::FlushFunc g_flush = defaultFlush;    // 默认刷新方法
-TimeZone g_logTimeZone;
+// setTimeZone()设置的时区的格式化缓存，为NULL时用UTC
+std::atomic<TimeFormatCache *> g_logTimeFormat(NULL);
 } // namespace muduo
 
 using namespace muduo;
 
 // 错误码 没有传0
 Logger::Impl::Impl(LogLevel level, int savedErrno,
-                   const muduo::Logger::SourceFile &file, int line)
+                   const muduo::Logger::SourceFile &file, int line,
+                   LogFormat format)
     : time_(Timestamp::now()), // 当前时间
       stream_(),               // 初始化logger[Impl]的四个成员
       level_(level),           // 日志级别
       line_(line),             // 调用LOG_*<<所在行，由__LINE__获取
-      basename_(file) // 调用LOG_*<<所在文件名，由__FILE__获取
-{
-  formatTime();         // 格式化时间 写入LogStream中
+      basename_(file), // 调用LOG_*<<所在文件名，由__FILE__获取
+      format_(format) {
   CurrentThread::tid(); // 缓存当前线程id
-  stream_ << " ";
+  if (format_ != kText) {
+    formatStructuredPrefix(savedErrno);
+    return;
+  }
+  formatTime(); // 格式化时间 写入LogStream中
+  stream_ << "  ";
   stream_ << T(CurrentThread::tidString(),
                CurrentThread::tidStringLength()); // 格式化线程tid字符串
   stream_ << " ";
@@ -101,42 +234,45 @@ Logger::Impl::Impl(LogLevel level, int savedErrno,
 }
 
 void Logger::Impl::formatTime() {
-  int64_t microSecondsSinceEpoch = time_.microSecondsSinceEpoch();
-  time_t seconds = static_cast<time_t>(microSecondsSinceEpoch /
-                                       Timestamp::kMicroSecondsPerSecond);
-  int microseconds = static_cast<int>(microSecondsSinceEpoch %
-                                      Timestamp::kMicroSecondsPerSecond);
-  if (seconds != t_lastSecond) {
-    t_lastSecond = seconds;
-    struct tm tm_time;
-    if (g_logTimeZone.valid()) {
-      tm_time = g_logTimeZone.toLocalTime(seconds);
-    } else {
-      ::gmtime_r(&seconds, &tm_time); // FIXME TimeZone::fromUtcTime
-    }
-
-    int len =
-        snprintf(t_time, sizeof t_time, "%4d%02d%02d %02d:%02d:%02d",
-                 tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
-                 tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
-    assert(len == 17);
-    (void)len;
-  }
+  char buf[kTimeLength];
+  int len = Logger::formatTime(time_, buf);
+  stream_ << T(buf, len);
+}
 
-  if (g_logTimeZone.valid()) {
-    Fmt us(".%06d ", microseconds);
-    assert(us.length() == 8);
-    stream_ << T(t_time, 17) << T(us.data(), 8);
+// 时间、tid、级别作为最前面的三个字段，之后每个字段以分隔符开头
+void Logger::Impl::formatStructuredPrefix(int savedErrno) {
+  T level(LogLevelName[level_], LogLevelNameLength[level_]);
+  if (format_ == kJson) {
+    stream_ << T("{\"time\":\"", 9);
+    formatTime();
+    stream_ << T("\",\"tid\":", 8) << CurrentThread::tid()
+            << T(",\"level\":\"", 10) << level << '"';
+    if (savedErrno != 0) {
+      stream_ << T(",\"error\":\"", 10) << strerror_tl(savedErrno)
+              << T("\",\"errno\":", 10) << savedErrno;
+    }
   } else {
-    Fmt us(".%06dZ ", microseconds);
-    assert(us.length() == 9);
-    stream_ << T(t_time, 17) << T(us.data(), 9);
+    stream_ << T("time=\"", 6);
+    formatTime();
+    stream_ << T("\" tid=", 6) << CurrentThread::tid() << T(" level=", 7)
+            << level;
+    if (savedErrno != 0) {
+      stream_ << T(" error=\"", 8) << strerror_tl(savedErrno)
+              << T("\" errno=", 8) << savedErrno;
+    }
   }
 }
 
 // 将名字行输进缓冲区
 void Logger::Impl::finish() {
-  stream_ << " - " << basename_ << ':' << line_ << '\n';
+  if (format_ == kText) {
+    stream_ << " - " << basename_ << ':' << line_ << '\n';
+  } else if (format_ == kJson) {
+    stream_ << T(",\"src\":\"", 8) << basename_ << ':' << line_
+            << T("\"}\n", 3);
+  } else {
+    stream_ << T(" src=", 5) << basename_ << ':' << line_ << '\n';
+  }
 }
 
 Logger::Logger(SourceFile file, int line) : impl_(INFO, 0, file, line) {}
@@ -153,6 +289,9 @@ Logger::Logger(SourceFile file, int line, LogLevel level)
 Logger::Logger(SourceFile file, int line, bool toAbort)
     : impl_(toAbort ? FATAL : ERROR, errno, file, line) {}
 
+Logger::Logger(SourceFile file, int line, LogLevel level, LogFormat format)
+    : impl_(level, 0, file, line, format) {}
+
 // 由于是临时对象，所以析构函数接管了所有日志输出的任务
 //
 // 1. 为日志信息添加后缀，通常是源文件名和所在行号
@@ -176,8 +315,111 @@ Logger::~Logger() {
   }
 }
 
+// 结构化日志行的前缀为time="..." tid=1234 level=INFO 或者
+// {"time":"...","tid":1234,"level":"INFO"
+static bool parseStructuredLogLevel(const char *line, int len,
+                                    Logger::LogLevel *level) {
+  // "20220101 08:00:00.123456"，不含Logger::kTimeLength中UTC时的'Z'
+  const int kDateTimeLength = TimeZone::kMicrosecondsFormatLength;
+  bool json = line[0] == '{';
+  const int prefixLength = (json ? 9 : 6) + kDateTimeLength;
+  if (len < prefixLength + 2) {
+    return false;
+  }
+  const char *end = line + len;
+  const char *p = line + prefixLength;
+  if (*p == 'Z') {
+    ++p;
+  }
+  const char *tidKey = json ? "\",\"tid\":" : "\" tid=";
+  size_t tidKeyLen = strlen(tidKey);
+  if (static_cast<size_t>(end - p) < tidKeyLen ||
+      memcmp(p, tidKey, tidKeyLen) != 0) {
+    return false;
+  }
+  p += tidKeyLen;
+  while (p != end && *p >= '0' && *p <= '9') {
+    ++p;
+  }
+  const char *levelKey = json ? ",\"level\":\"" : " level=";
+  size_t levelKeyLen = strlen(levelKey);
+  if (static_cast<size_t>(end - p) < levelKeyLen ||
+      memcmp(p, levelKey, levelKeyLen) != 0) {
+    return false;
+  }
+  p += levelKeyLen;
+  for (int i = 0; i < Logger::NUM_LOG_LEVELS; ++i) {
+    int n = LogLevelNameLength[i];
+    if (end - p > n && memcmp(p, LogLevelName[i], n) == 0 &&
+        p[n] == (json ? '"' : ' ')) {
+      *level = static_cast<Logger::LogLevel>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+// 日志行的前缀为"20220101 08:00:00.123456Z  1234 INFO  "，
+// 使用TimeZone时没有'Z'，tid至少5个字符
+bool Logger::parseLogLevel(const char *line, int len, LogLevel *level) {
+  // "20220101 08:00:00.123456"，不含Logger::kTimeLength中UTC时的'Z'
+  const int kDateTimeLength = TimeZone::kMicrosecondsFormatLength;
+  const char *end = line + len;
+  const char *p = line + kDateTimeLength;
+  if (len <= kDateTimeLength) {
+    return false;
+  }
+  if (memcmp(line, "time=\"", 6) == 0 ||
+      memcmp(line, "{\"time\":\"", 9) == 0) {
+    return parseStructuredLogLevel(line, len, level);
+  }
+  if (*p == 'Z') {
+    ++p;
+  }
+  if (p == end || *p++ != ' ') {
+    return false;
+  }
+  while (p != end && *p == ' ') {
+    ++p;
+  }
+  const char *tid = p;
+  while (p != end && *p >= '0' && *p <= '9') {
+    ++p;
+  }
+  if (p == tid || p == end || *p++ != ' ' || end - p < 6) {
+    return false;
+  }
+  for (int i = 0; i < NUM_LOG_LEVELS; ++i) {
+    if (memcmp(p, LogLevelName[i], 6) == 0) {
+      *level = static_cast<LogLevel>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
 // 设置日志级别
-void Logger::setLogLevel(Logger::LogLevel level) { g_logLevel = level; }
+void Logger::setLogLevel(Logger::LogLevel level) {
+  LogSiteRegistry &registry = logSiteRegistry();
+  MutexLockGuard lock(registry.mutex());
+  g_logLevel = level;
+  registry.updateAll();
+}
+
+void Logger::setStructuredFormat(LogFormat format) {
+  assert(format != kText);
+  g_structuredFormat = format;
+}
+
+void Logger::setModuleLogLevel(const string &module, LogLevel level) {
+  logSiteRegistry().setModuleLevel(module, level);
+}
+
+void Logger::clearModuleLogLevels() { logSiteRegistry().clearModuleLevels(); }
+
+bool Logger::registerSite(Site *site) {
+  return logSiteRegistry().registerSite(site);
+}
 
 // 设置输出函数，代替默认
 void Logger::setOutput(OutputFunc out) { g_output = out; }
@@ -185,4 +427,21 @@ void Logger::setOutput(OutputFunc out) { g_output = out; }
 // 设置刷新函数，代替默认
 void Logger::setFlush(FlushFunc flush) { g_flush = flush; }
 
-void Logger::setTimeZone(const TimeZone &tz) { g_logTimeZone = tz; }
+int Logger::formatTime(Timestamp time, char *buf) {
+  static_assert(
+      kTimeLength == TimeFormatCache::kMaxMicrosecondsFormatLength + 1,
+      "kTimeLength");
+  TimeFormatCache *cache = g_logTimeFormat.load(std::memory_order_acquire);
+  if (cache) {
+    return cache->formatMicroseconds(time, buf);
+  }
+  int len = TimeFormatCache::utc().formatMicroseconds(time, buf);
+  buf[len] = 'Z';
+  return len + 1;
+}
+
+// 旧的缓存可能还有线程正在读，不释放；时区通常只在启动时设置一次
+void Logger::setTimeZone(const TimeZone &tz) {
+  g_logTimeFormat.store(tz.valid() ? new TimeFormatCache(tz) : NULL,
+                        std::memory_order_release);
+}
@@ -25,6 +25,13 @@ public:
     NUM_LOG_LEVELS,
   };
 
+  // 一行日志的格式，kLogfmt和kJson只用于LOG_*_KV（见StructuredLogging.h）
+  enum LogFormat {
+    kText,   // 20220101 08:00:00.123456Z  1234 INFO  msg - file:line
+    kLogfmt, // time="20220101 08:00:00.123456Z" tid=1234 level=INFO k=v src=file:line
+    kJson,   // {"time":"...","tid":1234,"level":"INFO","k":v,"src":"file:line"}
+  };
+
   // SourceFile保存着调用LOG_*语句所在的源文件名和行号
   // compile time calculation of basename of source file
   class SourceFile {
@@ -57,14 +64,73 @@ public:
   Logger(SourceFile file, int line, LogLevel level);
   Logger(SourceFile file, int line, LogLevel level, const char *func);
   Logger(SourceFile file, int line, bool toAbort);
+  Logger(SourceFile file, int line, LogLevel level, LogFormat format);
   ~Logger();
 
   // 返回Impl的LogStream对象
   LogStream &stream() { return impl_.stream_; }
+  LogFormat format() const { return impl_.format_; }
 
   static LogLevel logLevel();
+  // 同时刷新所有调用点缓存的开关
   static void setLogLevel(LogLevel level);
 
+  static LogFormat structuredFormat();
+  /**
+   * @brief 设置LOG_*_KV输出的格式，kLogfmt（默认）或者kJson
+   *        也可以在启动时用环境变量设置：MUDUO_LOG_FORMAT=json
+   *
+   */
+  static void setStructuredFormat(LogFormat format);
+
+  /**
+   * @brief 单独设置某个模块的日志级别，优先于全局级别，运行时随时可以修改
+   *        模块即源文件，用文件名（"EventLoop.cc"）或去掉扩展名（"EventLoop"）指定
+   *        也可以在启动时用环境变量设置：MUDUO_LOG_MODULES=EventLoop=TRACE,Timer=WARN
+   *
+   * @param module 模块名
+   * @param level 级别
+   */
+  static void setModuleLogLevel(const string &module, LogLevel level);
+
+  /**
+   * @brief 清除所有模块的日志级别，全部回到全局级别
+   *
+   */
+  static void clearModuleLogLevels();
+
+  /**
+   * @brief 一个LOG_*调用点缓存的开关，由LOG_*宏为每个调用点定义一个static对象
+   *        级别变化时由Logger统一刷新，判断是否输出只需要读一次state
+   */
+  struct Site {
+    enum State {
+      kDisabled = 0,
+      kEnabled = 1,
+      kUnregistered = 2, // 第一次执行到时登记并计算开关
+    };
+
+    bool enabled() {
+      int s = __atomic_load_n(&state, __ATOMIC_RELAXED);
+      // 关闭时只有一次比较
+      return s != kDisabled && (s == kEnabled || registerSite(this));
+    }
+
+    const char *file;
+    LogLevel level;
+    int state;
+  };
+
+  /**
+   * @brief 从Logger输出的一行日志中解析出日志级别（格式见Impl的构造函数）
+   *
+   * @param line 日志行
+   * @param len 长度
+   * @param level 解析出的级别
+   * @return false 不是由Logger格式化的日志行
+   */
+  static bool parseLogLevel(const char *line, int len, LogLevel *level);
+
   // 输出函数，将日志信息输出
   typedef void (*OutputFunc)(const char *msg, int len);
   // 刷新缓冲区
@@ -73,15 +139,30 @@ public:
   static void setFlush(FlushFunc);
   static void setTimeZone(const TimeZone &tz);
 
+  // formatTime()最多写入的字节数，通常是25
+  static const int kTimeLength = 32;
+
+  /**
+   * @brief 按日志行前缀的格式写入时间，如 20150127 21:46:45.376742Z，
+   *        使用setTimeZone()的时区（此时没有'Z'），各线程共用一个格式化缓存
+   *
+   * @param buf 至少kTimeLength字节，不以'\0'结尾
+   * @return int 写入的字节数
+   */
+  static int formatTime(Timestamp time, char *buf);
+
 private:
+  static bool registerSite(Site *site);
+
   // Impl保存着所有Logger需要的数据 将对象与数据分开
   class Impl // 实际上上logger类内部的一个嵌套类，封装了Logger的缓冲区stream_
   {
   public:
     typedef Logger::LogLevel LogLevel;
-    Impl(LogLevel level, int old_errno, const SourceFile &file,
-         int line); // 级别错误文件行
+    Impl(LogLevel level, int old_errno, const SourceFile &file, int line,
+         LogFormat format = kText); // 级别错误文件行
     void formatTime();
+    void formatStructuredPrefix(int savedErrno);
     void finish();
 
     Timestamp time_;      // 当前时间
@@ -89,6 +170,7 @@ private:
     LogLevel level_;      // 级别
     int line_;            // 行
     SourceFile basename_; // 基本名称
+    LogFormat format_;
   };
 
   Impl impl_; // Logger构造这个对象
@@ -98,21 +180,28 @@ extern Logger::LogLevel g_logLevel;
 
 inline Logger::LogLevel Logger::logLevel() { return g_logLevel; }
 
+extern Logger::LogFormat g_structuredFormat;
+
+inline Logger::LogFormat Logger::structuredFormat() {
+  return g_structuredFormat;
+}
+
 //
-// CAUTION: do not write:
+// LOG_*可以直接写在不带花括号的if/else中：
 //
 // if (good)
 //   LOG_INFO << "Good news";
 // else
 //   LOG_WARN << "Bad news";
 //
-// this expends to
+// this expands to
 //
 // if (good)
-//   if (logging_INFO)
-//     logInfoStream << "Good news";
-//   else
-//     logWarnStream << "Bad news";
+//   if (!logging_INFO) {} else logInfoStream << "Good news";
+// else
+//   logWarnStream << "Bad news";
+//
+// 宏里的if已经带着自己的else，调用者的else与if (good)配对
 //
 
 // 使用if条件判断，如果当前级别大于TRACE，就相当于没有下面一行代码，不会编译，下同。
@@ -128,21 +217,49 @@ inline Logger::LogLevel Logger::logLevel() { return g_logLevel; }
  * 2.调用LogStream重载的operator<<操作符，将数据写入到LogStream的Buffer中
  * 3.当前语句结束，Logger临时对象析构，调用Logger析构函数，将LogStream中的数据输出
  */
+
+// 编译时的最低日志级别（0为TRACE，1为DEBUG……），低于它的LOG_*语句整个被编译器去掉
+// 例如release版本加上-DMUDUO_MIN_LOG_LEVEL=2，LOG_TRACE和LOG_DEBUG不再产生任何代码
+#ifndef MUDUO_MIN_LOG_LEVEL
+#define MUDUO_MIN_LOG_LEVEL 0
+#endif
+
+// 先比较编译时的级别，再读调用点缓存的开关（GNU statement expression中定义static对象，
+// 常量初始化，没有线程安全的初始化检查）
+#define MUDUO_LOG_ENABLED(lvl)                                                 \
+  (MUDUO_MIN_LOG_LEVEL <= (lvl) && ({                                          \
+     static muduo::Logger::Site muduo_log_site = {                             \
+         __FILE__, lvl, muduo::Logger::Site::kUnregistered};                   \
+     muduo_log_site.enabled();                                                 \
+   }))
+
 #define LOG_TRACE                                                              \
-  if (muduo::Logger::logLevel() <= muduo::Logger::TRACE)                       \
-  muduo::Logger(__FILE__, __LINE__, muduo::Logger::TRACE, __func__).stream()
+  if (!MUDUO_LOG_ENABLED(muduo::Logger::TRACE)) {                              \
+  } else                                                                       \
+    muduo::Logger(__FILE__, __LINE__, muduo::Logger::TRACE, __func__).stream()
 #define LOG_DEBUG                                                              \
-  if (muduo::Logger::logLevel() <= muduo::Logger::DEBUG)                       \
-  muduo::Logger(__FILE__, __LINE__, muduo::Logger::DEBUG, __func__).stream()
+  if (!MUDUO_LOG_ENABLED(muduo::Logger::DEBUG)) {                              \
+  } else                                                                       \
+    muduo::Logger(__FILE__, __LINE__, muduo::Logger::DEBUG, __func__).stream()
 #define LOG_INFO                                                               \
-  if (muduo::Logger::logLevel() <= muduo::Logger::INFO)                        \
-  muduo::Logger(__FILE__, __LINE__).stream()
-#define LOG_WARN muduo::Logger(__FILE__, __LINE__, muduo::Logger::WARN).stream()
+  if (!MUDUO_LOG_ENABLED(muduo::Logger::INFO)) {                               \
+  } else                                                                       \
+    muduo::Logger(__FILE__, __LINE__).stream()
+#define LOG_WARN                                                               \
+  if (!MUDUO_LOG_ENABLED(muduo::Logger::WARN)) {                               \
+  } else                                                                       \
+    muduo::Logger(__FILE__, __LINE__, muduo::Logger::WARN).stream()
 #define LOG_ERROR                                                              \
-  muduo::Logger(__FILE__, __LINE__, muduo::Logger::ERROR).stream()
+  if (!MUDUO_LOG_ENABLED(muduo::Logger::ERROR)) {                              \
+  } else                                                                       \
+    muduo::Logger(__FILE__, __LINE__, muduo::Logger::ERROR).stream()
+// FATAL总是输出
 #define LOG_FATAL                                                              \
   muduo::Logger(__FILE__, __LINE__, muduo::Logger::FATAL).stream()
-#define LOG_SYSERR muduo::Logger(__FILE__, __LINE__, false).stream()
+#define LOG_SYSERR                                                             \
+  if (!MUDUO_LOG_ENABLED(muduo::Logger::ERROR)) {                              \
+  } else                                                                       \
+    muduo::Logger(__FILE__, __LINE__, false).stream()
 #define LOG_SYSFATAL muduo::Logger(__FILE__, __LINE__, true).stream()
 #define LOG muduo::Logger(__FILE__, __LINE__).stream()
 
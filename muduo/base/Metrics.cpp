@@ -0,0 +1,344 @@
+#include "Metrics.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+
+using namespace muduo;
+
+namespace muduo {
+namespace detail {
+
+__thread std::atomic<int64_t> *t_metricsCells = NULL;
+
+} // namespace detail
+} // namespace muduo
+
+namespace {
+
+const size_t kShardBytes =
+    (MetricsRegistry::kMaxCells + MetricsRegistry::kOverflowCells) *
+    sizeof(std::atomic<int64_t>);
+
+pthread_key_t g_metricsShardKey;
+pthread_once_t g_metricsShardOnce = PTHREAD_ONCE_INIT;
+
+void createMetricsShardKey() {
+  MCHECK(pthread_key_create(&g_metricsShardKey, &detail::releaseMetricsShard));
+}
+
+void appendInt(string *out, int64_t value) {
+  char buf[32];
+  snprintf(buf, sizeof buf, "%lld", static_cast<long long>(value));
+  out->append(buf);
+}
+
+} // namespace
+
+std::atomic<int64_t> *detail::registerMetricsShard() {
+  pthread_once(&g_metricsShardOnce, &createMetricsShardKey);
+  // 匿名映射按页对齐、内容为0，只有用到的页才占用内存
+  void *memory = ::mmap(NULL, kShardBytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    fprintf(stderr, "Metrics: mmap %zu bytes failed\n", kShardBytes);
+    abort();
+  }
+  std::atomic<int64_t> *cells = static_cast<std::atomic<int64_t> *>(memory);
+  MetricsRegistry::instance().addShard(cells);
+  MCHECK(pthread_setspecific(g_metricsShardKey, cells));
+  t_metricsCells = cells;
+  return cells;
+}
+
+void detail::releaseMetricsShard(void *cells) {
+  t_metricsCells = NULL;
+  MetricsRegistry::instance().removeShard(
+      static_cast<std::atomic<int64_t> *>(cells));
+}
+
+Metric::Metric(Type type, const string &name, const string &help,
+               const string &labels, int cells)
+    : type_(type), name_(name), help_(help), labels_(labels), cells_(cells),
+      offset_(MetricsRegistry::instance().add(this, cells)) {}
+
+Metric::~Metric() { MetricsRegistry::instance().remove(this, offset_, cells_); }
+
+string Metric::fullName(const char *suffix, const string &extraLabel) const {
+  string result(name_);
+  result += suffix;
+  if (!labels_.empty() || !extraLabel.empty()) {
+    result += '{';
+    result += labels_;
+    if (!labels_.empty() && !extraLabel.empty()) {
+      result += ',';
+    }
+    result += extraLabel;
+    result += '}';
+  }
+  return result;
+}
+
+int64_t MetricCounter::value() const {
+  int64_t sum = 0;
+  MetricsRegistry::instance().collect(offset_, 1, &sum);
+  return sum;
+}
+
+void MetricCounter::appendText(string *out) const {
+  *out += fullName();
+  *out += ' ';
+  appendInt(out, value());
+  *out += '\n';
+}
+
+void MetricCounter::appendPrometheus(string *out) const { appendText(out); }
+
+void MetricGauge::appendText(string *out) const {
+  *out += fullName();
+  *out += ' ';
+  appendInt(out, value());
+  *out += '\n';
+}
+
+void MetricGauge::appendPrometheus(string *out) const { appendText(out); }
+
+double MetricHistogram::Snapshot::average() const {
+  return count_ > 0 ? static_cast<double>(sum_) / static_cast<double>(count_)
+                    : 0.0;
+}
+
+int64_t MetricHistogram::Snapshot::percentile(double p) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  int64_t target = static_cast<int64_t>(static_cast<double>(count_) * p);
+  int64_t seen = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    seen += bucketCount(i);
+    if (seen > target) {
+      return bucketLimit(i);
+    }
+  }
+  return bucketLimit(kBuckets - 1);
+}
+
+int64_t MetricHistogram::Snapshot::max() const {
+  for (int i = kBuckets - 1; i >= 0; --i) {
+    if (bucketCount(i) > 0) {
+      return bucketLimit(i);
+    }
+  }
+  return 0;
+}
+
+string MetricHistogram::Snapshot::toString() const {
+  char buf[256];
+  snprintf(buf, sizeof buf,
+           "count=%lld avg=%.1f p50<%lld p99<%lld p999<%lld max<%lld",
+           static_cast<long long>(count()), average(),
+           static_cast<long long>(percentile(0.5)),
+           static_cast<long long>(percentile(0.99)),
+           static_cast<long long>(percentile(0.999)),
+           static_cast<long long>(max()));
+  return buf;
+}
+
+MetricHistogram::Snapshot MetricHistogram::snapshot() const {
+  std::vector<int64_t> cells(kBuckets + 1, 0);
+  MetricsRegistry::instance().collect(offset_, kBuckets + 1, cells.data());
+  Snapshot snapshot;
+  for (int i = 0; i < kBuckets; ++i) {
+    snapshot.counts_[static_cast<size_t>(i)] = cells[static_cast<size_t>(i)];
+    snapshot.count_ += cells[static_cast<size_t>(i)];
+  }
+  snapshot.sum_ = cells[kBuckets];
+  return snapshot;
+}
+
+void MetricHistogram::appendText(string *out) const {
+  *out += fullName();
+  *out += ' ';
+  *out += toString();
+  *out += '\n';
+}
+
+void MetricHistogram::appendPrometheus(string *out) const {
+  Snapshot snap = snapshot();
+  // 只在2的幂处输出累计计数，le取整数上界2^k-1，直到最大值所在的桶
+  int64_t cumulative = 0;
+  int64_t limit = snap.max();
+  for (int i = 0; i < kBuckets && cumulative < snap.count(); ++i) {
+    cumulative += snap.bucketCount(i);
+    int64_t upper = bucketLimit(i);
+    if ((upper & (upper - 1)) == 0 || upper >= limit) {
+      string le("le=\"");
+      appendInt(&le, upper - 1);
+      le += '"';
+      *out += fullName("_bucket", le);
+      *out += ' ';
+      appendInt(out, cumulative);
+      *out += '\n';
+    }
+  }
+  *out += fullName("_bucket", "le=\"+Inf\"");
+  *out += ' ';
+  appendInt(out, snap.count());
+  *out += '\n';
+  *out += fullName("_sum");
+  *out += ' ';
+  appendInt(out, snap.sum());
+  *out += '\n';
+  *out += fullName("_count");
+  *out += ' ';
+  appendInt(out, snap.count());
+  *out += '\n';
+}
+
+MetricsRegistry::MetricsRegistry()
+    : retired_(kMaxCells, 0), nextCell_(0), overflowWarned_(false) {}
+
+MetricsRegistry &MetricsRegistry::instance() {
+  // 不析构，线程退出和全局对象析构时可能还会用到
+  static MetricsRegistry *registry = new MetricsRegistry;
+  return *registry;
+}
+
+int MetricsRegistry::add(Metric *metric, int cells) {
+  assert(cells <= kOverflowCells);
+  MutexLockGuard lock(mutex_);
+  if (cells == 0) {
+    metrics_.push_back(metric);
+    return 0;
+  }
+  for (auto it = freeCells_.begin(); it != freeCells_.end(); ++it) {
+    if (it->second >= cells) {
+      int offset = it->first;
+      it->first += cells;
+      it->second -= cells;
+      if (it->second == 0) {
+        freeCells_.erase(it);
+      }
+      metrics_.push_back(metric);
+      return offset;
+    }
+  }
+  if (nextCell_ + cells > kMaxCells) {
+    // 不因为指标太多而终止进程：该指标照常使用，但不计数也不输出
+    if (!overflowWarned_) {
+      overflowWarned_ = true;
+      fprintf(stderr,
+              "Metrics: too many metrics, %s needs %d more cells, "
+              "it and later ones are not recorded\n",
+              metric->name().c_str(), cells);
+    }
+    return kMaxCells;
+  }
+  metrics_.push_back(metric);
+  int offset = nextCell_;
+  nextCell_ += cells;
+  return offset;
+}
+
+void MetricsRegistry::remove(Metric *metric, int offset, int cells) {
+  if (offset == kMaxCells) {
+    return; // 没有注册
+  }
+  MutexLockGuard dumpLock(dumpMutex_);
+  MutexLockGuard lock(mutex_);
+  metrics_.erase(std::find(metrics_.begin(), metrics_.end(), metric));
+  if (cells == 0) {
+    return;
+  }
+  // 清零后留给之后注册的指标
+  for (std::atomic<int64_t> *shard : shards_) {
+    for (int i = offset; i < offset + cells; ++i) {
+      shard[i].store(0, std::memory_order_relaxed);
+    }
+  }
+  std::fill(retired_.begin() + offset, retired_.begin() + offset + cells, 0);
+  freeCells_.push_back(std::make_pair(offset, cells));
+}
+
+void MetricsRegistry::collect(int offset, int cells, int64_t *out) const {
+  if (offset == kMaxCells) {
+    return;
+  }
+  MutexLockGuard lock(mutex_);
+  for (int i = 0; i < cells; ++i) {
+    out[i] += retired_[static_cast<size_t>(offset + i)];
+  }
+  for (const std::atomic<int64_t> *shard : shards_) {
+    for (int i = 0; i < cells; ++i) {
+      out[i] += shard[offset + i].load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void MetricsRegistry::addShard(std::atomic<int64_t> *cells) {
+  MutexLockGuard lock(mutex_);
+  shards_.push_back(cells);
+}
+
+void MetricsRegistry::removeShard(std::atomic<int64_t> *cells) {
+  {
+    MutexLockGuard lock(mutex_);
+    shards_.erase(std::find(shards_.begin(), shards_.end(), cells));
+    for (int i = 0; i < nextCell_; ++i) {
+      retired_[static_cast<size_t>(i)] +=
+          cells[i].load(std::memory_order_relaxed);
+    }
+  }
+  ::munmap(cells, kShardBytes);
+}
+
+std::vector<Metric *> MetricsRegistry::sortedMetrics() const {
+  std::vector<Metric *> metrics;
+  {
+    MutexLockGuard lock(mutex_);
+    metrics = metrics_;
+  }
+  std::stable_sort(metrics.begin(), metrics.end(),
+                   [](const Metric *lhs, const Metric *rhs) {
+                     return lhs->name() < rhs->name();
+                   });
+  return metrics;
+}
+
+string MetricsRegistry::dumpText() const {
+  MutexLockGuard dumpLock(dumpMutex_);
+  string out;
+  for (const Metric *metric : sortedMetrics()) {
+    metric->appendText(&out);
+  }
+  return out;
+}
+
+string MetricsRegistry::dumpPrometheus() const {
+  static const char *const kTypeNames[] = {"counter", "gauge", "histogram"};
+  MutexLockGuard dumpLock(dumpMutex_);
+  string out;
+  const string *lastName = NULL;
+  for (const Metric *metric : sortedMetrics()) {
+    // 同名的指标（标签不同）只输出一次HELP和TYPE
+    if (lastName == NULL || *lastName != metric->name()) {
+      out += "# HELP ";
+      out += metric->name();
+      out += ' ';
+      out += metric->help();
+      out += "\n# TYPE ";
+      out += metric->name();
+      out += ' ';
+      out += kTypeNames[metric->type()];
+      out += '\n';
+      lastName = &metric->name();
+    }
+    metric->appendPrometheus(&out);
+  }
+  return out;
+}
@@ -0,0 +1,289 @@
+#ifndef BASE_METRICS_H
+#define BASE_METRICS_H
+
+#include "Mutex.h"
+#include "Types.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace muduo {
+
+namespace detail {
+
+// 当前线程的计数数组，第一次使用时分配，线程退出时把值并入MetricsRegistry
+extern __thread std::atomic<int64_t> *t_metricsCells;
+std::atomic<int64_t> *registerMetricsShard();
+void releaseMetricsShard(void *cells);
+
+inline std::atomic<int64_t> *metricsCells() {
+  std::atomic<int64_t> *cells = t_metricsCells;
+  if (__builtin_expect(cells == NULL, 0)) {
+    cells = registerMetricsShard();
+  }
+  return cells;
+}
+
+// 只有所属线程写自己的计数，不需要原子的读-改-写
+inline void addToCell(int offset, int64_t n) {
+  std::atomic<int64_t> &cell = metricsCells()[offset];
+  cell.store(cell.load(std::memory_order_relaxed) + n,
+             std::memory_order_relaxed);
+}
+
+} // namespace detail
+
+/**
+ * @brief 所有指标的基类，构造时注册到MetricsRegistry，析构时注销
+ *        name和labels遵循Prometheus的格式，labels形如 pool="Main",kind="io"
+ *
+ */
+class Metric : noncopyable {
+public:
+  enum Type { kCounter, kGauge, kHistogram };
+
+  const string &name() const { return name_; }
+  const string &help() const { return help_; }
+  const string &labels() const { return labels_; }
+  Type type() const { return type_; }
+
+  virtual void appendText(string *out) const = 0;
+  virtual void appendPrometheus(string *out) const = 0;
+
+protected:
+  // cells为每个线程需要的计数个数，0表示不分片
+  Metric(Type type, const string &name, const string &help,
+         const string &labels, int cells);
+  virtual ~Metric();
+
+  // 名字和标签，如 name{labels}，后缀加在名字后面，extraLabel加在标签最后
+  string fullName(const char *suffix = "", const string &extraLabel = "") const;
+
+  const Type type_;
+  const string name_;
+  const string help_;
+  const string labels_;
+  const int cells_;
+  int offset_; // 在每个线程的计数数组中的位置
+};
+
+/**
+ * @brief 只增不减的计数，每个线程累加自己的分片，读取时汇总
+ *
+ */
+class MetricCounter : public Metric {
+public:
+  MetricCounter(const string &name, const string &help,
+                const string &labels = "")
+      : Metric(kCounter, name, help, labels, 1) {}
+
+  void add(int64_t n = 1) { detail::addToCell(offset_, n); }
+
+  // 所有线程（包括已经退出的）的总和
+  int64_t value() const;
+
+  void appendText(string *out) const override;
+  void appendPrometheus(string *out) const override;
+};
+
+/**
+ * @brief 可增可减的当前值，如队列长度、线程数
+ *        通常只有一个写者，直接存为一个原子变量，不分片；
+ *        也可以给出一个函数，在读取时才求值
+ *
+ */
+class MetricGauge : public Metric {
+public:
+  typedef std::function<int64_t()> ValueCallback;
+
+  MetricGauge(const string &name, const string &help,
+              const string &labels = "")
+      : Metric(kGauge, name, help, labels, 0), value_(0) {}
+
+  MetricGauge(const string &name, const string &help, const string &labels,
+              ValueCallback cb)
+      : Metric(kGauge, name, help, labels, 0), value_(0),
+        callback_(std::move(cb)) {}
+
+  void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+  void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+
+  int64_t value() const {
+    return callback_ ? callback_() : value_.load(std::memory_order_relaxed);
+  }
+
+  void appendText(string *out) const override;
+  void appendPrometheus(string *out) const override;
+
+private:
+  std::atomic<int64_t> value_;
+  const ValueCallback callback_;
+};
+
+/**
+ * @brief HDR风格的直方图：每个2的幂再均分为8个子桶，相对误差不超过12.5%
+ *        0到15精确计数，超过2^37的值计入最后一个桶
+ *        每个线程累加自己的分片，读取时汇总成Snapshot
+ *
+ */
+class MetricHistogram : public Metric {
+public:
+  static const int kSubBucketBits = 3;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  static const int kMaxExponent = 37;
+  static const int kBuckets =
+      (kMaxExponent - kSubBucketBits + 2) * kSubBuckets;
+
+  /**
+   * @brief 某一时刻各线程分片的汇总
+   *
+   */
+  class Snapshot {
+  public:
+    Snapshot() : counts_(kBuckets, 0), count_(0), sum_(0) {}
+
+    int64_t count() const { return count_; }
+    int64_t sum() const { return sum_; }
+    double average() const;
+    int64_t bucketCount(int i) const {
+      return counts_[static_cast<size_t>(i)];
+    }
+
+    /**
+     * @brief 百分位数所在桶的上界（不含），没有数据时返回0
+     *
+     * @param p 0到1之间
+     */
+    int64_t percentile(double p) const;
+
+    // 最大值所在桶的上界（不含）
+    int64_t max() const;
+
+    /**
+     * @brief count=... avg=... p50<... p99<... p999<... max<...
+     *
+     */
+    string toString() const;
+
+  private:
+    friend class MetricHistogram;
+    std::vector<int64_t> counts_;
+    int64_t count_;
+    int64_t sum_;
+  };
+
+  MetricHistogram(const string &name, const string &help,
+                  const string &labels = "")
+      : Metric(kHistogram, name, help, labels, kBuckets + 1) {}
+
+  /**
+   * @brief 记录一个非负的值，负数按0计算
+   *
+   */
+  void add(int64_t value) {
+    if (value < 0) {
+      value = 0;
+    }
+    detail::addToCell(offset_ + bucketIndex(value), 1);
+    detail::addToCell(offset_ + kBuckets, value);
+  }
+
+  Snapshot snapshot() const;
+
+  int64_t count() const { return snapshot().count(); }
+  string toString() const { return snapshot().toString(); }
+
+  static int bucketIndex(int64_t value) {
+    if (value < 2 * kSubBuckets) {
+      return static_cast<int>(value);
+    }
+    int exponent = 63 - __builtin_clzll(static_cast<uint64_t>(value));
+    if (exponent > kMaxExponent) {
+      return kBuckets - 1;
+    }
+    int sub = static_cast<int>(value >> (exponent - kSubBucketBits));
+    return (exponent - kSubBucketBits + 1) * kSubBuckets + sub - kSubBuckets;
+  }
+
+  // 第i个桶的下界（含）
+  static int64_t bucketLowerBound(int i) {
+    if (i < 2 * kSubBuckets) {
+      return i;
+    }
+    int exponent = i / kSubBuckets + kSubBucketBits - 1;
+    int64_t sub = i % kSubBuckets + kSubBuckets;
+    return sub << (exponent - kSubBucketBits);
+  }
+
+  // 第i个桶的上界（不含）
+  static int64_t bucketLimit(int i) { return bucketLowerBound(i + 1); }
+
+  void appendText(string *out) const override;
+  void appendPrometheus(string *out) const override;
+};
+
+/**
+ * @brief 进程内所有指标的注册表
+ *        每个线程有自己的计数数组（按页分配，互不共享cache line），
+ *        读取时加锁遍历所有线程的数组汇总，已退出线程的值并入一个公共数组
+ *
+ */
+class MetricsRegistry : noncopyable {
+public:
+  // 每个线程的计数个数上限
+  static const int kMaxCells = 16384;
+  // 超出上限的指标不注册，写入每个线程数组末尾的这段公共空间，读出来总是0
+  static const int kOverflowCells = MetricHistogram::kBuckets + 1;
+
+  static MetricsRegistry &instance();
+
+  /**
+   * @brief 每个指标一行：name{labels} value，直方图为count、平均值和百分位数
+   *
+   */
+  string dumpText() const;
+
+  /**
+   * @brief Prometheus text exposition format (version 0.0.4)
+   *
+   */
+  string dumpPrometheus() const;
+
+private:
+  friend class Metric;
+  friend class MetricCounter;
+  friend class MetricHistogram;
+  friend std::atomic<int64_t> *detail::registerMetricsShard();
+  friend void detail::releaseMetricsShard(void *cells);
+
+  MetricsRegistry();
+
+  int add(Metric *metric, int cells);
+  void remove(Metric *metric, int offset, int cells);
+  // 把[offset, offset + cells)在所有线程中的和累加到out
+  void collect(int offset, int cells, int64_t *out) const;
+
+  void addShard(std::atomic<int64_t> *cells);
+  void removeShard(std::atomic<int64_t> *cells);
+
+  std::vector<Metric *> sortedMetrics() const REQUIRES(dumpMutex_);
+
+  // dump期间不能注销指标；先于mutex_加锁
+  mutable MutexLock dumpMutex_ ACQUIRED_BEFORE(mutex_);
+  mutable MutexLock mutex_;
+  std::vector<Metric *> metrics_ GUARDED_BY(mutex_);
+  std::vector<std::atomic<int64_t> *> shards_ GUARDED_BY(mutex_);
+  std::vector<int64_t> retired_ GUARDED_BY(mutex_); // 已退出线程的计数之和
+  // 注销的指标留下的空位，(offset, cells)
+  std::vector<std::pair<int, int>> freeCells_ GUARDED_BY(mutex_);
+  int nextCell_ GUARDED_BY(mutex_);
+  bool overflowWarned_ GUARDED_BY(mutex_);
+};
+
+} // namespace muduo
+
+#endif // BASE_METRICS_H
@@ -144,6 +144,20 @@ public:
     assignHolder();
   }
 
+  /**
+   * @brief 尝试加锁，成功时记录线程的pid，锁已被占用时立即返回false
+   *
+   * @return true
+   * @return false
+   */
+  bool tryLock() TRY_ACQUIRE(true) {
+    if (pthread_mutex_trylock(&mutex_) == 0) {
+      assignHolder();
+      return true;
+    }
+    return false;
+  }
+
   /**
    * @brief 解锁，同时释放线程的pid
    *
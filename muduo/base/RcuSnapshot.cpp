@@ -0,0 +1,79 @@
+#include "RcuSnapshot.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <new>
+
+using namespace muduo;
+
+namespace muduo {
+namespace detail {
+
+__thread RcuReader *t_rcuReader = NULL;
+std::atomic<uint64_t> g_rcuEpoch(1); // 0表示读者不在临界区内
+
+} // namespace detail
+} // namespace muduo
+
+namespace {
+
+std::atomic<detail::RcuReader *> g_rcuReaders(NULL);
+pthread_key_t g_rcuReaderKey;
+pthread_once_t g_rcuReaderOnce = PTHREAD_ONCE_INIT;
+
+void releaseRcuReader(void *x) {
+  detail::RcuReader *reader = static_cast<detail::RcuReader *>(x);
+  assert(reader->nesting == 0);
+  reader->inUse.store(false, std::memory_order_release);
+}
+
+void createRcuReaderKey() {
+  MCHECK(pthread_key_create(&g_rcuReaderKey, &releaseRcuReader));
+}
+
+} // namespace
+
+detail::RcuReader *detail::registerRcuReader() {
+  pthread_once(&g_rcuReaderOnce, &createRcuReaderKey);
+  RcuReader *reader = NULL;
+  for (RcuReader *r = g_rcuReaders.load(std::memory_order_acquire); r;
+       r = r->next) {
+    bool inUse = false;
+    if (!r->inUse.load(std::memory_order_relaxed) &&
+        r->inUse.compare_exchange_strong(inUse, true,
+                                         std::memory_order_acquire)) {
+      reader = r;
+      break;
+    }
+  }
+  if (reader == NULL) {
+    // 记录从不释放，按cache line对齐，避免不同线程的记录互相干扰
+    void *memory = NULL;
+    MCHECK(posix_memalign(&memory, kCacheLineSize, sizeof(RcuReader)));
+    reader = new (memory) RcuReader;
+    reader->epoch.store(0, std::memory_order_relaxed);
+    reader->inUse.store(true, std::memory_order_relaxed);
+    reader->next = g_rcuReaders.load(std::memory_order_relaxed);
+    while (!g_rcuReaders.compare_exchange_weak(reader->next, reader,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+    }
+  }
+  reader->nesting = 0;
+  MCHECK(pthread_setspecific(g_rcuReaderKey, reader));
+  t_rcuReader = reader;
+  return reader;
+}
+
+uint64_t detail::minRcuReaderEpoch() {
+  uint64_t oldest = UINT64_MAX;
+  for (RcuReader *r = g_rcuReaders.load(std::memory_order_acquire); r;
+       r = r->next) {
+    uint64_t epoch = r->epoch.load(std::memory_order_seq_cst);
+    if (epoch != 0 && epoch < oldest) {
+      oldest = epoch;
+    }
+  }
+  return oldest;
+}
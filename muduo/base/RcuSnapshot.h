@@ -0,0 +1,177 @@
+#ifndef BASE_RCUSNAPSHOT_H
+#define BASE_RCUSNAPSHOT_H
+
+#include "Mutex.h"
+#include "SpinWait.h"
+
+#include <sched.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace muduo {
+namespace detail {
+
+/**
+ * @brief 每个读线程一条记录，由所有RcuSnapshot共享
+ *        epoch为0表示不在读临界区内，否则是进入时看到的全局epoch
+ *
+ */
+struct alignas(kCacheLineSize) RcuReader {
+  std::atomic<uint64_t> epoch;
+  std::atomic<bool> inUse;
+  int nesting; // 只由所属线程访问
+  RcuReader *next;
+};
+
+extern __thread RcuReader *t_rcuReader;
+extern std::atomic<uint64_t> g_rcuEpoch;
+
+// 为当前线程分配一条记录，线程退出时归还，供之后的线程复用
+RcuReader *registerRcuReader();
+
+// 所有读线程中最早的epoch，没有读者时返回UINT64_MAX
+uint64_t minRcuReaderEpoch();
+
+inline void rcuReadLock() {
+  RcuReader *reader = t_rcuReader;
+  if (__builtin_expect(reader == NULL, 0)) {
+    reader = registerRcuReader();
+  }
+  if (reader->nesting++ == 0) {
+    // seq_cst：保证写者要么看到这条记录，要么本线程之后读到新版本
+    reader->epoch.store(g_rcuEpoch.load(std::memory_order_acquire),
+                        std::memory_order_seq_cst);
+  }
+}
+
+inline void rcuReadUnlock() {
+  RcuReader *reader = t_rcuReader;
+  if (--reader->nesting == 0) {
+    reader->epoch.store(0, std::memory_order_release);
+  }
+}
+
+} // namespace detail
+
+/**
+ * @brief 读多写少的共享数据，写时复制，用基于epoch的RCU回收旧版本
+ *        读者不加锁、不修改引用计数，只写自己线程的记录，不会被写者阻塞；
+ *        写者之间用mutex串行，复制当前版本修改后发布，旧版本等所有可能看到它的读者离开后再删除
+ *        读临界区可以嵌套，也可以在其中更新（旧版本推迟到离开后删除），但不能调用synchronize()
+ *
+ *        RcuSnapshot<ConnectionList>::ReadGuard connections(snapshot);
+ *        for (auto &conn : *connections) { ... }
+ *
+ */
+template <typename T> class RcuSnapshot : noncopyable {
+public:
+  RcuSnapshot() : current_(new T) {}
+
+  // 接管initial的所有权
+  explicit RcuSnapshot(T *initial) : current_(initial) {}
+
+  // 析构时不能再有读者
+  ~RcuSnapshot() {
+    MutexLockGuard lock(mutex_);
+    for (auto &retired : retired_) {
+      delete retired.first;
+    }
+    delete current_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief 读临界区，期间当前版本不会被删除
+   *
+   */
+  class ReadGuard : noncopyable {
+  public:
+    explicit ReadGuard(const RcuSnapshot &snapshot) {
+      detail::rcuReadLock();
+      value_ = snapshot.current_.load(std::memory_order_seq_cst);
+    }
+
+    ~ReadGuard() { detail::rcuReadUnlock(); }
+
+    const T &operator*() const { return *value_; }
+    const T *operator->() const { return value_; }
+    const T *get() const { return value_; }
+
+  private:
+    const T *value_;
+  };
+
+  /**
+   * @brief 复制当前版本，用f修改后发布
+   *
+   */
+  template <typename F> void update(F f) {
+    MutexLockGuard lock(mutex_);
+    T *copy = new T(*current_.load(std::memory_order_relaxed));
+    f(*copy);
+    publish(copy);
+  }
+
+  /**
+   * @brief 发布一个新版本，接管value的所有权
+   *
+   */
+  void reset(T *value) {
+    MutexLockGuard lock(mutex_);
+    publish(value);
+  }
+
+  /**
+   * @brief 等待所有旧版本被删除，即调用前开始的读临界区都已结束
+   *        不能在读临界区内调用
+   *
+   */
+  void synchronize() {
+    MutexLockGuard lock(mutex_);
+    while (!retired_.empty()) {
+      reclaim();
+      if (!retired_.empty()) {
+        ::sched_yield();
+      }
+    }
+  }
+
+  // 等待删除的旧版本个数
+  size_t pendingReclaim() const {
+    MutexLockGuard lock(mutex_);
+    return retired_.size();
+  }
+
+private:
+  void publish(T *value) REQUIRES(mutex_) {
+    T *old = current_.exchange(value, std::memory_order_seq_cst);
+    // 之后进入读临界区的读者记录的epoch比retired大，一定读到新版本
+    uint64_t retired =
+        detail::g_rcuEpoch.fetch_add(1, std::memory_order_seq_cst);
+    retired_.push_back(std::make_pair(old, retired));
+    reclaim();
+  }
+
+  void reclaim() REQUIRES(mutex_) {
+    uint64_t oldest = detail::minRcuReaderEpoch();
+    size_t kept = 0;
+    for (size_t i = 0; i < retired_.size(); ++i) {
+      if (retired_[i].second < oldest) {
+        delete retired_[i].first;
+      } else {
+        retired_[kept++] = retired_[i];
+      }
+    }
+    retired_.resize(kept);
+  }
+
+  std::atomic<T *> current_;
+  mutable MutexLock mutex_; // 串行化写者
+  std::vector<std::pair<T *, uint64_t>> retired_ GUARDED_BY(mutex_);
+};
+
+} // namespace muduo
+
+#endif // BASE_RCUSNAPSHOT_H
@@ -0,0 +1,140 @@
+#ifndef BASE_RINGBUFFER_H
+#define BASE_RINGBUFFER_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <new>
+#include <utility>
+
+namespace muduo {
+
+/**
+ * @brief 连续存放的环形队列，满了之后容量翻倍，从不缩小
+ *        std::deque每存满一个512字节的块就要分配一次、取空一个块就要释放一次，
+ *        而RingBuffer在容量足够之后push_back/pop_front不再分配内存
+ *        只能移动，不能复制
+ *
+ * @tparam T 需要可移动构造
+ */
+template <typename T> class RingBuffer {
+public:
+  explicit RingBuffer(size_t capacity = 0)
+      : buffer_(NULL), capacity_(0), head_(0), size_(0) {
+    reserve(capacity);
+  }
+
+  RingBuffer(RingBuffer &&rhs) noexcept
+      : buffer_(rhs.buffer_), capacity_(rhs.capacity_), head_(rhs.head_),
+        size_(rhs.size_) {
+    rhs.buffer_ = NULL;
+    rhs.capacity_ = rhs.head_ = rhs.size_ = 0;
+  }
+
+  RingBuffer &operator=(RingBuffer &&rhs) noexcept {
+    if (this != &rhs) {
+      RingBuffer tmp(std::move(rhs));
+      swap(tmp);
+    }
+    return *this;
+  }
+
+  RingBuffer(const RingBuffer &) = delete;
+  RingBuffer &operator=(const RingBuffer &) = delete;
+
+  ~RingBuffer() {
+    clear();
+    ::free(buffer_);
+  }
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+
+  // 下标从队头开始计算
+  T &operator[](size_t i) {
+    assert(i < size_);
+    return slot(head_ + i);
+  }
+  const T &operator[](size_t i) const {
+    assert(i < size_);
+    return slot(head_ + i);
+  }
+
+  T &front() { return (*this)[0]; }
+  const T &front() const { return (*this)[0]; }
+  T &back() { return (*this)[size_ - 1]; }
+  const T &back() const { return (*this)[size_ - 1]; }
+
+  void push_back(const T &x) { emplace_back(x); }
+  void push_back(T &&x) { emplace_back(std::move(x)); }
+
+  template <typename... Args> void emplace_back(Args &&... args) {
+    if (size_ == capacity_) {
+      reserve(capacity_ ? capacity_ * 2 : kInitialCapacity);
+    }
+    new (&slot(head_ + size_)) T(std::forward<Args>(args)...);
+    ++size_;
+  }
+
+  void pop_front() {
+    assert(size_ > 0);
+    front().~T();
+    head_ = (head_ + 1) & (capacity_ - 1);
+    --size_;
+  }
+
+  void clear() {
+    while (size_ > 0) {
+      pop_front();
+    }
+    head_ = 0;
+  }
+
+  // 容量向上取整到2的幂
+  void reserve(size_t n) {
+    if (n <= capacity_) {
+      return;
+    }
+    size_t capacity = capacity_ ? capacity_ : 1;
+    while (capacity < n) {
+      capacity <<= 1;
+    }
+    T *buffer = static_cast<T *>(::malloc(capacity * sizeof(T)));
+    if (buffer == NULL) {
+      throw std::bad_alloc();
+    }
+    for (size_t i = 0; i < size_; ++i) {
+      T &x = slot(head_ + i);
+      new (&buffer[i]) T(std::move(x));
+      x.~T();
+    }
+    ::free(buffer_);
+    buffer_ = buffer;
+    capacity_ = capacity;
+    head_ = 0;
+  }
+
+  void swap(RingBuffer &rhs) noexcept {
+    std::swap(buffer_, rhs.buffer_);
+    std::swap(capacity_, rhs.capacity_);
+    std::swap(head_, rhs.head_);
+    std::swap(size_, rhs.size_);
+  }
+
+private:
+  static const size_t kInitialCapacity = 16;
+
+  T &slot(size_t i) { return buffer_[i & (capacity_ - 1)]; }
+  const T &slot(size_t i) const { return buffer_[i & (capacity_ - 1)]; }
+
+  T *buffer_;
+  size_t capacity_; // 0或者2的幂
+  size_t head_;
+  size_t size_;
+};
+
+} // namespace muduo
+
+#endif // BASE_RINGBUFFER_H
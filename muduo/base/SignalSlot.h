@@ -0,0 +1,225 @@
+#ifndef BASE_SIGNALSLOT_H
+#define BASE_SIGNALSLOT_H
+
+#include "RcuSnapshot.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace muduo {
+
+namespace detail {
+
+template <typename Callback> struct SignalImpl;
+
+template <typename Callback> struct SlotImpl : noncopyable {
+  typedef SignalImpl<Callback> Data;
+
+  SlotImpl(const std::shared_ptr<Data> &data, Callback &&cb)
+      : data_(data), cb_(std::move(cb)), tied_(false), connected_(true) {}
+
+  SlotImpl(const std::shared_ptr<Data> &data, Callback &&cb,
+           const std::shared_ptr<void> &tie)
+      : data_(data), cb_(std::move(cb)), tie_(tie), tied_(true),
+        connected_(true) {}
+
+  bool connected() const { return connected_.load(std::memory_order_acquire); }
+
+  // 只有第一次断开返回true，由它计入Signal的过期个数
+  bool markDisconnected() {
+    return connected_.exchange(false, std::memory_order_acq_rel);
+  }
+
+  std::weak_ptr<Data> data_;
+  Callback cb_;
+  std::weak_ptr<void> tie_;
+  bool tied_;
+  std::atomic<bool> connected_;
+};
+
+template <typename Callback> struct SignalImpl : noncopyable {
+  typedef SlotImpl<Callback> Slot;
+
+  // 不能断开的回调连续存放，发射时不需要检查标志，也不需要多一次间接访问
+  struct SlotList {
+    std::vector<std::shared_ptr<Slot>> owned;
+    std::vector<Callback> unowned;
+  };
+
+  // 过期的slot积累到这么多个，或者超过一半时，才重建一次列表
+  static const int kCleanupBatch = 16;
+
+  SignalImpl() : expired_(0) {}
+
+  void add(const std::shared_ptr<Slot> &slot) {
+    int removed = 0;
+    slots_.update([&slot, &removed](SlotList &list) {
+      removed = removeExpired(&list);
+      list.owned.push_back(slot);
+    });
+    expired_.fetch_sub(removed, std::memory_order_relaxed);
+  }
+
+  void addUnowned(Callback &&cb) {
+    int removed = 0;
+    slots_.update([&cb, &removed](SlotList &list) {
+      removed = removeExpired(&list);
+      list.unowned.push_back(std::move(cb));
+    });
+    expired_.fetch_sub(removed, std::memory_order_relaxed);
+  }
+
+  // 发射时也可能调用（tie已经失效），只计数，不修改列表
+  void slotExpired() { expired_.fetch_add(1, std::memory_order_relaxed); }
+
+  void slotDisconnected() {
+    int expired = expired_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (expired >= kCleanupBatch || expired * 2 > size()) {
+      clean();
+    }
+  }
+
+  void clean() {
+    int removed = 0;
+    slots_.update(
+        [&removed](SlotList &list) { removed = removeExpired(&list); });
+    expired_.fetch_sub(removed, std::memory_order_relaxed);
+  }
+
+  int size() const {
+    typename RcuSnapshot<SlotList>::ReadGuard slots(slots_);
+    return static_cast<int>(slots->owned.size() + slots->unowned.size());
+  }
+
+  static int removeExpired(SlotList *list) {
+    std::vector<std::shared_ptr<Slot>> &owned = list->owned;
+    size_t before = owned.size();
+    owned.erase(std::remove_if(owned.begin(), owned.end(),
+                               [](const std::shared_ptr<Slot> &slot) {
+                                 return !slot->connected();
+                               }),
+                owned.end());
+    return static_cast<int>(before - owned.size());
+  }
+
+  RcuSnapshot<SlotList> slots_;
+  std::atomic<int> expired_; // 已断开但还在列表中的slot个数
+};
+
+// Slot句柄的删除器：最后一个句柄析构时断开，真正的SlotImpl由Signal的列表持有
+template <typename Callback> struct SlotDisconnector {
+  explicit SlotDisconnector(const std::shared_ptr<SlotImpl<Callback>> &slot)
+      : slot_(slot) {}
+
+  void operator()(void *) const {
+    if (slot_->markDisconnected()) {
+      std::shared_ptr<SignalImpl<Callback>> data(slot_->data_.lock());
+      if (data) {
+        data->slotDisconnected();
+      }
+    }
+  }
+
+  std::shared_ptr<SlotImpl<Callback>> slot_;
+};
+
+} // namespace detail
+
+/**
+ * @brief 与Slot的生命期绑定的连接句柄
+ *        句柄（及其拷贝）都析构后slot断开，不再被调用；正在进行的call()可能还会调用它最后一次
+ *
+ */
+typedef std::shared_ptr<void> Slot;
+
+template <typename Signature> class Signal;
+
+/**
+ * @brief 一对多的回调，call()不加锁
+ *        slot列表是RcuSnapshot中的不可变快照，发射时只遍历快照、检查每个slot的断开标志，
+ *        不修改引用计数（tie的slot除外，调用期间要保证tie的对象存活）；
+ *        connectUnowned()的slot连续存放，先于其他slot调用；
+ *        connect时复制列表，断开只做标记，过期的slot成批地在之后的connect或断开时清理
+ *
+ */
+template <typename RET, typename... ARGS>
+class Signal<RET(ARGS...)> : noncopyable {
+public:
+  typedef std::function<void(ARGS...)> Callback;
+  typedef detail::SignalImpl<Callback> SignalImpl;
+  typedef detail::SlotImpl<Callback> SlotImpl;
+
+  Signal() : impl_(new SignalImpl) {}
+
+  /**
+   * @brief 连接func，返回的Slot存活期间保持连接
+   *
+   */
+  Slot connect(Callback &&func) {
+    std::shared_ptr<SlotImpl> slotImpl(
+        new SlotImpl(impl_, std::forward<Callback>(func)));
+    impl_->add(slotImpl);
+    return Slot(slotImpl.get(), detail::SlotDisconnector<Callback>(slotImpl));
+  }
+
+  /**
+   * @brief 同上，并且只在tie指向的对象存活时调用func，调用期间持有它
+   *
+   */
+  Slot connect(Callback &&func, const std::shared_ptr<void> &tie) {
+    std::shared_ptr<SlotImpl> slotImpl(
+        new SlotImpl(impl_, std::forward<Callback>(func), tie));
+    impl_->add(slotImpl);
+    return Slot(slotImpl.get(), detail::SlotDisconnector<Callback>(slotImpl));
+  }
+
+  /**
+   * @brief 不返回句柄、不能断开的连接，func引用的对象必须比Signal活得长
+   *
+   */
+  void connectUnowned(Callback &&func) {
+    impl_->addUnowned(std::forward<Callback>(func));
+  }
+
+  void call(ARGS... args) const {
+    typename RcuSnapshot<typename SignalImpl::SlotList>::ReadGuard slots(
+        impl_->slots_);
+    for (const Callback &cb : slots->unowned) {
+      cb(args...);
+    }
+    for (const std::shared_ptr<SlotImpl> &slot : slots->owned) {
+      if (!slot->connected()) {
+        continue;
+      }
+      if (slot->tied_) {
+        std::shared_ptr<void> guard(slot->tie_.lock());
+        if (guard) {
+          slot->cb_(args...);
+        } else if (slot->markDisconnected()) {
+          impl_->slotExpired();
+        }
+      } else {
+        slot->cb_(args...);
+      }
+    }
+  }
+
+  /**
+   * @brief 立即清理已断开的slot
+   *
+   */
+  void clean() { impl_->clean(); }
+
+  // 列表中slot的个数，包括已断开但还没清理的
+  int numSlots() const { return impl_->size(); }
+
+private:
+  const std::shared_ptr<SignalImpl> impl_;
+};
+
+} // namespace muduo
+
+#endif // BASE_SIGNALSLOT_H
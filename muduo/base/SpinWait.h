@@ -0,0 +1,27 @@
+#ifndef BASE_SPINWAIT_H
+#define BASE_SPINWAIT_H
+
+#include <stddef.h>
+#include <unistd.h>
+
+namespace muduo {
+namespace detail {
+
+const size_t kCacheLineSize = 64;
+
+// 只有一个CPU时持有者不可能在自旋期间释放，自旋只会浪费时间片
+inline bool isMultiCore() {
+  static const bool multiCore = ::sysconf(_SC_NPROCESSORS_ONLN) > 1;
+  return multiCore;
+}
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+} // namespace detail
+} // namespace muduo
+
+#endif // BASE_SPINWAIT_H
@@ -0,0 +1,99 @@
+#include "StructuredLogging.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace muduo {
+namespace detail {
+
+static inline bool needsLogEscape(char c, bool logfmt) {
+  unsigned char u = static_cast<unsigned char>(c);
+  return u < 0x20 || c == '"' || c == '\\' || (logfmt && (c == ' ' || c == '='));
+}
+
+const char *findLogEscape(const char *p, const char *end, bool logfmt) {
+#ifdef __SSE2__
+  // 无符号比较：min(c, 0x1F) == c即c <= 0x1F，UTF-8的多字节字符不受影响
+  const __m128i control = _mm_set1_epi8(0x1F);
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i equal = _mm_set1_epi8('=');
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i mask = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, control), v),
+                                _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                             _mm_cmpeq_epi8(v, backslash)));
+    if (logfmt) {
+      mask = _mm_or_si128(mask, _mm_or_si128(_mm_cmpeq_epi8(v, space),
+                                             _mm_cmpeq_epi8(v, equal)));
+    }
+    int bits = _mm_movemask_epi8(mask);
+    if (bits != 0) {
+      return p + __builtin_ctz(static_cast<unsigned>(bits));
+    }
+    p += 16;
+  }
+#endif
+  while (p != end && !needsLogEscape(*p, logfmt)) {
+    ++p;
+  }
+  return p;
+}
+
+void appendLogEscaped(LogStream &s, const char *p, const char *end) {
+  static const char digitsHex[] = "0123456789abcdef";
+  while (p != end) {
+    const char *q = findLogEscape(p, end, false);
+    s.append(p, static_cast<int>(q - p));
+    if (q == end) {
+      break;
+    }
+    switch (*q) {
+    case '"':
+      s.append("\\\"", 2);
+      break;
+    case '\\':
+      s.append("\\\\", 2);
+      break;
+    case '\n':
+      s.append("\\n", 2);
+      break;
+    case '\r':
+      s.append("\\r", 2);
+      break;
+    case '\t':
+      s.append("\\t", 2);
+      break;
+    default: {
+      unsigned char c = static_cast<unsigned char>(*q);
+      char buf[6] = {'\\', 'u', '0', '0', digitsHex[c >> 4], digitsHex[c & 0xF]};
+      s.append(buf, sizeof buf);
+      break;
+    }
+    }
+    p = q + 1;
+  }
+}
+
+void appendKVString(LogStream &s, Logger::LogFormat format, const char *str,
+                    size_t len) {
+  const char *end = str + len;
+  const char *q = str;
+  if (format == Logger::kLogfmt) {
+    q = findLogEscape(str, end, true);
+    if (q == end && len > 0) {
+      s.append(str, static_cast<int>(len));
+      return;
+    }
+  }
+  // [str, q)中没有任何需要转义的字符，不必再扫描一遍
+  s << '"';
+  s.append(str, static_cast<int>(q - str));
+  appendLogEscaped(s, q, end);
+  s << '"';
+}
+
+} // namespace detail
+} // namespace muduo
@@ -0,0 +1,170 @@
+#ifndef BASE_STRUCTUREDLOGGING_H
+#define BASE_STRUCTUREDLOGGING_H
+
+#include "LogStream.h"
+#include "Logging.h"
+#include "StringPiece.h"
+#include "Types.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <type_traits>
+
+namespace muduo {
+namespace detail {
+
+/**
+ * @brief 找到第一个需要转义的字符（双引号、反斜杠、控制字符），
+ *        logfmt还要找需要加引号的空格和'='，x86上一次比较16个字节
+ *
+ * @return const char* 没有时返回end
+ */
+const char *findLogEscape(const char *begin, const char *end, bool logfmt);
+
+// 按JSON的规则转义，不加引号
+void appendLogEscaped(LogStream &s, const char *begin, const char *end);
+
+// JSON总是加引号；logfmt只在值为空或者含有特殊字符时加引号
+void appendKVString(LogStream &s, Logger::LogFormat format, const char *str,
+                    size_t len);
+
+// 键名是字符串常量，由调用者保证不需要转义，长度在编译时确定
+template <int N>
+inline void appendKVKey(LogStream &s, Logger::LogFormat format,
+                        const char (&key)[N]) {
+  if (format == Logger::kJson) {
+    s.append(",\"", 2);
+    s.append(key, N - 1);
+    s.append("\":", 2);
+  } else {
+    s << ' ';
+    s.append(key, N - 1);
+    s << '=';
+  }
+}
+
+inline void appendKVKey(LogStream &s, Logger::LogFormat format,
+                        const char *key) {
+  if (format == Logger::kJson) {
+    s << ",\"" << key << "\":";
+  } else {
+    s << ' ' << key << '=';
+  }
+}
+
+inline void appendKVKey(LogStream &s, Logger::LogFormat format,
+                        const string &key) {
+  appendKVKey(s, format, key.c_str());
+}
+
+template <typename T>
+inline
+    typename std::enable_if<std::is_integral<T>::value &&
+                            !std::is_same<T, bool>::value &&
+                            !std::is_same<T, char>::value>::type
+    appendKVValue(LogStream &s, Logger::LogFormat, T v) {
+  s << v;
+}
+
+// JSON不能表示nan和inf，输出成字符串
+template <typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value>::type
+appendKVValue(LogStream &s, Logger::LogFormat format, T v) {
+  double d = static_cast<double>(v);
+  if (format == Logger::kJson && !isfinite(d)) {
+    s << '"' << d << '"';
+  } else {
+    s << d;
+  }
+}
+
+inline void appendKVValue(LogStream &s, Logger::LogFormat, bool v) {
+  if (v) {
+    s.append("true", 4);
+  } else {
+    s.append("false", 5);
+  }
+}
+
+inline void appendKVValue(LogStream &s, Logger::LogFormat format, char v) {
+  appendKVString(s, format, &v, 1);
+}
+
+inline void appendKVValue(LogStream &s, Logger::LogFormat format,
+                          const char *v) {
+  if (v) {
+    appendKVString(s, format, v, strlen(v));
+  } else if (format == Logger::kJson) {
+    s.append("null", 4);
+  } else {
+    s.append("(null)", 6);
+  }
+}
+
+inline void appendKVValue(LogStream &s, Logger::LogFormat format,
+                          const string &v) {
+  appendKVString(s, format, v.data(), v.size());
+}
+
+inline void appendKVValue(LogStream &s, Logger::LogFormat format,
+                          const StringPiece &v) {
+  appendKVString(s, format, v.data(), static_cast<size_t>(v.size()));
+}
+
+template <typename T>
+inline void appendKVValue(LogStream &s, Logger::LogFormat format, const T *v) {
+  if (format == Logger::kJson) {
+    s << '"' << static_cast<const void *>(v) << '"';
+  } else {
+    s << static_cast<const void *>(v);
+  }
+}
+
+inline void appendKVs(LogStream &, Logger::LogFormat) {}
+
+template <typename K, typename V, typename... Rest>
+inline void appendKVs(LogStream &s, Logger::LogFormat format, const K &key,
+                      const V &value, const Rest &... rest) {
+  appendKVKey(s, format, key);
+  appendKVValue(s, format, value);
+  appendKVs(s, format, rest...);
+}
+
+} // namespace detail
+
+/**
+ * @brief 把若干个键值对编码成一行logfmt或者JSON，直接写入Logger的FixedBuffer，
+ *        不分配内存；时间、tid、级别和源文件由Logger::Impl输出
+ *
+ * @param logger 临时的Logger对象，语句结束时析构并输出
+ * @param args 键、值、键、值……
+ */
+template <typename... Args>
+inline void logKeyValues(Logger &&logger, const Args &... args) {
+  static_assert(sizeof...(Args) % 2 == 0, "LOG_*_KV takes key/value pairs");
+  detail::appendKVs(logger.stream(), logger.format(), args...);
+}
+
+} // namespace muduo
+
+// 用法：LOG_INFO_KV("msg", "accepted", "conn", id, "bytes", n);
+// 输出：time="20220101 08:00:00.123456Z" tid=1234 level=INFO msg=accepted
+//       conn=1 bytes=1024 src=TcpServer.cc:100
+// 值支持整数、浮点数、bool、char、字符串和指针
+#define MUDUO_LOG_KV(level, ...)                                               \
+  do {                                                                         \
+    if (MUDUO_LOG_ENABLED(level)) {                                            \
+      muduo::logKeyValues(muduo::Logger(__FILE__, __LINE__, level,             \
+                                        muduo::Logger::structuredFormat()),    \
+                          __VA_ARGS__);                                        \
+    }                                                                          \
+  } while (0)
+
+#define LOG_TRACE_KV(...) MUDUO_LOG_KV(muduo::Logger::TRACE, __VA_ARGS__)
+#define LOG_DEBUG_KV(...) MUDUO_LOG_KV(muduo::Logger::DEBUG, __VA_ARGS__)
+#define LOG_INFO_KV(...) MUDUO_LOG_KV(muduo::Logger::INFO, __VA_ARGS__)
+#define LOG_WARN_KV(...) MUDUO_LOG_KV(muduo::Logger::WARN, __VA_ARGS__)
+#define LOG_ERROR_KV(...) MUDUO_LOG_KV(muduo::Logger::ERROR, __VA_ARGS__)
+
+#endif // BASE_STRUCTUREDLOGGING_H
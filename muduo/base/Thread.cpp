@@ -3,6 +3,9 @@
 #include "Exception.h"
 #include "Timestamp.h"
 
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
 #include <sys/prctl.h>
 #include <sys/syscall.h>
 
@@ -20,6 +23,86 @@ namespace detail {
  */
 pid_t gettid() { return static_cast<pid_t>(::syscall(SYS_gettid)); }
 
+// 与<numaif.h>中的MPOL_PREFERRED相同，直接用系统调用，不依赖libnuma
+const int kMpolPreferred = 1;
+
+/**
+ * @brief 当前线程之后首次访问的内存（包括栈上还没用到的页）优先分配在node上
+ *
+ */
+void setPreferredNode(int node) {
+  unsigned long mask[4] = {0};
+  const int kBits = static_cast<int>(8 * sizeof mask[0]);
+  if (node < 0 || node >= kBits * 4) {
+    return;
+  }
+  mask[node / kBits] = 1UL << (node % kBits);
+  if (::syscall(SYS_set_mempolicy, kMpolPreferred, mask, kBits * 4 + 1) < 0) {
+    fprintf(stderr, "set_mempolicy(node %d) failed: %s\n", node,
+            strerror(errno));
+  }
+}
+
+/**
+ * @brief 按placement设置pthread属性，某一项设置失败时报告并保留默认值
+ *
+ * @return 要求SCHED_FIFO并且设置成功时返回true
+ */
+bool setThreadAttr(const string &name, const ThreadPlacement &placement,
+                   pthread_attr_t *attr) {
+  std::vector<int> cpus = placement.cpus;
+  if (cpus.empty() && placement.numaNode >= 0) {
+    cpus = ThreadPlacement::cpusOfNode(placement.numaNode);
+  }
+  if (!cpus.empty()) {
+    // 线程从第一条指令起就在这些CPU上运行，栈由它自己首次访问
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+      if (0 <= cpu && cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &set);
+      }
+    }
+    int ret = pthread_attr_setaffinity_np(attr, sizeof set, &set);
+    if (ret != 0) {
+      fprintf(stderr, "Thread %s: failed to set CPU affinity: %s\n",
+              name.c_str(), strerror(ret));
+    }
+  }
+  if (placement.stackSize > 0) {
+    // 小于PTHREAD_STACK_MIN时返回EINVAL
+    int ret = pthread_attr_setstacksize(attr, placement.stackSize);
+    if (ret != 0) {
+      fprintf(stderr, "Thread %s: failed to set stack size %zu: %s, using "
+                      "default\n",
+              name.c_str(), placement.stackSize, strerror(ret));
+    }
+  }
+  if (placement.fifoPriority > 0) {
+    struct sched_param param;
+    memZero(&param, sizeof param);
+    param.sched_priority = placement.fifoPriority;
+    int ret = pthread_attr_setschedpolicy(attr, SCHED_FIFO);
+    if (ret == 0) {
+      // 优先级超出SCHED_FIFO的范围时返回EINVAL
+      ret = pthread_attr_setschedparam(attr, &param);
+    }
+    if (ret == 0) {
+      ret = pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED);
+    }
+    if (ret != 0) {
+      fprintf(stderr, "Thread %s: invalid SCHED_FIFO priority %d: %s, using "
+                      "SCHED_OTHER\n",
+              name.c_str(), placement.fifoPriority, strerror(ret));
+      pthread_attr_setschedpolicy(attr, SCHED_OTHER);
+      pthread_attr_setinheritsched(attr, PTHREAD_INHERIT_SCHED);
+      return false;
+    }
+    return true;
+  }
+  return false;
+}
+
 void afterFork() {
   muduo::CurrentThread::t_cachedTid = 0;
   muduo::CurrentThread::t_threadName = "main";
@@ -41,14 +124,19 @@ struct ThreadData {
   typedef muduo::Thread::ThreadFunc ThreadFunc;
   ThreadFunc func_;
   string name_;
+  int numaNode_;
   pid_t *tid_;
   CountDownLatch *latch_;
 
-  ThreadData(ThreadFunc func, const string &name, pid_t *tid,
+  ThreadData(ThreadFunc func, const string &name, int numaNode, pid_t *tid,
              CountDownLatch *latch)
-      : func_(move(func)), name_(name), tid_(tid), latch_(latch) {}
+      : func_(move(func)), name_(name), numaNode_(numaNode), tid_(tid),
+        latch_(latch) {}
 
   void runInThread() {
+    if (numaNode_ >= 0) {
+      setPreferredNode(numaNode_);
+    }
     *tid_ = muduo::CurrentThread::tid();
     tid_ = NULL;
     latch_->countDown(); // 倒计时
@@ -136,9 +224,27 @@ void Thread::start() {
   assert(!started_);
   started_ = true;
 
-  detail::ThreadData *data =
-      new detail::ThreadData(func_, name_, &tid_, &latch_);
-  if (pthread_create(&pthreadId_, NULL, &detail::startThread, data)) // 创建线程
+  detail::ThreadData *data = new detail::ThreadData(
+      func_, name_, placement_.numaNode, &tid_, &latch_);
+  int ret;
+  if (placement_.empty()) {
+    ret = pthread_create(&pthreadId_, NULL, &detail::startThread, data);
+  } else {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    bool realtime = detail::setThreadAttr(name_, placement_, &attr);
+    ret = pthread_create(&pthreadId_, &attr, &detail::startThread, data);
+    if (ret == EPERM && realtime) {
+      // 没有CAP_SYS_NICE或者RLIMIT_RTPRIO不够，退回普通调度
+      fprintf(stderr, "Thread %s: no permission for SCHED_FIFO %d, using "
+                      "SCHED_OTHER\n",
+              name_.c_str(), placement_.fifoPriority);
+      pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+      ret = pthread_create(&pthreadId_, &attr, &detail::startThread, data);
+    }
+    pthread_attr_destroy(&attr);
+  }
+  if (ret) // 创建线程
   {
     started_ = false;
     delete data;
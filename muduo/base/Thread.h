@@ -3,6 +3,7 @@
 
 #include "Atomic.h"
 #include "CountDownLatch.h"
+#include "ThreadPlacement.h"
 
 #include <functional>
 #include <memory>
@@ -18,6 +19,17 @@ public:
   explicit Thread(ThreadFunc, const string &name = string());
   ~Thread();
 
+  /**
+   * @brief 设置CPU亲和性、NUMA节点、栈大小和实时优先级
+   *        Must be called before start()
+   *
+   * @param placement
+   */
+  void setPlacement(const ThreadPlacement &placement) {
+    placement_ = placement;
+  }
+  const ThreadPlacement &placement() const { return placement_; }
+
   void start();
   int join(); // return pthread_join();
 
@@ -38,6 +50,7 @@ private:
   pid_t tid_;
   ThreadFunc func_;
   string name_;
+  ThreadPlacement placement_;
   CountDownLatch latch_;
 
   static AtomicInt32 numCreated_; 
@@ -0,0 +1,74 @@
+#include "ThreadPlacement.h"
+
+#include "FileUtil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace muduo;
+
+ThreadPlacement ThreadPlacement::onNode(int node, int i) {
+  ThreadPlacement placement;
+  placement.numaNode = node;
+  std::vector<int> cpus = cpusOfNode(node);
+  if (!cpus.empty()) {
+    placement.cpus.push_back(cpus[static_cast<size_t>(i) % cpus.size()]);
+  }
+  return placement;
+}
+
+int ThreadPlacement::numNumaNodes() {
+  string online;
+  if (FileUtil::readFile("/sys/devices/system/node/online", 4096, &online) !=
+      0) {
+    return 1;
+  }
+  std::vector<int> nodes = parseCpuList(online);
+  return nodes.empty() ? 1 : nodes.back() + 1;
+}
+
+std::vector<int> ThreadPlacement::cpusOfNode(int node) {
+  char path[64];
+  snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", node);
+  string list;
+  if (FileUtil::readFile(path, 4096, &list) == 0) {
+    return parseCpuList(list);
+  }
+
+  std::vector<int> cpus;
+  if (node == 0) {
+    long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 0; i < n; ++i) {
+      cpus.push_back(i);
+    }
+  }
+  return cpus;
+}
+
+std::vector<int> ThreadPlacement::parseCpuList(const string &list) {
+  std::vector<int> cpus;
+  const char *p = list.c_str();
+  while (*p) {
+    char *end;
+    long first = strtol(p, &end, 10);
+    if (end == p) {
+      break;
+    }
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      last = strtol(p + 1, &end, 10);
+      p = end;
+    }
+    for (long cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(static_cast<int>(cpu));
+    }
+    if (*p == ',') {
+      ++p;
+    } else {
+      break;
+    }
+  }
+  return cpus;
+}
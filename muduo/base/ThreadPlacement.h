@@ -0,0 +1,51 @@
+#ifndef BASE_THREADPLACEMENT_H
+#define BASE_THREADPLACEMENT_H
+
+#include "Types.h"
+
+#include <stddef.h>
+
+#include <vector>
+
+namespace muduo {
+/**
+ * @brief 线程在哪些CPU、哪个NUMA节点上运行，以及栈大小和实时优先级
+ *        默认都不设置，与pthread_create的默认属性相同
+ *
+ */
+struct ThreadPlacement {
+  ThreadPlacement() : numaNode(-1), stackSize(0), fifoPriority(0) {}
+
+  // 只允许在这些CPU上运行，为空时不限制（指定了numaNode时为该节点的所有CPU）
+  std::vector<int> cpus;
+  // 指定时线程从一开始就在该节点的CPU上运行，栈由线程自己首次访问，
+  // 之后分配的内存也优先放在该节点；-1表示不指定
+  int numaNode;
+  // 栈大小（字节），0使用默认值
+  size_t stackSize;
+  // 1-99时使用SCHED_FIFO调度，0使用普通调度；没有权限时退回普通调度
+  int fifoPriority;
+
+  bool empty() const {
+    return cpus.empty() && numaNode < 0 && stackSize == 0 && fifoPriority == 0;
+  }
+
+  /**
+   * @brief 在node的第i个CPU上运行（按CPU个数取模），用于把一组线程轮流绑定到一个节点的各个核
+   *
+   */
+  static ThreadPlacement onNode(int node, int i);
+
+  // 系统中NUMA节点的个数，没有NUMA信息时为1
+  static int numNumaNodes();
+
+  // 节点上在线的CPU，读取/sys/devices/system/node/node<N>/cpulist；
+  // 没有NUMA信息时node 0返回所有在线的CPU
+  static std::vector<int> cpusOfNode(int node);
+
+  // 解析"0-3,8,10-11"这样的CPU列表
+  static std::vector<int> parseCpuList(const string &list);
+};
+} // namespace muduo
+
+#endif // BASE_THREADPLACEMENT_H
@@ -1,16 +1,59 @@
 #include "ThreadPool.h"
 
 #include "Exception.h"
+#include "WorkStealingDeque.h"
 
 #include <assert.h>
 #include <stdio.h>
 
+#include <algorithm>
+
 using namespace muduo;
 using namespace std;
 
+// 每个线程的双端队列，满了之后放入共用队列
+struct ThreadPool::Worker {
+  static const int kDequeCapacity = 1024;
+
+  Worker(ThreadPool *owner, int i)
+      : pool(owner), index(i), deque(kDequeCapacity), seed(i + 1) {}
+
+  ThreadPool *pool;
+  int index;
+  WorkStealingDeque<Task> deque;
+  unsigned seed; // 随机选择窃取的起点
+};
+
+namespace {
+
+std::atomic<int> g_nextPoolId(0);
+
+string metricLabels(const string &name) {
+  return "pool=\"" + name + "\",id=\"" +
+         std::to_string(g_nextPoolId.fetch_add(1, memory_order_relaxed)) +
+         "\"";
+}
+
+} // namespace
+
+// 不是kWorkStealing线程池中的线程时为NULL
+__thread ThreadPool::Worker *ThreadPool::t_worker = NULL;
+
 ThreadPool::ThreadPool(const string &nameArg)
     : mutex_(), notEmpty_(mutex_), notFull_(mutex_), name_(nameArg),
-      maxQueueSize_(0), running_(false) {}
+      maxQueueSize_(0), running_(false), mode_(kSharedQueue), sleepers_(0),
+      queued_(0), runInCaller_(true), minThreads_(0), maxThreads_(0),
+      spawnLatency_(0), idleTimeout_(0), liveThreads_(0), idleThreads_(0),
+      nextThreadId_(0), collectStats_(false), labels_(metricLabels(nameArg)),
+      completed_("threadpool_tasks_completed_total", "Tasks run to completion",
+                 labels_),
+      threadsGauge_("threadpool_threads", "Live worker threads", labels_,
+                    [this] { return static_cast<int64_t>(numThreads()); }),
+      queueGauge_("threadpool_queue_size", "Tasks waiting in the shared queue",
+                  labels_, [this] {
+                    return static_cast<int64_t>(
+                        queued_.load(memory_order_relaxed));
+                  }) {}
 
 ThreadPool::~ThreadPool() {
   if (running_) {
@@ -18,23 +61,107 @@ ThreadPool::~ThreadPool() {
   }
 }
 
+void ThreadPool::setCollectStats(bool on) {
+  assert(!running_);
+  collectStats_ = on;
+  if (on && !queueWait_) {
+    queueWait_.reset(new MetricHistogram("threadpool_queue_wait_microseconds",
+                                         "Time tasks spent in the shared queue",
+                                         labels_));
+    runTime_.reset(new MetricHistogram("threadpool_run_time_microseconds",
+                                       "Task run time", labels_));
+  }
+}
+
+void ThreadPool::setElastic(int minThreads, int maxThreads,
+                            double spawnLatency, double idleTimeout) {
+  assert(0 <= minThreads && minThreads <= maxThreads && maxThreads > 0);
+  minThreads_ = minThreads;
+  maxThreads_ = maxThreads;
+  spawnLatency_ = spawnLatency;
+  idleTimeout_ = idleTimeout;
+}
+
 void ThreadPool::start(int numThreads) {
-  assert(threads_.empty());
+  assert(running_ == false);
+  assert(maxThreads_ == 0 || mode_ == kSharedQueue);
+  if (maxThreads_ > 0) {
+    numThreads = std::min(std::max(numThreads, minThreads_), maxThreads_);
+  }
   running_ = true;
-  threads_.reserve(numThreads);
+  runInCaller_ = numThreads == 0 && maxThreads_ == 0;
+  if (mode_ == kWorkStealing) {
+    // 线程开始运行前全部创建好，窃取时不需要加锁遍历
+    for (int i = 0; i < numThreads; ++i) {
+      workers_.emplace_back(new Worker(this, i));
+    }
+  }
+  {
+    MutexLockGuard lock(mutex_);
+    liveThreads_ = numThreads;
+    nextThreadId_ = numThreads;
+  }
   for (int i = 0; i < numThreads; ++i) {
-    char id[32];
-    snprintf(id, sizeof id, "%d", i + 1);
-    threads_.emplace_back(
-        new muduo::Thread(bind(&ThreadPool::runInThread, this), name_ + id));
-    threads_[i]->start();
+    addThread(i);
   }
 
-  if (numThreads == 0 && threadInitCallback_) {
+  if (runInCaller_ && threadInitCallback_) {
     threadInitCallback_();
   }
 }
 
+void ThreadPool::addThread(int index) {
+  char id[32];
+  snprintf(id, sizeof id, "%d", index + 1);
+  unique_ptr<muduo::Thread> thread(new muduo::Thread(
+      bind(&ThreadPool::runInThread, this, index), name_ + id));
+  if (placementCallback_) {
+    thread->setPlacement(placementCallback_(index));
+  }
+  thread->start();
+
+  // 退出的线程不再访问线程池，可以在锁外join
+  vector<unique_ptr<muduo::Thread>> exited;
+  {
+    MutexLockGuard lock(mutex_);
+    threads_.push_back(move(thread));
+    for (pid_t tid : exitedThreads_) {
+      for (auto it = threads_.begin(); it != threads_.end(); ++it) {
+        if ((*it)->tid() == tid) {
+          exited.push_back(move(*it));
+          threads_.erase(it);
+          break;
+        }
+      }
+    }
+    exitedThreads_.clear();
+  }
+  for (auto &thr : exited) {
+    thr->join();
+  }
+}
+
+ThreadPool::PlacementCallback ThreadPool::roundRobinOnNode(int node) {
+  return [node](int index) { return ThreadPlacement::onNode(node, index); };
+}
+
+bool ThreadPool::needMoreThreads(int64_t now, int *index) {
+  mutex_.assertLocked();
+  if (maxThreads_ == 0 || !running_ || idleThreads_ > 0 ||
+      liveThreads_ >= maxThreads_ || queue_.empty()) {
+    return false;
+  }
+  // 一个线程都没有时立即创建
+  if (liveThreads_ > 0 &&
+      static_cast<double>(now - queue_.front().enqueued) <
+          spawnLatency_ * Timestamp::kMicroSecondsPerSecond) {
+    return false;
+  }
+  ++liveThreads_;
+  *index = nextThreadId_++;
+  return true;
+}
+
 void ThreadPool::stop() {
   {
     // 加锁保护running，
@@ -43,49 +170,231 @@ void ThreadPool::stop() {
     notEmpty_.notifyAll();
   }
 
-  for (auto &thr : threads_) {
-    thr->join();
+  // 弹性模式下线程可能在退出前又创建了新的线程，直到threads_为空
+  for (;;) {
+    vector<unique_ptr<muduo::Thread>> threads;
+    {
+      MutexLockGuard lock(mutex_);
+      threads.swap(threads_);
+      exitedThreads_.clear();
+    }
+    if (threads.empty()) {
+      break;
+    }
+    for (auto &thr : threads) {
+      thr->join();
+    }
+  }
+
+  // 丢弃尚未执行的任务，不持有锁析构，submit()的Future会在这时得到异常
+  RingBuffer<QueuedTask> discarded;
+  {
+    MutexLockGuard lock(mutex_);
+    discarded = move(queue_);
+    queued_.store(0, memory_order_relaxed);
+    liveThreads_ = 0;
+  }
+  discarded.clear();
+  for (auto &worker : workers_) {
+    Task task;
+    while (worker->deque.pop(&task)) {
+    }
   }
 }
 
 size_t ThreadPool::queueSize() const {
   MutexLockGuard lock(mutex_);
-  return queue_.size();
+  size_t size = queue_.size();
+  for (const auto &worker : workers_) {
+    size += worker->deque.size();
+  }
+  return size;
+}
+
+int ThreadPool::numThreads() const {
+  MutexLockGuard lock(mutex_);
+  return liveThreads_;
 }
 
 void ThreadPool::run(Task task) {
-  if (threads_.empty()) { // 线程为空
+  if (runInCaller_) { // 线程为空
     task();
-  } else { // 否则，添加到队列中
+    return;
+  }
+
+  Worker *self = t_worker;
+  if (self && self->pool == this) {
+    // 本池的线程提交的任务放入自己的队列，不加锁
+    size_t before = self->deque.size();
+    if (self->deque.push(task)) {
+      // 队列由空变为非空时才唤醒一个线程来偷，醒来的线程偷到任务后会继续唤醒下一个
+      if (before == 0) {
+        wakeUpSleeper();
+      }
+      return;
+    }
+  }
+
+  // 否则，添加到队列中
+  int64_t now = enqueueTime();
+  int index = 0;
+  bool spawn = false;
+  {
     MutexLockGuard lock(mutex_);
     while (isFull()) {
       notFull_.wait();
     }
     assert(!isFull());
 
-    queue_.push_back(move(task));
+    queue_.emplace_back(move(task), now);
+    queued_.store(queue_.size(), memory_order_relaxed);
     notEmpty_.notify();
+    spawn = needMoreThreads(now, &index);
+  }
+  if (spawn) {
+    addThread(index);
   }
 }
 
-ThreadPool::Task ThreadPool::take() {
-  MutexLockGuard lock(mutex_);
+// 先发布任务再检查sleepers_，等待者先登记再检查任务，两边都有seq_cst的屏障
+void ThreadPool::wakeUpSleeper() {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (sleepers_.load(memory_order_relaxed) > 0) {
+    MutexLockGuard lock(mutex_);
+    notEmpty_.notify();
+  }
+}
+
+bool ThreadPool::take(Task *task) {
+  int index = 0;
+  bool spawn = false;
+  {
+    MutexLockGuard lock(mutex_);
 
-  // 如果任务列表为空且运行
-  // 要判断running,如果stop了线程池，那就不要再wait了
-  while (queue_.empty() && running_) { // 任务列表为空，等待
-    notEmpty_.wait();
+    // 如果任务列表为空且运行
+    // 要判断running,如果stop了线程池，那就不要再wait了
+    while (queue_.empty() && running_) { // 任务列表为空，等待
+      if (maxThreads_ == 0) {
+        notEmpty_.wait();
+        continue;
+      }
+      ++idleThreads_;
+      bool timeout = notEmpty_.waitForSeconds(idleTimeout_);
+      --idleThreads_;
+      if (timeout && queue_.empty() && running_ &&
+          liveThreads_ > minThreads_) {
+        --liveThreads_;
+        exitedThreads_.push_back(CurrentThread::tid());
+        return false;
+      }
+    }
+
+    if (!takeFromQueue(task)) {
+      return false;
+    }
+    // 后面的任务仍然等待太久，说明线程不够用
+    if (maxThreads_ > 0) {
+      spawn = needMoreThreads(Timestamp::now().microSecondsSinceEpoch(),
+                              &index);
+    }
+  }
+  if (spawn) {
+    addThread(index);
+  }
+  return true;
+}
+
+bool ThreadPool::takeFromQueue(Task *task) {
+  mutex_.assertLocked();
+  if (queue_.empty()) {
+    return false;
+  }
+  QueuedTask &front = queue_.front();
+  if (collectStats_) {
+    queueWait_->add(Timestamp::now().microSecondsSinceEpoch() - front.enqueued);
+  }
+  *task = move(front.task);
+  queue_.pop_front();
+  queued_.store(queue_.size(), memory_order_relaxed);
+  if (maxQueueSize_ > 0) { // 任务列表有空位
+    notFull_.notify();
   }
+  return true;
+}
 
-  Task task;
+bool ThreadPool::hasQueuedTasks() const {
+  mutex_.assertLocked();
   if (!queue_.empty()) {
-    task = queue_.front();
-    queue_.pop_front();
-    if (maxQueueSize_ > 0) { // 任务列表有空位
-      notFull_.notify();
+    return true;
+  }
+  for (const auto &worker : workers_) {
+    if (!worker->deque.empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::findTask(Worker *self, Task *task) {
+  if (self->deque.pop(task)) {
+    return true;
+  }
+
+  if (queued_.load(memory_order_relaxed) > 0) {
+    MutexLockGuard lock(mutex_);
+    if (takeFromQueue(task)) {
+      return true;
+    }
+  }
+
+  // 从随机的起点开始依次尝试其他线程
+  size_t n = workers_.size();
+  size_t start = rand_r(&self->seed) % n;
+  for (size_t i = 0; i < n; ++i) {
+    Worker *victim = workers_[(start + i) % n].get();
+    if (victim != self && victim->deque.steal(task)) {
+      if (!victim->deque.empty()) {
+        wakeUpSleeper();
+      }
+      return true;
     }
   }
-  return task;
+  return false;
+}
+
+void ThreadPool::runWorkStealing(Worker *self) {
+  t_worker = self;
+  while (running_) {
+    Task task;
+    if (findTask(self, &task)) {
+      runTask(task);
+      continue;
+    }
+
+    MutexLockGuard lock(mutex_);
+    sleepers_.fetch_add(1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    while (running_ && !hasQueuedTasks()) {
+      notEmpty_.wait();
+    }
+    sleepers_.fetch_sub(1, memory_order_relaxed);
+  }
+  t_worker = NULL;
+}
+
+void ThreadPool::runTask(Task &task) {
+  if (!collectStats_) {
+    task();
+    task = nullptr;
+    completed_.add();
+    return;
+  }
+  Timestamp start(Timestamp::now());
+  task();
+  task = nullptr;
+  completed_.add();
+  runTime_->add(Timestamp::now().microSecondsSinceEpoch() -
+               start.microSecondsSinceEpoch());
 }
 
 bool ThreadPool::isFull() const {
@@ -94,16 +403,19 @@ bool ThreadPool::isFull() const {
 }
 
 // 线程执行函数 ：循环调用 take 获取任务，并执行任务
-void ThreadPool::runInThread() {
+void ThreadPool::runInThread(int index) {
   try {
     if (threadInitCallback_) {
       threadInitCallback_();
     }
-    while (running_) {
-      Task task(take());
-      if (task) { // 要判断任务是否为空，因为stop的时候会返回空task
-        task();
-      }
+    if (mode_ == kWorkStealing) {
+      runWorkStealing(workers_[index].get());
+      return;
+    }
+    Task task;
+    // stop或者弹性模式下空闲太久时退出
+    while (running_ && take(&task)) {
+      runTask(task);
     }
   } catch (const Exception &ex) {
     fprintf(stderr, "exception caught in ThreadPool %s\n", name_.c_str());
@@ -2,18 +2,40 @@
 #define BASE_THREADPOOL_H
 
 #include "Condition.h"
+#include "Future.h"
+#include "InlineTask.h"
+#include "Metrics.h"
 #include "Mutex.h"
+#include "RingBuffer.h"
 #include "Thread.h"
+#include "Timestamp.h"
 
-#include <deque>
+#include <atomic>
 #include <vector>
 
+// ThreadPool::Task内部缓冲区的大小，捕获超过这个大小的任务在提交时要分配内存
+// 需要在编译整个库时统一定义，可以是64或128
+#ifndef MUDUO_TASK_INLINE_SIZE
+#define MUDUO_TASK_INLINE_SIZE 64
+#endif
+
 using namespace std;
 
 namespace muduo {
 class ThreadPool : noncopyable {
 public:
-  typedef function<void()> Task;
+  // 只能移动，不大于MUDUO_TASK_INLINE_SIZE的任务提交时不分配内存
+  typedef InlineTask<MUDUO_TASK_INLINE_SIZE> Task;
+  typedef function<void()> ThreadInitCallback;
+  // 参数是线程的编号，从0开始
+  typedef function<ThreadPlacement(int index)> PlacementCallback;
+
+  enum Mode {
+    kSharedQueue, // 所有线程共用一个加锁的队列（默认）
+    // 每个线程一个无锁的双端队列：线程内提交的任务放入自己的队列，
+    // 外部提交的任务放入共用的队列，空闲的线程从其他线程的队列偷任务
+    kWorkStealing,
+  };
 
   explicit ThreadPool(const string &nameArg = string("ThreadPool"));
   ~ThreadPool();
@@ -25,12 +47,54 @@ public:
    * @param maxSize
    */
   void setMaxQueueSize(int maxSize) { this->maxQueueSize_ = maxSize; }
+  /**
+   * @brief 设置调度方式，默认kSharedQueue
+   *        kWorkStealing下setMaxQueueSize只限制外部提交的任务
+   *
+   * @param mode
+   */
+  void setMode(Mode mode) { mode_ = mode; }
+  /**
+   * @brief 弹性模式，只用于kSharedQueue：线程数在[minThreads, maxThreads]之间随负载变化
+   *        没有空闲线程、且队首任务已经等待超过spawnLatency秒时增加一个线程；
+   *        空闲超过idleTimeout秒的线程退出，直到剩下minThreads个
+   *        新增的线程同样先运行threadInitCallback
+   *        start(numThreads)的numThreads是初始线程数
+   *
+   * @param minThreads
+   * @param maxThreads
+   * @param spawnLatency 秒
+   * @param idleTimeout 秒
+   */
+  void setElastic(int minThreads, int maxThreads, double spawnLatency = 0.01,
+                  double idleTimeout = 60.0);
+  /**
+   * @brief 统计每个任务的排队时间和运行时间，默认关闭
+   *        每个任务要多读几次时钟，细粒度的任务吞吐量会明显下降
+   *        第一次打开时才注册两个直方图
+   *
+   * @param on
+   */
+  void setCollectStats(bool on);
   /**
    * @brief 设置线程初始化回调函数
    *
    * @param cb
    */
-  void setThreadInitCallback(const Task &cb) { threadInitCallback_ = cb; }
+  void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+  /**
+   * @brief 创建每个线程前调用cb决定它的CPU、NUMA节点、栈大小和优先级
+   *
+   * @param cb
+   */
+  void setThreadPlacement(const PlacementCallback &cb) { placementCallback_ = cb; }
+
+  /**
+   * @brief 把线程轮流绑定到NUMA节点node的各个核上，第i个线程在第i % n个核
+   *        pool.setThreadPlacement(ThreadPool::roundRobinOnNode(0));
+   *
+   */
+  static PlacementCallback roundRobinOnNode(int node);
 
   /**
    * @brief 启动线程池
@@ -48,6 +112,17 @@ public:
 
   size_t queueSize() const;
 
+  // 当前的线程数，弹性模式下会变化
+  int numThreads() const;
+
+  // 任务在共用队列中等待的时间（微秒），kWorkStealing下线程内提交的任务不统计
+  // 没有setCollectStats(true)时为NULL
+  const MetricHistogram *queueWaitHistogram() const { return queueWait_.get(); }
+  // 任务的运行时间（微秒），没有setCollectStats(true)时为NULL
+  const MetricHistogram *runTimeHistogram() const { return runTime_.get(); }
+  // 已经运行完的任务数
+  int64_t completedTasks() const { return completed_.value(); }
+
   /**
    * @brief 将任务f加入线程池运行
    *
@@ -55,19 +130,100 @@ public:
    */
   void run(Task f); //
 
+  /**
+   * @brief 将f加入线程池运行，通过返回的Future取得f的返回值或者抛出的异常
+   *        线程池stop时还没有运行的任务，Future会得到异常
+   *
+   * @param f 可调用对象，没有参数
+   */
+  template <typename F>
+  Future<typename std::result_of<F()>::type> submit(F f) {
+    typedef typename std::result_of<F()>::type R;
+    std::shared_ptr<detail::FutureState<R>> state(
+        std::make_shared<detail::FutureState<R>>());
+    run(detail::FutureTask<R, F>(state, std::move(f)));
+    return Future<R>(state);
+  }
+
+  /**
+   * @brief 把[begin, end)中的任务一次加入线程池，只加锁一次、notifyAll一次
+   *        任务会被移走；设置了setMaxQueueSize时，队列满了会在中途等待
+   *
+   */
+  template <typename Iterator> void runBatch(Iterator begin, Iterator end) {
+    if (runInCaller_) {
+      for (; begin != end; ++begin) {
+        Task task(std::move(*begin));
+        task();
+      }
+      return;
+    }
+
+    int64_t now = enqueueTime();
+    int index = 0;
+    bool spawn = false;
+    {
+      MutexLockGuard lock(mutex_);
+      for (; begin != end; ++begin) {
+        while (isFull()) {
+          queued_.store(queue_.size(), std::memory_order_relaxed);
+          notEmpty_.notifyAll();
+          notFull_.wait();
+        }
+        queue_.emplace_back(Task(std::move(*begin)), now);
+      }
+      queued_.store(queue_.size(), std::memory_order_relaxed);
+      notEmpty_.notifyAll();
+      spawn = needMoreThreads(now, &index);
+    }
+    if (spawn) {
+      addThread(index);
+    }
+  }
+
 private:
+  struct Worker;
+  static __thread Worker *t_worker; // 当前线程所属的Worker
+
+  // 共用队列中的任务，带有放入时的时间（微秒）
+  struct QueuedTask {
+    QueuedTask(Task &&t, int64_t when) : task(std::move(t)), enqueued(when) {}
+    Task task;
+    int64_t enqueued;
+  };
+
   bool isFull() const REQUIRES(mutex_);
   /**
    * @brief 运行run中添加的任务
    *
    */
-  void runInThread();
+  void runInThread(int index);
   /**
    * @brief 从queue中获取任务
    *
-   * @return Task
+   * @return false 线程池已经停止，或者本线程空闲太久需要退出
    */
-  Task take();
+  bool take(Task *task);
+  // 创建并启动一个线程，顺便join已经退出的线程
+  void addThread(int index);
+  // 弹性模式下是否需要增加线程，是则预留一个名额并返回它的编号
+  bool needMoreThreads(int64_t now, int *index) REQUIRES(mutex_);
+  // 运行任务并统计运行时间
+  void runTask(Task &task);
+  // 弹性模式或者统计时才读时钟，否则为0
+  int64_t enqueueTime() const {
+    return maxThreads_ > 0 || collectStats_
+               ? Timestamp::now().microSecondsSinceEpoch()
+               : 0;
+  }
+
+  // kWorkStealing下的线程主循环
+  void runWorkStealing(Worker *self);
+  // 依次从自己的队列、共用队列、其他线程的队列中取任务
+  bool findTask(Worker *self, Task *task);
+  bool takeFromQueue(Task *task) REQUIRES(mutex_);
+  bool hasQueuedTasks() const REQUIRES(mutex_);
+  void wakeUpSleeper();
 
   mutable MutexLock mutex_;
   // 用来告知线程池里面的线程当前是否有尚未执行的任务（即任务列表是否空）
@@ -75,11 +231,34 @@ private:
   // 用来告知传递任务的线程当前线程池的任务列表是否已经塞满
   Condition notFull_ GUARDED_BY(mutex_);
   string name_;
-  Task threadInitCallback_;
-  vector<unique_ptr<muduo::Thread>> threads_;
-  deque<Task> queue_ GUARDED_BY(mutex_);
+  ThreadInitCallback threadInitCallback_;
+  PlacementCallback placementCallback_;
+  vector<unique_ptr<muduo::Thread>> threads_ GUARDED_BY(mutex_);
+  RingBuffer<QueuedTask> queue_ GUARDED_BY(mutex_);
   size_t maxQueueSize_;
   bool running_;
+  Mode mode_;
+  vector<unique_ptr<Worker>> workers_; // kWorkStealing下每个线程一个
+  std::atomic<int> sleepers_;          // 在notEmpty_上等待的线程数
+  std::atomic<size_t> queued_; // queue_.size()，不加锁判断共用队列是否为空
+  bool runInCaller_;           // 没有线程，run()直接在调用线程运行任务
+  int minThreads_;
+  int maxThreads_; // 为0时不是弹性模式
+  double spawnLatency_;
+  double idleTimeout_;
+  int liveThreads_ GUARDED_BY(mutex_); // 包括正在创建的线程
+  int idleThreads_ GUARDED_BY(mutex_); // 在notEmpty_上等待的线程数
+  int nextThreadId_ GUARDED_BY(mutex_);
+  vector<pid_t> exitedThreads_ GUARDED_BY(mutex_); // 已退出、等待join的线程
+  bool collectStats_;
+  // 以下指标注册在MetricsRegistry中，标签为pool="name",id="n"
+  // 同名的线程池用id区分
+  const string labels_;
+  MetricCounter completed_;
+  unique_ptr<MetricHistogram> queueWait_;
+  unique_ptr<MetricHistogram> runTime_;
+  MetricGauge threadsGauge_;
+  MetricGauge queueGauge_;
 };
 } // namespace muduo
 
@@ -0,0 +1,113 @@
+#include "TimeFormat.h"
+
+#include <stdio.h>
+
+using namespace muduo;
+
+namespace muduo {
+namespace detail {
+const char kDigitPairs[200] = {
+    '0', '0', '0', '1', '0', '2', '0', '3', '0', '4', '0', '5', '0', '6', '0',
+    '7', '0', '8', '0', '9', '1', '0', '1', '1', '1', '2', '1', '3', '1', '4',
+    '1', '5', '1', '6', '1', '7', '1', '8', '1', '9', '2', '0', '2', '1', '2',
+    '2', '2', '3', '2', '4', '2', '5', '2', '6', '2', '7', '2', '8', '2', '9',
+    '3', '0', '3', '1', '3', '2', '3', '3', '3', '4', '3', '5', '3', '6', '3',
+    '7', '3', '8', '3', '9', '4', '0', '4', '1', '4', '2', '4', '3', '4', '4',
+    '4', '5', '4', '6', '4', '7', '4', '8', '4', '9', '5', '0', '5', '1', '5',
+    '2', '5', '3', '5', '4', '5', '5', '5', '6', '5', '7', '5', '8', '5', '9',
+    '6', '0', '6', '1', '6', '2', '6', '3', '6', '4', '6', '5', '6', '6', '6',
+    '7', '6', '8', '6', '9', '7', '0', '7', '1', '7', '2', '7', '3', '7', '4',
+    '7', '5', '7', '6', '7', '7', '7', '8', '7', '9', '8', '0', '8', '1', '8',
+    '2', '8', '3', '8', '4', '8', '5', '8', '6', '8', '7', '8', '8', '8', '9',
+    '9', '0', '9', '1', '9', '2', '9', '3', '9', '4', '9', '5', '9', '6', '9',
+    '7', '9', '8', '9', '9',
+};
+} // namespace detail
+} // namespace muduo
+
+namespace {
+// 还没有缓存任何时间
+const int64_t kNoSecond = INT64_MIN;
+// 时区偏移不超过一天，离四位数年份的边界一天以内的都走慢路径
+const int64_t kSecondsPerDay = 24 * 3600;
+} // namespace
+
+TimeFormatCache::TimeFormatCache() : TimeFormatCache(TimeZone(0, "UTC")) {}
+
+TimeFormatCache::TimeFormatCache(const TimeZone &tz)
+    : zone_(tz), seq_(0), second_(kNoSecond) {
+  for (int i = 0; i < kWords; ++i) {
+    text_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+int TimeFormatCache::format(time_t seconds, char *buf) {
+  static_assert(kWords * sizeof(uint64_t) >= TimeZone::kSecondsFormatLength,
+                "text_ too small");
+  if (__builtin_expect(
+          seconds < detail::kFourDigitYearBegin + kSecondsPerDay ||
+              seconds >= detail::kFourDigitYearEnd - kSecondsPerDay,
+          0)) {
+    return formatSlow(seconds, buf);
+  }
+  uint64_t words[kWords];
+  unsigned seq = seq_.load(std::memory_order_acquire);
+  if ((seq & 1) == 0) {
+    int64_t cached = second_.load(std::memory_order_relaxed);
+    for (int i = 0; i < kWords; ++i) {
+      words[i] = text_[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (cached == seconds && seq == seq_.load(std::memory_order_relaxed)) {
+      memcpy(buf, words, TimeZone::kSecondsFormatLength);
+      return TimeZone::kSecondsFormatLength;
+    }
+  }
+
+  zone_.formatLocalTime(&seconds, 1, buf);
+  // 只发布更新的时间；有别的线程正在发布就放弃，不等待
+  if (static_cast<int64_t>(seconds) > second_.load(std::memory_order_relaxed) &&
+      (seq & 1) == 0 &&
+      seq_.compare_exchange_strong(seq, seq + 1, std::memory_order_relaxed)) {
+    std::atomic_thread_fence(std::memory_order_release);
+    memset(words, 0, sizeof words);
+    memcpy(words, buf, TimeZone::kSecondsFormatLength);
+    second_.store(seconds, std::memory_order_relaxed);
+    for (int i = 0; i < kWords; ++i) {
+      text_[i].store(words[i], std::memory_order_relaxed);
+    }
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+  return TimeZone::kSecondsFormatLength;
+}
+
+int TimeFormatCache::formatSlow(time_t seconds, char *buf) const {
+  struct tm localTm = zone_.toLocalTime(seconds);
+  char text[32];
+  int len = snprintf(text, sizeof text, "%04d%02d%02d %02d:%02d:%02d",
+                     localTm.tm_year + 1900, localTm.tm_mon + 1,
+                     localTm.tm_mday, localTm.tm_hour, localTm.tm_min,
+                     localTm.tm_sec);
+  assert(len <= kMaxSecondsFormatLength);
+  memcpy(buf, text, static_cast<size_t>(len));
+  return len;
+}
+
+int TimeFormatCache::formatMicroseconds(Timestamp time, char *buf) {
+  int64_t us = time.microSecondsSinceEpoch();
+  int64_t seconds = us / Timestamp::kMicroSecondsPerSecond;
+  int64_t microseconds = us - seconds * Timestamp::kMicroSecondsPerSecond;
+  if (microseconds < 0) {
+    --seconds;
+    microseconds += Timestamp::kMicroSecondsPerSecond;
+  }
+  int len = format(static_cast<time_t>(seconds), buf);
+  buf[len] = '.';
+  detail::formatDigits6(static_cast<int>(microseconds), buf + len + 1);
+  return len + 7;
+}
+
+TimeFormatCache &TimeFormatCache::utc() {
+  static TimeFormatCache cache;
+  return cache;
+}
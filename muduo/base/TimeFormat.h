@@ -0,0 +1,93 @@
+#ifndef BASE_TIMEFORMAT_H
+#define BASE_TIMEFORMAT_H
+
+#include "TimeZone.h"
+#include "Timestamp.h"
+#include "noncopyable.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+
+namespace muduo {
+
+namespace detail {
+
+// "00" "01" ... "99"
+extern const char kDigitPairs[200];
+
+// 0..99写成两位
+inline void formatDigits2(int v, char *buf) {
+  assert(0 <= v && v < 100);
+  memcpy(buf, kDigitPairs + 2 * v, 2);
+}
+
+// 0..999999写成六位，不用snprintf
+inline void formatDigits6(int v, char *buf) {
+  formatDigits2(v / 10000, buf);
+  formatDigits2(v / 100 % 100, buf + 2);
+  formatDigits2(v % 100, buf + 4);
+}
+
+// 0000-01-01 00:00:00和10000-01-01 00:00:00 UTC，在此之间的年份是四位数
+const int64_t kFourDigitYearBegin = -62167219200;
+const int64_t kFourDigitYearEnd = 253402300800;
+
+} // namespace detail
+
+/**
+ * @brief 进程内共享的"YYYYMMDD HH:MM:SS"缓存，每个时区一个对象，保存最近一秒的结果
+ *        用seqlock发布：读者不加锁也不写共享的cache line，
+ *        秒数变了的时候由第一个发现的线程格式化并发布，其他线程同时发现的就自己格式化
+ *
+ */
+class TimeFormatCache : noncopyable {
+public:
+  // UTC
+  TimeFormatCache();
+  explicit TimeFormatCache(const TimeZone &tz);
+
+  // 年份不在0..9999之内时用snprintf，负号和更多的位数最多多出7个字符
+  static const int kMaxSecondsFormatLength = TimeZone::kSecondsFormatLength + 7;
+  static const int kMaxMicrosecondsFormatLength =
+      TimeZone::kMicrosecondsFormatLength + 7;
+
+  const TimeZone &timeZone() const { return zone_; }
+
+  /**
+   * @brief 通常写入TimeZone::kSecondsFormatLength个字节，不含'\0'
+   *
+   * @param buf 至少kMaxSecondsFormatLength字节
+   * @return int 写入的字节数
+   */
+  int format(time_t seconds, char *buf);
+
+  /**
+   * @brief "YYYYMMDD HH:MM:SS.uuuuuu"，
+   *        通常写入TimeZone::kMicrosecondsFormatLength个字节，不含'\0'
+   *
+   * @param buf 至少kMaxMicrosecondsFormatLength字节
+   * @return int 写入的字节数
+   */
+  int formatMicroseconds(Timestamp time, char *buf);
+
+  // 进程内共用的UTC缓存
+  static TimeFormatCache &utc();
+
+private:
+  static const int kWords = 3; // 17个字符放在3个uint64_t里
+
+  // 年份写不进四位时不经过缓存
+  int formatSlow(time_t seconds, char *buf) const;
+
+  const TimeZone zone_;
+  std::atomic<unsigned> seq_;
+  std::atomic<int64_t> second_;
+  std::atomic<uint64_t> text_[kWords];
+};
+
+} // namespace muduo
+
+#endif // BASE_TIMEFORMAT_H
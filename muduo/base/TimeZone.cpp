@@ -1,8 +1,10 @@
 #include "TimeZone.h"
 #include "Date.h"
+#include "TimeFormat.h"
 #include "noncopyable.h"
 
 #include <algorithm>
+#include <atomic>
 #include <stdexcept>
 #include <string.h>
 #include <vector>
@@ -74,6 +76,8 @@ struct TimeZone::Data {
   vector<detail::Localtime> localtimes;
   vector<string> names;
   string abbreviation; // 缩写
+  // 上一次命中的过渡区间，见detail::findInterval()；多线程共用，只是提示
+  std::atomic<int> cachedInterval{-1};
 };
 
 namespace muduo {
@@ -134,6 +138,7 @@ bool readTimeZoneFile(const char *zonefile, struct TimeZone::Data *data) {
         throw logic_error("bad head");
       }
       string version = f.readBytes(1);
+      f.readBytes(15); // 保留字段
 
       int32_t isgmtcnt = f.readInt32();
       int32_t isstdcnt = f.readInt32();
@@ -210,6 +215,223 @@ const Localtime *findLocaltime(const TimeZone::Data &data, Transition sentry,
   return local;
 }
 
+// 第i个区间为[transitions[i].gmttime, transitions[i + 1].gmttime)，
+// -1为第一个过渡之前，最后一个区间没有上界
+bool intervalContains(const TimeZone::Data &data, int i, time_t seconds) {
+  int n = static_cast<int>(data.transitions.size());
+  if (i >= 0 && seconds < data.transitions[i].gmttime) {
+    return false;
+  }
+  return i + 1 >= n || seconds < data.transitions[i + 1].gmttime;
+}
+
+// 先试hint和它的下一个区间，都不是才二分查找
+int findInterval(const TimeZone::Data &data, time_t seconds, int hint) {
+  int n = static_cast<int>(data.transitions.size());
+  if (hint >= -1 && hint < n) {
+    if (intervalContains(data, hint, seconds)) {
+      return hint;
+    }
+    if (hint + 1 < n && intervalContains(data, hint + 1, seconds)) {
+      return hint + 1;
+    }
+  }
+  Transition sentry(seconds, 0, 0);
+  vector<Transition>::const_iterator it = upper_bound(
+      data.transitions.begin(), data.transitions.end(), sentry, Comp(true));
+  return static_cast<int>(it - data.transitions.begin()) - 1;
+}
+
+// 与findLocaltime()按gmt查找的结果相同
+const Localtime *localtimeOfInterval(const TimeZone::Data &data, int i) {
+  if (data.localtimes.empty()) {
+    return NULL;
+  }
+  if (i < 0) {
+    // FIXME: should be first non dst time zone
+    return &data.localtimes.front();
+  }
+  return &data.localtimes[data.transitions[i].localtimeIdx];
+}
+
+// 每块先查过渡区间，再统一做日期运算
+const int kBlockSize = 64;
+
+/**
+ * @brief 一块时间的日期运算，按字段分开存放
+ *
+ */
+struct CalendarBlock {
+  int days[kBlockSize]; // 本地时间自1970-01-01的天数
+  int secondsOfDay[kBlockSize];
+  int microseconds[kBlockSize];
+  const Localtime *local[kBlockSize];
+  int year[kBlockSize];
+  int month[kBlockSize]; // 1..12
+  int day[kBlockSize];   // 1..31
+  int yday[kBlockSize];
+  int wday[kBlockSize];
+  int hour[kBlockSize];
+  int minute[kBlockSize];
+  int second[kBlockSize];
+
+  // 本地时间拆成天数和一天内的秒数，向下取整
+  void setLocalSeconds(int i, int64_t s) {
+    int64_t d = s / kSecondsPerDay;
+    int64_t sod = s - d * kSecondsPerDay;
+    if (sod < 0) {
+      --d;
+      sod += kSecondsPerDay;
+    }
+    days[i] = static_cast<int>(d);
+    secondsOfDay[i] = static_cast<int>(sod);
+  }
+
+  /**
+   * @brief 从天数算出第i个的年月日时分秒，用Howard Hinnant的civil_from_days，
+   *        只有32位整数乘除和条件选择，没有查表和分支
+   *
+   */
+  __attribute__((always_inline)) void computeAt(int i) {
+    // 以3月1日为一年的开始，闰日在年末
+    int z = days[i] + 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    int m = mp < 10 ? mp + 3 : mp - 9;
+    int y = yoe + era * 400 + (m <= 2 ? 1 : 0);
+    int leap = (y % 4 == 0) & ((y % 100 != 0) | (y % 400 == 0));
+
+    year[i] = y;
+    month[i] = m;
+    day[i] = doy - (153 * mp + 2) / 5 + 1;
+    // 3月1日是第59（闰年60）天
+    yday[i] = m <= 2 ? doy - 306 : doy + 59 + leap;
+    // 1970-01-01是星期四
+    int w = (days[i] + 4) % 7;
+    wday[i] = w < 0 ? w + 7 : w;
+    int sod = secondsOfDay[i];
+    hour[i] = sod / 3600;
+    minute[i] = sod / 60 % 60;
+    second[i] = sod % 60;
+  }
+
+  /**
+   * @brief 算前count个；数量多时补零算满一块，
+   *        固定的循环次数让编译器在-O2下也能向量化
+   *
+   */
+  void compute(int count) {
+    if (count < kBlockSize / 4) {
+      for (int i = 0; i < count; ++i) {
+        computeAt(i);
+      }
+      return;
+    }
+    for (int i = count; i < kBlockSize; ++i) {
+      days[i] = 0;
+      secondsOfDay[i] = 0;
+    }
+    for (int i = 0; i < kBlockSize; ++i) {
+      computeAt(i);
+    }
+  }
+
+  void fillTm(int i, const string &abbreviation, struct tm *tm) const {
+    memset(tm, 0, sizeof(*tm));
+    if (local[i] == NULL) {
+      return;
+    }
+    tm->tm_year = year[i] - 1900;
+    tm->tm_mon = month[i] - 1;
+    tm->tm_mday = day[i];
+    tm->tm_yday = yday[i];
+    tm->tm_wday = wday[i];
+    tm->tm_hour = hour[i];
+    tm->tm_min = minute[i];
+    tm->tm_sec = second[i];
+    tm->tm_isdst = local[i]->isDst;
+    tm->tm_gmtoff = local[i]->gmtOffset;
+    tm->tm_zone = &abbreviation[local[i]->arrbIdx];
+  }
+
+  // 20150127 21:46:45
+  // 定长的结果放不下0..9999以外的年份，整个写成'*'
+  void format(int i, char *buf) const {
+    if (__builtin_expect(year[i] < 0 || year[i] > 9999, 0)) {
+      memset(buf, '*', TimeZone::kSecondsFormatLength);
+      return;
+    }
+    appendDigits4(year[i], buf);
+    formatDigits2(month[i], buf + 4);
+    formatDigits2(day[i], buf + 6);
+    buf[8] = ' ';
+    formatDigits2(hour[i], buf + 9);
+    buf[11] = ':';
+    formatDigits2(minute[i], buf + 12);
+    buf[14] = ':';
+    formatDigits2(second[i], buf + 15);
+  }
+
+  // 20150127 21:46:45.376742
+  void formatMicroseconds(int i, char *buf) const {
+    format(i, buf);
+    buf[17] = '.';
+    formatDigits6(microseconds[i], buf + 18);
+  }
+
+  static void appendDigits4(int v, char *buf) {
+    formatDigits2(v / 100, buf);
+    formatDigits2(v % 100, buf + 2);
+  }
+};
+
+inline void splitSeconds(time_t t, int64_t *seconds, int *microseconds) {
+  *seconds = t;
+  *microseconds = 0;
+}
+
+inline void splitSeconds(Timestamp t, int64_t *seconds, int *microseconds) {
+  int64_t us = t.microSecondsSinceEpoch();
+  int64_t s = us / Timestamp::kMicroSecondsPerSecond;
+  int64_t rem = us - s * Timestamp::kMicroSecondsPerSecond;
+  if (rem < 0) {
+    --s;
+    rem += Timestamp::kMicroSecondsPerSecond;
+  }
+  *seconds = s;
+  *microseconds = static_cast<int>(rem);
+}
+
+/**
+ * @brief 分块转换，每块算完后调用output(block, count, 块在输入中的起点)
+ *
+ */
+template <typename Input, typename Output>
+void convertInBlocks(TimeZone::Data &data, const Input *in, size_t n,
+                     Output output) {
+  int hint = data.cachedInterval.load(std::memory_order_relaxed);
+  CalendarBlock block;
+  for (size_t start = 0; start < n; start += kBlockSize) {
+    int count = static_cast<int>(
+        n - start < static_cast<size_t>(kBlockSize) ? n - start : kBlockSize);
+    for (int i = 0; i < count; ++i) {
+      int64_t seconds;
+      splitSeconds(in[start + static_cast<size_t>(i)], &seconds,
+                   &block.microseconds[i]);
+      hint = findInterval(data, static_cast<time_t>(seconds), hint);
+      const Localtime *local = localtimeOfInterval(data, hint);
+      block.local[i] = local;
+      block.setLocalSeconds(i, seconds + (local ? local->gmtOffset : 0));
+    }
+    block.compute(count);
+    output(block, count, start);
+  }
+  data.cachedInterval.store(hint, std::memory_order_relaxed);
+}
+
 } // namespace detail
 } // namespace muduo
 
@@ -227,23 +449,63 @@ TimeZone::TimeZone(int eastOfUtc, const char *name)
 
 struct tm TimeZone::toLocalTime(time_t seconds) const {
   struct tm localTime;
-  memset(&localTime,0, sizeof(localTime));
+  toLocalTime(&seconds, 1, &localTime);
+  return localTime;
+}
+
+void TimeZone::toLocalTime(const time_t *seconds, size_t n,
+                           struct tm *out) const {
   assert(data_ != NULL);
-  const Data &data(*data_);
+  const string &abbreviation = data_->abbreviation;
+  detail::convertInBlocks(
+      *data_, seconds, n,
+      [out, &abbreviation](const detail::CalendarBlock &block, int count,
+                           size_t start) {
+        for (int i = 0; i < count; ++i) {
+          block.fillTm(i, abbreviation, &out[start + static_cast<size_t>(i)]);
+        }
+      });
+}
 
-  detail::Transition sentry(seconds, 0, 0);
-  const detail::Localtime *local =
-      findLocaltime(data, sentry, detail::Comp(true));
-
-  if (local) {
-    time_t localSeconds = seconds + local->gmtOffset;
-    ::gmtime_r(&localSeconds, &localTime); // FIXME: fromUtcTime
-    localTime.tm_isdst = local->isDst;
-    localTime.tm_gmtoff = local->gmtOffset;
-    localTime.tm_zone = &data.abbreviation[local->arrbIdx];
-  }
+void TimeZone::toLocalTime(const Timestamp *times, size_t n,
+                           struct tm *out) const {
+  assert(data_ != NULL);
+  const string &abbreviation = data_->abbreviation;
+  detail::convertInBlocks(
+      *data_, times, n,
+      [out, &abbreviation](const detail::CalendarBlock &block, int count,
+                           size_t start) {
+        for (int i = 0; i < count; ++i) {
+          block.fillTm(i, abbreviation, &out[start + static_cast<size_t>(i)]);
+        }
+      });
+}
 
-  return localTime;
+void TimeZone::formatLocalTime(const time_t *seconds, size_t n,
+                               char *buf) const {
+  assert(data_ != NULL);
+  detail::convertInBlocks(
+      *data_, seconds, n,
+      [buf](const detail::CalendarBlock &block, int count, size_t start) {
+        for (int i = 0; i < count; ++i) {
+          block.format(i, buf + (start + static_cast<size_t>(i)) *
+                                    kSecondsFormatLength);
+        }
+      });
+}
+
+void TimeZone::formatLocalTime(const Timestamp *times, size_t n,
+                               char *buf) const {
+  assert(data_ != NULL);
+  detail::convertInBlocks(
+      *data_, times, n,
+      [buf](const detail::CalendarBlock &block, int count, size_t start) {
+        for (int i = 0; i < count; ++i) {
+          block.formatMicroseconds(
+              i, buf + (start + static_cast<size_t>(i)) *
+                           kMicrosecondsFormatLength);
+        }
+      });
 }
 
 time_t TimeZone::fromLocalTime(const struct tm &localTm) const {
@@ -1,8 +1,10 @@
 #ifndef BASE_TIMEZONE_H
 #define BASE_TIMEZONE_H
 
+#include "Timestamp.h"
 #include "copyable.h"
 #include <memory>
+#include <stddef.h>
 #include <time.h>
 
 namespace muduo {
@@ -22,8 +24,39 @@ public:
 
   bool valid() const { return static_cast<bool>(data_); }
 
+  /**
+   * @brief 转换为本地时间
+   *        每个TimeZone（及其拷贝）缓存上一次命中的过渡区间，
+   *        同一区间内的时间不再二分查找，也不调用gmtime_r
+   *
+   */
   struct tm toLocalTime(time_t secondsSinceEpoch) const;
   time_t fromLocalTime(const struct tm &) const;
+
+  /**
+   * @brief 批量转换，结果与逐个调用toLocalTime()相同
+   *        按块先查过渡区间，再对整块做日期运算（没有分支，便于编译器向量化）
+   *        Timestamp的微秒部分被舍去
+   *
+   */
+  void toLocalTime(const time_t *seconds, size_t n, struct tm *out) const;
+  void toLocalTime(const Timestamp *times, size_t n, struct tm *out) const;
+
+  // 20150127 21:46:45
+  static const int kSecondsFormatLength = 17;
+  // 20150127 21:46:45.376742
+  static const int kMicrosecondsFormatLength = 24;
+
+  /**
+   * @brief 批量格式化为本地时间，每个结果定长，依次写入buf，不含'\0'
+   *        time_t每个占kSecondsFormatLength字节，
+   *        Timestamp每个占kMicrosecondsFormatLength字节
+   *        年份不在0..9999之内的写不下，日期和时间部分写成'*'，
+   *        需要时用TimeFormatCache::format()
+   *
+   */
+  void formatLocalTime(const time_t *seconds, size_t n, char *buf) const;
+  void formatLocalTime(const Timestamp *times, size_t n, char *buf) const;
   
   // gmtime(3)
   static struct tm toUtcTime(time_t secondsSinceEpoch, bool yday = false);
@@ -3,7 +3,9 @@
 #undef __STDC_FORMAT_MACROS
 
 #include "Timestamp.h"
-#include <sys/time.h>
+
+#include "Clock.h"
+#include "TimeFormat.h"
 
 using namespace muduo;
 
@@ -22,29 +24,19 @@ std::string Timestamp::toString() const {
 }
 
 std::string Timestamp::toFormattedString(bool showMicroseconds) const {
-  char buf[32];
-  time_t seconds =
-      static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
-  struct tm tm_time;
-  gmtime_r(&seconds, &tm_time); // 将数据存储到用户提供的结构体中
-
+  char buf[TimeFormatCache::kMaxMicrosecondsFormatLength];
   if (showMicroseconds) {
-    int microseconds =
-        static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
-    snprintf(buf, sizeof(buf), "%4d%02d%02d %02d:%02d:%02d:%06d",
-             tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
-             tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec, microseconds);
-  } else {
-    snprintf(buf, sizeof(buf), "%4d%02d%02d %02d:%02d:%02d",
-             tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
-             tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+    int len = TimeFormatCache::utc().formatMicroseconds(*this, buf);
+    buf[len - 7] = ':';
+    return std::string(buf, static_cast<size_t>(len));
   }
-  return buf;
+  // 向下取整，1970年以前的时间与formatMicroseconds一致
+  int64_t seconds = microSecondsSinceEpoch_ / kMicroSecondsPerSecond;
+  if (microSecondsSinceEpoch_ % kMicroSecondsPerSecond < 0) {
+    --seconds;
+  }
+  int len = TimeFormatCache::utc().format(static_cast<time_t>(seconds), buf);
+  return std::string(buf, static_cast<size_t>(len));
 }
 
-Timestamp Timestamp::now() {
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  int64_t seconds = tv.tv_sec;// 秒
-  return Timestamp(seconds * kMicroSecondsPerSecond + tv.tv_usec);// 微秒
-}
+Timestamp Timestamp::now() { return Timestamp(Clock::nowMicroseconds()); }
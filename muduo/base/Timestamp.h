@@ -65,7 +65,7 @@ public:
   }
 
   /**
-   * @brief 获取当前时间
+   * @brief 获取当前时间，读取Clock::setSource()选择的时钟
    *
    * @return Timestamp
    */
@@ -0,0 +1,145 @@
+#ifndef BASE_WORKSTEALINGDEQUE_H
+#define BASE_WORKSTEALINGDEQUE_H
+
+#include "noncopyable.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace muduo {
+
+/**
+ * @brief Chase-Lev工作窃取双端队列（按Lê等人的C11内存模型版本实现），容量固定
+ *        所有者在底部push/pop（后进先出，缓存更热），其他线程从顶部steal（先进先出）
+ *        所有者的操作只有在只剩一个元素时才需要CAS
+ *        元素直接存放在槽位中：窃取者先用CAS占到槽位再把元素移出，
+ *        移出后才清除槽位的标志，所有者绕回来时看到标志未清除就当作队列已满
+ *
+ * @tparam T 需要可默认构造、可移动赋值
+ */
+template <typename T> class WorkStealingDeque : noncopyable {
+public:
+  // 容量向上取整到2的幂
+  explicit WorkStealingDeque(int capacity)
+      : capacity_(roundUpPowerOfTwo(capacity)), mask_(capacity_ - 1), top_(0),
+        bottom_(0), slots_(new Slot[static_cast<size_t>(capacity_)]) {}
+
+  /**
+   * @brief 只能由所有者调用，成功时x被移走
+   *
+   * @return false 队列已满
+   */
+  bool push(T &x) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    Slot &slot = slots_[b & mask_];
+    if (b - t >= capacity_ || slot.busy.load(std::memory_order_acquire)) {
+      return false;
+    }
+    slot.value = std::move(x);
+    slot.busy.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /**
+   * @brief 只能由所有者调用，取出最后push的元素
+   *
+   * @return false 队列为空，或者最后一个元素被偷走了
+   */
+  bool pop(T *x) {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+    if (t == b) {
+      // 最后一个元素，与窃取者竞争
+      bool won = top_.compare_exchange_strong(t, t + 1,
+                                              std::memory_order_seq_cst,
+                                              std::memory_order_relaxed);
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      if (!won) {
+        return false;
+      }
+    }
+    release(&slots_[b & mask_], x);
+    return true;
+  }
+
+  /**
+   * @brief 任何线程都可以调用，取出最早push的元素
+   *
+   * @return false 队列为空，或者与其他线程竞争失败
+   */
+  bool steal(T *x) {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return false;
+    }
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return false;
+    }
+    release(&slots_[t & mask_], x);
+    return true;
+  }
+
+  // 并发修改时只是一个近似值
+  size_t size() const {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    return b > t ? static_cast<size_t>(b - t) : 0;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  size_t capacity() const { return static_cast<size_t>(capacity_); }
+
+private:
+  struct Slot {
+    Slot() : busy(false) {}
+    std::atomic<bool> busy; // 已写入且尚未被移出
+    T value;
+  };
+
+  static void release(Slot *slot, T *x) {
+    *x = std::move(slot->value);
+    slot->value = T();
+    slot->busy.store(false, std::memory_order_release);
+  }
+
+  static int64_t roundUpPowerOfTwo(int n) {
+    assert(n > 0);
+    int64_t size = 1;
+    while (size < n) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  const int64_t capacity_;
+  const int64_t mask_;
+  // 窃取者修改top_，所有者修改bottom_，分开放在不同的cache line
+  char pad0_[64];
+  std::atomic<int64_t> top_;
+  char pad1_[64 - sizeof(std::atomic<int64_t>)];
+  std::atomic<int64_t> bottom_;
+  char pad2_[64 - sizeof(std::atomic<int64_t>)];
+  std::unique_ptr<Slot[]> slots_;
+};
+
+} // namespace muduo
+
+#endif // BASE_WORKSTEALINGDEQUE_H
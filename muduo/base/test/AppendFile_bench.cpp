@@ -0,0 +1,98 @@
+#include "../FileUtil.h"
+#include "../Timestamp.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace muduo;
+
+const int64_t kMegaBytes = 1024 * 1024;
+
+// 文件在page cache中的字节数
+int64_t residentBytes(const char *path) {
+  FileUtil::MappedFile file(path);
+  const size_t kPageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  std::vector<unsigned char> pages((file.size() + kPageSize - 1) / kPageSize);
+  if (pages.empty() ||
+      ::mincore(const_cast<char *>(file.data()), file.size(), pages.data())) {
+    return 0;
+  }
+  int64_t resident = 0;
+  for (unsigned char page : pages) {
+    resident += page & 1;
+  }
+  return resident * static_cast<int64_t>(kPageSize);
+}
+
+// 像日志一样写入totalBytes字节，长度不等的行，每秒钟的量flush一次
+void bench(const char *name, const char *path, int64_t totalBytes,
+           const FileUtil::AppendFile::Options &options) {
+  ::unlink(path);
+  char lines[4096];
+  for (size_t i = 0; i < sizeof lines; ++i) {
+    lines[i] = i % 64 == 63 ? '\n' : static_cast<char>('a' + i % 26);
+  }
+  // 每隔这么多字节采样一次page cache占用
+  const int64_t kSampleBytes = std::max<int64_t>(totalBytes / 10, kMegaBytes);
+  int64_t maxResident = 0;
+  int64_t nextSample = kSampleBytes;
+
+  Timestamp start(Timestamp::now());
+  {
+    FileUtil::AppendFile file(path, options);
+    unsigned seed = 1;
+    int64_t written = 0;
+    while (written < totalBytes) {
+      size_t len = 64 + static_cast<size_t>(rand_r(&seed) % 192);
+      file.append(lines, len);
+      written += static_cast<int64_t>(len);
+      if (written >= nextSample) {
+        file.flush();
+        maxResident = std::max(maxResident, residentBytes(path));
+        nextSample += kSampleBytes;
+      }
+    }
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  int64_t finalResident = residentBytes(path);
+  printf("%-28s %8.1f MB/s  page cache max %6" PRId64 " MB  after close %6" PRId64
+         " MB\n",
+         name, static_cast<double>(totalBytes) / kMegaBytes / seconds,
+         maxResident / kMegaBytes, finalResident / kMegaBytes);
+  ::unlink(path);
+}
+
+int main(int argc, char *argv[]) {
+  // 默认写10GB，可以用第一个参数指定MB数
+  int64_t totalBytes = (argc > 1 ? atoll(argv[1]) : 10240) * kMegaBytes;
+  const char *path = argc > 2 ? argv[2] : "/tmp/appendfile_bench.log";
+  printf("writing %" PRId64 " MB to %s\n", totalBytes / kMegaBytes, path);
+
+  FileUtil::AppendFile::Options options;
+  bench("stdio", path, totalBytes, options);
+
+  FileUtil::AppendFile::Options managed;
+  managed.preallocateBytes = 64 * kMegaBytes;
+  managed.dropBehindBytes = 8 * kMegaBytes;
+  bench("stdio prealloc dropbehind", path, totalBytes, managed);
+
+  FileUtil::AppendFile::Options raw;
+  raw.rawFd = true;
+  raw.bufferSize = 1024 * 1024;
+  bench("raw", path, totalBytes, raw);
+
+  managed.rawFd = true;
+  managed.bufferSize = 1024 * 1024;
+  bench("raw prealloc dropbehind", path, totalBytes, managed);
+
+  managed.fsyncBytes = 64 * kMegaBytes;
+  bench("raw ... fsync every 64MB", path, totalBytes, managed);
+}
@@ -0,0 +1,144 @@
+#include "../AsyncFileWriter.h"
+#include "../LogFile.h"
+#include "../LogStream.h"
+#include "../Thread.h"
+#include "../Timestamp.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+using namespace muduo;
+
+typedef detail::FixedBuffer<detail::kLargeBuffer> Buffer;
+
+std::atomic<bool> g_running(false);
+
+// 旁边的进程不停地write + fsync，制造一块慢盘
+void fsyncLoad() {
+  int fd = ::open("asyncfilewriter_bench.load", O_WRONLY | O_CREAT | O_TRUNC,
+                  0644);
+  string chunk(1024 * 1024, 'L');
+  int64_t written = 0;
+  while (g_running) {
+    ssize_t n = ::write(fd, chunk.data(), chunk.size());
+    (void)n;
+    ::fdatasync(fd);
+    written += static_cast<int64_t>(chunk.size());
+    if (written > 256 * 1024 * 1024) {
+      ::ftruncate(fd, 0);
+      ::lseek(fd, 0, SEEK_SET);
+      written = 0;
+    }
+  }
+  ::close(fd);
+  ::unlink("asyncfilewriter_bench.load");
+}
+
+/**
+ * @brief 可复用的buffer，异步写完之后才能再次使用
+ *
+ */
+class BufferPool : noncopyable {
+public:
+  explicit BufferPool(int size) : mutex_(), cond_(mutex_) {
+    string line(99, 'X');
+    line += '\n';
+    for (int i = 0; i < size; ++i) {
+      Buffer *buffer = new Buffer;
+      while (buffer->avail() > static_cast<int>(line.size())) {
+        buffer->append(line.data(), line.size());
+      }
+      all_.emplace_back(buffer);
+      free_.push_back(buffer);
+    }
+  }
+
+  Buffer *take() {
+    MutexLockGuard lock(mutex_);
+    while (free_.empty()) {
+      cond_.wait();
+    }
+    Buffer *buffer = free_.back();
+    free_.pop_back();
+    return buffer;
+  }
+
+  void put(Buffer *buffer) {
+    MutexLockGuard lock(mutex_);
+    free_.push_back(buffer);
+    cond_.notify();
+  }
+
+private:
+  MutexLock mutex_;
+  Condition cond_ GUARDED_BY(mutex_);
+  std::vector<std::unique_ptr<Buffer>> all_;
+  std::vector<Buffer *> free_ GUARDED_BY(mutex_);
+};
+
+/**
+ * @brief 模拟AsyncLogging后端每轮写一块4MB的buffer再flush，
+ *        统计每轮后端线程被阻塞的时间
+ *
+ * @param writer 为NULL时使用同步的LogFile
+ */
+void bench(const char *type, AsyncFileWriter *writer, int rounds) {
+  BufferPool pool(8);
+  std::vector<double> stalls;
+  stalls.reserve(rounds);
+  {
+    LogFile output(type, 1000 * 1000 * 1000, false, 3, 1024, writer);
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < rounds; ++i) {
+      Timestamp begin(Timestamp::now());
+      Buffer *buffer = pool.take();
+      output.appendAsync(buffer->data(), static_cast<size_t>(buffer->length()),
+                         std::bind(&BufferPool::put, &pool, buffer));
+      output.flush();
+      stalls.push_back(timeDifference(Timestamp::now(), begin) * 1e3);
+      // 前端大约每20ms写满一块buffer
+      ::usleep(20 * 1000);
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+    std::sort(stalls.begin(), stalls.end());
+    printf("%22s: p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms  %6.2fs\n", type,
+           stalls[stalls.size() / 2], stalls[stalls.size() * 99 / 100],
+           stalls.back(), seconds);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int rounds = argc > 1 ? atoi(argv[1]) : 300;
+  bool load = argc > 2 ? atoi(argv[2]) != 0 : true;
+  printf("%d rounds of 4MB, fsync load %s\n", rounds, load ? "on" : "off");
+
+  g_running = load;
+  Thread loader(fsyncLoad, "fsyncLoad");
+  if (load) {
+    loader.start();
+  }
+
+  bench("logfile_sync", NULL, rounds);
+  {
+    AsyncFileWriter writer(4, AsyncFileWriter::kThreadPool);
+    bench("async_threadpool", &writer, rounds);
+  }
+  {
+    AsyncFileWriter writer(4, AsyncFileWriter::kIoUring);
+    bench(writer.backend() == AsyncFileWriter::kIoUring ? "async_io_uring"
+                                                        : "async_io_uring(n/a)",
+          &writer, rounds);
+  }
+
+  g_running = false;
+  if (load) {
+    loader.join();
+  }
+}
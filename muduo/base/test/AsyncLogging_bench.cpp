@@ -0,0 +1,63 @@
+#include "../AsyncLogging.h"
+#include "../CountDownLatch.h"
+#include "../Logging.h"
+#include "../Thread.h"
+#include "../Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace muduo;
+
+AsyncLogging *g_asyncLog = NULL;
+
+void asyncOutput(const char *msg, int len) { g_asyncLog->append(msg, len); }
+
+void logInThread(int lines, CountDownLatch *startLatch) {
+  startLatch->wait();
+  for (int i = 0; i < lines; ++i) {
+    LOG_INFO << "Hello 0123456789"
+             << " abcdefghijklmnopqrstuvwxyz " << i;
+  }
+}
+
+// 多个前端线程同时写日志，统计前端每秒能写入多少行
+double bench(AsyncLogging::FrontEnd frontEnd, int numThreads, int totalLines) {
+  AsyncLogging log("asynclogging_bench", 500 * 1000 * 1000, 3, frontEnd);
+  log.start();
+  g_asyncLog = &log;
+
+  int linesPerThread = totalLines / numThreads;
+  CountDownLatch startLatch(1);
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int i = 0; i < numThreads; ++i) {
+    threads.emplace_back(
+        new Thread(std::bind(logInThread, linesPerThread, &startLatch)));
+    threads.back()->start();
+  }
+
+  Timestamp start(Timestamp::now());
+  startLatch.countDown();
+  for (auto &thr : threads) {
+    thr->join();
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+
+  log.stop();
+  g_asyncLog = NULL;
+  return linesPerThread * numThreads / seconds;
+}
+
+int main(int argc, char *argv[]) {
+  int totalLines = argc > 1 ? atoi(argv[1]) : 1000 * 1000;
+  Logger::setOutput(asyncOutput);
+
+  printf("%8s %16s %16s\n", "threads", "shared lines/s", "local lines/s");
+  for (int numThreads = 1; numThreads <= 32; numThreads *= 2) {
+    double shared = bench(AsyncLogging::kSharedBuffer, numThreads, totalLines);
+    double local =
+        bench(AsyncLogging::kThreadLocalBuffer, numThreads, totalLines);
+    printf("%8d %16.0f %16.0f\n", numThreads, shared, local);
+  }
+}
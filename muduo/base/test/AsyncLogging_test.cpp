@@ -0,0 +1,153 @@
+#include "../AsyncLogging.h"
+#include "../FileUtil.h"
+#include "../Logging.h"
+#include "../Thread.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
+using namespace muduo;
+
+AsyncLogging *g_asyncLog = NULL;
+int g_failures = 0;
+
+const int kThreads = 4;
+const int kLinesPerThread = 20 * 1000;
+const int64_t kTotalLines = kThreads * kLinesPerThread;
+const int64_t kImportantLines = kTotalLines / 10;
+
+// Release版本中assert不起作用，失败时计数，main返回非0
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+      ++g_failures;                                                            \
+    }                                                                          \
+  } while (0)
+
+struct LineCounts {
+  int64_t lines;     // 本测试写的日志行
+  int64_t important; // 其中WARN级别的行
+};
+
+bool contains(StringPiece line, const char *str) {
+  return ::memmem(line.data(), static_cast<size_t>(line.size()), str,
+                  strlen(str)) != NULL;
+}
+
+// 统计当前目录下本进程写的basename.*文件中的日志行，之后删除这些文件
+LineCounts countAndRemove(const string &basename) {
+  LineCounts counts = {0, 0};
+  string prefix = basename + '.';
+  string suffix = '.' + std::to_string(::getpid()) + ".log";
+  DIR *dir = ::opendir(".");
+  while (struct dirent *entry = ::readdir(dir)) {
+    string name(entry->d_name);
+    if (name.compare(0, prefix.size(), prefix) != 0 ||
+        name.size() < suffix.size() ||
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+      continue;
+    }
+    {
+      FileUtil::MappedFile file(name);
+      FileUtil::MappedFile::LineIterator it = file.lines();
+      StringPiece line;
+      while (it.next(&line)) {
+        // 过载时后端写入的提示行没有源文件名
+        if (contains(line, " - AsyncLogging_test.cpp:")) {
+          ++counts.lines;
+          if (contains(line, "important")) {
+            ++counts.important;
+          }
+        }
+      }
+    }
+    ::unlink(name.c_str());
+  }
+  ::closedir(dir);
+  return counts;
+}
+
+void asyncOutput(const char *msg, int len) { g_asyncLog->append(msg, len); }
+
+void burst() {
+  muduo::string longStr(3000, 'X');
+  for (int i = 0; i < kLinesPerThread; ++i) {
+    if (i % 10 == 0) {
+      LOG_WARN << "important " << i;
+    } else {
+      LOG_INFO << longStr << i;
+    }
+  }
+}
+
+// 用很小的待写上限制造过载，观察各种策略的计数
+void test(const char *name, AsyncLogging::OverloadPolicy policy) {
+  char basename[64];
+  snprintf(basename, sizeof basename, "asynclogging_test_%s", name);
+  AsyncLogging log(basename, 500 * 1000 * 1000);
+  log.setOverloadPolicy(policy);
+  log.setMaxPendingBuffers(2);
+  log.setKeepBuffersOnDrop(1);
+  log.setBufferPoolSize(4);
+  log.setBlockTimeout(0.5);
+  log.start();
+  g_asyncLog = &log;
+
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back(new Thread(burst));
+    threads.back()->start();
+  }
+  for (auto &thr : threads) {
+    thr->join();
+  }
+  log.stop();
+  g_asyncLog = NULL;
+
+  AsyncLogging::Stats stats = log.stats();
+  printf("%-16s dropped %" PRId64 " bytes %" PRId64 " lines, blocked %" PRId64
+         " times %.3f ms, spilled %" PRId64 " bytes\n",
+         name, stats.droppedBytes, stats.droppedLines, stats.blockedTimes,
+         static_cast<double>(stats.blockedNanoseconds) / 1e6,
+         stats.spilledBytes);
+
+  // 写入日志文件（和basename.spill.*文件）的行数加上丢弃的行数等于写的总行数
+  LineCounts counts = countAndRemove(basename);
+  if (policy == AsyncLogging::kSpillToFile) {
+    CHECK(stats.droppedLines == 0 && stats.droppedBytes == 0);
+  } else {
+    CHECK(stats.spilledBytes == 0);
+  }
+  CHECK(counts.lines + stats.droppedLines == kTotalLines);
+  CHECK((stats.droppedLines == 0) == (stats.droppedBytes == 0));
+  if (policy == AsyncLogging::kDropByLevel) {
+    CHECK(counts.important == kImportantLines);
+  }
+  if (policy != AsyncLogging::kBlockProducers) {
+    CHECK(stats.blockedTimes == 0);
+  }
+}
+
+int main() {
+  const char *line = "20220101 08:00:00.123456Z  1234 WARN  hello - a.cc:1\n";
+  Logger::LogLevel level = Logger::TRACE;
+  bool ok = Logger::parseLogLevel(line, static_cast<int>(strlen(line)), &level);
+  CHECK(ok && level == Logger::WARN);
+
+  Logger::setOutput(asyncOutput);
+  test("drop_buffers", AsyncLogging::kDropBuffers);
+  test("block", AsyncLogging::kBlockProducers);
+  test("drop_by_level", AsyncLogging::kDropByLevel);
+  test("spill", AsyncLogging::kSpillToFile);
+  if (g_failures > 0) {
+    fprintf(stderr, "%d checks failed\n", g_failures);
+    return 1;
+  }
+  puts("PASS");
+}
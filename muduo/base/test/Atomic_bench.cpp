@@ -0,0 +1,86 @@
+#include "../Atomic.h"
+#include "../Thread.h"
+#include "../Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <memory>
+#include <vector>
+
+using namespace muduo;
+
+// 原来的get()：用CAS读，每次读都要独占cache line
+int64_t legacyGet(volatile int64_t *value) {
+  return __sync_val_compare_and_swap(value, 0, 0);
+}
+
+// nthreads个线程各执行ops次f(i)，返回每次操作的纳秒数
+template <typename F> double bench(int nthreads, int ops, F f) {
+  std::vector<std::unique_ptr<Thread>> threads;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < nthreads; ++i) {
+    threads.emplace_back(new Thread([i, ops, &f] {
+      for (int j = 0; j < ops; ++j) {
+        f(i);
+      }
+    }));
+    threads.back()->start();
+  }
+  for (auto &thr : threads) {
+    thr->join();
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  return seconds * 1e9 / ops / nthreads;
+}
+
+int main(int argc, char **argv) {
+  int ops = argc > 1 ? atoi(argv[1]) : 10 * 1000 * 1000;
+  const int kMaxThreads = 8;
+  volatile int64_t legacy = 0;
+  AtomicInt64 shared;
+  AtomicInt64 unpadded[kMaxThreads];
+  static PaddedAtomicInt64 padded[kMaxThreads];
+  StripedCounter striped;
+  std::atomic<int64_t> sink(0);
+
+  printf("read, ns/op (each thread also increments every 16th op)\n");
+  printf("%8s %10s %10s %10s\n", "threads", "CAS get", "get()", "relaxed");
+  for (int n = 1; n <= kMaxThreads; n *= 2) {
+    double cas = bench(n, ops, [&](int) {
+      int64_t v = legacyGet(&legacy);
+      if ((v & 15) == 0) {
+        __sync_fetch_and_add(&legacy, 1);
+      }
+      sink.store(v, std::memory_order_relaxed);
+    });
+    double seqCst = bench(n, ops, [&](int) {
+      int64_t v = shared.get();
+      if ((v & 15) == 0) {
+        shared.increment();
+      }
+      sink.store(v, std::memory_order_relaxed);
+    });
+    double relaxed = bench(n, ops, [&](int) {
+      int64_t v = shared.getRelaxed();
+      if ((v & 15) == 0) {
+        shared.addRelaxed(1);
+      }
+      sink.store(v, std::memory_order_relaxed);
+    });
+    printf("%8d %10.2f %10.2f %10.2f\n", n, cas, seqCst, relaxed);
+  }
+
+  printf("increment, ns/op\n");
+  printf("%8s %10s %10s %10s %10s\n", "threads", "shared", "unpadded",
+         "padded", "striped");
+  for (int n = 1; n <= kMaxThreads; n *= 2) {
+    double s = bench(n, ops, [&](int) { shared.increment(); });
+    double u = bench(n, ops, [&](int i) { unpadded[i].addRelaxed(1); });
+    double p = bench(n, ops, [&](int i) { padded[i].addRelaxed(1); });
+    double t = bench(n, ops, [&](int) { striped.increment(); });
+    printf("%8d %10.2f %10.2f %10.2f %10.2f\n", n, s, u, p, t);
+  }
+  printf("striped counter: %d stripes, total %lld\n", striped.stripes(),
+         static_cast<long long>(striped.get()));
+}
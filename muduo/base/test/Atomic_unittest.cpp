@@ -35,6 +35,30 @@ int main(int argc, char **argv) {
     assert(a1.get() == 100);
   }
 
+  {
+    muduo::AtomicInt32 a2;
+    a2.set(7, std::memory_order_release);
+    assert(a2.getAcquire() == 7);
+    a2.addRelaxed(3);
+    assert(a2.getRelaxed() == 10);
+    assert(a2.getAndAdd(1, std::memory_order_relaxed) == 10);
+    a2.setRelease(-1);
+    assert(a2.get(std::memory_order_acquire) == -1);
+
+    static muduo::PaddedAtomicInt64 padded[2];
+    static_assert(sizeof(muduo::PaddedAtomicInt64) == 64, "one cache line");
+    assert(reinterpret_cast<uintptr_t>(&padded[1]) % 64 == 0);
+    padded[1].increment();
+    assert(padded[1].get() == 1);
+
+    muduo::StripedCounter striped(3);
+    assert(striped.stripes() == 4);
+    striped.increment();
+    striped.add(10);
+    striped.decrement();
+    assert(striped.get() == 10);
+  }
+
   {
     muduo::AtomicInt64 a1;
     a1.get();
@@ -0,0 +1,95 @@
+#include "../BinaryLogging.h"
+#include "../AsyncLogging.h"
+#include "../Thread.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include <vector>
+
+using namespace muduo;
+
+MutexLock g_mutex;
+string g_raw; // BinaryLogger输出的原始字节流
+
+void captureOutput(const char *data, int len) {
+  MutexLockGuard lock(g_mutex);
+  g_raw.append(data, static_cast<size_t>(len));
+}
+
+void logInThread(int n) {
+  for (int i = 0; i < n; ++i) {
+    BINLOG_INFO("thread {} line {}", CurrentThread::tid(), i);
+  }
+  // 线程退出时自动输出剩余的记录
+}
+
+AsyncLogging *g_asyncLog = NULL;
+
+void asyncBinaryOutput(const char *data, int len) {
+  g_asyncLog->appendBinary(data, len);
+}
+
+int main() {
+  BinaryLogger::setOutput(captureOutput);
+
+  string str("a string");
+  int x = 0;
+  BINLOG_INFO("int {} uint {} int64 {} uint64 {}", -42, 42u, -(int64_t(1) << 40),
+              uint64_t(1) << 63);
+  BINLOG_WARN("double {} char {} bool {} pointer {}", 3.25, 'c', true, &x);
+  BINLOG_ERROR("cstr {} string {} piece {}", "hello", str, StringPiece("sp"));
+  BINLOG_INFO("no args");
+  BINLOG_DEBUG("filtered {}", 1); // 默认级别为INFO
+  BinaryLogger::flush();
+
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int i = 0; i < 3; ++i) {
+    threads.emplace_back(new Thread(std::bind(logInThread, 10000)));
+    threads.back()->start();
+  }
+  for (auto &thr : threads) {
+    thr->join();
+  }
+
+  BinaryLogDecoder decoder;
+  string text;
+  size_t n = decoder.decode(g_raw.data(), g_raw.size(), &text);
+  assert(n == g_raw.size() && !decoder.error());
+  (void)n;
+
+  int lines = 0;
+  size_t start = 0;
+  for (size_t end = text.find('\n'); end != string::npos;
+       start = end + 1, end = text.find('\n', start)) {
+    Logger::LogLevel level = Logger::TRACE;
+    bool ok = Logger::parseLogLevel(text.data() + start,
+                                    static_cast<int>(end - start), &level);
+    assert(ok && level >= Logger::INFO);
+    (void)ok;
+    if (lines < 4) {
+      fwrite(text.data() + start, 1, end - start + 1, stdout);
+    }
+    ++lines;
+  }
+  assert(lines == 4 + 3 * 10000);
+  assert(text.find("int -42 uint 42 int64 -1099511627776 "
+                   "uint64 9223372036854775808 - BinaryLogging_test.cpp") !=
+         string::npos);
+  assert(text.find("double 3.25 char c bool 1 pointer 0x") != string::npos);
+  assert(text.find("cstr hello string a string piece sp") != string::npos);
+  assert(text.find("INFO  no args - ") != string::npos);
+  assert(text.find("filtered") == string::npos);
+  printf("%d lines, %zd bytes binary, %zd bytes text\n", lines, g_raw.size(),
+         text.size());
+
+  // 交给AsyncLogging的后端线程解码
+  AsyncLogging log("binarylogging_test", 500 * 1000 * 1000);
+  log.start();
+  g_asyncLog = &log;
+  BinaryLogger::setOutput(asyncBinaryOutput);
+  logInThread(1000);
+  BinaryLogger::flush();
+  log.stop();
+  g_asyncLog = NULL;
+}
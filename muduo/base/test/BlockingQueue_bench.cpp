@@ -1,4 +1,6 @@
 #include "../BlockingQueue.h"
+#include "../BoundedBlockingQueue.h"
+#include "../BoundedMPMCQueue.h"
 #include "../CountDownLatch.h"
 #include "../Thread.h"
 #include "../Timestamp.h"
@@ -6,7 +8,9 @@
 #include <iostream>
 #include <map>
 #include <stdio.h>
+#include <string.h>
 #include <string>
+#include <time.h>
 #include <unistd.h>
 #include <vector>
 
@@ -82,12 +86,157 @@ private:
   vector<unique_ptr<muduo::Thread>> threads_;
 };
 
+int64_t nowNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// 按2的幂分桶的延迟直方图，第i个桶是[2^(i-1), 2^i)纳秒
+struct LatencyHistogram {
+  static const int kBuckets = 40;
+  int64_t counts[kBuckets];
+
+  LatencyHistogram() { memset(counts, 0, sizeof counts); }
+
+  void add(int64_t nanos) {
+    int i = nanos > 0 ? 64 - __builtin_clzll(static_cast<uint64_t>(nanos)) : 0;
+    ++counts[i < kBuckets ? i : kBuckets - 1];
+  }
+
+  void merge(const LatencyHistogram &rhs) {
+    for (int i = 0; i < kBuckets; ++i) {
+      counts[i] += rhs.counts[i];
+    }
+  }
+
+  // 返回百分位数所在桶的上界
+  int64_t percentile(double p) const {
+    int64_t total = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+      total += counts[i];
+    }
+    int64_t target = static_cast<int64_t>(static_cast<double>(total) * p);
+    int64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+      seen += counts[i];
+      if (seen > target) {
+        return int64_t(1) << i;
+      }
+    }
+    return int64_t(1) << (kBuckets - 1);
+  }
+
+  void print() const {
+    printf("    histogram(ns):");
+    for (int i = 0; i < kBuckets; ++i) {
+      if (counts[i]) {
+        printf(" <%lld:%lld", 1LL << i, static_cast<long long>(counts[i]));
+      }
+    }
+    printf("\n");
+  }
+};
+
+template <typename Queue> Queue *newQueue(int capacity) {
+  return new Queue(capacity);
+}
+
+template <>
+muduo::BlockingQueue<int64_t> *newQueue<muduo::BlockingQueue<int64_t>>(int) {
+  return new muduo::BlockingQueue<int64_t>;
+}
+
+/**
+ * @brief producers个线程各放入perProducer个发送时间，consumers个线程取出，
+ *        统计吞吐量和从put到take的延迟
+ *
+ */
+template <typename Queue>
+void benchQueue(const char *name, int producers, int consumers,
+                int perProducer) {
+  std::unique_ptr<Queue> queue(newQueue<Queue>(1024));
+  std::vector<LatencyHistogram> histograms(consumers);
+  muduo::CountDownLatch ready(producers + consumers);
+  muduo::CountDownLatch go(1);
+
+  vector<unique_ptr<muduo::Thread>> threads;
+  for (int i = 0; i < consumers; ++i) {
+    LatencyHistogram *histogram = &histograms[i];
+    threads.emplace_back(new muduo::Thread([&queue, &ready, histogram] {
+      ready.countDown();
+      for (;;) {
+        int64_t sent = queue->take();
+        if (sent < 0) {
+          break;
+        }
+        histogram->add(nowNanos() - sent);
+      }
+    }));
+  }
+  for (int i = 0; i < producers; ++i) {
+    threads.emplace_back(
+        new muduo::Thread([&queue, &ready, &go, perProducer] {
+          ready.countDown();
+          go.wait();
+          for (int j = 0; j < perProducer; ++j) {
+            queue->put(nowNanos());
+          }
+        }));
+  }
+  for (auto &thr : threads) {
+    thr->start();
+  }
+  ready.wait();
+
+  int64_t start = nowNanos();
+  go.countDown();
+  for (int i = consumers; i < consumers + producers; ++i) {
+    threads[i]->join();
+  }
+  for (int i = 0; i < consumers; ++i) {
+    queue->put(-1);
+  }
+  for (int i = 0; i < consumers; ++i) {
+    threads[i]->join();
+  }
+  double seconds = static_cast<double>(nowNanos() - start) / 1e9;
+
+  LatencyHistogram all;
+  for (const auto &h : histograms) {
+    all.merge(h);
+  }
+  int64_t items = static_cast<int64_t>(producers) * perProducer;
+  printf("%-22s %2dP%2dC %8.2f Mops/s  latency(ns) p50 <%lld p99 <%lld "
+         "p999 <%lld\n",
+         name, producers, consumers, static_cast<double>(items) / seconds / 1e6,
+         static_cast<long long>(all.percentile(0.5)),
+         static_cast<long long>(all.percentile(0.99)),
+         static_cast<long long>(all.percentile(0.999)));
+  all.print();
+}
+
 int main(int argc, char **argv) {
-  int threads = 5;
+  if (argc > 1 && strcmp(argv[1], "-d") == 0) {
+    // 原来的测试：每毫秒放入一个时间戳，打印每个消费者的延迟分布
+    int threads = 5;
+
+    Bench t(threads); // 创建threads个线程，并且绑定函数
+    t.run(10000);
+    t.joinAll();
+    return 0;
+  }
 
-  Bench t(threads); // 创建threads个线程，并且绑定函数
-  t.run(10000);
-  t.joinAll();
+  const int kItems = argc > 1 ? atoi(argv[1]) : 1000000;
+  const int kConfigs[] = {1, 4, 16};
+  for (int n : kConfigs) {
+    benchQueue<muduo::BlockingQueue<int64_t>>("BlockingQueue", n, n,
+                                              kItems / n);
+    benchQueue<muduo::BoundedBlockingQueue<int64_t>>("BoundedBlockingQueue", n,
+                                                     n, kItems / n);
+    benchQueue<muduo::BoundedMPMCQueue<int64_t>>("BoundedMPMCQueue", n, n,
+                                                 kItems / n);
+  }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,81 @@
+#include "../BoundedMPMCQueue.h"
+#include "../Thread.h"
+
+#include <assert.h>
+#include <stdio.h>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
+#include <memory>
+#include <vector>
+
+using namespace muduo;
+
+// 容量很小，生产者和消费者都会经常阻塞
+void testProducersConsumers(int producers, int consumers, int perProducer) {
+  BoundedMPMCQueue<int64_t> queue(4);
+  std::atomic<int64_t> sum(0);
+  std::atomic<int64_t> count(0);
+
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int i = 0; i < consumers; ++i) {
+    threads.emplace_back(new Thread([&] {
+      for (;;) {
+        int64_t x = queue.take();
+        if (x < 0) {
+          break;
+        }
+        sum += x;
+        ++count;
+      }
+    }));
+  }
+  for (int i = 0; i < producers; ++i) {
+    threads.emplace_back(new Thread([&queue, i, perProducer] {
+      for (int j = 1; j <= perProducer; ++j) {
+        queue.put(static_cast<int64_t>(i) * perProducer + j);
+      }
+    }));
+  }
+  for (auto &thr : threads) {
+    thr->start();
+  }
+  for (int i = consumers; i < consumers + producers; ++i) {
+    threads[i]->join();
+  }
+  for (int i = 0; i < consumers; ++i) {
+    queue.put(-1);
+  }
+  for (int i = 0; i < consumers; ++i) {
+    threads[i]->join();
+  }
+
+  int64_t n = static_cast<int64_t>(producers) * perProducer;
+  printf("%dP%dC: took %" PRId64 ", sum %" PRId64 "\n", producers, consumers,
+         count.load(), sum.load());
+  assert(count == n);
+  assert(sum == n * (n + 1) / 2);
+  assert(queue.empty());
+  (void)n;
+}
+
+void testMove() {
+  BoundedMPMCQueue<std::unique_ptr<int>> queue(3);
+  assert(queue.capacity() == 4);
+  queue.put(std::unique_ptr<int>(new int(42)));
+  queue.put(std::unique_ptr<int>(new int(43)));
+  assert(queue.size() == 2);
+  std::unique_ptr<int> x = queue.take();
+  assert(*x == 42);
+  (void)x;
+  // 剩下的元素由析构函数释放
+}
+
+int main() {
+  testMove();
+  testProducersConsumers(1, 1, 200000);
+  testProducersConsumers(4, 4, 50000);
+  testProducersConsumers(8, 2, 20000);
+  testProducersConsumers(2, 8, 50000);
+  puts("PASS");
+}
@@ -0,0 +1,101 @@
+#include "../Clock.h"
+#include "../Timestamp.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace muduo;
+
+uint64_t g_sink = 0;
+
+// 每次调用的纳秒数
+template <typename F> double nsPerCall(const char *name, int n, F f) {
+  MonotonicTime start(MonotonicTime::now());
+  for (int i = 0; i < n; ++i) {
+    g_sink += static_cast<uint64_t>(f());
+  }
+  double ns = timeDifference(MonotonicTime::now(), start) * 1e9 / n;
+  printf("%-28s %8.2f ns\n", name, ns);
+  return ns;
+}
+
+int64_t gettimeofdayMicroseconds() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<int64_t>(tv.tv_sec) * Timestamp::kMicroSecondsPerSecond +
+         tv.tv_usec;
+}
+
+void benchSources(int n) {
+  nsPerCall("gettimeofday", n, gettimeofdayMicroseconds);
+  const Clock::Source kSources[] = {Clock::kRealtime, Clock::kRealtimeCoarse,
+                                    Clock::kTsc};
+  const char *kNames[] = {"now() realtime", "now() realtime coarse",
+                          "now() tsc"};
+  for (int i = 0; i < 3; ++i) {
+    if (Clock::setSource(kSources[i]) != kSources[i]) {
+      printf("%-28s unavailable\n", kNames[i]);
+      continue;
+    }
+    nsPerCall(kNames[i], n,
+              [] { return Timestamp::now().microSecondsSinceEpoch(); });
+    nsPerCall("  MonotonicTime::now()", n,
+              [] { return MonotonicTime::now().nanoseconds(); });
+  }
+  nsPerCall("cachedNow()", n,
+            [] { return Clock::cachedNow().microSecondsSinceEpoch(); });
+  Clock::setSource(Clock::kRealtime);
+}
+
+// TSC时钟与系统时钟的偏差，每100ms采样一次；同时检查不倒退
+void testDrift(int seconds) {
+  if (Clock::setSource(Clock::kTsc) != Clock::kTsc) {
+    printf("invariant TSC unavailable, skip drift test\n");
+    return;
+  }
+  printf("TSC %.3f GHz, drift against gettimeofday:\n", Clock::tscGhz());
+  int64_t maxDrift = 0;
+  int64_t last = 0;
+  int backwards = 0;
+  for (int i = 0; i < seconds * 10; ++i) {
+    int64_t before = gettimeofdayMicroseconds();
+    int64_t tsc = Clock::nowMicroseconds();
+    int64_t after = gettimeofdayMicroseconds();
+    int64_t drift =
+        tsc < before ? before - tsc : (tsc > after ? tsc - after : 0);
+    maxDrift = drift > maxDrift ? drift : maxDrift;
+    backwards += tsc < last;
+    last = tsc;
+    if (i % 10 == 9) {
+      printf("  %2ds: drift %lld us, max %lld us\n", (i + 1) / 10,
+             static_cast<long long>(drift), static_cast<long long>(maxDrift));
+    }
+    // 期间不断读取，触发重新同步
+    for (int j = 0; j < 1000; ++j) {
+      int64_t t = Clock::nowMicroseconds();
+      backwards += t < last;
+      last = t;
+    }
+    ::usleep(100 * 1000);
+  }
+  printf("went backwards %d times\n", backwards);
+  // 每秒重新同步一次，偏差应该在1ms以内
+  assert(maxDrift < 1000);
+  assert(backwards == 0);
+  Clock::setSource(Clock::kRealtime);
+}
+
+int main(int argc, char **argv) {
+  int seconds = argc > 1 ? atoi(argv[1]) : 5;
+  MonotonicTime a = MonotonicTime::now();
+  MonotonicTime b = MonotonicTime::now();
+  assert(!(b < a));
+  (void)a;
+  (void)b;
+  benchSources(10 * 1000 * 1000);
+  testDrift(seconds);
+  printf("sink %llu\n", static_cast<unsigned long long>(g_sink % 10));
+}
@@ -1,11 +1,179 @@
+#include "../AsyncFileWriter.h"
 #include "../FileUtil.h"
 
+#include <assert.h>
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
+#include <vector>
+
 using namespace muduo;
 
+// 按'\n'切分，与MappedFile::LineIterator对比
+std::vector<string> splitLines(const string &content) {
+  std::vector<string> lines;
+  size_t start = 0;
+  while (start < content.size()) {
+    size_t end = content.find('\n', start);
+    if (end == string::npos) {
+      end = content.size();
+    }
+    lines.push_back(content.substr(start, end - start));
+    start = end + 1;
+  }
+  return lines;
+}
+
+void testMappedFile(const string &content, int options) {
+  char path[] = "/tmp/mappedfile_testXXXXXX";
+  int fd = ::mkstemp(path);
+  assert(fd >= 0);
+  ssize_t n = ::write(fd, content.data(), content.size());
+  assert(n == static_cast<ssize_t>(content.size()));
+  ::close(fd);
+  (void)n;
+
+  FileUtil::MappedFile file(path, options);
+  assert(file.valid());
+  assert(file.size() == content.size());
+  assert(string(file.data(), file.size()) == content);
+  assert(content.size() < 4 || file.slice(1, 3) == content.substr(1, 3));
+  assert(file.slice(content.size(), 1).empty());
+
+  std::vector<string> expected = splitLines(content);
+  FileUtil::MappedFile::LineIterator it = file.lines();
+  StringPiece line;
+  size_t count = 0;
+  while (it.next(&line)) {
+    assert(count < expected.size());
+    assert(line == expected[count]);
+    ++count;
+  }
+  assert(count == expected.size());
+  ::unlink(path);
+}
+
+void testMappedFile() {
+  testMappedFile("", 0);
+  testMappedFile("\n", 0);
+  testMappedFile("\n\n\nabc", 0);
+  testMappedFile("no newline", 0);
+  // 各种长度的行，跨越扫描块的边界
+  string content;
+  unsigned seed = 1;
+  for (int i = 0; i < 5000; ++i) {
+    content.append(static_cast<size_t>(rand_r(&seed) % 100),
+                   static_cast<char>('a' + i % 26));
+    content += '\n';
+  }
+  testMappedFile(content, 0);
+  content += "tail";
+  testMappedFile(content, FileUtil::MappedFile::kPopulate);
+  testMappedFile(content, FileUtil::MappedFile::kSequential |
+                              FileUtil::MappedFile::kWillNeed);
+  testMappedFile(content, FileUtil::MappedFile::kHugePages);
+
+  FileUtil::MappedFile notExist("/notexist");
+  assert(notExist.error() == ENOENT);
+  FileUtil::MappedFile dir("/tmp");
+  assert(dir.error() == EISDIR);
+  StringPiece line;
+  assert(!dir.lines().next(&line));
+  printf("MappedFile OK\n");
+}
+
+void testAppendFile(const FileUtil::AppendFile::Options &options) {
+  char path[] = "/tmp/appendfile_testXXXXXX";
+  int fd = ::mkstemp(path);
+  assert(fd >= 0);
+  ::close(fd);
+
+  string expected = "existing\n";
+  {
+    FileUtil::AppendFile file(path);
+    file.append(expected.data(), expected.size());
+  }
+  {
+    FileUtil::AppendFile file(path, options);
+    unsigned seed = 2;
+    for (int i = 0; i < 20000; ++i) {
+      // 偶尔有比缓冲区还长的一块
+      size_t len = i % 1000 == 0 ? 100 * 1000
+                                 : static_cast<size_t>(rand_r(&seed) % 200);
+      string line(len, static_cast<char>('a' + i % 26));
+      line += '\n';
+      if (i % 100 == 0) {
+        struct iovec iov[2];
+        iov[0].iov_base = &line[0];
+        iov[0].iov_len = line.size() / 2;
+        iov[1].iov_base = &line[line.size() / 2];
+        iov[1].iov_len = line.size() - line.size() / 2;
+        file.appendv(iov, 2);
+      } else {
+        file.append(line.data(), line.size());
+      }
+      expected += line;
+      if (i % 5000 == 0) {
+        file.flush();
+      }
+    }
+    assert(file.writtenBytes() == static_cast<off_t>(expected.size() - 9));
+  }
+
+  FileUtil::MappedFile file(path);
+  assert(file.size() == expected.size());
+  assert(string(file.data(), file.size()) == expected);
+  // 没用到的预分配空间已经释放
+  struct stat statbuf;
+  ::stat(path, &statbuf);
+  assert(statbuf.st_blocks * 512 < static_cast<off_t>(expected.size()) +
+                                       1024 * 1024);
+  (void)statbuf;
+  ::unlink(path);
+}
+
+void testAppendFile() {
+  FileUtil::AppendFile::Options options;
+  testAppendFile(options);
+  options.preallocateBytes = 4 * 1024 * 1024;
+  options.dropBehindBytes = 256 * 1024;
+  testAppendFile(options);
+  options.fsyncBytes = 1024 * 1024;
+  options.fsyncOnFlush = true;
+  testAppendFile(options);
+  options.rawFd = true;
+  options.bufferSize = 5000; // 取整到页
+  testAppendFile(options);
+  options.preallocateBytes = 0;
+  options.dropBehindBytes = 0;
+  options.fsyncBytes = 0;
+  options.fsyncOnFlush = false;
+  testAppendFile(options);
+
+  // 打开失败时报错，之后的写入被忽略
+  FileUtil::AppendFile bad("/notexist/appendfile", options);
+  assert(!bad.valid());
+  bad.append("x", 1);
+  bad.flush();
+  assert(bad.writtenBytes() == 0);
+
+  // 异步版本同样忽略写入，但仍然调用done
+  AsyncFileWriter writer(1);
+  FileUtil::AsyncAppendFile badAsync("/notexist/appendfile", &writer);
+  assert(!badAsync.valid());
+  bool done = false;
+  badAsync.append("x", 1, [&done] { done = true; });
+  assert(done && badAsync.writtenBytes() == 0);
+  (void)done;
+  printf("AppendFile OK\n");
+}
+
 int main() {
   string result;
   int64_t size = 0;
@@ -25,4 +193,6 @@ int main() {
   printf("%d %zd %" PRIu64 "\n", err, result.size(), size);
   err = FileUtil::readFile("/dev/zero", 102400, &result, NULL);
   printf("%d %zd %" PRIu64 "\n", err, result.size(), size);
+  testMappedFile();
+  testAppendFile();
 }
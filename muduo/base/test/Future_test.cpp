@@ -0,0 +1,137 @@
+#include "../CountDownLatch.h"
+#include "../CurrentThread.h"
+#include "../ThreadPool.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace muduo;
+
+void testSubmit(ThreadPool &pool) {
+  Future<int> answer = pool.submit([] { return 42; });
+  assert(answer.valid());
+  assert(answer.get() == 42);
+  assert(!answer.valid());
+
+  std::atomic<int> called(0);
+  Future<void> done = pool.submit([&called] { ++called; });
+  done.get();
+  assert(called == 1);
+
+  // 只能移动的结果
+  Future<std::unique_ptr<int>> p =
+      pool.submit([] { return std::unique_ptr<int>(new int(7)); });
+  assert(*p.get() == 7);
+}
+
+void testThen(ThreadPool &pool) {
+  CountDownLatch gate(1);
+  int workerTid = 0;
+  Future<std::string> chained =
+      pool.submit([&gate, &workerTid] {
+            gate.wait();
+            workerTid = CurrentThread::tid();
+            return 20;
+          })
+          .then([](int x) { return x + 1; })
+          .then([&workerTid](int x) {
+            // 在完成前一个任务的线程上运行
+            assert(CurrentThread::tid() == workerTid);
+            return std::to_string(x * 2);
+          });
+  gate.countDown();
+  assert(chained.get() == "42");
+
+  // 已经就绪时在调用线程运行
+  Future<int> ready = pool.submit([] { return 1; });
+  ready.wait();
+  int callerTid = CurrentThread::tid();
+  int ranOn = 0;
+  ready.then([&ranOn](int) { ranOn = CurrentThread::tid(); }).get();
+  assert(ranOn == callerTid);
+  (void)ranOn;
+  (void)callerTid;
+}
+
+void testException(ThreadPool &pool) {
+  Future<int> failed =
+      pool.submit([]() -> int { throw std::runtime_error("boom"); })
+          .then([](int x) { return x + 1; });
+  bool caught = false;
+  try {
+    failed.get();
+  } catch (const std::runtime_error &e) {
+    caught = std::string(e.what()) == "boom";
+  }
+  assert(caught);
+  (void)caught;
+}
+
+void testBatch(ThreadPool &pool) {
+  const int kTasks = 1000;
+  std::atomic<int> sum(0);
+  CountDownLatch latch(kTasks);
+  std::vector<ThreadPool::Task> tasks;
+  for (int i = 1; i <= kTasks; ++i) {
+    tasks.push_back([&sum, &latch, i] {
+      sum += i;
+      latch.countDown();
+    });
+  }
+  pool.runBatch(tasks.begin(), tasks.end());
+  latch.wait();
+  assert(sum == kTasks * (kTasks + 1) / 2);
+}
+
+// 线程池stop时丢弃的任务
+void testDiscarded() {
+  ThreadPool pool("DiscardPool");
+  pool.start(1);
+  CountDownLatch started(1);
+  CountDownLatch gate(1);
+  pool.run([&started, &gate] {
+    started.countDown();
+    gate.wait();
+  });
+  started.wait();
+  Future<int> pending = pool.submit([] { return 1; });
+  // stop()先把running_设为false，再等正在运行的任务结束
+  ThreadPool *p = &pool;
+  Thread stopper([p] { p->stop(); });
+  stopper.start();
+  usleep(100 * 1000);
+  gate.countDown();
+  stopper.join();
+
+  bool caught = false;
+  try {
+    pending.get();
+  } catch (const Exception &) {
+    caught = true;
+  }
+  assert(caught);
+  (void)caught;
+}
+
+int main() {
+  const ThreadPool::Mode kModes[] = {ThreadPool::kSharedQueue,
+                                     ThreadPool::kWorkStealing};
+  for (ThreadPool::Mode mode : kModes) {
+    ThreadPool pool("FuturePool");
+    pool.setMode(mode);
+    pool.start(4);
+    testSubmit(pool);
+    testThen(pool);
+    testException(pool);
+    testBatch(pool);
+    pool.stop();
+  }
+  testDiscarded();
+  puts("PASS");
+}
@@ -0,0 +1,93 @@
+#include "../InlineTask.h"
+#include "../RingBuffer.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+
+using namespace muduo;
+
+typedef InlineTask<64> Task;
+
+void testInlineAndHeap() {
+  int x = 0;
+  Task small([&x] { ++x; });
+  assert(small.isInline());
+  small();
+  assert(x == 1);
+
+  char big[100] = {1};
+  Task large([&x, big] { x += big[0]; });
+  assert(!large.isInline());
+  large();
+  assert(x == 2);
+
+  Task moved(std::move(large));
+  assert(!large);
+  moved();
+  assert(x == 3);
+  (void)x;
+}
+
+// std::function放不下只能移动的可调用对象
+struct MoveOnly {
+  std::unique_ptr<int> p;
+  int *result;
+  void operator()() { *result = *p; }
+};
+
+void testMoveOnly() {
+  int result = 0;
+  MoveOnly f = {std::unique_ptr<int>(new int(42)), &result};
+  Task task(std::move(f));
+  assert(task.isInline());
+  Task other;
+  other = std::move(task);
+  other();
+  assert(result == 42);
+  (void)result;
+}
+
+void testNull() {
+  std::function<void()> empty;
+  void (*fp)() = NULL;
+  assert(!Task(empty));
+  assert(!Task(fp));
+  assert(!Task(nullptr));
+  (void)empty;
+  (void)fp;
+}
+
+// 反复放入取出，队头绕回缓冲区开头，并且中途扩容
+void testRingBuffer() {
+  RingBuffer<std::string> ring;
+  int next = 0;
+  int expected = 0;
+  for (int round = 0; round < 100; ++round) {
+    for (int i = 0; i < round; ++i) {
+      ring.push_back(std::to_string(next++));
+    }
+    for (int i = 0; i < round / 2; ++i) {
+      assert(ring.front() == std::to_string(expected));
+      ring.pop_front();
+      ++expected;
+    }
+  }
+  assert(ring.size() == static_cast<size_t>(next - expected));
+  assert(ring[0] == std::to_string(expected));
+  assert(ring.back() == std::to_string(next - 1));
+
+  RingBuffer<std::string> moved(std::move(ring));
+  assert(ring.empty());
+  assert(moved.size() == static_cast<size_t>(next - expected));
+}
+
+int main() {
+  testInlineAndHeap();
+  testMoveOnly();
+  testNull();
+  testRingBuffer();
+  puts("PASS");
+}
@@ -0,0 +1,84 @@
+#include "../LogFile.h"
+#include "../LogStream.h"
+#include "../Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include <memory>
+#include <vector>
+
+using namespace muduo;
+
+typedef detail::FixedBuffer<detail::kLargeBuffer> Buffer;
+
+// /proc/self/io中的syscw为进程累计的write类系统调用次数
+long writeSyscalls() {
+  long syscw = -1;
+  FILE *fp = fopen("/proc/self/io", "r");
+  if (fp) {
+    char line[256];
+    while (fgets(line, sizeof line, fp)) {
+      if (strncmp(line, "syscw:", 6) == 0) {
+        syscw = atol(line + 6);
+      }
+    }
+    fclose(fp);
+  }
+  return syscw;
+}
+
+// 模拟AsyncLogging后端：每批batch块4MB的buffer
+void bench(const char *type, bool vectored, int64_t totalBytes, int batch) {
+  std::vector<std::unique_ptr<Buffer>> buffers;
+  string line(99, 'X');
+  line += '\n';
+  for (int i = 0; i < batch; ++i) {
+    buffers.emplace_back(new Buffer);
+    while (buffers.back()->avail() > static_cast<int>(line.size())) {
+      buffers.back()->append(line.data(), line.size());
+    }
+  }
+
+  LogFile output(type, 1000 * 1000 * 1000, false);
+  long syscallsBefore = writeSyscalls();
+  Timestamp start(Timestamp::now());
+  int64_t written = 0;
+  std::vector<struct iovec> iov(batch);
+  while (written < totalBytes) {
+    if (vectored) {
+      for (int i = 0; i < batch; ++i) {
+        iov[i].iov_base = const_cast<char *>(buffers[i]->data());
+        iov[i].iov_len = buffers[i]->length();
+      }
+      output.appendv(iov.data(), batch);
+    } else {
+      for (const auto &buffer : buffers) {
+        output.append(buffer->data(), buffer->length());
+      }
+    }
+    for (const auto &buffer : buffers) {
+      written += buffer->length();
+    }
+    output.flush();
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  long syscalls = writeSyscalls() - syscallsBefore;
+
+  const double kGB = 1024.0 * 1024 * 1024;
+  printf("%14s: %8.2f MiB/s, %10.1f write syscalls/GiB\n", type,
+         static_cast<double>(written) / seconds / (1024 * 1024),
+         static_cast<double>(syscalls) / (static_cast<double>(written) / kGB));
+}
+
+int main(int argc, char *argv[]) {
+  // 默认每种方式写1GB
+  int64_t totalBytes = argc > 1 ? atoll(argv[1]) : 1024LL * 1024 * 1024;
+  int batch = argc > 2 ? atoi(argv[2]) : 4;
+  printf("%lld bytes per run, %d buffers per batch\n",
+         static_cast<long long>(totalBytes), batch);
+  bench("logfile_stdio", false, totalBytes, batch);
+  bench("logfile_writev", true, totalBytes, batch);
+}
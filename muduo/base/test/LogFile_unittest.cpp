@@ -0,0 +1,133 @@
+#include "../LogFile.h"
+#include "../Timestamp.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace muduo;
+
+std::vector<string> listDir() {
+  std::vector<string> names;
+  DIR *dir = opendir(".");
+  while (struct dirent *entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') {
+      names.push_back(entry->d_name);
+    }
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+bool endsWith(const string &str, const string &suffix) {
+  return str.size() >= suffix.size() &&
+         str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int main() {
+  char dir[] = "/tmp/logfile_test.XXXXXX";
+  if (!mkdtemp(dir) || chdir(dir) != 0) {
+    perror("mkdtemp");
+    return 1;
+  }
+
+  const int kRolls = 6;
+  string line(999, 'X');
+  line += '\n';
+  {
+    // 每写超过1000字节滚动一次，旧文件压缩后只保留最新的3个
+    LogFile output("logfile_test", 1000, false);
+    output.setCompress(true);
+    output.setRetention(3, 0);
+    for (int i = 0; i < kRolls; ++i) {
+      // 同一秒内不会再次滚动
+      usleep(1100 * 1000);
+      output.append(line.data(), static_cast<int>(line.size()));
+      Timestamp start(Timestamp::now());
+      output.append(line.data(), static_cast<int>(line.size())); // 滚动
+      printf("roll %d: %.1f us\n", i,
+             timeDifference(Timestamp::now(), start) * 1e6);
+    }
+  }
+
+  std::vector<string> names = listDir();
+  int compressed = 0;
+  int plain = 0;
+  for (const auto &name : names) {
+    printf("%s\n", name.c_str());
+    assert(name.compare(0, 13, "logfile_test.") == 0);
+    assert(name.find(".next.") == string::npos);
+    if (endsWith(name, ".log.gz")) {
+      ++compressed;
+    } else {
+      assert(endsWith(name, ".log"));
+      ++plain;
+    }
+  }
+  // 最后一次滚动之后的文件没有退役，不压缩
+  assert(compressed == 3 && plain == 1);
+  (void)compressed;
+  (void)plain;
+
+  for (const auto &name : names) {
+    unlink(name.c_str());
+  }
+
+  {
+    // 只预先打开：滚动时直接换上basename.next.*，析构时删除没有用到的临时文件
+    LogFile output("logfile_test", 1000, false);
+    output.setPreopen(true);
+    usleep(100 * 1000); // 等后台线程打开
+    names = listDir();
+    assert(names.size() == 2);
+    usleep(1100 * 1000);
+    output.append(line.data(), static_cast<int>(line.size()));
+    output.append(line.data(), static_cast<int>(line.size())); // 滚动
+    usleep(100 * 1000);
+    names = listDir();
+    int next = 0;
+    for (const auto &name : names) {
+      next += name.find(".next.") != string::npos;
+    }
+    assert(names.size() == 3 && next == 1);
+    (void)next;
+  }
+  names = listDir();
+  assert(names.size() == 2);
+  for (const auto &name : names) {
+    assert(name.find(".next.") == string::npos);
+    unlink(name.c_str());
+  }
+
+  {
+    // 不压缩也不删除旧文件时没有后台线程，不会预先打开basename.next.*
+    // 日志文件的AppendFile选项：不经过stdio，预分配，写回后丢掉page cache
+    FileUtil::AppendFile::Options options;
+    options.rawFd = true;
+    options.preallocateBytes = 1024 * 1024;
+    options.dropBehindBytes = 1024 * 1024;
+    LogFile output("logfile_test", 1000, false, 3, 1024, NULL, options);
+    output.append(line.data(), static_cast<int>(line.size()));
+    names = listDir();
+    assert(names.size() == 1 && names[0].find(".next.") == string::npos);
+  }
+  // 关闭时写出缓冲区并释放没有用到的预分配空间
+  struct stat st;
+  assert(stat(names[0].c_str(), &st) == 0 &&
+         st.st_size == static_cast<off_t>(line.size()) &&
+         st.st_blocks * 512 <= 64 * 1024);
+  (void)st;
+  for (const auto &name : listDir()) {
+    unlink(name.c_str());
+  }
+  chdir("/");
+  rmdir(dir);
+  puts("PASS");
+}
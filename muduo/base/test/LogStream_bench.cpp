@@ -1,4 +1,7 @@
+#include "../BinaryLogging.h"
 #include "../LogStream.h"
+#include "../Logging.h"
+#include "../StructuredLogging.h"
 #include "../Timestamp.h"
 
 #include <sstream>
@@ -12,14 +15,24 @@ const size_t N = 1000000;
 
 #pragma GCC diagnostic ignored "-Wold-style-cast"
 
+// 整数取值0..N，double取带小数的值，避免只测到整数这种最简单的情况
+template <typename T> T value(size_t i) { return (T)(i); }
+
+template <> double value<double>(size_t i) { return (double)(i) * 1.0001; }
+
+template <> uint64_t value<uint64_t>(size_t i) {
+  return UINT64_MAX - (uint64_t)(i);
+}
+
 template <typename T> void benchPrintf(const char *fmt) {
-  char buf[32];
+  char buf[64];
   Timestamp start(Timestamp::now());
   for (size_t i = 0; i < N; ++i)
-    snprintf(buf, sizeof buf, fmt, (T)(i));
+    snprintf(buf, sizeof buf, fmt, value<T>(i));
   Timestamp end(Timestamp::now());
 
-  printf("benchPrintf %f\n", timeDifference(end, start));
+  printf("%-18s %f (%5.1f ns/op)\n", "benchPrintf", timeDifference(end, start),
+         timeDifference(end, start) * 1e9 / N);
 }
 
 template <typename T> void benchStringStream() {
@@ -27,24 +40,70 @@ template <typename T> void benchStringStream() {
   std::ostringstream os;
 
   for (size_t i = 0; i < N; ++i) {
-    os << (T)(i);
+    os << value<T>(i);
     os.seekp(0, std::ios_base::beg); // beg : 序列的开始
   }
   Timestamp end(Timestamp::now());
 
-  printf("benchStringStream %f\n", timeDifference(end, start));
+  printf("%-18s %f (%5.1f ns/op)\n", "benchStringStream", timeDifference(end, start),
+         timeDifference(end, start) * 1e9 / N);
 }
 
 template <typename T> void benchLogStream() {
   Timestamp start(Timestamp::now());
   LogStream os;
   for (size_t i = 0; i < N; ++i) {
-    os << (T)(i);
+    os << value<T>(i);
     os.resetBuffer();
   }
   Timestamp end(Timestamp::now());
 
-  printf("benchLogStream %f\n", timeDifference(end, start));
+  printf("%-18s %f (%5.1f ns/op)\n", "benchLogStream", timeDifference(end, start),
+         timeDifference(end, start) * 1e9 / N);
+}
+
+void nullOutput(const char *msg, int len) {}
+
+// 完整的一条日志：LOG_INFO在调用线程格式化时间、整数和浮点数
+void benchLogger() {
+  Logger::setOutput(nullOutput);
+  Timestamp start(Timestamp::now());
+  for (size_t i = 0; i < N; ++i) {
+    LOG_INFO << "request " << i << " took " << 1.5 << " us";
+  }
+  Timestamp end(Timestamp::now());
+
+  printf("benchLogger %f (%.1f ns/line)\n", timeDifference(end, start),
+         timeDifference(end, start) * 1e9 / N);
+}
+
+// 同样的内容以键值对输出，format为kLogfmt或kJson
+void benchStructuredLogger(Logger::LogFormat format) {
+  Logger::setOutput(nullOutput);
+  Logger::setStructuredFormat(format);
+  Timestamp start(Timestamp::now());
+  for (size_t i = 0; i < N; ++i) {
+    LOG_INFO_KV("msg", "request done", "request", i, "us", 1.5);
+  }
+  Timestamp end(Timestamp::now());
+
+  printf("benchStructuredLogger(%s) %f (%.1f ns/line)\n",
+         format == Logger::kJson ? "json" : "logfmt",
+         timeDifference(end, start), timeDifference(end, start) * 1e9 / N);
+}
+
+// 同样的日志，BINLOG_INFO只写入调用点id、tick和参数的原始字节
+void benchBinaryLogger() {
+  BinaryLogger::setOutput(nullOutput);
+  Timestamp start(Timestamp::now());
+  for (size_t i = 0; i < N; ++i) {
+    BINLOG_INFO("request {} took {} us", i, 1.5);
+  }
+  BinaryLogger::flush();
+  Timestamp end(Timestamp::now());
+
+  printf("benchBinaryLogger %f (%.1f ns/line)\n", timeDifference(end, start),
+         timeDifference(end, start) * 1e9 / N);
 }
 
 // 测试每种类型输出消耗的时间
@@ -57,7 +116,7 @@ int main() {
   benchLogStream<int>();
 
   puts("double");
-  benchPrintf<double>("%.12g");
+  benchPrintf<double>("%.17g");
   benchStringStream<double>();
   benchLogStream<double>();
 
@@ -66,8 +125,19 @@ int main() {
   benchStringStream<int64_t>();
   benchLogStream<int64_t>();
 
+  puts("uint64_t");
+  benchPrintf<uint64_t>("%" PRIu64);
+  benchStringStream<uint64_t>();
+  benchLogStream<uint64_t>();
+
   puts("void*");
   benchPrintf<void *>("%p");
   benchStringStream<void *>();
   benchLogStream<void *>();
+
+  puts("log line");
+  benchLogger();
+  benchStructuredLogger(Logger::kLogfmt);
+  benchStructuredLogger(Logger::kJson);
+  benchBinaryLogger();
 }
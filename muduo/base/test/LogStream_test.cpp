@@ -147,8 +147,9 @@ BOOST_AUTO_TEST_CASE(testLogStreamFloats) {
   BOOST_CHECK_EQUAL(buf.toString(), string("0.15"));
   os.resetBuffer();
 
+  // 输出能还原成同一个double的最短数字，不再截断到12位
   os << a + b;
-  BOOST_CHECK_EQUAL(buf.toString(), string("0.15"));
+  BOOST_CHECK_EQUAL(buf.toString(), string("0.15000000000000002"));
   os.resetBuffer();
 
   BOOST_CHECK(a + b != c);
@@ -164,6 +165,24 @@ BOOST_AUTO_TEST_CASE(testLogStreamFloats) {
   os << -123.456;
   BOOST_CHECK_EQUAL(buf.toString(), string("-123.456"));
   os.resetBuffer();
+
+  os << 1e16 << ' ' << 1e17 << ' ' << 1.5e300 << ' ' << 0.0001 << ' ' << 1e-5;
+  BOOST_CHECK_EQUAL(buf.toString(),
+                    string("10000000000000000 1e+17 1.5e+300 0.0001 1e-05"));
+  os.resetBuffer();
+
+  os << -0.0 << ' ' << std::numeric_limits<double>::infinity() << ' '
+     << std::numeric_limits<double>::quiet_NaN() << ' '
+     << std::numeric_limits<double>::denorm_min();
+  BOOST_CHECK_EQUAL(buf.toString(), string("-0 inf nan 5e-324"));
+  os.resetBuffer();
+
+  // 恰好在两个double中点上（或离中点极近）的短小数，Grisu3无法确定，仍然最短
+  os << 5e22 << ' ' << 6.1637e-11 << ' ' << 8.41e21 << ' ' << 1e23 << ' '
+     << 4.471e-07;
+  BOOST_CHECK_EQUAL(buf.toString(),
+                    string("5e+22 6.1637e-11 8.41e+21 1e+23 4.471e-07"));
+  os.resetBuffer();
 }
 
 BOOST_AUTO_TEST_CASE(testLogStreamVoid) {
@@ -0,0 +1,100 @@
+#include "../Logging.h"
+#include "../Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+
+const int N = 100 * 1000 * 1000;
+
+int g_lines;
+
+void countOutput(const char *msg, int len) { ++g_lines; }
+
+// 阻止编译器把整个循环优化掉
+inline void barrier() { asm volatile("" ::: "memory"); }
+
+void report(const char *name, Timestamp start) {
+  double seconds = timeDifference(Timestamp::now(), start);
+  printf("%-28s %f (%5.2f ns/stmt)\n", name, seconds, seconds * 1e9 / N);
+}
+
+void benchEmptyLoop() {
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < N; ++i) {
+    barrier();
+  }
+  report("empty loop", start);
+}
+
+// 旧的写法：每次读全局级别再比较
+void benchGlobalLevel() {
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < N; ++i) {
+    if (Logger::logLevel() <= Logger::DEBUG)
+      Logger(__FILE__, __LINE__, Logger::DEBUG, __func__).stream() << i;
+    barrier();
+  }
+  report("global level check", start);
+}
+
+void benchDisabledDebug() {
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < N; ++i) {
+    LOG_DEBUG << i;
+    barrier();
+  }
+  report("LOG_DEBUG (disabled)", start);
+}
+
+// 全局级别为INFO，本文件的级别设成WARN
+void benchModuleDisabledInfo() {
+  Logger::setModuleLogLevel("Logging_bench", Logger::WARN);
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < N; ++i) {
+    LOG_INFO << i;
+    barrier();
+  }
+  report("LOG_INFO (module disabled)", start);
+  Logger::clearModuleLogLevels();
+}
+
+// 运行时打开本文件的DEBUG，再恢复
+void checkModuleLevel() {
+  g_lines = 0;
+  Logger::setModuleLogLevel("Logging_bench.cpp", Logger::DEBUG);
+  LOG_DEBUG << "enabled";
+  Logger::clearModuleLogLevels();
+  LOG_DEBUG << "disabled again";
+  printf("%d line(s) written\n", g_lines);
+  if (g_lines != 1) {
+    abort();
+  }
+}
+
+// 以下代码相当于用-DMUDUO_MIN_LOG_LEVEL=2编译
+#undef MUDUO_MIN_LOG_LEVEL
+#define MUDUO_MIN_LOG_LEVEL 2
+
+void benchCompiledOut() {
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < N; ++i) {
+    LOG_DEBUG << i;
+    barrier();
+  }
+  report("LOG_DEBUG (compiled out)", start);
+}
+
+int main() {
+  Logger::setOutput(countOutput);
+  Logger::setLogLevel(Logger::INFO);
+
+  benchEmptyLoop();
+  benchGlobalLevel();
+  benchDisabledDebug();
+  benchModuleDisabledInfo();
+  benchCompiledOut();
+
+  checkModuleLevel();
+}
@@ -67,6 +67,17 @@ int main() {
   LOG_INFO << sizeof(muduo::Fmt);
   LOG_INFO << sizeof(muduo::LogStream::Buffer);
 
+  // LOG_*之后的else属于调用者的if
+  bool elseTaken = false;
+  if (g_total < 0)
+    LOG_ERROR << "unreachable";
+  else
+    elseTaken = true;
+  if (!elseTaken) {
+    fprintf(stderr, "LOG_ERROR swallowed the caller's else\n");
+    return 1;
+  }
+
   sleep(1);
   bench("nop");
 
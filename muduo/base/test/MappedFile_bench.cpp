@@ -0,0 +1,139 @@
+#include "../FileUtil.h"
+#include "../Timestamp.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <limits.h>
+
+using namespace muduo;
+
+// 类似数独题库的文件：每行81个数字
+void createFile(const char *path, int64_t bytes) {
+  FILE *fp = ::fopen(path, "we");
+  assert(fp);
+  char line[82];
+  unsigned seed = 1;
+  for (int64_t written = 0; written < bytes; written += sizeof line) {
+    for (int i = 0; i < 81; ++i) {
+      line[i] = static_cast<char>('0' + rand_r(&seed) % 10);
+    }
+    line[81] = '\n';
+    ::fwrite(line, 1, sizeof line, fp);
+  }
+  ::fclose(fp);
+}
+
+// 文件在page cache中的比例
+double residentRatio(const char *path) {
+  FileUtil::MappedFile file(path);
+  const size_t kPageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  std::vector<unsigned char> pages((file.size() + kPageSize - 1) / kPageSize);
+  if (pages.empty() ||
+      ::mincore(const_cast<char *>(file.data()), file.size(), pages.data())) {
+    return 0;
+  }
+  size_t resident = 0;
+  for (unsigned char page : pages) {
+    resident += page & 1;
+  }
+  return static_cast<double>(resident) / static_cast<double>(pages.size());
+}
+
+// 把文件从page cache中清掉，模拟冷启动；有的文件系统不理会这个建议
+void dropCache(const char *path) {
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  ::fdatasync(fd);
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  ::close(fd);
+}
+
+int64_t countLinesMemchr(const char *data, size_t size) {
+  int64_t lines = 0;
+  const char *end = data + size;
+  while (data < end) {
+    const char *nl = static_cast<const char *>(
+        ::memchr(data, '\n', static_cast<size_t>(end - data)));
+    ++lines;
+    data = nl ? nl + 1 : end;
+  }
+  return lines;
+}
+
+int64_t countLines(const FileUtil::MappedFile &file) {
+  FileUtil::MappedFile::LineIterator it = file.lines();
+  StringPiece line;
+  int64_t lines = 0;
+  while (it.next(&line)) {
+    ++lines;
+  }
+  return lines;
+}
+
+void report(const char *name, bool cold, Timestamp start, Timestamp loaded,
+            int64_t lines) {
+  Timestamp end(Timestamp::now());
+  printf("%-5s %-30s load %7.1f ms  load+lines %7.1f ms  (%lld lines)\n",
+         cold ? "cold" : "warm", name, timeDifference(loaded, start) * 1e3,
+         timeDifference(end, start) * 1e3, static_cast<long long>(lines));
+}
+
+void benchReadFile(const char *path, bool cold) {
+  if (cold) {
+    dropCache(path);
+  }
+  Timestamp start(Timestamp::now());
+  string content;
+  int64_t size = 0;
+  int err = FileUtil::readFile(path, INT_MAX, &content, &size);
+  assert(err == 0);
+  (void)err;
+  Timestamp loaded(Timestamp::now());
+  int64_t lines = countLinesMemchr(content.data(), content.size());
+  report("readFile + memchr", cold, start, loaded, lines);
+}
+
+void benchMapped(const char *name, const char *path, int options, bool cold,
+                 bool useMemchr) {
+  if (cold) {
+    dropCache(path);
+  }
+  Timestamp start(Timestamp::now());
+  FileUtil::MappedFile file(path, options);
+  assert(file.valid());
+  Timestamp loaded(Timestamp::now());
+  int64_t lines = useMemchr ? countLinesMemchr(file.data(), file.size())
+                            : countLines(file);
+  report(name, cold, start, loaded, lines);
+}
+
+int main(int argc, char *argv[]) {
+  int64_t megabytes = argc > 1 ? atoi(argv[1]) : 512;
+  const char *path = argc > 2 ? argv[2] : "/tmp/mappedfile_bench.dat";
+  createFile(path, megabytes * 1024 * 1024);
+  // 刚写完的文件第一次读取可能还在等写回，先完整读一遍，不计时
+  countLines(FileUtil::MappedFile(path));
+  dropCache(path);
+  printf("%lld MB, lines of 81 digits, %.0f%% in page cache after drop\n",
+         static_cast<long long>(megabytes), residentRatio(path) * 100);
+
+  typedef FileUtil::MappedFile F;
+  for (int cold = 1; cold >= 0; --cold) {
+    benchReadFile(path, cold);
+    benchMapped("mmap + memchr", path, 0, cold, true);
+    benchMapped("mmap + lines", path, 0, cold, false);
+    benchMapped("mmap populate + lines", path, F::kPopulate, cold, false);
+    benchMapped("mmap seq|willneed + lines", path,
+                F::kSequential | F::kWillNeed, cold, false);
+    benchMapped("mmap huge|populate + lines", path,
+                F::kHugePages | F::kPopulate, cold, false);
+  }
+  ::unlink(path);
+}
@@ -0,0 +1,193 @@
+#include "../Atomic.h"
+#include "../BlockingQueue.h"
+#include "../CountDownLatch.h"
+#include "../Metrics.h"
+#include "../Thread.h"
+#include "../ThreadPool.h"
+#include "../Timestamp.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <memory>
+#include <vector>
+
+using namespace muduo;
+
+void testHistogramBuckets() {
+  for (int i = 0; i < MetricHistogram::kBuckets; ++i) {
+    int64_t lower = MetricHistogram::bucketLowerBound(i);
+    int64_t limit = MetricHistogram::bucketLimit(i);
+    assert(lower < limit);
+    assert(MetricHistogram::bucketIndex(lower) == i);
+    assert(MetricHistogram::bucketIndex(limit - 1) == i);
+    // 相对误差不超过1/8
+    assert(i < 2 * MetricHistogram::kSubBuckets || (limit - lower) * 8 <= lower);
+    (void)lower;
+    (void)limit;
+  }
+  assert(MetricHistogram::bucketIndex(int64_t(1) << 60) ==
+         MetricHistogram::kBuckets - 1);
+
+  MetricHistogram histogram("test_latency", "Latency");
+  for (int i = 1; i <= 1000; ++i) {
+    histogram.add(i);
+  }
+  MetricHistogram::Snapshot snapshot = histogram.snapshot();
+  assert(snapshot.count() == 1000);
+  assert(snapshot.sum() == 500500);
+  int64_t p50 = snapshot.percentile(0.5);
+  assert(p50 > 500 && p50 <= 500 + 500 / 8 + 1);
+  assert(snapshot.max() >= 1000 && snapshot.max() <= 1024);
+  (void)p50;
+  printf("%s\n", snapshot.toString().c_str());
+}
+
+void testShards() {
+  MetricCounter counter("test_events_total", "Events", "kind=\"shard\"");
+  MetricGauge gauge("test_level", "Level");
+  const int kThreads = 8;
+  const int kEvents = 10000;
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back(new Thread([&counter, &gauge] {
+      for (int j = 0; j < kEvents; ++j) {
+        counter.add();
+      }
+      gauge.add(1);
+    }));
+    threads.back()->start();
+  }
+  for (auto &thr : threads) {
+    thr->join();
+  }
+  // 线程都已退出，计数并入了公共数组
+  counter.add(5);
+  assert(counter.value() == kThreads * kEvents + 5);
+  assert(gauge.value() == kThreads);
+
+  {
+    MetricCounter temporary("test_temporary_total", "Unregistered on exit");
+    temporary.add(42);
+  }
+  // 注销的计数清零后被复用
+  MetricCounter reused("test_reused_total", "Reuses freed cells");
+  assert(reused.value() == 0);
+
+  string text = MetricsRegistry::instance().dumpText();
+  assert(text.find("test_events_total{kind=\"shard\"} 80005\n") !=
+         string::npos);
+  assert(text.find("test_temporary_total") == string::npos);
+  (void)text;
+}
+
+void testUsers() {
+  ThreadPool pool("MetricsPool");
+  pool.start(2);
+  CountDownLatch latch(100);
+  for (int i = 0; i < 100; ++i) {
+    pool.run([&latch] { latch.countDown(); });
+  }
+  latch.wait();
+  pool.stop();
+  assert(pool.completedTasks() == 100);
+
+  BlockingQueue<int> queue;
+  queue.enableMetrics("numbers");
+  queue.put(1);
+  queue.put(2);
+  queue.take();
+
+  string prometheus = MetricsRegistry::instance().dumpPrometheus();
+  printf("%s", prometheus.c_str());
+  assert(prometheus.find("# TYPE threadpool_tasks_completed_total counter\n") !=
+         string::npos);
+  size_t pos = prometheus.find(
+      "threadpool_tasks_completed_total{pool=\"MetricsPool\",id=\"");
+  assert(pos != string::npos);
+  assert(prometheus.compare(prometheus.find('}', pos), 6, "} 100\n") == 0);
+  // 没有打开统计时不注册直方图
+  assert(prometheus.find("threadpool_run_time_microseconds") == string::npos);
+  (void)pos;
+  assert(prometheus.find("blockingqueue_size{queue=\"numbers\"} 1\n") !=
+         string::npos);
+  assert(prometheus.find("test_latency_bucket{le=\"+Inf\"} 1000\n") ==
+         string::npos); // 已经析构
+  (void)prometheus;
+}
+
+// 指标太多时不终止进程，超出的指标不计数也不输出
+void testOverflow() {
+  const int kHistograms =
+      MetricsRegistry::kMaxCells / (MetricHistogram::kBuckets + 1) + 10;
+  std::vector<std::unique_ptr<MetricHistogram>> histograms;
+  for (int i = 0; i < kHistograms; ++i) {
+    histograms.emplace_back(new MetricHistogram(
+        "test_overflow", "Overflow", "i=\"" + std::to_string(i) + "\""));
+    histograms.back()->add(i);
+  }
+  assert(histograms.front()->count() == 1);
+  assert(histograms.back()->count() == 0);
+  string text = MetricsRegistry::instance().dumpText();
+  assert(text.find("test_overflow{i=\"0\"}") != string::npos);
+  assert(text.find("test_overflow{i=\"" + std::to_string(kHistograms - 1) +
+                   "\"}") == string::npos);
+  histograms.clear();
+
+  // 线程池默认不注册直方图，同名的线程池输出不同的序列
+  std::vector<std::unique_ptr<ThreadPool>> pools;
+  for (int i = 0; i < 100; ++i) {
+    pools.emplace_back(new ThreadPool);
+  }
+  text = MetricsRegistry::instance().dumpText();
+  size_t first =
+      text.find("threadpool_tasks_completed_total{pool=\"ThreadPool\"");
+  assert(first != string::npos);
+  size_t end = text.find('\n', first);
+  assert(text.find(text.substr(first, end - first + 1), end) == string::npos);
+  (void)first;
+  (void)end;
+}
+
+// 多个线程累加同一个计数：共享的AtomicInt64与每线程分片
+template <typename F> double benchCounter(int nthreads, int64_t adds, F add) {
+  std::vector<std::unique_ptr<Thread>> threads;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < nthreads; ++i) {
+    threads.emplace_back(new Thread([adds, &add] {
+      for (int64_t j = 0; j < adds; ++j) {
+        add();
+      }
+    }));
+    threads.back()->start();
+  }
+  for (auto &thr : threads) {
+    thr->join();
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  return static_cast<double>(adds) * nthreads / seconds / 1e6;
+}
+
+int main(int argc, char **argv) {
+  testHistogramBuckets();
+  testShards();
+  testUsers();
+  testOverflow();
+
+  int64_t adds = argc > 1 ? atoll(argv[1]) : 20 * 1000 * 1000;
+  AtomicInt64 shared;
+  MetricCounter sharded("bench_adds_total", "Adds");
+  MetricHistogram latency("bench_latency", "Latency");
+  printf("%8s %14s %14s %14s  (M adds/s)\n", "threads", "AtomicInt64",
+         "MetricCounter", "MetricHistogram");
+  const int kThreads[] = {1, 2, 4, 8};
+  for (int nthreads : kThreads) {
+    int64_t perThread = adds / nthreads;
+    printf("%8d %14.1f %14.1f %14.1f\n", nthreads,
+           benchCounter(nthreads, perThread, [&shared] { shared.increment(); }),
+           benchCounter(nthreads, perThread, [&sharded] { sharded.add(); }),
+           benchCounter(nthreads, perThread, [&latency] { latency.add(100); }));
+  }
+  assert(sharded.value() == shared.get());
+}
@@ -1,9 +1,12 @@
 #include "../CountDownLatch.h"
+#include "../Futex.h"
 #include "../Mutex.h"
 #include "../Thread.h"
 #include "../Timestamp.h"
 
+#include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <vector>
 
 using namespace std;
@@ -34,6 +37,108 @@ int foo() {
   return 0;
 }
 
+// 竞争测试：nthreads个线程共做totalOps次加锁，临界区内做work次计算
+template <typename Mutex, typename Guard, typename Latch> struct Contention {
+  Mutex mutex;
+  int64_t counter = 0;
+  uint64_t sink = 0;
+
+  double run(int nthreads, int totalOps, int work) {
+    counter = 0;
+    int ops = totalOps / nthreads;
+    Latch ready(nthreads);
+    Latch go(1);
+    vector<unique_ptr<Thread>> threads;
+    for (int i = 0; i < nthreads; ++i) {
+      threads.emplace_back(new Thread([this, ops, work, &ready, &go] {
+        ready.countDown();
+        go.wait();
+        for (int j = 0; j < ops; ++j) {
+          Guard lock(mutex);
+          ++counter;
+          for (int k = 0; k < work; ++k) {
+            sink = sink * 6364136223846793005ULL + 1442695040888963407ULL;
+          }
+        }
+      }));
+      threads.back()->start();
+    }
+    ready.wait();
+    Timestamp start(Timestamp::now());
+    go.countDown();
+    for (auto &thr : threads) {
+      thr->join();
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+    assert(counter == static_cast<int64_t>(ops) * nthreads);
+    return static_cast<double>(ops) * nthreads / seconds / 1e6;
+  }
+};
+
+typedef Contention<MutexLock, MutexLockGuard, CountDownLatch> PthreadContention;
+typedef Contention<FutexMutex, FutexMutexGuard, FutexCountDownLatch>
+    FutexContention;
+
+void benchMatrix(int totalOps) {
+  const int kThreads[] = {1, 2, 4, 8, 16, 32, 64};
+  const int kShort = 0;
+  const int kLong = 200;
+  printf("%8s %20s %20s\n", "", "short (Mops/s)", "long (Mops/s)");
+  printf("%8s %10s %9s %10s %9s\n", "threads", "pthread", "futex", "pthread",
+         "futex");
+  PthreadContention pthreadLock;
+  FutexContention futexLock;
+  for (int nthreads : kThreads) {
+    printf("%8d %10.2f %9.2f %10.2f %9.2f\n", nthreads,
+           pthreadLock.run(nthreads, totalOps, kShort),
+           futexLock.run(nthreads, totalOps, kShort),
+           pthreadLock.run(nthreads, totalOps / 10, kLong),
+           futexLock.run(nthreads, totalOps / 10, kLong));
+  }
+}
+
+// FutexCondition/FutexCountDownLatch的正确性：notifyAll唤醒所有等待者，超时返回true
+void testFutexCondition() {
+  FutexMutex mutex;
+  FutexCondition cond(mutex);
+  int generation = 0;
+  const int kWaiters = 8;
+  FutexCountDownLatch waiting(kWaiters);
+  FutexCountDownLatch done(kWaiters);
+  vector<unique_ptr<Thread>> threads;
+  for (int i = 0; i < kWaiters; ++i) {
+    threads.emplace_back(new Thread([&] {
+      FutexMutexGuard lock(mutex);
+      waiting.countDown();
+      while (generation == 0) {
+        cond.wait();
+      }
+      assert(mutex.isLockedByThisThread());
+      done.countDown();
+    }));
+    threads.back()->start();
+  }
+  waiting.wait();
+  {
+    FutexMutexGuard lock(mutex);
+    generation = 1;
+    cond.notifyAll();
+  }
+  done.wait();
+  assert(done.getCount() == 0);
+  for (auto &thr : threads) {
+    thr->join();
+  }
+
+  FutexMutexGuard lock(mutex);
+  bool timeout = cond.waitForSeconds(0.01);
+  assert(timeout);
+  assert(mutex.isLockedByThisThread());
+  (void)timeout;
+  assert(!mutex.tryLock());
+  printf("FutexCondition ok\n");
+}
+
 int main(int argc, char **argv) {
   MCHECK(foo());
   if (g_count != 1) {
@@ -41,8 +146,7 @@ int main(int argc, char **argv) {
     abort();
   }
 
-  const int kMaxThreads = 8;
-  g_vec.reserve(kMaxThreads * kCount);
+  g_vec.reserve(kCount);
 
   Timestamp start(Timestamp::now());
   for (int i = 0; i < kCount; ++i) {
@@ -57,21 +161,7 @@ int main(int argc, char **argv) {
   printf("single thread with lock %f\n",
          timeDifference(Timestamp::now(), start));
 
-  for (int nthreads = 1; nthreads < kMaxThreads; ++nthreads) {
-    vector<unique_ptr<Thread>> threads;
-    g_vec.clear();
-    start = Timestamp::now();
-    for (int i = 0; i < nthreads; ++i) {
-      threads.emplace_back(new Thread(&threadFunc));
-      threads.back()->start();
-    }
-    printf("join......\n");
-    for (int i = 0; i < nthreads; ++i) {
-      threads[i]->join();
-    }
-
-    printf("%d thread(s) with lock %f\n", nthreads,
-           timeDifference(Timestamp::now(), start));
-  }
+  testFutexCondition();
+  benchMatrix(argc > 1 ? atoi(argv[1]) : 2 * 1000 * 1000);
   return 0;
-}
\ No newline at end of file
+}
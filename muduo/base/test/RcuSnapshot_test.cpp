@@ -0,0 +1,174 @@
+#include "../CountDownLatch.h"
+#include "../Mutex.h"
+#include "../RcuSnapshot.h"
+#include "../Thread.h"
+#include "../Timestamp.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <memory>
+#include <set>
+#include <vector>
+
+using namespace muduo;
+
+// 每个版本的内容自洽：values是0..n-1；析构时破坏magic，读到已删除的版本会失败
+struct Version {
+  Version() : magic(kMagic) {}
+  Version(const Version &rhs) : magic(kMagic), values(rhs.values) {}
+  ~Version() { magic = 0; }
+
+  static const int kMagic = 0x5a5a5a5a;
+  int magic;
+  std::vector<int> values;
+};
+
+void testReclaim() {
+  RcuSnapshot<Version> snapshot;
+  std::atomic<bool> running(true);
+  std::atomic<int64_t> reads(0);
+  const int kReaders = 4;
+  std::vector<std::unique_ptr<Thread>> readers;
+  for (int i = 0; i < kReaders; ++i) {
+    readers.emplace_back(new Thread([&] {
+      int64_t n = 0;
+      while (running.load(std::memory_order_relaxed)) {
+        RcuSnapshot<Version>::ReadGuard version(snapshot);
+        {
+          RcuSnapshot<Version>::ReadGuard nested(snapshot);
+          (void)nested;
+        }
+        assert(version->magic == Version::kMagic);
+        for (size_t j = 0; j < version->values.size(); ++j) {
+          assert(version->values[j] == static_cast<int>(j));
+          (void)j;
+        }
+        ++n;
+      }
+      reads += n;
+    }));
+    readers.back()->start();
+  }
+
+  const int kUpdates = 2000;
+  for (int i = 0; i < kUpdates; ++i) {
+    snapshot.update([](Version &v) {
+      v.values.push_back(static_cast<int>(v.values.size()));
+    });
+  }
+  running = false;
+  for (auto &thr : readers) {
+    thr->join();
+  }
+  snapshot.synchronize();
+  assert(snapshot.pendingReclaim() == 0);
+  RcuSnapshot<Version>::ReadGuard last(snapshot);
+  assert(last->values.size() == kUpdates);
+  (void)last;
+  printf("testReclaim: %lld reads during %d updates\n",
+         static_cast<long long>(reads.load()), kUpdates);
+}
+
+// 模拟聊天服务器的广播：每条消息遍历一次连接列表，偶尔有连接加入或离开
+typedef std::set<int> ConnectionList;
+
+struct MutexCopyOnWrite {
+  MutexCopyOnWrite() : connections(new ConnectionList) {}
+
+  template <typename F> void update(F f) {
+    MutexLockGuard lock(mutex);
+    if (!connections.unique()) {
+      connections.reset(new ConnectionList(*connections));
+    }
+    f(*connections);
+  }
+
+  int64_t broadcast() {
+    std::shared_ptr<ConnectionList> list;
+    {
+      MutexLockGuard lock(mutex);
+      list = connections;
+    }
+    int64_t sum = 0;
+    for (int conn : *list) {
+      sum += conn;
+    }
+    return sum;
+  }
+
+  MutexLock mutex;
+  std::shared_ptr<ConnectionList> connections GUARDED_BY(mutex);
+};
+
+struct RcuCopyOnWrite {
+  template <typename F> void update(F f) { connections.update(f); }
+
+  int64_t broadcast() {
+    RcuSnapshot<ConnectionList>::ReadGuard list(connections);
+    int64_t sum = 0;
+    for (int conn : *list) {
+      sum += conn;
+    }
+    return sum;
+  }
+
+  RcuSnapshot<ConnectionList> connections;
+};
+
+template <typename CopyOnWrite>
+double benchBroadcast(int nthreads, int messages, int connections) {
+  CopyOnWrite cow;
+  for (int i = 0; i < connections; ++i) {
+    cow.update([i](ConnectionList &list) { list.insert(i); });
+  }
+  CountDownLatch latch(nthreads);
+  std::atomic<int64_t> sink(0);
+  std::vector<std::unique_ptr<Thread>> threads;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < nthreads; ++i) {
+    threads.emplace_back(new Thread([&, i] {
+      int64_t sum = 0;
+      for (int j = 0; j < messages; ++j) {
+        sum += cow.broadcast();
+        // 千分之一的消息伴随一次连接变化
+        if (j % 1000 == 0) {
+          int conn = connections + i;
+          cow.update([conn](ConnectionList &list) {
+            if (!list.erase(conn)) {
+              list.insert(conn);
+            }
+          });
+        }
+      }
+      sink += sum;
+      latch.countDown();
+    }));
+    threads.back()->start();
+  }
+  latch.wait();
+  double seconds = timeDifference(Timestamp::now(), start);
+  for (auto &thr : threads) {
+    thr->join();
+  }
+  return static_cast<double>(nthreads) * messages / seconds / 1e6;
+}
+
+int main(int argc, char **argv) {
+  testReclaim();
+
+  int messages = argc > 1 ? atoi(argv[1]) : 1000000;
+  const int kConnections = 4;
+  printf("broadcast to %d connections, Mmsgs/s\n", kConnections);
+  printf("%8s %12s %12s\n", "threads", "mutex", "rcu");
+  const int kThreads[] = {1, 2, 4, 8};
+  for (int nthreads : kThreads) {
+    printf("%8d %12.2f %12.2f\n", nthreads,
+           benchBroadcast<MutexCopyOnWrite>(nthreads, messages / nthreads,
+                                            kConnections),
+           benchBroadcast<RcuCopyOnWrite>(nthreads, messages / nthreads,
+                                          kConnections));
+  }
+}
@@ -0,0 +1,126 @@
+#include "../Mutex.h"
+#include "../SignalSlot.h"
+#include "../Timestamp.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <memory>
+#include <vector>
+
+using namespace muduo;
+
+// 原来的写法：mutex保护的shared_ptr<vector<weak_ptr>>，每次发射加锁、逐个提升weak_ptr
+class MutexSignal : noncopyable {
+public:
+  typedef std::function<void(int)> Callback;
+  typedef std::vector<std::weak_ptr<Callback>> SlotList;
+
+  MutexSignal() : slots_(new SlotList) {}
+
+  std::shared_ptr<Callback> connect(Callback &&func) {
+    std::shared_ptr<Callback> slot(new Callback(std::move(func)));
+    MutexLockGuard lock(mutex_);
+    if (!slots_.unique()) {
+      slots_.reset(new SlotList(*slots_));
+    }
+    slots_->push_back(slot);
+    return slot;
+  }
+
+  void call(int x) {
+    std::shared_ptr<SlotList> slots;
+    {
+      MutexLockGuard lock(mutex_);
+      slots = slots_;
+    }
+    for (const std::weak_ptr<Callback> &weak : *slots) {
+      std::shared_ptr<Callback> slot(weak.lock());
+      if (slot) {
+        (*slot)(x);
+      }
+    }
+  }
+
+private:
+  MutexLock mutex_;
+  std::shared_ptr<SlotList> slots_ GUARDED_BY(mutex_);
+};
+
+void testDisconnect() {
+  Signal<void(int)> signal;
+  int sum = 0;
+  Slot a = signal.connect([&sum](int x) { sum += x; });
+  Slot b = signal.connect([&sum](int x) { sum += 10 * x; });
+  signal.connectUnowned([&sum](int x) { sum += 100 * x; });
+  signal.call(1);
+  assert(sum == 111);
+
+  b.reset();
+  signal.call(1);
+  assert(sum == 212);
+  // 只断开了一个，还没到清理的批量
+  assert(signal.numSlots() == 3);
+
+  std::shared_ptr<int> owner(new int(0));
+  Slot tied = signal.connect([&sum](int x) { sum += 1000 * x; }, owner);
+  // connect时顺便清理了b
+  assert(signal.numSlots() == 3);
+  signal.call(1);
+  assert(sum == 1313);
+  owner.reset();
+  signal.call(1);
+  assert(sum == 1414);
+
+  // 大量断开时成批清理
+  std::vector<Slot> slots;
+  for (int i = 0; i < 100; ++i) {
+    slots.push_back(signal.connect([](int) {}));
+  }
+  slots.clear();
+  assert(signal.numSlots() < 100);
+  signal.clean();
+  assert(signal.numSlots() == 2);
+  (void)sum;
+  printf("testDisconnect ok\n");
+}
+
+// slot只做一次加法，发射的开销主要在遍历上
+template <typename S> double benchEmit(S &signal, int emits) {
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < emits; ++i) {
+    signal.call(i);
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  return emits / seconds;
+}
+
+int main(int argc, char **argv) {
+  testDisconnect();
+
+  int totalCalls = argc > 1 ? atoi(argv[1]) : 20 * 1000 * 1000;
+  printf("%8s %14s %14s %14s\n", "slots", "mutex+weak", "owned", "unowned");
+  const int kSlots[] = {1, 10, 100, 1000};
+  for (int nslots : kSlots) {
+    int64_t sink = 0;
+    std::function<void(int)> func = [&sink](int x) { sink += x; };
+    MutexSignal mutexSignal;
+    Signal<void(int)> owned;
+    Signal<void(int)> unowned;
+    std::vector<std::shared_ptr<MutexSignal::Callback>> mutexSlots;
+    std::vector<Slot> ownedSlots;
+    for (int i = 0; i < nslots; ++i) {
+      mutexSlots.push_back(mutexSignal.connect(std::function<void(int)>(func)));
+      ownedSlots.push_back(owned.connect(std::function<void(int)>(func)));
+      unowned.connectUnowned(std::function<void(int)>(func));
+    }
+    int emits = totalCalls / nslots;
+    printf("%8d %14.0f %14.0f %14.0f  emits/s\n", nslots,
+           benchEmit(mutexSignal, emits), benchEmit(owned, emits),
+           benchEmit(unowned, emits));
+    if (sink == 0) {
+      printf("unexpected\n");
+    }
+  }
+}
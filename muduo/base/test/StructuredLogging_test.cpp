@@ -0,0 +1,116 @@
+#include "../StructuredLogging.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+
+string g_line;
+
+void captureOutput(const char *msg, int len) { g_line.assign(msg, len); }
+
+// 逐字节的参考实现
+string escapeSlow(const string &str) {
+  string result;
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    } else if (c == '\n') {
+      result += "\\n";
+    } else if (c == '\r') {
+      result += "\\r";
+    } else if (c == '\t') {
+      result += "\\t";
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof buf, "\\u%04x", static_cast<unsigned char>(c));
+      result += buf;
+    } else {
+      result += c;
+    }
+  }
+  return result;
+}
+
+void testEscape() {
+  // 长度跨过16字节的边界，特殊字符出现在各个位置
+  const char kChars[] = "ab \"\\=\n\t\x01\x7f\xc3\xa9z";
+  srand(1);
+  for (int i = 0; i < 100000; ++i) {
+    string str(static_cast<size_t>(rand() % 40), 'x');
+    for (auto &c : str) {
+      if (rand() % 8 == 0) {
+        c = kChars[rand() % (sizeof kChars - 1)];
+      }
+    }
+    LogStream s;
+    detail::appendLogEscaped(s, str.data(), str.data() + str.size());
+    assert(s.buffer().toString() == escapeSlow(str));
+
+    bool quote =
+        str.empty() || str.find_first_of(" =\"\\\n\t\x01") != string::npos;
+    (void)quote;
+    LogStream logfmt;
+    detail::appendKVString(logfmt, Logger::kLogfmt, str.data(), str.size());
+    assert(logfmt.buffer().toString() ==
+           (quote ? '"' + escapeSlow(str) + '"' : str));
+  }
+}
+
+void testFormat(Logger::LogFormat format) {
+  Logger::setStructuredFormat(format);
+  string str("a \"quoted\" string");
+  int x = 0;
+  Logger::LogLevel level = Logger::TRACE;
+  (void)level;
+
+  LOG_INFO_KV("conn", 42, "bytes", -(int64_t(1) << 40), "ok", true, "rate", 0.5);
+  printf("%s", g_line.c_str());
+  assert(Logger::parseLogLevel(g_line.data(), static_cast<int>(g_line.size()),
+                               &level) &&
+         level == Logger::INFO);
+  if (format == Logger::kJson) {
+    assert(g_line.compare(0, 9, "{\"time\":\"") == 0);
+    assert(g_line.find("\"level\":\"INFO\",\"conn\":42,"
+                       "\"bytes\":-1099511627776,\"ok\":true,\"rate\":0.5,"
+                       "\"src\":\"StructuredLogging_test.cpp:") !=
+           string::npos);
+    assert(g_line.compare(g_line.size() - 3, 3, "\"}\n") == 0);
+  } else {
+    assert(g_line.compare(0, 6, "time=\"") == 0);
+    assert(g_line.find(" level=INFO conn=42 bytes=-1099511627776 ok=true "
+                       "rate=0.5 src=StructuredLogging_test.cpp:") !=
+           string::npos);
+  }
+
+  LOG_WARN_KV("msg", str, "empty", "", "piece", StringPiece("a=b"), "c", 'c',
+              "ptr", &x, "nan", 0.0 / 0.0);
+  printf("%s", g_line.c_str());
+  assert(Logger::parseLogLevel(g_line.data(), static_cast<int>(g_line.size()),
+                               &level) &&
+         level == Logger::WARN);
+  if (format == Logger::kJson) {
+    assert(g_line.find("\"msg\":\"a \\\"quoted\\\" string\",\"empty\":\"\","
+                       "\"piece\":\"a=b\",\"c\":\"c\",\"ptr\":\"0x") !=
+           string::npos);
+    assert(g_line.find("\"nan\":\"nan\"") != string::npos);
+  } else {
+    assert(g_line.find(" msg=\"a \\\"quoted\\\" string\" empty=\"\" "
+                       "piece=\"a=b\" c=c ptr=0x") != string::npos);
+    assert(g_line.find(" nan=nan ") != string::npos);
+  }
+
+  g_line.clear();
+  LOG_DEBUG_KV("filtered", 1); // 默认级别为INFO
+  assert(g_line.empty());
+}
+
+int main() {
+  Logger::setOutput(captureOutput);
+  testEscape();
+  testFormat(Logger::kLogfmt);
+  testFormat(Logger::kJson);
+  puts("PASS");
+}
@@ -0,0 +1,130 @@
+#include "../CurrentThread.h"
+#include "../Thread.h"
+#include "../ThreadPool.h"
+#include "../Timestamp.h"
+
+#include <assert.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+
+using namespace muduo;
+
+// 两个线程通过一个cache line来回传递，测量往返延迟
+// 自旋一会儿之后让出CPU，两个线程在同一个核上时也能跑完
+std::atomic<int> g_ball(0);
+
+void waitFor(int value) {
+  int spins = 0;
+  while (g_ball.load(std::memory_order_acquire) != value) {
+    if (++spins > 1000) {
+      sched_yield();
+      spins = 0;
+    }
+  }
+}
+
+void pingPong(const char *name, const ThreadPlacement &ping,
+              const ThreadPlacement &pong, int rounds) {
+  g_ball.store(0);
+  Thread ponger([rounds] {
+    for (int i = 0; i < rounds; ++i) {
+      waitFor(1);
+      g_ball.store(0, std::memory_order_release);
+    }
+  });
+  ponger.setPlacement(pong);
+
+  double seconds = 0;
+  Thread pinger([rounds, &seconds] {
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < rounds; ++i) {
+      g_ball.store(1, std::memory_order_release);
+      waitFor(0);
+    }
+    seconds = timeDifference(Timestamp::now(), start);
+  });
+  pinger.setPlacement(ping);
+
+  ponger.start();
+  pinger.start();
+  pinger.join();
+  ponger.join();
+  printf("%-28s %8.1f ns/round trip\n", name, seconds * 1e9 / rounds);
+}
+
+ThreadPlacement onCpu(int cpu) {
+  ThreadPlacement placement;
+  placement.cpus.push_back(cpu);
+  return placement;
+}
+
+// 检查轮流绑定和实时优先级的设置是否生效
+void checkPoolPlacement(int node) {
+  ThreadPool pool("PinnedPool");
+  pool.setThreadPlacement(ThreadPool::roundRobinOnNode(node));
+  pool.start(2);
+  std::vector<int> cpus = ThreadPlacement::cpusOfNode(node);
+  for (int i = 0; i < 4; ++i) {
+    Future<int> cpu = pool.submit([] { return sched_getcpu(); });
+    printf("pool task ran on cpu %d, node %d cpus:", cpu.get(), node);
+    for (int c : cpus) {
+      printf(" %d", c);
+    }
+    printf("\n");
+  }
+  pool.stop();
+
+  ThreadPlacement fifo;
+  fifo.fifoPriority = 10;
+  fifo.stackSize = 256 * 1024;
+  Thread rt([] {
+    int policy;
+    struct sched_param param;
+    pthread_getschedparam(pthread_self(), &policy, &param);
+    printf("thread with fifoPriority=10: policy %s priority %d\n",
+           policy == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_OTHER",
+           param.sched_priority);
+  });
+  rt.setPlacement(fifo);
+  rt.start();
+  rt.join();
+
+  // 无效的设置报告后退回默认值，线程照常运行
+  ThreadPlacement invalid;
+  invalid.stackSize = 1;
+  invalid.fifoPriority = 1000;
+  bool ran = false;
+  Thread fallback([&ran] { ran = true; });
+  fallback.setPlacement(invalid);
+  fallback.start();
+  fallback.join();
+  printf("thread with invalid placement ran: %d\n", ran);
+}
+
+int main(int argc, char **argv) {
+  int rounds = argc > 1 ? atoi(argv[1]) : 200000;
+  assert(ThreadPlacement::parseCpuList("0-2,5,7-8\n") ==
+         std::vector<int>({0, 1, 2, 5, 7, 8}));
+  int nodes = ThreadPlacement::numNumaNodes();
+  std::vector<int> node0 = ThreadPlacement::cpusOfNode(0);
+  printf("%d NUMA node(s), %zu cpu(s) on node 0\n", nodes, node0.size());
+
+  pingPong("unpinned", ThreadPlacement(), ThreadPlacement(), rounds);
+  if (!node0.empty()) {
+    pingPong("same core", onCpu(node0[0]), onCpu(node0[0]), rounds);
+  }
+  if (node0.size() > 1) {
+    pingPong("two cores, same node", onCpu(node0[0]), onCpu(node0[1]), rounds);
+  }
+  if (nodes > 1) {
+    std::vector<int> node1 = ThreadPlacement::cpusOfNode(1);
+    if (!node1.empty() && !node0.empty()) {
+      pingPong("two nodes", onCpu(node0[0]), onCpu(node1[0]), rounds);
+    }
+  }
+
+  checkPoolPlacement(0);
+}
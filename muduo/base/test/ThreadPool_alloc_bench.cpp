@@ -0,0 +1,135 @@
+#include "../BlockingQueue.h"
+#include "../CountDownLatch.h"
+#include "../ThreadPool.h"
+#include "../Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+
+using namespace muduo;
+
+// 替换malloc/free统计分配次数，libstdc++的operator new也会经过这里
+extern "C" {
+void *__libc_malloc(size_t size);
+void __libc_free(void *ptr);
+}
+
+std::atomic<int64_t> g_mallocs(0);
+
+extern "C" void *malloc(size_t size) {
+  g_mallocs.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+extern "C" void free(void *ptr) { __libc_free(ptr); }
+
+// 捕获kBytes字节数据的任务
+template <int kBytes> struct Payload {
+  char data[kBytes];
+  std::atomic<int64_t> *counter;
+
+  void operator()() const { counter->fetch_add(data[0] + 1); }
+};
+
+template <int kBytes> Payload<kBytes> makePayload(std::atomic<int64_t> *c) {
+  Payload<kBytes> p;
+  p.data[0] = 0;
+  p.counter = c;
+  return p;
+}
+
+void report(const char *name, int64_t tasks, int64_t mallocs,
+            double seconds) {
+  printf("%-40s %6.3f mallocs/task %8.2f Mtasks/s\n", name,
+         static_cast<double>(mallocs) / static_cast<double>(tasks),
+         static_cast<double>(tasks) / seconds / 1e6);
+}
+
+// 单线程先放入batch个再全部取出，只看队列和任务类型本身的开销
+template <typename Queue, typename Task, int kBytes>
+void benchQueue(const char *name, int batch, int rounds) {
+  std::atomic<int64_t> counter(0);
+  Queue queue;
+  // 预热，让队列的容量稳定下来
+  for (int i = 0; i < batch; ++i) {
+    queue.push_back(Task(makePayload<kBytes>(&counter)));
+  }
+  while (!queue.empty()) {
+    queue.pop_front();
+  }
+
+  int64_t mallocs = g_mallocs.load();
+  Timestamp start(Timestamp::now());
+  for (int r = 0; r < rounds; ++r) {
+    for (int i = 0; i < batch; ++i) {
+      queue.push_back(Task(makePayload<kBytes>(&counter)));
+    }
+    while (!queue.empty()) {
+      Task task(std::move(queue.front()));
+      queue.pop_front();
+      task();
+    }
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  report(name, static_cast<int64_t>(batch) * rounds, g_mallocs.load() - mallocs,
+         seconds);
+}
+
+template <int kBytes>
+void benchPool(const char *name, ThreadPool::Mode mode, int threads,
+               int tasks) {
+  std::atomic<int64_t> counter(0);
+  ThreadPool pool("AllocPool");
+  pool.setMode(mode);
+  pool.start(threads);
+
+  // 预热一轮，之后计数
+  for (int round = 0; round < 2; ++round) {
+    CountDownLatch latch(1);
+    int64_t mallocs = g_mallocs.load();
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < tasks; ++i) {
+      pool.run(makePayload<kBytes>(&counter));
+    }
+    pool.run([&latch] { latch.countDown(); });
+    latch.wait();
+    double seconds = timeDifference(Timestamp::now(), start);
+    if (round == 1) {
+      report(name, tasks, g_mallocs.load() - mallocs, seconds);
+    }
+  }
+  pool.stop();
+}
+
+int main(int argc, char **argv) {
+  int tasks = argc > 1 ? atoi(argv[1]) : 1000000;
+  int batch = 1000;
+  int rounds = tasks / batch;
+
+  printf("sizeof(ThreadPool::Task) = %zu, inline capacity = %zu\n",
+         sizeof(ThreadPool::Task), ThreadPool::Task::kCapacity);
+
+  typedef std::function<void()> Function;
+  benchQueue<std::deque<Function>, Function, 8>("deque<function> 16B capture",
+                                                batch, rounds);
+  benchQueue<std::deque<Function>, Function, 48>("deque<function> 56B capture",
+                                                 batch, rounds);
+  benchQueue<RingBuffer<ThreadPool::Task>, ThreadPool::Task, 8>(
+      "RingBuffer<Task> 16B capture", batch, rounds);
+  benchQueue<RingBuffer<ThreadPool::Task>, ThreadPool::Task, 48>(
+      "RingBuffer<Task> 56B capture", batch, rounds);
+  benchQueue<RingBuffer<ThreadPool::Task>, ThreadPool::Task, 200>(
+      "RingBuffer<Task> 208B capture (heap)", batch, rounds);
+
+  benchPool<8>("ThreadPool kSharedQueue 16B x4", ThreadPool::kSharedQueue, 4,
+               tasks);
+  benchPool<48>("ThreadPool kSharedQueue 56B x4", ThreadPool::kSharedQueue, 4,
+                tasks);
+  benchPool<48>("ThreadPool kWorkStealing 56B x4", ThreadPool::kWorkStealing,
+                4, tasks);
+}
@@ -0,0 +1,100 @@
+#include "../CountDownLatch.h"
+#include "../ThreadPool.h"
+#include "../Timestamp.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+
+using namespace muduo;
+
+const char *modeName(ThreadPool::Mode mode) {
+  return mode == ThreadPool::kSharedQueue ? "kSharedQueue" : "kWorkStealing";
+}
+
+/**
+ * @brief 任务在线程池中递归地产生两个子任务，直到depth为0，
+ *        模拟fork-join的细粒度任务；完成的任务数到达total时通知主线程
+ *
+ */
+struct Spawner {
+  ThreadPool *pool;
+  std::atomic<int64_t> done;
+  int64_t total;
+  CountDownLatch latch;
+
+  Spawner(ThreadPool *p, int depth)
+      : pool(p), done(0), total((int64_t(1) << (depth + 1)) - 1), latch(1) {}
+
+  void spawn(int depth) {
+    if (depth > 0) {
+      pool->run([this, depth] { spawn(depth - 1); });
+      pool->run([this, depth] { spawn(depth - 1); });
+    }
+    if (done.fetch_add(1) + 1 == total) {
+      latch.countDown();
+    }
+  }
+};
+
+void benchSpawn(ThreadPool::Mode mode, int threads, int depth) {
+  ThreadPool pool("SpawnPool");
+  pool.setMode(mode);
+  pool.start(threads);
+
+  Spawner spawner(&pool, depth);
+  Timestamp start(Timestamp::now());
+  pool.run([&spawner, depth] { spawner.spawn(depth); });
+  spawner.latch.wait();
+  double seconds = timeDifference(Timestamp::now(), start);
+  pool.stop();
+
+  assert(spawner.done == spawner.total);
+  printf("spawn %-14s %2d threads %9lld tasks %8.2f Mtasks/s\n",
+         modeName(mode), threads, static_cast<long long>(spawner.total),
+         static_cast<double>(spawner.total) / seconds / 1e6);
+}
+
+// 主线程直接提交所有任务，工作窃取模式下全部经过共用队列
+void benchFlat(ThreadPool::Mode mode, int threads, int tasks) {
+  ThreadPool pool("FlatPool");
+  pool.setMode(mode);
+  pool.start(threads);
+
+  std::atomic<int> done(0);
+  CountDownLatch latch(1);
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < tasks; ++i) {
+    pool.run([&done, &latch, tasks] {
+      if (done.fetch_add(1) + 1 == tasks) {
+        latch.countDown();
+      }
+    });
+  }
+  latch.wait();
+  double seconds = timeDifference(Timestamp::now(), start);
+  pool.stop();
+
+  printf("flat  %-14s %2d threads %9d tasks %8.2f Mtasks/s\n", modeName(mode),
+         threads, tasks, static_cast<double>(tasks) / seconds / 1e6);
+}
+
+int main(int argc, char **argv) {
+  int depth = argc > 1 ? atoi(argv[1]) : 20;
+  int tasks = 1 << depth;
+  const int kThreads[] = {1, 4, 16};
+  const ThreadPool::Mode kModes[] = {ThreadPool::kSharedQueue,
+                                     ThreadPool::kWorkStealing};
+  for (int n : kThreads) {
+    for (ThreadPool::Mode mode : kModes) {
+      benchSpawn(mode, n, depth);
+    }
+  }
+  for (int n : kThreads) {
+    for (ThreadPool::Mode mode : kModes) {
+      benchFlat(mode, n, tasks);
+    }
+  }
+}
@@ -1,7 +1,9 @@
+#include "../Atomic.h"
 #include "../CountDownLatch.h"
 #include "../CurrentThread.h"
 #include "../ThreadPool.h"
 
+#include <assert.h>
 #include <iostream>
 #include <stdio.h>
 #include <unistd.h> // usleep
@@ -40,8 +42,45 @@ void test(int maxSize) {
   pool.stop();
 }
 
+// 任务堆积时线程增加到上限，空闲后退回下限
+void testElastic() {
+  cout << "Test elastic ThreadPool" << endl;
+  muduo::ThreadPool pool("ElasticPool");
+  muduo::AtomicInt32 inits;
+  pool.setElastic(1, 4, 0.005, 0.2);
+  pool.setCollectStats(true);
+  pool.setThreadInitCallback([&inits] { inits.increment(); });
+  pool.start(1);
+  assert(pool.numThreads() == 1);
+
+  muduo::CountDownLatch latch(40);
+  for (int i = 0; i < 40; ++i) {
+    pool.run([&latch] {
+      usleep(10 * 1000);
+      latch.countDown();
+    });
+  }
+  latch.wait();
+  int peak = pool.numThreads();
+  cout << "peak threads = " << peak << ", init callbacks = " << inits.get()
+       << endl;
+  assert(peak > 1 && peak <= 4);
+  assert(inits.get() == peak);
+
+  usleep(600 * 1000);
+  cout << "threads after idle = " << pool.numThreads() << endl;
+  assert(pool.numThreads() == 1);
+
+  cout << "queue wait(us): " << pool.queueWaitHistogram()->toString() << endl;
+  cout << "run time(us): " << pool.runTimeHistogram()->toString() << endl;
+  assert(pool.runTimeHistogram()->count() == 40);
+  pool.stop();
+  (void)peak;
+}
+
 int main() {
   test(0);
+  testElastic();
   //test(1);
   //test(5);
   //test(10);
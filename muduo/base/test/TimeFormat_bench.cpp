@@ -0,0 +1,139 @@
+#include "../CountDownLatch.h"
+#include "../LogStream.h"
+#include "../Logging.h"
+#include "../Thread.h"
+#include "../TimeFormat.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+using namespace muduo;
+
+// 原来Logger::Impl::formatTime()的做法：每个线程缓存一秒，微秒用snprintf
+__thread char t_time[64];
+__thread time_t t_lastSecond;
+
+int oldFormatTime(Timestamp time, char *buf) {
+  int64_t microSecondsSinceEpoch = time.microSecondsSinceEpoch();
+  time_t seconds = static_cast<time_t>(microSecondsSinceEpoch /
+                                       Timestamp::kMicroSecondsPerSecond);
+  int microseconds = static_cast<int>(microSecondsSinceEpoch %
+                                      Timestamp::kMicroSecondsPerSecond);
+  if (seconds != t_lastSecond) {
+    t_lastSecond = seconds;
+    struct tm tm_time;
+    ::gmtime_r(&seconds, &tm_time);
+    snprintf(t_time, sizeof t_time, "%4d%02d%02d %02d:%02d:%02d",
+             tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+             tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+  }
+  Fmt us(".%06dZ", microseconds);
+  memcpy(buf, t_time, 17);
+  memcpy(buf + 17, us.data(), 8);
+  return 25;
+}
+
+int newFormatTime(Timestamp time, char *buf) {
+  return Logger::formatTime(time, buf);
+}
+
+void testFormat() {
+  char buf[Logger::kTimeLength];
+  int len = Logger::formatTime(Timestamp(1422366405376742), buf);
+  assert(len == 25);
+  assert(memcmp(buf, "20150127 13:46:45.376742Z", 25) == 0);
+  len = Logger::formatTime(Timestamp(-1), buf);
+  assert(memcmp(buf, "19691231 23:59:59.999999Z", 25) == 0);
+  // 年份不是四位数时与snprintf一致
+  len = Logger::formatTime(Timestamp(253402300800000000), buf);
+  assert(len == 26 && memcmp(buf, "100000101 00:00:00.000000Z", 26) == 0);
+  len = Logger::formatTime(Timestamp(-62168219200000000), buf);
+  assert(len == 25 && memcmp(buf, "-0011220 10:13:20.000000Z", 25) == 0);
+  (void)len;
+
+  // 每个线程交错格式化相邻的秒，结果都要与gmtime_r一致
+  const int kThreads = 4;
+  CountDownLatch latch(kThreads);
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back(new Thread([t, &latch] {
+      int64_t us = 1400000000LL * 1000000 + t * 7;
+      for (int i = 0; i < 200 * 1000; ++i) {
+        us += 3001 * (i % 3 == 2 ? -1 : 1) + 17 * t;
+        char got[Logger::kTimeLength];
+        char expected[Logger::kTimeLength];
+        int gotLen = Logger::formatTime(Timestamp(us), got);
+        oldFormatTime(Timestamp(us), expected);
+        if (gotLen != 25 || memcmp(got, expected, 25) != 0) {
+          printf("WRONG %.25s != %.25s\n", got, expected);
+          assert(0);
+        }
+      }
+      latch.countDown();
+    }));
+    threads.back()->start();
+  }
+  latch.wait();
+  for (auto &thr : threads) {
+    thr->join();
+  }
+}
+
+// 所有线程共用的模拟时钟，每格式化一次前进step微秒
+std::atomic<int64_t> g_now;
+
+template <typename F>
+void bench(const char *name, int threads, int64_t step, F format) {
+  const int kN = 10 * 1000 * 1000;
+  CountDownLatch latch(threads);
+  std::vector<std::unique_ptr<Thread>> pool;
+  g_now.store(Timestamp::now().microSecondsSinceEpoch());
+  Timestamp start(Timestamp::now());
+  for (int t = 0; t < threads; ++t) {
+    pool.emplace_back(new Thread([&latch, step, format] {
+      char buf[Logger::kTimeLength];
+      int64_t sink = 0;
+      for (int i = 0; i < kN; ++i) {
+        int64_t us = g_now.fetch_add(step, std::memory_order_relaxed);
+        sink += format(Timestamp(us), buf) + buf[24];
+      }
+      if (sink == 0) {
+        printf("%lld\n", static_cast<long long>(sink));
+      }
+      latch.countDown();
+    }));
+    pool.back()->start();
+  }
+  latch.wait();
+  for (auto &thr : pool) {
+    thr->join();
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  printf("%-40s %6.2f ns/prefix\n", name, seconds * 1e9 / kN / threads);
+}
+
+int main() {
+  testFormat();
+  // 每行前进1us：几乎总在同一秒；前进30ms：每三十多行换一秒
+  const int64_t kSteps[] = {1, 30 * 1000};
+  for (int64_t step : kSteps) {
+    for (int threads = 1; threads <= 4; threads *= 4) {
+      char name[64];
+      snprintf(name, sizeof name, "per-thread snprintf step=%lldus %dt",
+               static_cast<long long>(step), threads);
+      bench(name, threads, step, oldFormatTime);
+      snprintf(name, sizeof name, "shared cache step=%lldus %dt",
+               static_cast<long long>(step), threads);
+      bench(name, threads, step, newFormatTime);
+    }
+  }
+  TimeZone beijing(8 * 3600, "CST");
+  Logger::setTimeZone(beijing);
+  bench("shared cache CST step=1us 1t", 1, 1, newFormatTime);
+  bench("shared cache CST step=30000us 1t", 1, 30 * 1000, newFormatTime);
+}
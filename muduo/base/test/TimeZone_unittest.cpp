@@ -1,10 +1,16 @@
 #include "../TimeZone.h"
+#include "../TimeFormat.h"
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <vector>
+
 using muduo::TimeZone;
+using muduo::TimeFormatCache;
+using muduo::Timestamp;
 
 struct tm getTm(int year, int month, int day, int hour, int minute,
                 int seconds) {
@@ -187,14 +193,14 @@ void testSydney() {
   TimeZone tz("/usr/share/zoneinfo/Australia/Sydney");
   TestCase cases[] = {
 
-      {"2011-01-01 00:00:00", "2011-01-01 11:00:00+1100(EST)", true},
-      {"2011-04-02 15:59:59", "2011-04-03 02:59:59+1100(EST)", true},
-      {"2011-04-02 16:00:00", "2011-04-03 02:00:00+1000(EST)", false},
-      {"2011-04-02 16:59:59", "2011-04-03 02:59:59+1000(EST)", false},
-      {"2011-05-02 01:00:00", "2011-05-02 11:00:00+1000(EST)", false},
-      {"2011-10-01 15:59:59", "2011-10-02 01:59:59+1000(EST)", false},
-      {"2011-10-01 16:00:00", "2011-10-02 03:00:00+1100(EST)", true},
-      {"2011-12-31 22:00:00", "2012-01-01 09:00:00+1100(EST)", true},
+      {"2011-01-01 00:00:00", "2011-01-01 11:00:00+1100(AEDT)", true},
+      {"2011-04-02 15:59:59", "2011-04-03 02:59:59+1100(AEDT)", true},
+      {"2011-04-02 16:00:00", "2011-04-03 02:00:00+1000(AEST)", false},
+      {"2011-04-02 16:59:59", "2011-04-03 02:59:59+1000(AEST)", false},
+      {"2011-05-02 01:00:00", "2011-05-02 11:00:00+1000(AEST)", false},
+      {"2011-10-01 15:59:59", "2011-10-02 01:59:59+1000(AEST)", false},
+      {"2011-10-01 16:00:00", "2011-10-02 03:00:00+1100(AEDT)", true},
+      {"2011-12-31 22:00:00", "2012-01-01 09:00:00+1100(AEDT)", true},
 
   };
 
@@ -236,11 +242,202 @@ void testFixedTimezone() {
   }
 }
 
-int main() {
+bool sameTm(const struct tm &lhs, const struct tm &rhs) {
+  return lhs.tm_year == rhs.tm_year && lhs.tm_mon == rhs.tm_mon &&
+         lhs.tm_mday == rhs.tm_mday && lhs.tm_hour == rhs.tm_hour &&
+         lhs.tm_min == rhs.tm_min && lhs.tm_sec == rhs.tm_sec &&
+         lhs.tm_wday == rhs.tm_wday && lhs.tm_yday == rhs.tm_yday &&
+         lhs.tm_isdst == rhs.tm_isdst && lhs.tm_gmtoff == rhs.tm_gmtoff;
+}
+
+// 与glibc的localtime_r对比，时间跳跃着走，覆盖缓存命中、下一个区间和二分查找
+void testAgainstLocaltime(const char *zone) {
+  std::string path = std::string("/usr/share/zoneinfo/") + zone;
+  TimeZone tz(path.c_str());
+  ::setenv("TZ", (":" + path).c_str(), 1);
+  ::tzset();
+  std::vector<time_t> times;
+  const time_t kStart = getGmt(1971, 1, 1, 0, 0, 0);
+  const time_t kEnd = getGmt(2037, 12, 31, 0, 0, 0);
+  for (time_t t = kStart; t < kEnd; t += 3600 * 7 + 13) {
+    times.push_back(t);
+  }
+  unsigned seed = 1;
+  for (int i = 0; i < 10000; ++i) {
+    times.push_back(kStart + rand_r(&seed) % (kEnd - kStart));
+  }
+
+  std::vector<struct tm> bulk(times.size());
+  tz.toLocalTime(times.data(), times.size(), bulk.data());
+  std::vector<char> formatted(times.size() * TimeZone::kSecondsFormatLength);
+  tz.formatLocalTime(times.data(), times.size(), formatted.data());
+  for (size_t i = 0; i < times.size(); ++i) {
+    struct tm expected;
+    ::localtime_r(&times[i], &expected);
+    struct tm single = tz.toLocalTime(times[i]);
+    char buf[32];
+    strftime(buf, sizeof buf, "%Y%m%d %H:%M:%S", &expected);
+    const char *got = &formatted[i * TimeZone::kSecondsFormatLength];
+    if (!sameTm(single, expected) || !sameTm(bulk[i], expected) ||
+        memcmp(got, buf, TimeZone::kSecondsFormatLength) != 0) {
+      printf("WRONG %s %ld: %s %.17s\n", zone, static_cast<long>(times[i]),
+             buf, got);
+      assert(0);
+    }
+  }
+  ::unsetenv("TZ");
+  ::tzset();
+  printf("%s: %zd times match localtime_r\n", zone, times.size());
+}
+
+// 固定时区、负的时间戳和微秒
+void testTimestampFormat() {
+  TimeZone tz(8 * 3600, "CST");
+  Timestamp times[] = {
+      Timestamp(0), Timestamp(1), Timestamp(-1),
+      Timestamp(1422366405376742), Timestamp(-86400LL * 1000000 * 365 - 7),
+  };
+  const char *expected[] = {
+      "19700101 08:00:00.000000", "19700101 08:00:00.000001",
+      "19700101 07:59:59.999999", "20150127 21:46:45.376742",
+      "19690101 07:59:59.999993",
+  };
+  const size_t n = sizeof times / sizeof times[0];
+  char buf[n * TimeZone::kMicrosecondsFormatLength];
+  tz.formatLocalTime(times, n, buf);
+  struct tm tms[n];
+  tz.toLocalTime(times, n, tms);
+  for (size_t i = 0; i < n; ++i) {
+    const char *got = buf + i * TimeZone::kMicrosecondsFormatLength;
+    if (memcmp(got, expected[i], TimeZone::kMicrosecondsFormatLength) != 0 ||
+        tms[i].tm_gmtoff != 8 * 3600) {
+      printf("WRONG %.24s != %s\n", got, expected[i]);
+      assert(0);
+    }
+  }
+}
+
+// 年份不在0..9999之内：批量格式化写成'*'，TimeFormatCache与snprintf一致
+void testYearRange() {
+  TimeZone tz(8 * 3600, "CST");
+  Timestamp times[] = {
+      Timestamp(-62168219200000000), Timestamp(253402300800000000),
+      Timestamp(253402271999999999),
+  };
+  const size_t n = sizeof times / sizeof times[0];
+  char buf[n * TimeZone::kMicrosecondsFormatLength];
+  tz.formatLocalTime(times, n, buf);
+  assert(memcmp(buf, "*****************.000000", 24) == 0);
+  assert(memcmp(buf + 24, "*****************.000000", 24) == 0);
+  assert(memcmp(buf + 48, "99991231 23:59:59.999999", 24) == 0);
+  struct tm tms[n];
+  tz.toLocalTime(times, n, tms);
+  assert(tms[0].tm_year + 1900 == -1 && tms[1].tm_year + 1900 == 10000);
+
+  TimeFormatCache cache(tz);
+  const char *expected[] = {
+      "-0011220 18:13:20.000000",
+      "100000101 08:00:00.000000",
+      "99991231 23:59:59.999999",
+  };
+  for (size_t i = 0; i < n; ++i) {
+    char got[TimeFormatCache::kMaxMicrosecondsFormatLength];
+    int len = cache.formatMicroseconds(times[i], got);
+    if (len != static_cast<int>(strlen(expected[i])) ||
+        memcmp(got, expected[i], static_cast<size_t>(len)) != 0) {
+      printf("WRONG %.*s != %s\n", len, got, expected[i]);
+      assert(0);
+    }
+  }
+}
+
+double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<double>(ts.tv_sec) +
+         static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+// 日志一样的时间序列：每次前进几百毫秒，秒数不断变化
+// 每轮转换kBatch个，数组留在cache里，测的是转换本身
+void benchThroughput() {
+  TimeZone tz("/usr/share/zoneinfo/America/New_York");
+  ::setenv("TZ", ":/usr/share/zoneinfo/America/New_York", 1);
+  ::tzset();
+  const size_t kBatch = 4096;
+  const int kRounds = 256;
+  const double kTotal = static_cast<double>(kBatch) * kRounds;
+  std::vector<time_t> times(kBatch);
+  std::vector<Timestamp> stamps(kBatch);
+  std::vector<struct tm> tms(kBatch);
+  std::vector<char> buf(kBatch * TimeZone::kMicrosecondsFormatLength);
+  int64_t us = 1400000000LL * 1000000;
+  double elapsed[6] = {0, 0, 0, 0, 0, 0};
+  int64_t sink = 0;
+
+  for (int round = 0; round < kRounds; ++round) {
+    for (size_t i = 0; i < kBatch; ++i) {
+      us += 300 * 1000 + static_cast<int64_t>(i % 1000);
+      times[i] = static_cast<time_t>(us / 1000000);
+      stamps[i] = Timestamp(us);
+    }
+    double t0 = now();
+    for (size_t i = 0; i < kBatch; ++i) {
+      ::localtime_r(&times[i], &tms[i]);
+    }
+    double t1 = now();
+    for (size_t i = 0; i < kBatch; ++i) {
+      tms[i] = tz.toLocalTime(times[i]);
+    }
+    double t2 = now();
+    tz.toLocalTime(times.data(), kBatch, tms.data());
+    double t3 = now();
+    for (size_t i = 0; i < kBatch; ++i) {
+      strftime(buf.data() + i * TimeZone::kMicrosecondsFormatLength,
+               TimeZone::kMicrosecondsFormatLength, "%Y%m%d %H:%M:%S",
+               &tms[i]);
+    }
+    double t4 = now();
+    tz.formatLocalTime(times.data(), kBatch, buf.data());
+    double t5 = now();
+    tz.formatLocalTime(stamps.data(), kBatch, buf.data());
+    double t6 = now();
+    elapsed[0] += t1 - t0;
+    elapsed[1] += t2 - t1;
+    elapsed[2] += t3 - t2;
+    elapsed[3] += t4 - t3;
+    elapsed[4] += t5 - t4;
+    elapsed[5] += t6 - t5;
+    sink += tms[kBatch - 1].tm_sec + buf[0];
+  }
+  ::unsetenv("TZ");
+  ::tzset();
+
+  const char *names[] = {
+      "localtime_r",          "toLocalTime",
+      "toLocalTime bulk",     "strftime",
+      "formatLocalTime bulk", "formatLocalTime bulk (us)",
+  };
+  printf("ns per time (%.0f times):\n", kTotal);
+  for (int i = 0; i < 6; ++i) {
+    printf("  %-26s %6.1f\n", names[i], elapsed[i] * 1e9 / kTotal);
+  }
+  printf("  %lld\n", static_cast<long long>(sink % 10));
+}
+
+int main(int argc, char *argv[]) {
   testNewYork();
   testLondon();
   testSydney();
   testHongKong();
   testFixedTimezone();
   testUtc();
+  testAgainstLocaltime("America/New_York");
+  testAgainstLocaltime("Europe/London");
+  testAgainstLocaltime("Australia/Sydney");
+  testTimestampFormat();
+  testYearRange();
+  if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+    benchThroughput();
+  }
 }
@@ -1,6 +1,7 @@
 #include "../Timestamp.h"
 #include <vector>
 #include <stdio.h>
+#include <stdlib.h>
 
 using muduo::Timestamp;
 
@@ -60,8 +61,39 @@ void benchmark()
   }
 }
 
+// 1970年以前的时间向下取整到秒
+void testBeforeEpoch()
+{
+  Timestamp t(-1);
+  if (t.toFormattedString(false) != "19691231 23:59:59" ||
+      t.toFormattedString(true) != "19691231 23:59:59:999999")
+  {
+    printf("bad format %s %s\n", t.toFormattedString(false).c_str(),
+           t.toFormattedString(true).c_str());
+    exit(1);
+  }
+}
+
+// 年份不是四位数时与原来的snprintf一致，不截断也不越界
+void testYearRange()
+{
+  Timestamp before(-62168219200000000);
+  Timestamp after(253402300800000000);
+  if (before.toFormattedString() != "-0011220 10:13:20:000000" ||
+      before.toFormattedString(false) != "-0011220 10:13:20" ||
+      after.toFormattedString() != "100000101 00:00:00:000000" ||
+      after.toFormattedString(false) != "100000101 00:00:00")
+  {
+    printf("bad format %s %s\n", before.toFormattedString().c_str(),
+           after.toFormattedString().c_str());
+    exit(1);
+  }
+}
+
 int main()
 {
+  testBeforeEpoch();
+  testYearRange();
   Timestamp now(Timestamp::now());//构造函数初始化一个Timestamp，时间为当前时间
   printf("%s\n", now.toString().c_str());//打印当前时间微秒数
   passByValue(now);//打印当前时间微秒数
@@ -0,0 +1,39 @@
+#include "../BinaryLogging.h"
+
+#include <stdio.h>
+
+using namespace muduo;
+
+// 把BinaryLogger直接写入文件的二进制日志还原成文本
+// usage: binlog_decode [file]，不指定文件时读stdin
+int main(int argc, char *argv[]) {
+  FILE *fp = argc > 1 ? fopen(argv[1], "rb") : stdin;
+  if (fp == NULL) {
+    perror("fopen");
+    return 1;
+  }
+
+  BinaryLogDecoder decoder;
+  string pending; // 上一次没有解码完的条目
+  string text;
+  char buf[64 * 1024];
+  size_t n = 0;
+  while ((n = fread(buf, 1, sizeof buf, fp)) > 0) {
+    pending.append(buf, n);
+    size_t decoded = decoder.decode(pending.data(), pending.size(), &text);
+    pending.erase(0, decoded);
+    fwrite(text.data(), 1, text.size(), stdout);
+    text.clear();
+    if (decoder.error()) {
+      fprintf(stderr, "binlog_decode: malformed input\n");
+      return 1;
+    }
+  }
+  if (!pending.empty()) {
+    fprintf(stderr, "binlog_decode: %zd bytes truncated at end of input\n",
+            pending.size());
+  }
+  if (fp != stdin) {
+    fclose(fp);
+  }
+}
@@ -69,7 +69,7 @@ int main()
 
   int i, nfds;
   socklen_t clilen;
-  ssize_t n;
+  ssize_t n = 0;
   char buf[MAXLINE];
 
   while (1) {
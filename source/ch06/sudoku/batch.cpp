@@ -0,0 +1,161 @@
+#include "sudoku.h"
+
+#include "CountDownLatch.h"
+#include "ThreadPool.h"
+#include "Timestamp.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+
+// 批量求解数独，比较几种向ThreadPool提交任务、收集结果的方式
+
+typedef std::vector<string> Puzzles;
+
+const char* kSamples[] = {
+  "000000010400000000020000000000050407008000300001090000300400200050100000000806000",
+  "000000012000035000000600070700000300000400800100000000000120000080000040050000600",
+  "000000012003600000000007000410020000000500300700000600280000040000300500000000000",
+  "000000012008030000000000040120500000000004700060000000507000300000620000000100000",
+};
+
+Puzzles readPuzzles(const char* file, int count)
+{
+  Puzzles puzzles;
+  if (file)
+  {
+    std::ifstream in(file);
+    std::string line;
+    while (std::getline(in, line))
+    {
+      if (line.size() >= kCells)
+        puzzles.push_back(line.substr(0, kCells));
+    }
+  }
+  else
+  {
+    const int n = static_cast<int>(sizeof kSamples / sizeof kSamples[0]);
+    for (int i = 0; i < count; ++i)
+      puzzles.push_back(kSamples[i % n]);
+  }
+  return puzzles;
+}
+
+void report(const char* name, const Puzzles& puzzles, Timestamp start,
+            const std::vector<string>& results, const std::vector<string>& expected)
+{
+  double seconds = timeDifference(Timestamp::now(), start);
+  bool same = results == expected;
+  printf("%-28s %8.3f s %10.0f puzzles/s %s\n", name, seconds,
+         static_cast<double>(puzzles.size()) / seconds, same ? "" : "MISMATCH");
+}
+
+// 原来的做法：每道题一个run()，结果写进共享的vector，CountDownLatch等待全部完成
+void solveWithLatch(ThreadPool& pool, const Puzzles& puzzles,
+                    std::vector<string>* results)
+{
+  CountDownLatch latch(static_cast<int>(puzzles.size()));
+  for (size_t i = 0; i < puzzles.size(); ++i)
+  {
+    pool.run([&puzzles, results, &latch, i] {
+      (*results)[i] = solveSudoku(puzzles[i]);
+      latch.countDown();
+    });
+  }
+  latch.wait();
+}
+
+// submit()返回Future，then()在同一个线程上检查结果
+void solveWithFutures(ThreadPool& pool, const Puzzles& puzzles,
+                      std::vector<string>* results, int* unsolved)
+{
+  std::vector<Future<string>> futures;
+  futures.reserve(puzzles.size());
+  for (size_t i = 0; i < puzzles.size(); ++i)
+  {
+    const string* puzzle = &puzzles[i];
+    futures.push_back(pool.submit([puzzle] { return solveSudoku(*puzzle); }));
+  }
+
+  std::vector<Future<bool>> checks;
+  checks.reserve(puzzles.size());
+  for (size_t i = 0; i < futures.size(); ++i)
+  {
+    string* result = &(*results)[i];
+    checks.push_back(futures[i].then([result](string solution) {
+      *result = std::move(solution);
+      return *result != kNoSolution;
+    }));
+  }
+
+  *unsolved = 0;
+  for (auto& check : checks)
+  {
+    if (!check.get())
+      ++*unsolved;
+  }
+}
+
+// 把题目分成若干块，runBatch()一次加锁提交，每块只有一次countDown
+void solveWithBatch(ThreadPool& pool, const Puzzles& puzzles,
+                    std::vector<string>* results, int chunks)
+{
+  CountDownLatch latch(chunks);
+  std::vector<ThreadPool::Task> tasks;
+  tasks.reserve(chunks);
+  size_t perChunk = (puzzles.size() + chunks - 1) / chunks;
+  for (int c = 0; c < chunks; ++c)
+  {
+    size_t begin = std::min(puzzles.size(), c * perChunk);
+    size_t end = std::min(puzzles.size(), begin + perChunk);
+    tasks.push_back([&puzzles, results, &latch, begin, end] {
+      for (size_t i = begin; i < end; ++i)
+        (*results)[i] = solveSudoku(puzzles[i]);
+      latch.countDown();
+    });
+  }
+  pool.runBatch(tasks.begin(), tasks.end());
+  latch.wait();
+}
+
+int main(int argc, char* argv[])
+{
+  int numThreads = argc > 1 ? atoi(argv[1]) : 4;
+  const char* file = argc > 2 ? argv[2] : NULL;
+  Puzzles puzzles = readPuzzles(file, 20000);
+  printf("%zu puzzles, %d threads\n", puzzles.size(), numThreads);
+
+  std::vector<string> expected(puzzles.size());
+  Timestamp start(Timestamp::now());
+  for (size_t i = 0; i < puzzles.size(); ++i)
+    expected[i] = solveSudoku(puzzles[i]);
+  report("serial", puzzles, start, expected, expected);
+
+  ThreadPool pool("SudokuBatch");
+  pool.start(numThreads);
+
+  std::vector<string> results(puzzles.size());
+  start = Timestamp::now();
+  solveWithLatch(pool, puzzles, &results);
+  report("run() + CountDownLatch", puzzles, start, results, expected);
+
+  results.assign(puzzles.size(), string());
+  int unsolved = 0;
+  start = Timestamp::now();
+  solveWithFutures(pool, puzzles, &results, &unsolved);
+  report("submit() + then()", puzzles, start, results, expected);
+
+  results.assign(puzzles.size(), string());
+  start = Timestamp::now();
+  solveWithBatch(pool, puzzles, &results, numThreads * 4);
+  report("runBatch()", puzzles, start, results, expected);
+
+  printf("unsolved: %d\n", unsolved);
+  pool.stop();
+}
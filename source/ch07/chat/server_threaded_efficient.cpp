@@ -1,7 +1,7 @@
 #include "codec.h"
 
 #include "Logging.h"
-#include "Mutex.h"
+#include "RcuSnapshot.h"
 #include "EventLoop.h"
 #include "TcpServer.h"
 
@@ -18,8 +18,7 @@ class ChatServer : noncopyable
   ChatServer(EventLoop* loop,
              const InetAddress& listenAddr)
   : server_(loop, listenAddr, "ChatServer"),
-    codec_(std::bind(&ChatServer::onStringMessage, this, _1, _2, _3)),
-    connections_(new ConnectionList)
+    codec_(std::bind(&ChatServer::onStringMessage, this, _1, _2, _3))
   {
     server_.setConnectionCallback(
         std::bind(&ChatServer::onConnection, this, _1));
@@ -44,32 +43,29 @@ class ChatServer : noncopyable
         << conn->localAddress().toIpPort() << " is "
         << (conn->connected() ? "UP" : "DOWN");
 
-    MutexLockGuard lock(mutex_);
-    if (!connections_.unique())
+    bool connected = conn->connected();
+    connections_.update([&conn, connected](ConnectionList& connections)
     {
-      connections_.reset(new ConnectionList(*connections_));
-    }
-    assert(connections_.unique());
-
-    if (conn->connected())
-    {
-      connections_->insert(conn);
-    }
-    else
-    {
-      connections_->erase(conn);
-    }
+      if (connected)
+      {
+        connections.insert(conn);
+      }
+      else
+      {
+        connections.erase(conn);
+      }
+    });
   }
 
   typedef std::set<TcpConnectionPtr> ConnectionList;
-  typedef std::shared_ptr<ConnectionList> ConnectionListPtr;
 
   void onStringMessage(const TcpConnectionPtr&,
                        const string& message,
                        Timestamp)
   {
-    ConnectionListPtr connections = getConnectionList();
-    for (ConnectionList::iterator it = connections->begin();
+    // 不加锁也不修改引用计数，各IO线程广播时互不干扰
+    RcuSnapshot<ConnectionList>::ReadGuard connections(connections_);
+    for (ConnectionList::const_iterator it = connections->begin();
         it != connections->end();
         ++it)
     {
@@ -77,16 +73,9 @@ class ChatServer : noncopyable
     }
   }
 
-  ConnectionListPtr getConnectionList()
-  {
-    MutexLockGuard lock(mutex_);
-    return connections_;
-  }
-
   TcpServer server_;
   LengthHeaderCodec codec_;
-  MutexLock mutex_;
-  ConnectionListPtr connections_ GUARDED_BY(mutex_);
+  RcuSnapshot<ConnectionList> connections_;
 };
 
 int main(int argc, char* argv[])